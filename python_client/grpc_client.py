@@ -16,6 +16,7 @@
 
 from __future__ import annotations
 
+import hashlib
 import sys
 import time
 from pathlib import Path
@@ -40,6 +41,38 @@ if TYPE_CHECKING:
     from collections.abc import Iterator
     from typing import Any
 
+# Inputs above this size are streamed with ExecuteUpload instead of being
+# sent as one message, which the server would hold in memory and may reject.
+UPLOAD_THRESHOLD_BYTES = 1024 * 1024
+
+# Size of each stdin chunk sent by ExecuteUpload.
+UPLOAD_CHUNK_BYTES = 256 * 1024
+
+
+def _upload_chunks(language: str, code: str, stdin_data: str) -> Iterator[Any]:
+    """Yield the ExecuteUpload message sequence for one request.
+
+    The first message carries the request with the code inline; stdin follows
+    in UPLOAD_CHUNK_BYTES pieces.
+    """
+    yield sandbox_pb2.UploadChunk(
+        request=sandbox_pb2.CodeRequest(language=language, code=code)
+    )
+    data = stdin_data.encode("utf-8")
+    for offset in range(0, len(data), UPLOAD_CHUNK_BYTES):
+        yield sandbox_pb2.UploadChunk(
+            stdin_chunk=data[offset:offset + UPLOAD_CHUNK_BYTES]
+        )
+
+
+def _blob_chunks(data: bytes, digest: str) -> Iterator[Any]:
+    """Yield the UploadBlob message sequence for data with a known digest."""
+    yield sandbox_pb2.BlobChunk(data=data[:UPLOAD_CHUNK_BYTES], digest=digest)
+    for offset in range(UPLOAD_CHUNK_BYTES, len(data), UPLOAD_CHUNK_BYTES):
+        yield sandbox_pb2.BlobChunk(
+            data=data[offset:offset + UPLOAD_CHUNK_BYTES]
+        )
+
 
 class GrpcClient:
     """gRPC client for communicating with the DCodeX server."""
@@ -66,6 +99,7 @@ class GrpcClient:
             language: str,
             description: str = "",
             stdin_data: str = "",
+            stdin_digest: str = "",
     ) -> ExecutionResult:
         """Execute code and return results with timing.
 
@@ -75,6 +109,8 @@ class GrpcClient:
             description: Optional description of the code.
             stdin_data: Data to feed to the program's standard input.
                 Empty string means the program receives EOF immediately.
+            stdin_digest: Digest of a blob stored with upload_blob() to use
+                as stdin instead of stdin_data.
 
         Returns:
             ExecutionResult containing stdout, stderr, timing, and cache status.
@@ -85,15 +121,73 @@ class GrpcClient:
         if self._stub is None:
             raise RuntimeError("gRPC stub not set. Call set_stub() first.")
 
-        request: Any = sandbox_pb2.CodeRequest(
-            language=language,
-            code=code,
-            stdin_data=stdin_data,
+        start_time = time.time()
+        responses: Iterator[Any]
+        if not stdin_digest and len(stdin_data) > UPLOAD_THRESHOLD_BYTES:
+            responses = self._stub.ExecuteUpload(
+                _upload_chunks(language, code, stdin_data)
+            )
+        else:
+            request: Any = sandbox_pb2.CodeRequest(
+                language=language,
+                code=code,
+                stdin_data=stdin_data,
+                stdin_digest=stdin_digest,
+            )
+            responses = self._stub.Execute(request)
+        return self._collect(responses, start_time)
+
+    def compile_program(self, code: str, language: str) -> str:
+        """Build code once on the server for later run_program() calls.
+
+        Args:
+            code: Code to build.
+            language: Execution language ("c", "cpp", or "python").
+
+        Returns:
+            The program's handle, valid until it goes unused for the lease
+            TTL the server reports.
+
+        Raises:
+            RuntimeError: If no stub has been set or the build failed.
+        """
+        if self._stub is None:
+            raise RuntimeError("gRPC stub not set. Call set_stub() first.")
+
+        response = self._stub.Compile(
+            sandbox_pb2.CompileRequest(language=language, code=code)
         )
+        if not response.success:
+            raise RuntimeError(
+                f"Compilation failed:\n{response.compiler_output}"
+            )
+        return response.handle
+
+    def run_program(self, handle: str, stdin_data: str = "") -> ExecutionResult:
+        """Run a program from compile_program() without rebuilding it.
+
+        Args:
+            handle: Handle returned by compile_program().
+            stdin_data: Data to feed to the program's standard input.
+
+        Returns:
+            ExecutionResult as for execute_code().
+
+        Raises:
+            RuntimeError: If no stub has been set.
+        """
+        if self._stub is None:
+            raise RuntimeError("gRPC stub not set. Call set_stub() first.")
 
         start_time = time.time()
-        responses: Iterator[Any] = self._stub.Execute(request)
+        responses = self._stub.Run(
+            sandbox_pb2.RunRequest(handle=handle, stdin_data=stdin_data)
+        )
+        return self._collect(responses, start_time)
 
+    @staticmethod
+    def _collect(responses: Iterator[Any], start_time: float) -> ExecutionResult:
+        """Print a stream of ExecutionLogs as it arrives and summarize it."""
         peak_memory = 0
         execution_time = 0.0
         cache_hit = False
@@ -142,3 +236,27 @@ class GrpcClient:
             wall_clock_timeout=wall_clock_timeout,
             output_truncated=output_truncated,
         )
+
+    def upload_blob(self, data: bytes) -> str:
+        """Store data on the server unless it is already there.
+
+        Args:
+            data: Payload to store, e.g. a test input reused across runs.
+
+        Returns:
+            The payload's SHA-256 hex digest, for CodeRequest.stdin_digest or
+            CodeRequest.code_digest.
+
+        Raises:
+            RuntimeError: If no stub has been set.
+        """
+        if self._stub is None:
+            raise RuntimeError("gRPC stub not set. Call set_stub() first.")
+
+        digest = hashlib.sha256(data).hexdigest()
+        missing = self._stub.HasBlobs(
+            sandbox_pb2.HasBlobsRequest(digests=[digest])
+        ).missing_digests
+        if digest in missing:
+            self._stub.UploadBlob(_blob_chunks(data, digest))
+        return digest
@@ -0,0 +1,95 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/api/blob_upload_reactor.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "src/api/execute_reactor.h"
+#include "src/common/status_macros.h"
+
+ABSL_DECLARE_FLAG(uint64_t, max_upload_bytes);
+
+namespace dcodex {
+
+BlobUploadReactor::BlobUploadReactor(std::shared_ptr<BlobStore> blobs,
+                                     BlobRef* response)
+    : blobs_(std::move(blobs)), response_(response) {
+  if (blobs_ == nullptr) {
+    Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                        "The blob store is disabled"));
+    return;
+  }
+  StartRead(&chunk_);
+}
+
+void BlobUploadReactor::OnReadDone(bool ok) {
+  if (cancelled_.load()) {
+    // The partial upload is discarded with `upload_`.
+    Finish(grpc::Status::CANCELLED);
+    return;
+  }
+  if (!ok) {
+    // The client half-closed: the upload is complete.
+    const absl::Status completed = Complete();
+    Finish(completed.ok() ? grpc::Status::OK : ToGrpcStatus(completed));
+    return;
+  }
+  if (const absl::Status consumed = Consume(chunk_); !consumed.ok()) {
+    Finish(ToGrpcStatus(consumed));
+    return;
+  }
+  StartRead(&chunk_);
+}
+
+absl::Status BlobUploadReactor::Consume(const BlobChunk& chunk) {
+  if (!chunk.digest().empty()) {
+    if (!expected_digest_.empty() && expected_digest_ != chunk.digest()) {
+      return absl::InvalidArgumentError(
+          "BlobChunks name different expected digests");
+    }
+    expected_digest_ = chunk.digest();
+  }
+  if (chunk.data().empty()) {
+    return absl::OkStatus();
+  }
+  if (upload_ == nullptr) {
+    ABSL_ASSIGN_OR_RETURN(upload_, blobs_->NewUpload());
+  }
+  if (upload_->size() + chunk.data().size() >
+      absl::GetFlag(FLAGS_max_upload_bytes)) {
+    return absl::ResourceExhaustedError("Blob exceeds --max_upload_bytes");
+  }
+  return upload_->Append(chunk.data());
+}
+
+absl::Status BlobUploadReactor::Complete() {
+  if (upload_ == nullptr) {
+    // An empty blob still has a digest; store it like any other.
+    ABSL_ASSIGN_OR_RETURN(upload_, blobs_->NewUpload());
+  }
+  const uint64_t size = upload_->size();
+  ABSL_ASSIGN_OR_RETURN(std::string digest,
+                        blobs_->Commit(std::move(upload_), expected_digest_));
+  response_->set_digest(std::move(digest));
+  response_->set_size_bytes(size);
+  return absl::OkStatus();
+}
+
+}  // namespace dcodex
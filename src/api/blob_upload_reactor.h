@@ -0,0 +1,60 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SRC_API_BLOB_UPLOAD_REACTOR_H_
+#define SRC_API_BLOB_UPLOAD_REACTOR_H_
+
+#include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "proto/sandbox.grpc.pb.h"
+#include "src/common/blob_store.h"
+#include "src/common/content_digest.h"
+
+namespace dcodex {
+
+// Reactor for UploadBlob. Streams the chunks into a BlobStore upload, which
+// hashes them as they are written, and commits the blob when the client
+// half-closes. The reactor deletes itself once gRPC is done with it.
+class BlobUploadReactor final : public grpc::ServerReadReactor<BlobChunk> {
+ public:
+  // Starts reading into `blobs`; with a null store the call fails with
+  // FAILED_PRECONDITION.
+  BlobUploadReactor(std::shared_ptr<BlobStore> blobs, BlobRef* response);
+
+  void OnReadDone(bool ok) override;
+  void OnCancel() override { cancelled_.store(true); }
+  void OnDone() override { delete this; }
+
+ private:
+  // Applies one received chunk.
+  absl::Status Consume(const BlobChunk& chunk);
+  // Commits the blob and fills the response.
+  absl::Status Complete();
+
+  std::shared_ptr<BlobStore> blobs_;
+  BlobRef* response_;
+  BlobChunk chunk_;
+  std::string expected_digest_;
+  std::unique_ptr<DigestingFileWriter> upload_;
+  std::atomic<bool> cancelled_{false};
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_API_BLOB_UPLOAD_REACTOR_H_
@@ -14,21 +14,30 @@
 
 #include "src/api/code_executor_service.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/strings/string_view.h"
+#include "src/api/blob_upload_reactor.h"
 #include "src/api/execute_reactor.h"
+#include "src/engine/sandbox_warm_state.h"
 
 ABSL_DECLARE_FLAG(int, max_concurrent_sandboxes);
+ABSL_DECLARE_FLAG(int, max_concurrent_compiles);
+ABSL_DECLARE_FLAG(bool, worker_warm_state);
+ABSL_DECLARE_FLAG(std::vector<std::string>, python_zygote_preload);
+ABSL_DECLARE_FLAG(std::vector<std::string>, sandbox_namespaces);
 
 namespace dcodex {
 
 class RejectReactor final : public grpc::ServerWriteReactor<ExecutionLog> {
  public:
-  RejectReactor(absl::string_view reason, CodeExecutorServiceImpl* owner)
+  RejectReactor(grpc::Status status, CodeExecutorServiceImpl* owner)
       : owner_(owner) {
-    Finish(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
-                        std::string(reason)));
+    Finish(std::move(status));
   }
 
   void OnDone() override;
@@ -44,18 +53,56 @@ void RejectReactor::OnDone() {
 }
 
 CodeExecutorServiceImpl::CodeExecutorServiceImpl(int max_sandboxes,
-                                                 std::shared_ptr<CacheInterface> cache)
+                                                 std::shared_ptr<CacheInterface> cache,
+                                                 CompilationServices compilation,
+                                                 std::shared_ptr<SandboxSupervisor> supervisor,
+                                                 std::shared_ptr<BlobStore> blobs,
+                                                 std::shared_ptr<ProgramRegistry> programs)
     : active_sandboxes_(0),
       worker_pool_([max_sandboxes]() {
         DynamicWorkerCoordinator::Options opts;
         opts.max_workers = max_sandboxes;
+        absl::StatusOr<int> namespaces = SandboxNamespaces::ParseKinds(
+            absl::GetFlag(FLAGS_sandbox_namespaces));
+        if (!namespaces.ok()) {
+          LOG(WARNING) << "Ignoring --sandbox_namespaces: "
+                       << namespaces.status();
+          namespaces = 0;
+        }
+        // Namespaces live in the warm state, so they bring one of their own
+        // even without --worker_warm_state.
+        const bool warm = absl::GetFlag(FLAGS_worker_warm_state);
+        if (warm || *namespaces != 0) {
+          opts.warm_state_factory = SandboxWarmState::Factory(
+              {.python_zygote = warm,
+               .preload_modules = absl::GetFlag(FLAGS_python_zygote_preload),
+               .namespaces = *namespaces});
+        }
+        return opts;
+      }()),
+      compile_pool_([]() {
+        DynamicWorkerCoordinator::Options opts;
+        opts.min_workers = 1;
+        opts.max_workers =
+            std::max(1, absl::GetFlag(FLAGS_max_concurrent_compiles));
+        // Compile workers run no Python, so they need no zygote.
+        if (absl::GetFlag(FLAGS_worker_warm_state)) {
+          opts.warm_state_factory = SandboxWarmState::Factory({});
+        }
         return opts;
       }()),
-      executor_(std::make_shared<SandboxedProcess>(std::move(cache))) {
+      executor_(std::make_shared<SandboxedProcess>(std::move(cache),
+                                                   std::move(compilation),
+                                                   std::move(supervisor))),
+      blob_store_(std::move(blobs)),
+      programs_(std::move(programs)) {
   worker_pool_.Start();
+  compile_pool_.Start();
 }
 
 CodeExecutorServiceImpl::~CodeExecutorServiceImpl() {
+  // Compile first: its workers may still be dispatching into the run pool.
+  compile_pool_.Shutdown();
   worker_pool_.Shutdown();
   absl::MutexLock lock(&reject_mutex_);
   reject_reactors_.clear();
@@ -76,27 +123,186 @@ grpc::ServerWriteReactor<ExecutionLog>* CodeExecutorServiceImpl::Execute(
     grpc::CallbackServerContext* context, const CodeRequest* request) {
   (void)context;
   if (active_sandboxes_.load() >= absl::GetFlag(FLAGS_max_concurrent_sandboxes)) {
-    auto reactor = std::make_shared<RejectReactor>(
-        "Too many active sandboxes", this);
-    TrackRejectReactor(reactor);
-    return reactor.get();
-  }
-  auto reactor = std::make_shared<ExecuteReactor>(request, active_sandboxes_,
-                                                   &worker_pool_, executor_);
-  
-  LanguageId lang = ParseLanguageId(request->language());
-  absl::StatusOr<WorkerTask*> assignment = worker_pool_.LeaseWorker(lang, reactor);
-  
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Too many active sandboxes"));
+  }
+  auto reactor = ExecuteReactor::Create(request, active_sandboxes_,
+                                        &worker_pool_, executor_);
+  if (const absl::Status resolved = reactor->ResolveBlobs(blob_store_.get());
+      !resolved.ok()) {
+    reactor->CancelBeforeStart();
+    return Reject(ToGrpcStatus(resolved));
+  }
+
+  const absl::Status scheduled = Schedule(reactor);
+  if (!scheduled.ok()) {
+    LOG(WARNING) << "Worker pool rejected request: " << scheduled;
+    reactor->CancelBeforeStart();
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Worker pool rejected request"));
+  }
+  return reactor.get();
+}
+
+grpc::ServerWriteReactor<ExecutionLog>* CodeExecutorServiceImpl::ExecuteBatch(
+    grpc::CallbackServerContext* context, const BatchRequest* request) {
+  (void)context;
+  if (active_sandboxes_.load() >= absl::GetFlag(FLAGS_max_concurrent_sandboxes)) {
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Too many active sandboxes"));
+  }
+  auto reactor = BatchExecuteReactor::Create(request, active_sandboxes_,
+                                             &worker_pool_, executor_);
+  if (const absl::Status resolved = reactor->ResolveBlobs(blob_store_.get());
+      !resolved.ok()) {
+    reactor->CancelBeforeStart();
+    return Reject(ToGrpcStatus(resolved));
+  }
+
+  const absl::Status scheduled = Schedule(reactor);
+  if (!scheduled.ok()) {
+    LOG(WARNING) << "Worker pool rejected batch: " << scheduled;
+    reactor->CancelBeforeStart();
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Worker pool rejected request"));
+  }
+  return reactor.get();
+}
+
+grpc::ServerBidiReactor<UploadChunk, ExecutionLog>*
+CodeExecutorServiceImpl::ExecuteUpload(grpc::CallbackServerContext* context) {
+  (void)context;
+  const bool saturated =
+      active_sandboxes_.load() >= absl::GetFlag(FLAGS_max_concurrent_sandboxes);
+  auto reactor = ExecuteUploadReactor::Create(
+      active_sandboxes_, &worker_pool_, executor_, blob_store_,
+      [this](const std::shared_ptr<ExecuteTask>& task) {
+        return Schedule(task);
+      });
+  if (saturated) {
+    reactor->Reject("Too many active sandboxes");
+  } else {
+    reactor->StartUpload();
+  }
+  return reactor.get();
+}
+
+absl::Status CodeExecutorServiceImpl::Schedule(
+    const std::shared_ptr<ExecuteTask>& reactor) {
+  const CodeRequest& request = reactor->request();
+  // Overlap the compile with the lease wait below; the worker's own compile
+  // step picks up (or joins) the result.
+  executor_->SpeculativeCompile(request.language(), request.code());
+
+  LanguageId lang = ParseLanguageId(request.language());
+  absl::StatusOr<WorkerTask*> assignment;
+  if (lang != LanguageId::kPython && executor_->CanStageCompilation()) {
+    // Two-stage: the compile stage hands the reactor to the run pool itself.
+    assignment = compile_pool_.LeaseWorker(
+        lang, std::make_shared<CompileStageTask>(reactor, executor_,
+                                                 &compile_pool_, &worker_pool_,
+                                                 lang));
+  } else {
+    assignment = worker_pool_.LeaseWorker(lang, reactor);
+  }
+  return assignment.status();
+}
+
+grpc::ServerReadReactor<BlobChunk>* CodeExecutorServiceImpl::UploadBlob(
+    grpc::CallbackServerContext* context, BlobRef* response) {
+  (void)context;
+  return new BlobUploadReactor(blob_store_, response);
+}
+
+grpc::ServerUnaryReactor* CodeExecutorServiceImpl::HasBlobs(
+    grpc::CallbackServerContext* context, const HasBlobsRequest* request,
+    HasBlobsResponse* response) {
+  auto* reactor = context->DefaultReactor();
+  if (blob_store_ == nullptr) {
+    reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                                 "The blob store is disabled"));
+    return reactor;
+  }
+  for (const std::string& digest : request->digests()) {
+    if (!blob_store_->Contains(digest)) {
+      response->add_missing_digests(digest);
+    }
+  }
+  reactor->Finish(grpc::Status::OK);
+  return reactor;
+}
+
+grpc::ServerUnaryReactor* CodeExecutorServiceImpl::Compile(
+    grpc::CallbackServerContext* context, const CompileRequest* request,
+    CompileResponse* response) {
+  auto* reactor = context->DefaultReactor();
+  if (programs_ == nullptr) {
+    reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                                 "Program handles are disabled"));
+    return reactor;
+  }
+  auto task = std::make_shared<CompileProgramTask>(
+      request, response, reactor, executor_, programs_, &compile_pool_);
+  if (const absl::Status resolved = task->ResolveBlobs(blob_store_.get());
+      !resolved.ok()) {
+    reactor->Finish(ToGrpcStatus(resolved));
+    return reactor;
+  }
+  const absl::StatusOr<WorkerTask*> assignment =
+      compile_pool_.LeaseWorker(ParseLanguageId(request->language()), task);
+  if (!assignment.ok()) {
+    LOG(WARNING) << "Compile pool rejected request: " << assignment.status();
+    reactor->Finish(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                 "Compile pool rejected request"));
+  }
+  return reactor;
+}
+
+grpc::ServerWriteReactor<ExecutionLog>* CodeExecutorServiceImpl::Run(
+    grpc::CallbackServerContext* context, const RunRequest* request) {
+  (void)context;
+  if (programs_ == nullptr) {
+    return Reject(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                               "Program handles are disabled"));
+  }
+  if (active_sandboxes_.load() >= absl::GetFlag(FLAGS_max_concurrent_sandboxes)) {
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Too many active sandboxes"));
+  }
+  absl::StatusOr<std::shared_ptr<const PreparedProgram>> program =
+      programs_->Acquire(request->handle());
+  if (!program.ok()) {
+    return Reject(ToGrpcStatus(program.status()));
+  }
+  const LanguageId lang = ParseLanguageId((*program)->language_id());
+  auto reactor = RunPreparedReactor::Create(request, *std::move(program),
+                                            active_sandboxes_, &worker_pool_,
+                                            executor_);
+  if (const absl::Status resolved = reactor->ResolveBlobs(blob_store_.get());
+      !resolved.ok()) {
+    reactor->CancelBeforeStart();
+    return Reject(ToGrpcStatus(resolved));
+  }
+
+  // Straight to the run pool: there is nothing to compile or speculate on.
+  const absl::StatusOr<WorkerTask*> assignment =
+      worker_pool_.LeaseWorker(lang, reactor);
   if (!assignment.ok()) {
-    LOG(WARNING) << "Worker pool rejected request: " << assignment.status();
-    auto reject_reactor = std::make_shared<RejectReactor>(
-        "Worker pool rejected request", this);
-    TrackRejectReactor(reject_reactor);
-    return reject_reactor.get();
+    LOG(WARNING) << "Worker pool rejected run: " << assignment.status();
+    reactor->CancelBeforeStart();
+    return Reject(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               "Worker pool rejected request"));
   }
   return reactor.get();
 }
 
+grpc::ServerWriteReactor<ExecutionLog>* CodeExecutorServiceImpl::Reject(
+    grpc::Status status) {
+  auto reactor = std::make_shared<RejectReactor>(std::move(status), this);
+  TrackRejectReactor(reactor);
+  return reactor.get();
+}
+
 grpc::ServerUnaryReactor* CodeExecutorServiceImpl::GetSystemMetrics(
     grpc::CallbackServerContext* context, const EmptyRequest* /*request*/,
     SystemMetrics* response) {
@@ -114,10 +320,50 @@ grpc::ServerUnaryReactor* CodeExecutorServiceImpl::GetSystemMetrics(
   response->set_total_requests_served(pool_m.total_requests_served);
   response->set_p50_latency_ms(pool_m.p50_latency_ms);
   response->set_p99_latency_ms(pool_m.p99_latency_ms);
+  response->set_run_queue_depth(pool_m.queued_requests);
+  response->set_affinity_hits(pool_m.affinity_hits);
+  response->set_affinity_misses(pool_m.affinity_misses);
+  response->set_affinity_hit_rate(pool_m.affinity_hit_rate);
+
+  const auto compile_m = compile_pool_.GetMetrics();
+  response->set_compile_active_workers(compile_m.active_workers);
+  response->set_compile_pool_size(compile_m.current_pool_size);
+  response->set_compile_queue_depth(compile_m.queued_requests);
+  response->set_compile_p99_wait_ms(compile_m.p99_latency_ms);
+  response->set_compile_governor_permits(exec_m.governor_stats.permits);
+  response->set_compile_governor_in_use(exec_m.governor_stats.in_use);
+  response->set_compile_governor_waiting(exec_m.governor_stats.waiting);
+  response->set_supervised_sandboxes(
+      static_cast<int32_t>(exec_m.supervisor_stats.watching));
 
   response->set_cache_hits(static_cast<int64_t>(exec_m.cache_stats.hits));
   response->set_cache_misses(static_cast<int64_t>(exec_m.cache_stats.misses));
 
+  response->set_artifact_cache_hits(exec_m.artifact_stats.hits);
+  response->set_artifact_cache_misses(exec_m.artifact_stats.misses);
+  response->set_artifact_cache_evictions(exec_m.artifact_stats.evictions);
+  response->set_artifact_cache_bytes(
+      static_cast<int64_t>(exec_m.artifact_stats.total_bytes));
+
+  response->set_tier_fast_hits(exec_m.tier_stats.fast_hits);
+  response->set_tier_optimized_hits(exec_m.tier_stats.optimized_hits);
+  response->set_tier_promotions(exec_m.tier_stats.promotions);
+
+  if (blob_store_ != nullptr) {
+    const BlobStore::Stats blob_stats = blob_store_->GetStats();
+    response->set_blob_store_entries(
+        static_cast<int64_t>(blob_stats.entries));
+    response->set_blob_store_bytes(
+        static_cast<int64_t>(blob_stats.total_bytes));
+    response->set_blob_store_hits(blob_stats.hits);
+    response->set_blob_store_misses(blob_stats.misses);
+  }
+
+  if (programs_ != nullptr) {
+    response->set_program_handles(
+        static_cast<int32_t>(programs_->GetStats().programs));
+  }
+
   // Placeholder for hardware-level metrics if needed in future.
   response->set_peak_memory_usage_bytes(0);
   response->set_cpu_load_average(0.0);
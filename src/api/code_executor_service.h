@@ -23,22 +23,55 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
 #include "proto/sandbox.grpc.pb.h"
+#include "src/common/blob_store.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/program_registry.h"
 #include "src/engine/sandbox.h"
 #include "src/engine/dynamic_worker_coordinator.h"
 
 namespace dcodex {
 
+class ExecuteTask;
 class RejectReactor;
 
 class CodeExecutorServiceImpl final : public CodeExecutor::CallbackService {
  public:
-  explicit CodeExecutorServiceImpl(int max_sandboxes, std::shared_ptr<CacheInterface> cache);
+  // `supervisor` is optional; with one, run workers hand programs to it and
+  // return instead of waiting on them. `blobs` is optional and enables
+  // UploadBlob, HasBlobs and digest references in requests. `programs` is
+  // optional and enables Compile and Run.
+  explicit CodeExecutorServiceImpl(int max_sandboxes, std::shared_ptr<CacheInterface> cache,
+                                   CompilationServices compilation = {},
+                                   std::shared_ptr<SandboxSupervisor> supervisor = nullptr,
+                                   std::shared_ptr<BlobStore> blobs = nullptr,
+                                   std::shared_ptr<ProgramRegistry> programs = nullptr);
   ~CodeExecutorServiceImpl() override;
 
   grpc::ServerWriteReactor<ExecutionLog>* Execute(
       grpc::CallbackServerContext* context, const CodeRequest* request) override;
 
+  grpc::ServerBidiReactor<UploadChunk, ExecutionLog>* ExecuteUpload(
+      grpc::CallbackServerContext* context) override;
+
+  grpc::ServerWriteReactor<ExecutionLog>* ExecuteBatch(
+      grpc::CallbackServerContext* context,
+      const BatchRequest* request) override;
+
+  grpc::ServerReadReactor<BlobChunk>* UploadBlob(
+      grpc::CallbackServerContext* context, BlobRef* response) override;
+
+  grpc::ServerUnaryReactor* HasBlobs(grpc::CallbackServerContext* context,
+                                     const HasBlobsRequest* request,
+                                     HasBlobsResponse* response) override;
+
+  grpc::ServerUnaryReactor* Compile(grpc::CallbackServerContext* context,
+                                    const CompileRequest* request,
+                                    CompileResponse* response) override;
+
+  grpc::ServerWriteReactor<ExecutionLog>* Run(
+      grpc::CallbackServerContext* context, const RunRequest* request) override;
+
   grpc::ServerUnaryReactor* GetSystemMetrics(
       grpc::CallbackServerContext* context, const EmptyRequest* request,
       SystemMetrics* response) override;
@@ -47,9 +80,22 @@ class CodeExecutorServiceImpl final : public CodeExecutor::CallbackService {
   void ReleaseRejectReactor(const RejectReactor* reactor);
 
  private:
+  // Hands `reactor` to the compile or run pool, blocking while the pool is
+  // saturated, and starts a speculative compile to overlap that wait.
+  absl::Status Schedule(const std::shared_ptr<ExecuteTask>& reactor);
+
+  // Ends a server-streaming call with `status` without running anything.
+  grpc::ServerWriteReactor<ExecutionLog>* Reject(grpc::Status status);
+
   std::atomic<int> active_sandboxes_;
+  // Run stage: executes programs (and interpreted languages end to end).
   DynamicWorkerCoordinator worker_pool_;
+  // Compile stage: sized independently so long compiles cannot occupy the
+  // workers that short runs need.
+  DynamicWorkerCoordinator compile_pool_;
   std::shared_ptr<SandboxedProcess> executor_;
+  std::shared_ptr<BlobStore> blob_store_;
+  std::shared_ptr<ProgramRegistry> programs_;
 
   mutable absl::Mutex reject_mutex_;
   absl::flat_hash_map<const RejectReactor*, std::shared_ptr<RejectReactor>>
@@ -14,12 +14,157 @@
 
 #include "src/api/execute_reactor.h"
 
+#include <algorithm>
+
+#include "absl/flags/flag.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "absl/time/time.h"
+#include "src/common/status_macros.h"
 #include "src/engine/dynamic_worker_coordinator.h"
 
+ABSL_DECLARE_FLAG(std::string, upload_dir);
+ABSL_DECLARE_FLAG(uint64_t, max_upload_bytes);
+ABSL_DECLARE_FLAG(int, max_batch_cases);
+ABSL_DECLARE_FLAG(int, batch_case_parallelism);
+
 namespace dcodex {
 
+namespace {
+
+Diagnostic::Severity ToProtoSeverity(CompilerDiagnostic::Severity severity) {
+  switch (severity) {
+    case CompilerDiagnostic::Severity::kError:
+      return Diagnostic::ERROR;
+    case CompilerDiagnostic::Severity::kWarning:
+      return Diagnostic::WARNING;
+    case CompilerDiagnostic::Severity::kNote:
+      return Diagnostic::NOTE;
+  }
+  return Diagnostic::SEVERITY_UNSPECIFIED;
+}
+
+// Appends `diagnostics` to an ExecutionLog or CompileResponse.
+template <typename Message>
+void AddDiagnostics(const std::vector<CompilerDiagnostic>& diagnostics,
+                    Message& message) {
+  for (const auto& diag : diagnostics) {
+    auto* proto_diag = message.add_diagnostics();
+    proto_diag->set_file(diag.file);
+    proto_diag->set_line(diag.line);
+    proto_diag->set_column(diag.column);
+    proto_diag->set_severity(ToProtoSeverity(diag.severity));
+    proto_diag->set_message(diag.message);
+  }
+}
+
+// The stderr text reporting a failed run: its error and backend trace.
+std::string ErrorText(const ExecutionResult& result) {
+  std::string error_msg;
+  if (!result.error_message.empty()) {
+    absl::SubstituteAndAppend(&error_msg, "ERROR: $0\n", result.error_message);
+  }
+  if (!result.backend_trace.empty()) {
+    absl::SubstituteAndAppend(&error_msg, "$0\n", result.backend_trace);
+  }
+  return error_msg;
+}
+
+ExecutionResult ResultOrError(absl::StatusOr<ExecutionResult> result) {
+  if (result.ok()) {
+    return *std::move(result);
+  }
+  ExecutionResult failed;
+  failed.success = false;
+  failed.error_message = std::string(result.status().message());
+  return failed;
+}
+
+// Checks a reference to the blob `digest` in place of an inline field,
+// which is set when `has_inline`. An empty digest references nothing.
+absl::Status CheckBlobRef(const BlobStore* blobs, absl::string_view digest,
+                          bool has_inline, absl::string_view inline_field,
+                          absl::string_view digest_field) {
+  if (digest.empty()) {
+    return absl::OkStatus();
+  }
+  if (blobs == nullptr) {
+    return absl::FailedPreconditionError("The blob store is disabled");
+  }
+  if (!Sha256::IsValidHexDigest(digest)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Malformed blob digest '", digest,
+                     "': expected 64 lowercase hex characters"));
+  }
+  if (has_inline) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Set either ", inline_field, " or ", digest_field, ", not both"));
+  }
+  return absl::OkStatus();
+}
+
+// The expectation `expected` describes. Its bytes, inline or read from the
+// blob store, are copied into `storage`, which must outlive the run: the
+// request itself is freed when the call ends.
+absl::StatusOr<OutputExpectation> ResolveExpectation(
+    BlobStore* blobs, const ExpectedOutput& expected, std::string& storage) {
+  ABSL_RETURN_IF_ERROR(CheckBlobRef(blobs, expected.digest(),
+                                    !expected.data().empty(),
+                                    "expected_output.data",
+                                    "expected_output.digest"));
+  if (expected.float_tolerance() < 0) {
+    return absl::InvalidArgumentError(
+        "expected_output.float_tolerance must not be negative");
+  }
+  OutputExpectation expectation;
+  if (!expected.digest().empty()) {
+    ABSL_ASSIGN_OR_RETURN(storage, blobs->Read(expected.digest()));
+  } else {
+    storage = expected.data();
+  }
+  expectation.expected = storage;
+  switch (expected.mode()) {
+    case ExpectedOutput::TOKENS:
+      expectation.mode = OutputExpectation::Mode::kTokens;
+      break;
+    case ExpectedOutput::FLOAT_TOLERANCE:
+      expectation.mode = OutputExpectation::Mode::kFloatTolerance;
+      break;
+    default:
+      expectation.mode = OutputExpectation::Mode::kExact;
+      break;
+  }
+  if (expected.float_tolerance() > 0) {
+    expectation.tolerance = expected.float_tolerance();
+  }
+  return expectation;
+}
+
+// Adds `verdict` to a final stats message, if the run was checked.
+void SetVerdict(const OutputVerdict& verdict, ExecutionLog& log) {
+  if (verdict.kind == OutputVerdict::Kind::kNotChecked) {
+    return;
+  }
+  Verdict* proto_verdict = log.mutable_verdict();
+  proto_verdict->set_kind(verdict.kind == OutputVerdict::Kind::kAccepted
+                              ? Verdict::ACCEPTED
+                              : Verdict::WRONG_ANSWER);
+  proto_verdict->set_expected_offset(verdict.expected_offset);
+  proto_verdict->set_actual_offset(verdict.actual_offset);
+  proto_verdict->set_line(verdict.line);
+  proto_verdict->set_expected_excerpt(verdict.expected_excerpt);
+  proto_verdict->set_actual_excerpt(verdict.actual_excerpt);
+}
+
+}  // namespace
+
+grpc::Status ToGrpcStatus(const absl::Status& status) {
+  // absl::StatusCode and grpc::StatusCode share their numbering.
+  return grpc::Status(static_cast<grpc::StatusCode>(status.code()),
+                      std::string(status.message()));
+}
+
 void ThreadSafeLogQueue::Push(ExecutionLog log) {
   absl::MutexLock lock(&mutex_);
   queue_.push(std::move(log));
@@ -38,56 +183,107 @@ bool ThreadSafeLogQueue::Empty() const {
   return queue_.empty();
 }
 
-ReactorInternalState::ReactorInternalState(const CodeRequest* req, std::atomic<int>& c, ExecuteReactor* r)
+ReactorInternalState::ReactorInternalState(const CodeRequest* req, std::atomic<int>& c, ExecuteTask* r)
     : request(req), counter(c), reactor(r), state(ReactorState::kIdle) {}
 
-ExecuteReactor::ExecuteReactor(const CodeRequest* request, std::atomic<int>& counter,
-                               DynamicWorkerCoordinator* pool,
-                               std::shared_ptr<SandboxedProcess> executor)
+// -----------------------------------------------------------------------------
+// BasicExecuteReactor
+// -----------------------------------------------------------------------------
+
+template <typename Stream>
+BasicExecuteReactor<Stream>::BasicExecuteReactor(
+    const CodeRequest* request, std::atomic<int>& counter,
+    DynamicWorkerCoordinator* pool, std::shared_ptr<SandboxedProcess> executor)
     : shared_state_(std::make_shared<ReactorInternalState>(request, counter, this)),
       pool_(pool),
       executor_(std::move(executor)) {
   shared_state_->counter.fetch_add(1);
 }
 
-void ExecuteReactor::StartExecution() {
-  absl::StatusOr<ExecutionResult> result = executor_->CompileAndRunStreaming(
-      shared_state_->request->language(), shared_state_->request->code(),
-      shared_state_->request->stdin_data(), [state = shared_state_](absl::string_view o,
-                                                                   absl::string_view e) {
-        if (o.empty() && e.empty()) return;
-        ExecutionLog log;
-        if (!o.empty()) log.set_stdout_chunk(std::string(o));
-        if (!e.empty()) log.set_stderr_chunk(std::string(e));
-        state->log_queue.Push(std::move(log));
-        {
-          absl::MutexLock lock(&state->notify_mutex);
-          state->notification_pending = true;
-        }
-        state->notify_cv.Signal();
-      });
+template <typename Stream>
+void BasicExecuteReactor<Stream>::CancelBeforeStart() {
+  shared_state_->counter.fetch_sub(1);
+  self_.reset();
+}
 
-  ExecutionResult final_res;
-  if (result.ok()) {
-    final_res = *result;
-  } else {
-    final_res.success = false;
-    final_res.error_message = std::string(result.status().message());
+template <typename Stream>
+absl::Status BasicExecuteReactor<Stream>::ResolveBlobs(BlobStore* blobs) {
+  const CodeRequest& request = *shared_state_->request;
+  ABSL_RETURN_IF_ERROR(CheckBlobRef(blobs, request.stdin_digest(),
+                                    !request.stdin_data().empty(),
+                                    "stdin_data", "stdin_digest"));
+  ABSL_RETURN_IF_ERROR(CheckBlobRef(blobs, request.code_digest(),
+                                    !request.code().empty(), "code",
+                                    "code_digest"));
+
+  if (!request.stdin_digest().empty()) {
+    ABSL_ASSIGN_OR_RETURN(stdin_blob_, blobs->Acquire(request.stdin_digest()));
+  }
+  if (!request.code_digest().empty()) {
+    ABSL_ASSIGN_OR_RETURN(std::string code, blobs->Read(request.code_digest()));
+    resolved_request_ = request;
+    resolved_request_.set_code(std::move(code));
+    shared_state_->request = &resolved_request_;
+  }
+  if (shared_state_->request->has_expected_output()) {
+    ABSL_ASSIGN_OR_RETURN(
+        expectation_,
+        ResolveExpectation(blobs, shared_state_->request->expected_output(),
+                           expected_blob_));
   }
+  return absl::OkStatus();
+}
+
+template <typename Stream>
+StdinSource BasicExecuteReactor<Stream>::Stdin() const {
+  if (!stdin_blob_.empty()) {
+    return StdinSource::File(stdin_blob_.path(), stdin_blob_.digest());
+  }
+  return StdinSource(shared_state_->request->stdin_data());
+}
+
+template <typename Stream>
+OutputCallback BasicExecuteReactor<Stream>::MakeOutputCallback() {
+  return [self = this->shared_from_this()](absl::string_view o,
+                                           absl::string_view e) {
+    if (o.empty() && e.empty()) return;
+    ExecutionLog log;
+    if (!o.empty()) log.set_stdout_chunk(std::string(o));
+    if (!e.empty()) log.set_stderr_chunk(std::string(e));
+    self->shared_state_->log_queue.Push(std::move(log));
+    self->PumpWrites();
+  };
+}
+
+template <typename Stream>
+void BasicExecuteReactor<Stream>::StartExecution() {
+  if (shared_state_->cancelled.load()) {
+    PublishResult(absl::CancelledError("Request cancelled"));
+    return;
+  }
+  executor_->CompileAndRunAsync(
+      shared_state_->request->language(), shared_state_->request->code(),
+      Stdin(), MakeOutputCallback(),
+      [self = this->shared_from_this()](absl::StatusOr<ExecutionResult> result) {
+        self->PublishResult(std::move(result));
+      },
+      expectation_, &cancellation_);
+}
+
+template <typename Stream>
+void BasicExecuteReactor<Stream>::PublishResult(
+    absl::StatusOr<ExecutionResult> result) {
+  ExecutionResult final_res = ResultOrError(std::move(result));
 
   shared_state_->final_stats = final_res.stats;
+  shared_state_->diagnostics = std::move(final_res.diagnostics);
+  shared_state_->verdict = std::move(final_res.verdict);
   shared_state_->cache_hit.store(final_res.cache_hit);
   shared_state_->wall_clock_timeout.store(final_res.wall_clock_timeout);
   shared_state_->output_truncated.store(final_res.output_truncated);
 
   if (!final_res.success) {
-    std::string error_msg;
-    if (!final_res.error_message.empty()) {
-      absl::SubstituteAndAppend(&error_msg, "ERROR: $0\n", final_res.error_message);
-    }
-    if (!final_res.backend_trace.empty()) {
-      absl::SubstituteAndAppend(&error_msg, "$0\n", final_res.backend_trace);
-    }
+    std::string error_msg = ErrorText(final_res);
     if (!error_msg.empty()) {
       ExecutionLog error_log;
       error_log.set_stderr_chunk(error_msg);
@@ -95,98 +291,745 @@ void ExecuteReactor::StartExecution() {
     }
   }
   shared_state_->execution_finished.store(true);
-  {
-    absl::MutexLock lock(&shared_state_->notify_mutex);
-    shared_state_->notification_pending = true;
-  }
-  shared_state_->notify_cv.Signal();
+  PumpWrites();
 }
 
-void ExecuteReactor::PumpWrites() {
+template <typename Stream>
+void BasicExecuteReactor<Stream>::PumpWrites() {
+  ReactorInternalState& state = *shared_state_;
   while (true) {
-    {
-      absl::MutexLock lock(&shared_state_->notify_mutex);
-      while (!shared_state_->notification_pending &&
-             !shared_state_->reactor_done &&
-             !shared_state_->cancelled.load()) {
-        shared_state_->notify_cv.Wait(&shared_state_->notify_mutex);
+    // Claiming kIdle -> kWriting makes this thread the only one touching the
+    // stream; a write in flight pumps again from OnWriteDone().
+    ReactorState expected = ReactorState::kIdle;
+    if (!state.state.compare_exchange_strong(expected, ReactorState::kWriting)) {
+      return;
+    }
+
+    if (state.cancelled.load()) {
+      // OnCancel() killed the program; the worker and the supervisor still
+      // use this request until the run's result is published.
+      if (!scheduled_.load() || state.execution_finished.load()) {
+        state.state.store(ReactorState::kFinishing);
+        this->Finish(grpc::Status::CANCELLED);
+        return;
       }
-      if (shared_state_->reactor_done ||
-          (shared_state_->cancelled.load() &&
-           shared_state_->state.load() == ReactorState::kIdle)) {
-        break;
+      state.state.store(ReactorState::kIdle);
+      if (scheduled_.load() && !state.execution_finished.load()) {
+        return;
       }
-      shared_state_->notification_pending = false;
-    }
-
-    ReactorState current = shared_state_->state.load();
-    if (current == ReactorState::kIdle) {
-      ExecutionLog log;
-      if (shared_state_->log_queue.Pop(log)) {
-        shared_state_->current_log = std::move(log);
-        if (shared_state_->state.compare_exchange_strong(current,
-                                                         ReactorState::kWriting)) {
-          StartWrite(&shared_state_->current_log);
-        }
-      } else if (shared_state_->execution_finished.load()) {
-        if (!shared_state_->stats_sent.load()) {
-          ExecutionLog stats_log;
-          stats_log.set_peak_memory_bytes(shared_state_->final_stats.peak_memory_bytes);
-          stats_log.set_execution_time_ms(
-              static_cast<float>(shared_state_->final_stats.elapsed_time_ms));
-          stats_log.set_cache_hit(shared_state_->cache_hit.load());
-          stats_log.set_wall_clock_timeout(shared_state_->wall_clock_timeout.load());
-          stats_log.set_output_truncated(shared_state_->output_truncated.load());
-          shared_state_->current_log = std::move(stats_log);
-          shared_state_->stats_sent.store(true);
-          if (shared_state_->state.compare_exchange_strong(current,
-                                                           ReactorState::kWriting)) {
-            StartWrite(&shared_state_->current_log);
-          }
-        } else {
-          if (shared_state_->state.compare_exchange_strong(current,
-                                                           ReactorState::kFinishing)) {
-            Finish(grpc::Status::OK);
-          }
-        }
+      continue;
+    }
+
+    ExecutionLog log;
+    if (state.log_queue.Pop(log)) {
+      state.current_log = std::move(log);
+      this->StartWrite(&state.current_log);
+      return;
+    }
+
+    if (state.execution_finished.load()) {
+      if (!state.stats_sent.load()) {
+        ExecutionLog stats_log;
+        stats_log.set_peak_memory_bytes(state.final_stats.peak_memory_bytes);
+        stats_log.set_execution_time_ms(
+            static_cast<float>(state.final_stats.elapsed_time_ms));
+        stats_log.set_cache_hit(state.cache_hit.load());
+        stats_log.set_wall_clock_timeout(state.wall_clock_timeout.load());
+        stats_log.set_output_truncated(state.output_truncated.load());
+        AddDiagnostics(state.diagnostics, stats_log);
+        SetVerdict(state.verdict, stats_log);
+        state.current_log = std::move(stats_log);
+        state.stats_sent.store(true);
+        this->StartWrite(&state.current_log);
+      } else {
+        state.state.store(ReactorState::kFinishing);
+        this->Finish(grpc::Status::OK);
       }
+      return;
     }
-    if (shared_state_->state.load() == ReactorState::kFinishing) {
-      break;
+
+    // Nothing to send yet. A producer that lost the claim to this thread
+    // relies on the re-check below.
+    state.state.store(ReactorState::kIdle);
+    if (state.log_queue.Empty() && !state.execution_finished.load() &&
+        !state.cancelled.load()) {
+      return;
     }
   }
 }
 
-void ExecuteReactor::OnWriteDone(bool ok) {
+template <typename Stream>
+void BasicExecuteReactor<Stream>::Abandon(const absl::Status& status) {
+  // The request will not run, so a cancel need not wait for it.
+  scheduled_.store(false);
+  FinishWithError(grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                               std::string(status.message())));
+}
+
+template <typename Stream>
+void BasicExecuteReactor<Stream>::FinishWithError(grpc::Status status) {
+  ReactorState expected = ReactorState::kIdle;
+  if (shared_state_->state.compare_exchange_strong(expected,
+                                                   ReactorState::kFinishing)) {
+    this->Finish(std::move(status));
+  }
+}
+
+template <typename Stream>
+void BasicExecuteReactor<Stream>::OnWriteDone(bool ok) {
   (void)ok;
   ReactorState expected = ReactorState::kWriting;
   shared_state_->state.compare_exchange_strong(expected, ReactorState::kIdle);
-  {
-    absl::MutexLock lock(&shared_state_->notify_mutex);
-    shared_state_->notification_pending = true;
-  }
-  shared_state_->notify_cv.Signal();
+  PumpWrites();
 }
 
-void ExecuteReactor::OnDone() {
-  {
-    absl::MutexLock lock(&shared_state_->notify_mutex);
-    shared_state_->reactor_done = true;
-  }
-  shared_state_->notify_cv.SignalAll();
+template <typename Stream>
+void BasicExecuteReactor<Stream>::OnDone() {
+  // May be the last reference; destroyed when this function returns.
+  const std::shared_ptr<BasicExecuteReactor> self = std::move(self_);
+  shared_state_->state.store(ReactorState::kFinished);
   shared_state_->counter.fetch_sub(1);
   if (pool_ != nullptr) {
     pool_->ReleaseWorker(this);
   }
 }
 
-void ExecuteReactor::OnCancel() {
+template <typename Stream>
+void BasicExecuteReactor<Stream>::OnCancel() {
   shared_state_->cancelled.store(true);
-  {
-    absl::MutexLock lock(&shared_state_->notify_mutex);
-    shared_state_->notification_pending = true;
+  cancellation_.Cancel();
+  PumpWrites();
+}
+
+template class BasicExecuteReactor<grpc::ServerWriteReactor<ExecutionLog>>;
+template class BasicExecuteReactor<
+    grpc::ServerBidiReactor<UploadChunk, ExecutionLog>>;
+
+// -----------------------------------------------------------------------------
+// ExecuteReactor
+// -----------------------------------------------------------------------------
+
+ExecuteReactor::ExecuteReactor(const CodeRequest* request,
+                               std::atomic<int>& counter,
+                               DynamicWorkerCoordinator* pool,
+                               std::shared_ptr<SandboxedProcess> executor)
+    : BasicExecuteReactor(&request_, counter, pool, std::move(executor)),
+      request_(*request) {}
+
+std::shared_ptr<ExecuteReactor> ExecuteReactor::Create(
+    const CodeRequest* request, std::atomic<int>& counter,
+    DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor) {
+  std::shared_ptr<ExecuteReactor> reactor(
+      new ExecuteReactor(request, counter, pool, std::move(executor)));
+  reactor->self_ = reactor;
+  return reactor;
+}
+
+// -----------------------------------------------------------------------------
+// RunPreparedReactor
+// -----------------------------------------------------------------------------
+
+RunPreparedReactor::RunPreparedReactor(
+    const RunRequest* request, std::shared_ptr<const PreparedProgram> program,
+    std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor)
+    : BasicExecuteReactor(&run_request_, counter, pool, std::move(executor)),
+      program_(std::move(program)) {
+  run_request_.set_language(program_->language_id());
+  run_request_.set_stdin_data(request->stdin_data());
+  run_request_.set_stdin_digest(request->stdin_digest());
+  if (request->has_expected_output()) {
+    *run_request_.mutable_expected_output() = request->expected_output();
+  }
+}
+
+std::shared_ptr<RunPreparedReactor> RunPreparedReactor::Create(
+    const RunRequest* request, std::shared_ptr<const PreparedProgram> program,
+    std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor) {
+  std::shared_ptr<RunPreparedReactor> reactor(new RunPreparedReactor(
+      request, std::move(program), counter, pool, std::move(executor)));
+  reactor->self_ = reactor;
+  return reactor;
+}
+
+void RunPreparedReactor::StartExecution() {
+  if (shared_state_->cancelled.load()) {
+    PublishResult(absl::CancelledError("Request cancelled"));
+    return;
+  }
+  executor_->RunPreparedAsync(
+      program_, Stdin(), MakeOutputCallback(),
+      [self = shared_from_this()](absl::StatusOr<ExecutionResult> result) {
+        self->PublishResult(std::move(result));
+      },
+      expectation_, &cancellation_);
+}
+
+// -----------------------------------------------------------------------------
+// ExecuteUploadReactor
+// -----------------------------------------------------------------------------
+
+ExecuteUploadReactor::ExecuteUploadReactor(
+    std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor,
+    std::shared_ptr<BlobStore> blobs, Scheduler schedule)
+    : BasicExecuteReactor(&upload_request_, counter, pool, std::move(executor)),
+      blobs_(std::move(blobs)),
+      schedule_(std::move(schedule)) {
+  // Until CompleteUpload(), a cancelled call has nothing to wait for.
+  scheduled_.store(false);
+}
+
+std::shared_ptr<ExecuteUploadReactor> ExecuteUploadReactor::Create(
+    std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor,
+    std::shared_ptr<BlobStore> blobs, Scheduler schedule) {
+  std::shared_ptr<ExecuteUploadReactor> reactor(new ExecuteUploadReactor(
+      counter, pool, std::move(executor), std::move(blobs),
+      std::move(schedule)));
+  reactor->self_ = reactor;
+  return reactor;
+}
+
+void ExecuteUploadReactor::StartUpload() { StartRead(&chunk_); }
+
+void ExecuteUploadReactor::Reject(absl::string_view reason) {
+  FinishWithError(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                               std::string(reason)));
+}
+
+void ExecuteUploadReactor::OnReadDone(bool ok) {
+  if (shared_state_->cancelled.load()) {
+    return;
+  }
+  if (!ok) {
+    // The client half-closed: the upload is complete.
+    CompleteUpload();
+    return;
   }
-  shared_state_->notify_cv.Signal();
+  const absl::Status consumed = Consume(chunk_);
+  if (!consumed.ok()) {
+    FinishWithError(ToGrpcStatus(consumed));
+    return;
+  }
+  StartRead(&chunk_);
+}
+
+absl::Status ExecuteUploadReactor::Consume(UploadChunk& chunk) {
+  if (!have_request_) {
+    if (!chunk.has_request()) {
+      return absl::InvalidArgumentError(
+          "The first UploadChunk must carry the request");
+    }
+    upload_request_ = std::move(*chunk.mutable_request());
+    have_request_ = true;
+    uploaded_bytes_ = upload_request_.code().size();
+    std::string inline_stdin = std::move(*upload_request_.mutable_stdin_data());
+    upload_request_.clear_stdin_data();
+    return AppendStdin(inline_stdin);
+  }
+
+  switch (chunk.payload_case()) {
+    case UploadChunk::kCodeChunk:
+      uploaded_bytes_ += chunk.code_chunk().size();
+      if (uploaded_bytes_ > absl::GetFlag(FLAGS_max_upload_bytes)) {
+        return absl::ResourceExhaustedError("Upload exceeds --max_upload_bytes");
+      }
+      upload_request_.mutable_code()->append(chunk.code_chunk());
+      return absl::OkStatus();
+    case UploadChunk::kStdinChunk:
+      return AppendStdin(chunk.stdin_chunk());
+    case UploadChunk::kRequest:
+      return absl::InvalidArgumentError("Only the first UploadChunk may carry the request");
+    case UploadChunk::PAYLOAD_NOT_SET:
+      return absl::OkStatus();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ExecuteUploadReactor::AppendStdin(absl::string_view bytes) {
+  if (bytes.empty()) {
+    return absl::OkStatus();
+  }
+  uploaded_bytes_ += bytes.size();
+  if (uploaded_bytes_ > absl::GetFlag(FLAGS_max_upload_bytes)) {
+    return absl::ResourceExhaustedError("Upload exceeds --max_upload_bytes");
+  }
+  if (stdin_writer_ == nullptr) {
+    absl::StatusOr<std::unique_ptr<DigestingFileWriter>> writer =
+        DigestingFileWriter::Create(absl::GetFlag(FLAGS_upload_dir));
+    if (!writer.ok()) {
+      return absl::InternalError(writer.status().message());
+    }
+    stdin_writer_ = *std::move(writer);
+  }
+  const absl::Status appended = stdin_writer_->Append(bytes);
+  if (!appended.ok()) {
+    return absl::InternalError(appended.message());
+  }
+  return absl::OkStatus();
+}
+
+void ExecuteUploadReactor::CompleteUpload() {
+  if (!have_request_) {
+    FinishWithError(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                 "Upload ended before the request"));
+    return;
+  }
+  if (stdin_writer_ != nullptr) {
+    absl::StatusOr<DigestingFileWriter::Written> written =
+        stdin_writer_->Finish();
+    if (!written.ok()) {
+      FinishWithError(grpc::Status(grpc::StatusCode::INTERNAL,
+                                   std::string(written.status().message())));
+      return;
+    }
+    stdin_file_ = *std::move(written);
+    if (!upload_request_.stdin_digest().empty()) {
+      FinishWithError(grpc::Status(
+          grpc::StatusCode::INVALID_ARGUMENT,
+          "Set either uploaded stdin or stdin_digest, not both"));
+      return;
+    }
+  }
+  if (const absl::Status resolved = ResolveBlobs(blobs_.get());
+      !resolved.ok()) {
+    FinishWithError(ToGrpcStatus(resolved));
+    return;
+  }
+  // Set before the cancel check so that a concurrent OnCancel() either is
+  // seen here or waits for the result published below or by the run.
+  scheduled_.store(true);
+  if (shared_state_->cancelled.load()) {
+    PublishResult(absl::CancelledError("Request cancelled"));
+    return;
+  }
+  const absl::Status scheduled = schedule_(shared_from_this());
+  if (!scheduled.ok()) {
+    LOG(WARNING) << "Worker pool rejected upload: " << scheduled;
+    scheduled_.store(false);
+    Reject("Worker pool rejected request");
+  }
+}
+
+StdinSource ExecuteUploadReactor::Stdin() const {
+  if (stdin_file_.path.empty()) {
+    return BasicExecuteReactor::Stdin();
+  }
+  return StdinSource::File(stdin_file_.path, stdin_file_.sha256);
+}
+
+// -----------------------------------------------------------------------------
+// BatchExecuteReactor
+// -----------------------------------------------------------------------------
+
+// Runs one case of a batch on a run-pool worker.
+class BatchExecuteReactor::CaseTask final : public WorkerTask {
+ public:
+  CaseTask(std::shared_ptr<BatchExecuteReactor> batch, int index)
+      : batch_(std::move(batch)), index_(index) {}
+
+  void StartExecution() override { batch_->RunCase(index_); }
+
+  void PumpWrites() override {
+    // The case's callbacks keep the batch alive while it runs.
+    batch_->pool_->ReleaseWorker(this);
+    batch_.reset();
+  }
+
+  void Abandon(const absl::Status& status) override {
+    batch_->FinishCase(index_, status);
+  }
+
+ private:
+  std::shared_ptr<BatchExecuteReactor> batch_;
+  int index_;
+};
+
+BatchExecuteReactor::BatchExecuteReactor(
+    const BatchRequest* request, std::atomic<int>& counter,
+    DynamicWorkerCoordinator* pool, std::shared_ptr<SandboxedProcess> executor)
+    : batch_(request),
+      counter_(counter),
+      pool_(pool),
+      executor_(std::move(executor)) {
+  program_.set_language(request->language());
+  program_.set_code(request->code());
+  counter_.fetch_add(1);
+}
+
+std::shared_ptr<BatchExecuteReactor> BatchExecuteReactor::Create(
+    const BatchRequest* request, std::atomic<int>& counter,
+    DynamicWorkerCoordinator* pool,
+    std::shared_ptr<SandboxedProcess> executor) {
+  std::shared_ptr<BatchExecuteReactor> reactor(
+      new BatchExecuteReactor(request, counter, pool, std::move(executor)));
+  reactor->self_ = reactor;
+  return reactor;
+}
+
+absl::Status BatchExecuteReactor::ResolveBlobs(BlobStore* blobs) {
+  const int num_cases = batch_->cases_size();
+  num_cases_ = num_cases;
+  if (num_cases == 0) {
+    return absl::InvalidArgumentError("ExecuteBatch needs at least one case");
+  }
+  if (num_cases > absl::GetFlag(FLAGS_max_batch_cases)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Batch of ", num_cases, " cases exceeds --max_batch_cases"));
+  }
+
+  ABSL_RETURN_IF_ERROR(CheckBlobRef(blobs, batch_->code_digest(),
+                                    !batch_->code().empty(), "code",
+                                    "code_digest"));
+  if (!batch_->code_digest().empty()) {
+    ABSL_ASSIGN_OR_RETURN(std::string code, blobs->Read(batch_->code_digest()));
+    program_.set_code(std::move(code));
+  }
+
+  stdin_blobs_.resize(static_cast<size_t>(num_cases));
+  stdin_data_.resize(static_cast<size_t>(num_cases));
+  // Sized up front: expectations view into these strings.
+  expected_blobs_.resize(static_cast<size_t>(num_cases));
+  expectations_.resize(static_cast<size_t>(num_cases));
+  for (int i = 0; i < num_cases; ++i) {
+    const BatchCase& batch_case = batch_->cases(i);
+    const auto slot = static_cast<size_t>(i);
+    absl::Status status = CheckBlobRef(
+        blobs, batch_case.stdin_digest(), !batch_case.stdin_data().empty(),
+        "stdin_data", "stdin_digest");
+    if (status.ok() && !batch_case.stdin_digest().empty()) {
+      absl::StatusOr<BlobStore::Lease> lease =
+          blobs->Acquire(batch_case.stdin_digest());
+      if (lease.ok()) {
+        stdin_blobs_[slot] = *std::move(lease);
+      } else {
+        status = lease.status();
+      }
+    } else {
+      stdin_data_[slot] = batch_case.stdin_data();
+    }
+    if (status.ok() && batch_case.has_expected_output()) {
+      absl::StatusOr<OutputExpectation> expectation = ResolveExpectation(
+          blobs, batch_case.expected_output(), expected_blobs_[slot]);
+      if (expectation.ok()) {
+        expectations_[slot] = *std::move(expectation);
+      } else {
+        status = expectation.status();
+      }
+    }
+    if (!status.ok()) {
+      return absl::Status(status.code(),
+                          absl::StrCat("Case ", i, ": ", status.message()));
+    }
+  }
+  return absl::OkStatus();
+}
+
+void BatchExecuteReactor::CancelBeforeStart() {
+  counter_.fetch_sub(1);
+  self_.reset();
+}
+
+void BatchExecuteReactor::StartExecution() {
+  // Built once here, whatever the artifact cache holds: after a compile
+  // stage this only copies the cached binary out, and without one (or once
+  // the entry is evicted) it is the batch's only compile.
+  absl::StatusOr<PreparedBuild> prepared = executor_->Prepare(
+      program_.language(), program_.code(), MakeOutputCallback());
+  if (!prepared.ok()) {
+    PublishResult(prepared.status());
+    return;
+  }
+  if (prepared->program == nullptr) {
+    PublishResult(std::move(prepared->result));
+    return;
+  }
+  prepared_ = std::move(prepared->program);
+  const int parallelism = std::min(
+      num_cases_, std::max(1, absl::GetFlag(FLAGS_batch_case_parallelism)));
+  for (int i = 0; i < parallelism; ++i) {
+    StartNextCase();
+  }
+  pending_.fetch_sub(1);
+  PumpWrites();
+}
+
+void BatchExecuteReactor::StartNextCase() {
+  if (cancelled_.load()) {
+    return;
+  }
+  const int index = next_case_.fetch_add(1);
+  if (index >= num_cases_) {
+    return;
+  }
+  pending_.fetch_add(1);
+  const absl::Status dispatched =
+      pool_->Dispatch(ParseLanguageId(program_.language()),
+                      std::make_shared<CaseTask>(shared_from_this(), index));
+  if (!dispatched.ok()) {
+    FinishCase(index, dispatched);
+  }
+}
+
+void BatchExecuteReactor::RunCase(int index) {
+  if (cancelled_.load()) {
+    FinishCase(index, absl::CancelledError("Batch cancelled"));
+    return;
+  }
+  const auto slot = static_cast<size_t>(index);
+  const BlobStore::Lease& blob = stdin_blobs_[slot];
+  const StdinSource stdin_source =
+      blob.empty() ? StdinSource(stdin_data_[slot])
+                   : StdinSource::File(blob.path(), blob.digest());
+  auto done = [self = shared_from_this(),
+               index](absl::StatusOr<ExecutionResult> result) {
+    self->FinishCase(index, std::move(result));
+  };
+  executor_->RunPreparedAsync(prepared_, stdin_source,
+                              MakeCaseOutputCallback(index), std::move(done),
+                              expectations_[slot], &cancellation_);
+}
+
+OutputCallback BatchExecuteReactor::MakeOutputCallback() {
+  return MakeCaseOutputCallback(-1);
+}
+
+OutputCallback BatchExecuteReactor::MakeCaseOutputCallback(int index) {
+  return [self = shared_from_this(), index](absl::string_view o,
+                                            absl::string_view e) {
+    if (o.empty() && e.empty()) return;
+    ExecutionLog log;
+    log.set_case_index(index);
+    if (!o.empty()) log.set_stdout_chunk(std::string(o));
+    if (!e.empty()) log.set_stderr_chunk(std::string(e));
+    self->log_queue_.Push(std::move(log));
+    self->PumpWrites();
+  };
+}
+
+void BatchExecuteReactor::PublishResult(absl::StatusOr<ExecutionResult> result) {
+  QueueResult(-1, ResultOrError(std::move(result)));
+  batch_finished_.store(true);
+  PumpWrites();
+}
+
+void BatchExecuteReactor::FinishCase(int index,
+                                     absl::StatusOr<ExecutionResult> result) {
+  QueueResult(index, ResultOrError(std::move(result)));
+  if (finished_cases_.fetch_add(1) + 1 == num_cases_) {
+    batch_finished_.store(true);
+  } else {
+    StartNextCase();
+  }
+  pending_.fetch_sub(1);
+  PumpWrites();
+}
+
+void BatchExecuteReactor::QueueResult(int index, const ExecutionResult& result) {
+  if (!result.success) {
+    if (std::string error_msg = ErrorText(result); !error_msg.empty()) {
+      ExecutionLog error_log;
+      error_log.set_case_index(index);
+      error_log.set_stderr_chunk(std::move(error_msg));
+      log_queue_.Push(std::move(error_log));
+    }
+  }
+  ExecutionLog stats_log;
+  stats_log.set_case_index(index);
+  stats_log.set_case_finished(true);
+  stats_log.set_peak_memory_bytes(result.stats.peak_memory_bytes);
+  stats_log.set_execution_time_ms(
+      static_cast<float>(result.stats.elapsed_time_ms));
+  stats_log.set_cache_hit(result.cache_hit);
+  stats_log.set_wall_clock_timeout(result.wall_clock_timeout);
+  stats_log.set_output_truncated(result.output_truncated);
+  AddDiagnostics(result.diagnostics, stats_log);
+  SetVerdict(result.verdict, stats_log);
+  log_queue_.Push(std::move(stats_log));
+}
+
+void BatchExecuteReactor::PumpWrites() {
+  while (true) {
+    // As in BasicExecuteReactor: the claiming thread owns the stream.
+    ReactorState expected = ReactorState::kIdle;
+    if (!state_.compare_exchange_strong(expected, ReactorState::kWriting)) {
+      return;
+    }
+
+    if (cancelled_.load()) {
+      // OnCancel() killed the running cases; they still use this reactor's
+      // copies of the batch until they finish.
+      if (batch_finished_.load() || pending_.load() == 0) {
+        state_.store(ReactorState::kFinishing);
+        Finish(grpc::Status::CANCELLED);
+        return;
+      }
+      state_.store(ReactorState::kIdle);
+      if (!batch_finished_.load() && pending_.load() != 0) {
+        return;
+      }
+      continue;
+    }
+
+    ExecutionLog log;
+    if (log_queue_.Pop(log)) {
+      current_log_ = std::move(log);
+      StartWrite(&current_log_);
+      return;
+    }
+
+    if (batch_finished_.load()) {
+      state_.store(ReactorState::kFinishing);
+      Finish(grpc::Status::OK);
+      return;
+    }
+
+    state_.store(ReactorState::kIdle);
+    if (log_queue_.Empty() && !batch_finished_.load() && !cancelled_.load()) {
+      return;
+    }
+  }
+}
+
+void BatchExecuteReactor::Abandon(const absl::Status& status) {
+  // The batch will not be built, so a cancel need not wait for it.
+  pending_.fetch_sub(1);
+  ReactorState expected = ReactorState::kIdle;
+  if (state_.compare_exchange_strong(expected, ReactorState::kFinishing)) {
+    Finish(grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                        std::string(status.message())));
+  }
+}
+
+void BatchExecuteReactor::OnWriteDone(bool ok) {
+  (void)ok;
+  ReactorState expected = ReactorState::kWriting;
+  state_.compare_exchange_strong(expected, ReactorState::kIdle);
+  PumpWrites();
+}
+
+void BatchExecuteReactor::OnDone() {
+  // Cases still running hold their own references.
+  const std::shared_ptr<BatchExecuteReactor> self = std::move(self_);
+  state_.store(ReactorState::kFinished);
+  counter_.fetch_sub(1);
+  if (pool_ != nullptr) {
+    pool_->ReleaseWorker(this);
+  }
+}
+
+void BatchExecuteReactor::OnCancel() {
+  cancelled_.store(true);
+  cancellation_.Cancel();
+  PumpWrites();
+}
+
+// -----------------------------------------------------------------------------
+// CompileStageTask
+// -----------------------------------------------------------------------------
+
+CompileStageTask::CompileStageTask(std::shared_ptr<ExecuteTask> reactor,
+                                   std::shared_ptr<SandboxedProcess> executor,
+                                   DynamicWorkerCoordinator* compile_pool,
+                                   DynamicWorkerCoordinator* run_pool,
+                                   LanguageId lang)
+    : reactor_(std::move(reactor)),
+      executor_(std::move(executor)),
+      compile_pool_(compile_pool),
+      run_pool_(run_pool),
+      lang_(lang) {}
+
+void CompileStageTask::StartExecution() {
+  absl::StatusOr<ExecutionResult> compiled = executor_->Precompile(
+      reactor_->request().language(), reactor_->request().code(),
+      reactor_->MakeOutputCallback());
+  if (compiled.ok() && compiled->success) {
+    const absl::Status dispatched = run_pool_->Dispatch(lang_, reactor_);
+    if (dispatched.ok()) {
+      return;
+    }
+    compiled = dispatched;
+  }
+  finished_here_ = true;
+  reactor_->PublishResult(std::move(compiled));
+}
+
+void CompileStageTask::PumpWrites() {
+  if (finished_here_) {
+    reactor_->PumpWrites();
+  }
+  compile_pool_->ReleaseWorker(this);
+  reactor_.reset();
+}
+
+void CompileStageTask::Abandon(const absl::Status& status) {
+  reactor_->Abandon(status);
+}
+
+// -----------------------------------------------------------------------------
+// CompileProgramTask
+// -----------------------------------------------------------------------------
+
+CompileProgramTask::CompileProgramTask(
+    const CompileRequest* request, CompileResponse* response,
+    grpc::ServerUnaryReactor* reactor,
+    std::shared_ptr<SandboxedProcess> executor,
+    std::shared_ptr<ProgramRegistry> programs,
+    DynamicWorkerCoordinator* compile_pool)
+    : request_(request),
+      response_(response),
+      reactor_(reactor),
+      executor_(std::move(executor)),
+      programs_(std::move(programs)),
+      compile_pool_(compile_pool),
+      code_(request->code()) {}
+
+absl::Status CompileProgramTask::ResolveBlobs(BlobStore* blobs) {
+  ABSL_RETURN_IF_ERROR(CheckBlobRef(blobs, request_->code_digest(),
+                                    !request_->code().empty(), "code",
+                                    "code_digest"));
+  if (!request_->code_digest().empty()) {
+    ABSL_ASSIGN_OR_RETURN(code_, blobs->Read(request_->code_digest()));
+  }
+  return absl::OkStatus();
+}
+
+void CompileProgramTask::StartExecution() {
+  std::string compiler_output;
+  absl::StatusOr<PreparedBuild> prepared = executor_->Prepare(
+      request_->language(), code_,
+      [&compiler_output](absl::string_view o, absl::string_view e) {
+        compiler_output.append(o);
+        compiler_output.append(e);
+      });
+  if (!prepared.ok()) {
+    status_ = ToGrpcStatus(prepared.status());
+    return;
+  }
+
+  response_->set_lease_ttl_ms(absl::ToInt64Milliseconds(programs_->ttl()));
+  response_->set_success(prepared->program != nullptr);
+  if (prepared->program == nullptr && compiler_output.empty()) {
+    compiler_output = ErrorText(prepared->result);
+  }
+  response_->set_compiler_output(std::move(compiler_output));
+  AddDiagnostics(prepared->result.diagnostics, *response_);
+  if (prepared->program != nullptr) {
+    response_->set_handle(programs_->Register(std::move(prepared->program)));
+  }
+}
+
+void CompileProgramTask::PumpWrites() {
+  reactor_->Finish(std::move(status_));
+  compile_pool_->ReleaseWorker(this);
+}
+
+void CompileProgramTask::Abandon(const absl::Status& status) {
+  reactor_->Finish(grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                                std::string(status.message())));
 }
 
 }  // namespace dcodex
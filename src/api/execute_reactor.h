@@ -17,14 +17,25 @@
 
 #include <grpcpp/grpcpp.h>
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <vector>
 
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/strings/string_view.h"
 #include "proto/sandbox.grpc.pb.h"
+#include "src/common/blob_store.h"
+#include "src/common/content_digest.h"
 #include "src/engine/sandbox.h"
 #include "src/engine/dynamic_worker_coordinator.h"
+#include "src/engine/prepared_program.h"
+#include "src/engine/program_registry.h"
 
 namespace dcodex {
 
@@ -50,11 +61,11 @@ class ThreadSafeLogQueue {
 
 // Internal state of the reactor, shared between threads
 struct ReactorInternalState {
-  ReactorInternalState(const CodeRequest* req, std::atomic<int>& c, class ExecuteReactor* r);
+  ReactorInternalState(const CodeRequest* req, std::atomic<int>& c, class ExecuteTask* r);
 
   const CodeRequest* request;
   std::atomic<int>& counter;
-  class ExecuteReactor* reactor;
+  class ExecuteTask* reactor;
 
   std::atomic<ReactorState> state;
   std::atomic<bool> execution_finished{false};
@@ -64,33 +75,369 @@ struct ReactorInternalState {
   std::atomic<bool> output_truncated{false};
   std::atomic<bool> cancelled{false};
 
-  absl::Mutex notify_mutex;
-  absl::CondVar notify_cv;
-  bool notification_pending = false;
-  bool reactor_done = false;
-
   ThreadSafeLogQueue log_queue;
   ExecutionLog current_log;
   ResourceStats final_stats;
+  std::vector<CompilerDiagnostic> diagnostics;
+  OutputVerdict verdict;
+};
+
+// Converts a status from the engine or the blob store into a gRPC status
+// with the same code.
+grpc::Status ToGrpcStatus(const absl::Status& status);
+
+// A request as the worker pools and CompileStageTask see it, whichever RPC
+// it arrived on.
+class ExecuteTask : public WorkerTask {
+ public:
+  [[nodiscard]] virtual const CodeRequest& request() const = 0;
+
+  // Streams output chunks to the client as they are produced.
+  virtual OutputCallback MakeOutputCallback() = 0;
+
+  // Queues `result` (and any error text) for the client and marks execution
+  // finished. StartExecution() ends with this; a compile stage that fails
+  // calls it directly so the request never needs a run worker.
+  virtual void PublishResult(absl::StatusOr<ExecutionResult> result) = 0;
+};
+
+// Streams one execution to the client over `Stream`, the gRPC reactor type
+// of the RPC. The reactor owns itself from creation until gRPC calls
+// OnDone(), so neither the worker that starts it nor a supervised program's
+// completion has to outlive the RPC. Writes are pumped from whichever thread
+// produces output or completes one; no thread waits on them. A cancelled call
+// kills its program and ends only once the run's result is in, so the
+// request's sandbox slot is held for as long as the program runs.
+template <typename Stream>
+class BasicExecuteReactor
+    : public Stream,
+      public ExecuteTask,
+      public std::enable_shared_from_this<BasicExecuteReactor<Stream>> {
+ public:
+  // Drops the self-reference of a reactor that was never handed to gRPC
+  // because the request was rejected.
+  void CancelBeforeStart();
+
+  // Starts the run and returns; with a sandbox supervisor the result is
+  // published from the supervisor thread.
+  void StartExecution() override;
+  // Writes the next queued message, the final stats, or Finish(), unless a
+  // write is already in flight. Never blocks.
+  void PumpWrites() override;
+  void Abandon(const absl::Status& status) override;
+
+  void PublishResult(absl::StatusOr<ExecutionResult> result) override;
+  OutputCallback MakeOutputCallback() override;
+
+  [[nodiscard]] const CodeRequest& request() const override {
+    return *shared_state_->request;
+  }
+
+  // Replaces the request's stdin_digest and code_digest with the blobs they
+  // name: the code is read into the request, and stdin is leased from
+  // `blobs` for the run. Also resolves the request's expected_output, whose
+  // digest is read into memory. Must be called before the request is
+  // scheduled. `blobs` may be null when the request references no blobs.
+  absl::Status ResolveBlobs(BlobStore* blobs);
+
+  void OnWriteDone(bool ok) override;
+  void OnDone() override;
+  void OnCancel() override;
+
+ protected:
+  BasicExecuteReactor(const CodeRequest* request, std::atomic<int>& counter,
+                      DynamicWorkerCoordinator* pool,
+                      std::shared_ptr<SandboxedProcess> executor);
+
+  // The program's stdin: the leased stdin blob, or else the request's inline
+  // bytes, unless overridden.
+  [[nodiscard]] virtual StdinSource Stdin() const;
+
+  // Ends the call with `status` before anything was written.
+  void FinishWithError(grpc::Status status);
+
+  std::shared_ptr<ReactorInternalState> shared_state_;
+  DynamicWorkerCoordinator* pool_;
+  std::shared_ptr<SandboxedProcess> executor_;
+  // The request with its code blob read in, when it referenced one.
+  CodeRequest resolved_request_;
+  BlobStore::Lease stdin_blob_;
+  // The request's expected_output, and a copy of its bytes.
+  std::optional<OutputExpectation> expectation_;
+  std::string expected_blob_;
+  // Kills the run's program from OnCancel().
+  RunCancellation cancellation_;
+  // Whether the request is with a worker pool, which ends it through
+  // PublishResult() or Abandon(). Execute and Run are scheduled before gRPC
+  // sees the reactor, an upload once it is complete.
+  std::atomic<bool> scheduled_{true};
+  // Released in OnDone() or CancelBeforeStart().
+  std::shared_ptr<BasicExecuteReactor> self_;
 };
 
-class ExecuteReactor final : public grpc::ServerWriteReactor<ExecutionLog>,
-                            public WorkerTask {
+// Reactor for Execute: the whole request arrives in one message.
+class ExecuteReactor final
+    : public BasicExecuteReactor<grpc::ServerWriteReactor<ExecutionLog>> {
  public:
+  static std::shared_ptr<ExecuteReactor> Create(
+      const CodeRequest* request, std::atomic<int>& counter,
+      DynamicWorkerCoordinator* pool,
+      std::shared_ptr<SandboxedProcess> executor);
+
+ private:
   ExecuteReactor(const CodeRequest* request, std::atomic<int>& counter,
-                 DynamicWorkerCoordinator* pool, std::shared_ptr<SandboxedProcess> executor);
+                 DynamicWorkerCoordinator* pool,
+                 std::shared_ptr<SandboxedProcess> executor);
+
+  // A copy of the call's request, which gRPC frees once the call ends while
+  // a worker may still hold the reactor.
+  CodeRequest request_;
+};
+
+// Reactor for Run: starts a program that Compile prepared. The RunRequest is
+// carried as a CodeRequest in the program's language, without code, so that
+// stdin and expected_output resolve as for Execute; the run then skips
+// straight to the run step. Holds the program until the call ends.
+class RunPreparedReactor final
+    : public BasicExecuteReactor<grpc::ServerWriteReactor<ExecutionLog>> {
+ public:
+  static std::shared_ptr<RunPreparedReactor> Create(
+      const RunRequest* request,
+      std::shared_ptr<const PreparedProgram> program,
+      std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+      std::shared_ptr<SandboxedProcess> executor);
 
   void StartExecution() override;
+
+ private:
+  RunPreparedReactor(const RunRequest* request,
+                     std::shared_ptr<const PreparedProgram> program,
+                     std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+                     std::shared_ptr<SandboxedProcess> executor);
+
+  CodeRequest run_request_;
+  std::shared_ptr<const PreparedProgram> program_;
+};
+
+// Reactor for ExecuteUpload. Reads the request, then code chunks into the
+// request and stdin chunks into a file under --upload_dir, hashing stdin as
+// it is written; nothing but the code is kept in memory. Once the client
+// half-closes, the request is scheduled like an Execute call and the program
+// reads its stdin from that file. The file is removed with the reactor.
+class ExecuteUploadReactor final
+    : public BasicExecuteReactor<
+          grpc::ServerBidiReactor<UploadChunk, ExecutionLog>> {
+ public:
+  // Leases a worker for a fully uploaded request, as Execute does.
+  using Scheduler =
+      std::function<absl::Status(const std::shared_ptr<ExecuteTask>&)>;
+
+  // `blobs` resolves digests in the uploaded request; it may be null.
+  static std::shared_ptr<ExecuteUploadReactor> Create(
+      std::atomic<int>& counter, DynamicWorkerCoordinator* pool,
+      std::shared_ptr<SandboxedProcess> executor,
+      std::shared_ptr<BlobStore> blobs, Scheduler schedule);
+
+  // Starts reading the upload.
+  void StartUpload();
+
+  // Ends the call with RESOURCE_EXHAUSTED before reading anything.
+  void Reject(absl::string_view reason);
+
+  void OnReadDone(bool ok) override;
+
+ protected:
+  [[nodiscard]] StdinSource Stdin() const override;
+
+ private:
+  ExecuteUploadReactor(std::atomic<int>& counter,
+                       DynamicWorkerCoordinator* pool,
+                       std::shared_ptr<SandboxedProcess> executor,
+                       std::shared_ptr<BlobStore> blobs, Scheduler schedule);
+
+  // Applies one received chunk.
+  absl::Status Consume(UploadChunk& chunk);
+  // Appends to the stdin file, creating it on first use.
+  absl::Status AppendStdin(absl::string_view bytes);
+  // Finishes the stdin file and schedules the request.
+  void CompleteUpload();
+
+  CodeRequest upload_request_;
+  UploadChunk chunk_;
+  bool have_request_ = false;
+  uint64_t uploaded_bytes_ = 0;
+  std::unique_ptr<DigestingFileWriter> stdin_writer_;
+  DigestingFileWriter::Written stdin_file_;
+  std::shared_ptr<BlobStore> blobs_;
+  Scheduler schedule_;
+};
+
+// Reactor for ExecuteBatch. To the worker pools and CompileStageTask the
+// batch is one request without stdin, so a compiled language is built once
+// into the artifact cache by the compile stage. When the batch then starts
+// on a run worker, it prepares the program once (SandboxedProcess::Prepare(),
+// which compiles only if the artifact cache is off or lost the binary) and
+// dispatches one task per case to the run pool, keeping at most
+// --batch_case_parallelism cases in flight. Each case runs the prepared
+// program against its own stdin, forked from a loaded copy when the sandbox
+// links programs with the fork server stub, and its output is tagged with
+// its case index on the shared stream. Cases bypass the result cache. A
+// cancelled batch starts no more cases, kills the running ones and ends once
+// they have finished.
+class BatchExecuteReactor final
+    : public grpc::ServerWriteReactor<ExecutionLog>,
+      public ExecuteTask,
+      public std::enable_shared_from_this<BatchExecuteReactor> {
+ public:
+  static std::shared_ptr<BatchExecuteReactor> Create(
+      const BatchRequest* request, std::atomic<int>& counter,
+      DynamicWorkerCoordinator* pool,
+      std::shared_ptr<SandboxedProcess> executor);
+
+  // Validates the cases and resolves the code and stdin digests, as
+  // BasicExecuteReactor::ResolveBlobs() does. Must be called before the
+  // batch is scheduled.
+  absl::Status ResolveBlobs(BlobStore* blobs);
+
+  // Drops the self-reference of a reactor that was never handed to gRPC.
+  void CancelBeforeStart();
+
+  // Starts the first cases and returns.
+  void StartExecution() override;
   void PumpWrites() override;
+  void Abandon(const absl::Status& status) override;
+
+  // The output of building the program, in the compile stage or in
+  // StartExecution(), and on failure its result; both are reported with case
+  // index -1.
+  OutputCallback MakeOutputCallback() override;
+  void PublishResult(absl::StatusOr<ExecutionResult> result) override;
+
+  [[nodiscard]] const CodeRequest& request() const override {
+    return program_;
+  }
 
   void OnWriteDone(bool ok) override;
   void OnDone() override;
   void OnCancel() override;
 
  private:
-  std::shared_ptr<ReactorInternalState> shared_state_;
+  class CaseTask;
+
+  BatchExecuteReactor(const BatchRequest* request, std::atomic<int>& counter,
+                      DynamicWorkerCoordinator* pool,
+                      std::shared_ptr<SandboxedProcess> executor);
+
+  // Dispatches the next case that has not started, if any.
+  void StartNextCase();
+  // Runs case `index` on the calling worker.
+  void RunCase(int index);
+  // Streams output of case `index` (-1 for building the program).
+  OutputCallback MakeCaseOutputCallback(int index);
+  // Queues the last message of case `index` and starts the next case.
+  void FinishCase(int index, absl::StatusOr<ExecutionResult> result);
+  // Queues the final message of case `index` with the stats of `result`.
+  void QueueResult(int index, const ExecutionResult& result);
+
+  // The call's request, which gRPC frees once the call ends. Read only by
+  // ResolveBlobs(); everything a case needs is copied out of it.
+  const BatchRequest* batch_;
+  // The batch's language and code, with any code blob read in.
+  CodeRequest program_;
+  int num_cases_ = 0;
+  // Per case, the leased stdin blob when the case referenced one, or else a
+  // copy of its inline stdin.
+  std::vector<BlobStore::Lease> stdin_blobs_;
+  std::vector<std::string> stdin_data_;
+  // Per case, its expected_output and a copy of its bytes.
+  std::vector<std::optional<OutputExpectation>> expectations_;
+  std::vector<std::string> expected_blobs_;
+  std::atomic<int>& counter_;
   DynamicWorkerCoordinator* pool_;
   std::shared_ptr<SandboxedProcess> executor_;
+  // The batch's program. Set before the first case is dispatched.
+  std::shared_ptr<const PreparedProgram> prepared_;
+
+  std::atomic<ReactorState> state_{ReactorState::kIdle};
+  std::atomic<int> next_case_{0};
+  std::atomic<int> finished_cases_{0};
+  // Building the program, until StartExecution() has dispatched the first
+  // cases, plus every case dispatched and not yet finished. A cancelled
+  // batch ends once this drops to zero.
+  std::atomic<int> pending_{1};
+  // Kills the running cases from OnCancel().
+  RunCancellation cancellation_;
+  // Set once every case finished or building the program failed.
+  std::atomic<bool> batch_finished_{false};
+  std::atomic<bool> cancelled_{false};
+  ThreadSafeLogQueue log_queue_;
+  ExecutionLog current_log_;
+  // Released in OnDone() or CancelBeforeStart().
+  std::shared_ptr<BatchExecuteReactor> self_;
+};
+
+// -----------------------------------------------------------------------------
+// CompileStageTask: first stage of a two-stage request.
+//
+// Runs on a compile-pool worker and compiles the request's source into the
+// artifact cache. On success the reactor is dispatched to the run pool, whose
+// worker then only executes the cached binary; a run slot is never held while
+// the compiler works. A compile error is delivered from this stage directly.
+// -----------------------------------------------------------------------------
+class CompileStageTask final : public WorkerTask {
+ public:
+  CompileStageTask(std::shared_ptr<ExecuteTask> reactor,
+                   std::shared_ptr<SandboxedProcess> executor,
+                   DynamicWorkerCoordinator* compile_pool,
+                   DynamicWorkerCoordinator* run_pool, LanguageId lang);
+
+  void StartExecution() override;
+  void PumpWrites() override;
+  void Abandon(const absl::Status& status) override;
+
+ private:
+  std::shared_ptr<ExecuteTask> reactor_;
+  std::shared_ptr<SandboxedProcess> executor_;
+  DynamicWorkerCoordinator* compile_pool_;
+  DynamicWorkerCoordinator* run_pool_;
+  LanguageId lang_;
+  // Set when this stage produced the request's final result.
+  bool finished_here_ = false;
+};
+
+// -----------------------------------------------------------------------------
+// CompileProgramTask: serves a Compile call.
+//
+// Runs on a compile-pool worker, builds the request's code into a prepared
+// program and registers it under a new handle, then finishes the unary call
+// and releases its worker.
+// -----------------------------------------------------------------------------
+class CompileProgramTask final : public WorkerTask {
+ public:
+  CompileProgramTask(const CompileRequest* request, CompileResponse* response,
+                     grpc::ServerUnaryReactor* reactor,
+                     std::shared_ptr<SandboxedProcess> executor,
+                     std::shared_ptr<ProgramRegistry> programs,
+                     DynamicWorkerCoordinator* compile_pool);
+
+  // Reads the request's code_digest in place of its code, as
+  // BasicExecuteReactor::ResolveBlobs() does. `blobs` may be null.
+  absl::Status ResolveBlobs(BlobStore* blobs);
+
+  void StartExecution() override;
+  void PumpWrites() override;
+  void Abandon(const absl::Status& status) override;
+
+ private:
+  const CompileRequest* request_;
+  CompileResponse* response_;
+  grpc::ServerUnaryReactor* reactor_;
+  std::shared_ptr<SandboxedProcess> executor_;
+  std::shared_ptr<ProgramRegistry> programs_;
+  DynamicWorkerCoordinator* compile_pool_;
+  // The code to build, read from the blob store for a code_digest.
+  std::string code_;
+  grpc::Status status_;
 };
 
 }  // namespace dcodex
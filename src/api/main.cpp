@@ -14,21 +14,108 @@
 
 #include <grpcpp/grpcpp.h>
 #include <string>
+#include <algorithm>
+#include <filesystem>
 #include <memory>
+#include <system_error>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "absl/time/time.h"
 #include "src/api/code_executor_service.h"
 #include "src/api/server_instance_manager.h"
+#include "src/common/artifact_cache.h"
+#include "src/common/blob_store.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/bounded_executor.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/compile_governor.h"
+#include "src/engine/compile_single_flight.h"
+#include "src/engine/fork_server_stub.h"
+#include "src/engine/language_toolchain.h"
+#include "src/engine/precompiled_header_manager.h"
+#include "src/engine/program_registry.h"
+#include "src/engine/python_zygote.h"
+#include "src/engine/sandbox.h"
+#include "src/engine/sandbox_supervisor.h"
+#include "src/engine/tiered_compilation.h"
 
 ABSL_FLAG(uint16_t, port, 50051, "Server port for the service");
 ABSL_FLAG(int, max_concurrent_sandboxes, 10,
           "Maximum number of concurrent sandboxes allowed");
+ABSL_FLAG(int, max_concurrent_compiles, 4,
+          "Maximum compile-stage workers; compiles queue separately from "
+          "program runs");
+ABSL_FLAG(int, max_concurrent_compiler_processes, 0,
+          "Host-wide cap on running compiler processes, shared by request, "
+          "speculative and promotion compiles (0 sizes it from cores and "
+          "available memory)");
+ABSL_FLAG(int, sandbox_supervisor_threads, 1,
+          "Event-loop threads watching running programs' output, exit and "
+          "deadline, so run workers do not block on them (0 disables)");
+ABSL_FLAG(std::string, artifact_cache_dir, "/tmp/dcodex_artifacts",
+          "Directory for cached compiled binaries (empty disables the cache)");
+ABSL_FLAG(uint64_t, artifact_cache_max_bytes, 1ULL * 1024 * 1024 * 1024,
+          "Disk budget in bytes for cached compiled binaries");
+ABSL_FLAG(std::string, pch_dir, "/tmp/dcodex_pch",
+          "Directory for C++ precompiled headers built at startup "
+          "(empty disables PCH)");
+ABSL_FLAG(std::string, fork_server_dir, "",
+          "Directory for the fork server stub linked into C and C++ programs; "
+          "prepared programs (Compile/Run handles, batches) then fork each run "
+          "from a loaded copy instead of exec'ing it (empty disables)");
+ABSL_FLAG(int, python_zygotes, 0,
+          "Pre-started Python interpreters that Python runs are forked from "
+          "instead of starting python3 (0 disables)");
+ABSL_FLAG(std::vector<std::string>, python_zygote_preload,
+          std::vector<std::string>({"bisect", "collections", "functools",
+                                    "heapq", "itertools", "math", "re"}),
+          "Modules the Python zygotes import once at startup");
+ABSL_FLAG(bool, worker_warm_state, false,
+          "Gives each worker a workspace, ready output pipes and resolved "
+          "toolchain paths, and each Python run worker a zygote of its own, "
+          "reset between tasks instead of set up by every run");
+ABSL_FLAG(std::vector<std::string>, sandbox_namespaces, {},
+          "Linux namespaces sandboxed runs are placed in, any of user, mount, "
+          "pid, net and ipc; each run worker creates its set once and its "
+          "runs join it (empty disables)");
+ABSL_FLAG(bool, tiered_compilation, false,
+          "Build compiled languages at -O0 first and rebuild hot sources at "
+          "-O2 in the background (requires the artifact cache)");
+ABSL_FLAG(int, tiered_promotion_threshold, 3,
+          "Executions of one source that trigger its optimized rebuild");
+ABSL_FLAG(int, speculative_compile_threads, 2,
+          "Threads compiling requests while they wait for a worker lease "
+          "(0 disables; requires the artifact cache)");
+ABSL_FLAG(std::string, tiered_fast_linker, "",
+          "Linker for fast-tier builds, passed as -fuse-ld (e.g. lld); "
+          "empty keeps the compiler default");
+ABSL_FLAG(std::string, upload_dir, "/tmp/dcodex_uploads",
+          "Directory receiving ExecuteUpload stdin payloads while their "
+          "requests run");
+ABSL_FLAG(uint64_t, max_upload_bytes, 1ULL * 1024 * 1024 * 1024,
+          "Largest code plus stdin accepted by one ExecuteUpload call, and "
+          "largest UploadBlob payload");
+ABSL_FLAG(int, max_batch_cases, 1024,
+          "Largest number of cases accepted by one ExecuteBatch call");
+ABSL_FLAG(int, batch_case_parallelism, 8,
+          "Cases of one ExecuteBatch call that run at the same time");
+ABSL_FLAG(std::string, blob_store_dir, "/tmp/dcodex_blobs",
+          "Directory for UploadBlob payloads referenced by digest (empty "
+          "disables the blob store)");
+ABSL_FLAG(uint64_t, blob_store_max_bytes, 4ULL * 1024 * 1024 * 1024,
+          "Disk budget in bytes for stored blobs (LRU eviction)");
+ABSL_FLAG(int, max_program_handles, 1024,
+          "Most programs held for Run by Compile handles, least recently "
+          "used evicted first (0 disables Compile and Run)");
+ABSL_FLAG(absl::Duration, program_handle_ttl, absl::Minutes(10),
+          "How long a Compile handle stays valid after its last use");
 
 namespace dcodex {
 
@@ -43,7 +130,159 @@ absl::Status RunServer() {
 
   std::string server_address = absl::Substitute("0.0.0.0:$0", absl::GetFlag(FLAGS_port));
   auto cache = std::make_shared<ExecutionCache>(absl::Hours(1), 1000);
-  CodeExecutorServiceImpl service(absl::GetFlag(FLAGS_max_concurrent_sandboxes), std::move(cache));
+
+  CompilationServices compilation;
+  int compiler_permits = absl::GetFlag(FLAGS_max_concurrent_compiler_processes);
+  if (compiler_permits <= 0) {
+    compiler_permits = CompileGovernor::DefaultPermits(
+        absl::GetFlag(FLAGS_compile_memory_limit_bytes));
+  }
+  compilation.governor = std::make_shared<CompileGovernor>(compiler_permits);
+  LOG(INFO) << "Compile governor allows " << compiler_permits
+            << " concurrent compiler processes";
+
+  if (const std::string artifact_dir = absl::GetFlag(FLAGS_artifact_cache_dir);
+      !artifact_dir.empty()) {
+    auto artifact_cache = ArtifactCache::Create(
+        artifact_dir, absl::GetFlag(FLAGS_artifact_cache_max_bytes));
+    if (artifact_cache.ok()) {
+      compilation.artifact_cache = *std::move(artifact_cache);
+      LOG(INFO) << "Artifact cache enabled at " << artifact_dir;
+    } else {
+      // Caching is an optimization; serve uncached rather than refuse to start.
+      LOG(WARNING) << "Artifact cache disabled: " << artifact_cache.status();
+    }
+  }
+
+  if (const int threads = absl::GetFlag(FLAGS_speculative_compile_threads);
+      threads > 0 && compilation.artifact_cache) {
+    compilation.single_flight = std::make_shared<CompileSingleFlight>();
+    compilation.speculation_executor = std::make_shared<BoundedExecutor>(
+        static_cast<size_t>(threads),
+        static_cast<size_t>(
+            std::max(1, absl::GetFlag(FLAGS_max_concurrent_sandboxes))));
+    LOG(INFO) << "Speculative compilation enabled with " << threads
+              << " threads";
+  }
+
+  if (absl::GetFlag(FLAGS_tiered_compilation)) {
+    TieredCompilationManager::Options options;
+    options.promotion_threshold =
+        absl::GetFlag(FLAGS_tiered_promotion_threshold);
+    if (const std::string linker = absl::GetFlag(FLAGS_tiered_fast_linker);
+        !linker.empty()) {
+      options.fast_flags.push_back(absl::StrCat("-fuse-ld=", linker));
+    }
+    compilation.tiering =
+        std::make_shared<TieredCompilationManager>(std::move(options));
+    LOG(INFO) << "Tiered compilation enabled (promotion after "
+              << absl::GetFlag(FLAGS_tiered_promotion_threshold) << " runs)";
+  }
+
+  if (const std::string pch_dir = absl::GetFlag(FLAGS_pch_dir);
+      !pch_dir.empty()) {
+    const auto cpp = LanguageToolchainFactory::CreateCpp();
+    // PCH selection requires an exact flag match, so build against the flags
+    // CompileStep will actually use.
+    std::vector<std::string> pch_flags = cpp->GetStandardFlags();
+    if (compilation.tiering) {
+      const auto& fast = compilation.tiering->FlagsFor(
+          TieredCompilationManager::Tier::kFast);
+      pch_flags.insert(pch_flags.end(), fast.begin(), fast.end());
+    }
+    auto pch_manager = PrecompiledHeaderManager::Create(
+        pch_dir, std::string(cpp->GetExecutable()), pch_flags);
+    if (pch_manager.ok()) {
+      LOG(INFO) << "Built " << (*pch_manager)->variant_count()
+                << " precompiled header variants in " << pch_dir;
+      compilation.pch_manager = *std::move(pch_manager);
+    } else {
+      LOG(WARNING) << "Precompiled headers disabled: " << pch_manager.status();
+    }
+  }
+
+  if (const std::string fork_server_dir = absl::GetFlag(FLAGS_fork_server_dir);
+      !fork_server_dir.empty()) {
+    auto stub = ForkServerStub::Create(
+        fork_server_dir,
+        std::string(LanguageToolchainFactory::CreateC()->GetExecutable()));
+    if (stub.ok()) {
+      LOG(INFO) << "Fork server stub built at " << (*stub)->object_path();
+      compilation.fork_server_stub = *std::move(stub);
+    } else {
+      LOG(WARNING) << "Fork servers disabled: " << stub.status();
+    }
+  }
+
+  if (const int python_zygotes = absl::GetFlag(FLAGS_python_zygotes);
+      python_zygotes > 0) {
+    auto zygote = std::make_shared<PythonZygote>(
+        python_zygotes, absl::GetFlag(FLAGS_python_zygote_preload));
+    // A zygote that fails to start only costs its runs the fork.
+    if (absl::Status started = zygote->Start(); started.ok()) {
+      LOG(INFO) << "Started " << python_zygotes << " Python zygotes";
+    }
+    compilation.python_zygote = std::move(zygote);
+  }
+
+  std::shared_ptr<SandboxSupervisor> supervisor;
+  if (const int threads = absl::GetFlag(FLAGS_sandbox_supervisor_threads);
+      threads > 0) {
+    auto created = SandboxSupervisor::Create(threads);
+    if (created.ok()) {
+      supervisor = *std::move(created);
+      LOG(INFO) << "Sandbox supervisor watching programs on " << threads
+                << " threads";
+    } else {
+      // Run workers then block on their programs, as before.
+      LOG(WARNING) << "Sandbox supervisor disabled: " << created.status();
+    }
+  }
+
+  // Uploads left by a previous process belong to requests that no longer
+  // exist.
+  const std::filesystem::path upload_dir = absl::GetFlag(FLAGS_upload_dir);
+  std::error_code ec;
+  std::filesystem::create_directories(upload_dir, ec);
+  if (ec) {
+    LOG(WARNING) << "ExecuteUpload unavailable: cannot create " << upload_dir
+                 << ": " << ec.message();
+  } else {
+    for (const auto& entry :
+         std::filesystem::directory_iterator(upload_dir, ec)) {
+      if (entry.path().filename().string().starts_with("upload_")) {
+        std::filesystem::remove(entry.path(), ec);
+      }
+    }
+  }
+
+  std::shared_ptr<BlobStore> blob_store;
+  if (const std::string blob_dir = absl::GetFlag(FLAGS_blob_store_dir);
+      !blob_dir.empty()) {
+    auto created =
+        BlobStore::Create(blob_dir, absl::GetFlag(FLAGS_blob_store_max_bytes));
+    if (created.ok()) {
+      blob_store = *std::move(created);
+      LOG(INFO) << "Blob store enabled at " << blob_dir << " ("
+                << blob_store->GetStats().entries << " blobs kept)";
+    } else {
+      // Clients can still send payloads inline.
+      LOG(WARNING) << "Blob store disabled: " << created.status();
+    }
+  }
+
+  std::shared_ptr<ProgramRegistry> programs;
+  if (const int max_programs = absl::GetFlag(FLAGS_max_program_handles);
+      max_programs > 0) {
+    programs = std::make_shared<ProgramRegistry>(
+        static_cast<size_t>(max_programs),
+        absl::GetFlag(FLAGS_program_handle_ttl));
+  }
+
+  CodeExecutorServiceImpl service(absl::GetFlag(FLAGS_max_concurrent_sandboxes),
+                                  std::move(cache), std::move(compilation),
+                                  std::move(supervisor), std::move(blob_store),
+                                  std::move(programs));
   
   grpc::ServerBuilder builder;
   builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
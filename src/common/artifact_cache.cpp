@@ -0,0 +1,256 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/common/artifact_cache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "src/common/content_digest.h"
+#include "src/common/execution_cache.h"
+
+namespace dcodex {
+
+namespace {
+
+/// Places a hard link to `source` at `destination`, falling back to a full
+/// copy when the two paths live on different filesystems.
+absl::Status LinkOrCopy(const std::string& source,
+                        const std::string& destination) {
+  if (link(source.c_str(), destination.c_str()) == 0) {
+    return absl::OkStatus();
+  }
+  const int link_errno = errno;
+  if (link_errno != EXDEV && link_errno != EPERM && link_errno != EMLINK) {
+    return absl::ErrnoToStatus(
+        link_errno, absl::StrCat("link failed: ", source, " -> ", destination));
+  }
+
+  std::error_code ec;
+  std::filesystem::copy_file(source, destination,
+                             std::filesystem::copy_options::overwrite_existing,
+                             ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrCat("copy failed: ", source, " -> ",
+                                           destination, ": ", ec.message()));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+// ==============================================================================
+// ArtifactCacheInterface Implementation
+// ==============================================================================
+
+absl::StatusOr<std::string> ArtifactCacheInterface::ComputeKey(
+    absl::string_view toolchain_id, absl::string_view compiler_version,
+    absl::Span<const std::string> flags, absl::string_view source) {
+  // A binary served under a colliding key would run in place of another
+  // source, so the key is a SHA-256, not CacheInterface::ComputeHash().
+  // NUL separators keep adjacent fields from aliasing ("ab" + "c" vs
+  // "a" + "bc").
+  const absl::string_view separator("\0", 1);
+  Sha256 hasher;
+  hasher.Update(toolchain_id);
+  hasher.Update(separator);
+  hasher.Update(compiler_version);
+  hasher.Update(separator);
+  for (const auto& flag : flags) {
+    hasher.Update(flag);
+    hasher.Update(separator);
+  }
+  hasher.Update(source);
+  return hasher.HexDigest();
+}
+
+// ==============================================================================
+// ArtifactCache Implementation
+// ==============================================================================
+
+absl::StatusOr<std::shared_ptr<ArtifactCache>> ArtifactCache::Create(
+    std::string root_dir, uint64_t max_bytes) {
+  if (root_dir.empty()) {
+    return absl::InvalidArgumentError("Artifact cache directory is empty");
+  }
+  if (max_bytes == 0) {
+    return absl::InvalidArgumentError("Artifact cache budget must be non-zero");
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(root_dir, ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrCat(
+        "Failed to create artifact cache directory ", root_dir, ": ",
+        ec.message()));
+  }
+
+  // The index lives in memory, so anything on disk is from a previous process
+  // and cannot be trusted to match this process's keys.
+  for (const auto& entry : std::filesystem::directory_iterator(root_dir, ec)) {
+    std::error_code remove_ec;
+    std::filesystem::remove(entry.path(), remove_ec);
+  }
+
+  return std::shared_ptr<ArtifactCache>(
+      new ArtifactCache(std::move(root_dir), max_bytes));
+}
+
+ArtifactCache::ArtifactCache(std::string root_dir, uint64_t max_bytes)
+    : root_dir_(std::move(root_dir)), max_bytes_(max_bytes) {}
+
+absl::Status ArtifactCache::Fetch(absl::string_view key,
+                                  const std::string& destination_path) {
+  absl::MutexLock lock(&mutex_);
+
+  const auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    misses_++;
+    return absl::NotFoundError(absl::StrCat("No artifact for key ", key));
+  }
+
+  // Linking under the lock guarantees the artifact cannot be evicted between
+  // the index lookup and the moment the caller owns its own link.
+  const absl::Status status = LinkOrCopy(it->second.path, destination_path);
+  if (!status.ok()) {
+    // The file vanished or is unreadable; forget it so the next caller
+    // recompiles instead of failing again.
+    EraseLocked(key);
+    misses_++;
+    return absl::NotFoundError(
+        absl::StrCat("Artifact for key ", key, " unavailable: ",
+                     status.message()));
+  }
+
+  hits_++;
+
+  // Promote to front of LRU list (most recently used) using splice for O(1).
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+  return absl::OkStatus();
+}
+
+absl::Status ArtifactCache::Store(absl::string_view key,
+                                  const std::string& artifact_path) {
+  std::error_code ec;
+  const uint64_t size_bytes = std::filesystem::file_size(artifact_path, ec);
+  if (ec) {
+    return absl::NotFoundError(absl::StrCat("Cannot stat artifact ",
+                                            artifact_path, ": ", ec.message()));
+  }
+  if (size_bytes > max_bytes_) {
+    return absl::ResourceExhaustedError(absl::StrFormat(
+        "Artifact of %d bytes exceeds the %d byte cache budget", size_bytes,
+        max_bytes_));
+  }
+
+  uint64_t staging_id = 0;
+  {
+    absl::MutexLock lock(&mutex_);
+    staging_id = next_staging_id_++;
+  }
+
+  // Stage under a unique name outside the lock (the copy fallback may be
+  // slow), then publish atomically with rename(2).
+  const std::string final_path = PathForKey(key);
+  const std::string staging_path =
+      absl::StrCat(final_path, ".staging.", staging_id);
+  if (absl::Status status = LinkOrCopy(artifact_path, staging_path);
+      !status.ok()) {
+    return status;
+  }
+  // Stored artifacts are shared by every later hit; make them read-only.
+  chmod(staging_path.c_str(), 0555);
+
+  absl::MutexLock lock(&mutex_);
+  if (std::rename(staging_path.c_str(), final_path.c_str()) != 0) {
+    const int rename_errno = errno;
+    unlink(staging_path.c_str());
+    return absl::ErrnoToStatus(rename_errno,
+                               absl::StrCat("rename failed: ", final_path));
+  }
+
+  if (const auto it = entries_.find(key); it != entries_.end()) {
+    total_bytes_ -= it->second.size_bytes;
+    lru_list_.erase(it->second.lru_iterator);
+    entries_.erase(it);
+  }
+
+  lru_list_.push_front(std::string(key));
+  entries_.emplace(std::string(key),
+                   Entry{final_path, size_bytes, lru_list_.begin()});
+  total_bytes_ += size_bytes;
+
+  EvictIfNeeded();
+  return absl::OkStatus();
+}
+
+absl::Status ArtifactCache::Erase(absl::string_view key) {
+  absl::MutexLock lock(&mutex_);
+  if (!entries_.contains(key)) {
+    return absl::NotFoundError(absl::StrCat("No artifact for key ", key));
+  }
+  EraseLocked(key);
+  return absl::OkStatus();
+}
+
+void ArtifactCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  for (const auto& [key, entry] : entries_) {
+    unlink(entry.path.c_str());
+  }
+  entries_.clear();
+  lru_list_.clear();
+  total_bytes_ = 0;
+}
+
+ArtifactCache::ArtifactStats ArtifactCache::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return {entries_.size(), total_bytes_, hits_, misses_, evictions_};
+}
+
+std::string ArtifactCache::PathForKey(absl::string_view key) const {
+  return absl::StrCat(root_dir_, "/", key, ".bin");
+}
+
+void ArtifactCache::EraseLocked(absl::string_view key) {
+  const auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return;
+  }
+  unlink(it->second.path.c_str());
+  total_bytes_ -= it->second.size_bytes;
+  lru_list_.erase(it->second.lru_iterator);
+  entries_.erase(it);
+}
+
+void ArtifactCache::EvictIfNeeded() {
+  while (total_bytes_ > max_bytes_ && !lru_list_.empty()) {
+    // Evict from back (least recently used). Copy the key: EraseLocked
+    // destroys the list node that holds it.
+    const std::string oldest_key = lru_list_.back();
+    EraseLocked(oldest_key);
+    evictions_++;
+  }
+}
+
+}  // namespace dcodex
@@ -0,0 +1,144 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_COMMON_ARTIFACT_CACHE_H_
+#define SRC_COMMON_ARTIFACT_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace dcodex {
+
+// =============================================================================
+// ArtifactCacheInterface: Content-addressed store for compiled binaries.
+// Unlike CacheInterface (keyed on code + stdin, stores program output), this
+// cache is keyed only on what determines the compiler's output, so one compile
+// serves every stdin the same source is later run against.
+// =============================================================================
+class ArtifactCacheInterface {
+ public:
+  virtual ~ArtifactCacheInterface() = default;
+
+  // Materializes the artifact stored under `key` at `destination_path`.
+  // Returns NotFoundError on a miss.
+  virtual absl::Status Fetch(absl::string_view key,
+                             const std::string& destination_path) = 0;
+
+  // Stores a copy of the file at `artifact_path` under `key`, evicting least
+  // recently used artifacts to stay within the disk budget.
+  virtual absl::Status Store(absl::string_view key,
+                             const std::string& artifact_path) = 0;
+
+  // Removes the artifact stored under `key`. Returns NotFoundError if absent.
+  virtual absl::Status Erase(absl::string_view key) = 0;
+
+  // Removes every stored artifact.
+  virtual void Clear() = 0;
+
+  // Artifact cache statistics.
+  struct ArtifactStats {
+    size_t entries = 0;
+    uint64_t total_bytes = 0;
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t evictions = 0;
+  };
+
+  // Gets artifact cache statistics.
+  [[nodiscard]] virtual ArtifactStats GetStats() const = 0;
+
+  // Computes the content address of a compiled artifact from everything that
+  // can change the compiler's output: the toolchain, the resolved compiler
+  // version, the exact flags, and the source text. The key is their SHA-256,
+  // in lowercase hex.
+  [[nodiscard]] static absl::StatusOr<std::string> ComputeKey(
+      absl::string_view toolchain_id, absl::string_view compiler_version,
+      absl::Span<const std::string> flags, absl::string_view source);
+};
+
+// Thread-safe, disk-backed LRU artifact cache with a byte budget.
+//
+// Artifacts are hard-linked in and out of `root_dir` where the filesystem
+// allows it, so a hit costs one link(2) instead of a compile. Because each
+// caller receives its own link, evicting an artifact never disturbs a binary
+// that is already being executed.
+class ArtifactCache final : public ArtifactCacheInterface {
+ public:
+  // Creates the cache rooted at `root_dir`, creating the directory if needed
+  // and discarding artifacts left behind by a previous server process.
+  [[nodiscard]] static absl::StatusOr<std::shared_ptr<ArtifactCache>> Create(
+      std::string root_dir, uint64_t max_bytes);
+
+  ~ArtifactCache() override = default;
+
+  // Disallow copy and move operations.
+  ArtifactCache(const ArtifactCache&) = delete;
+  ArtifactCache& operator=(const ArtifactCache&) = delete;
+  ArtifactCache(ArtifactCache&&) = delete;
+  ArtifactCache& operator=(ArtifactCache&&) = delete;
+
+  absl::Status Fetch(absl::string_view key,
+                     const std::string& destination_path) override;
+
+  absl::Status Store(absl::string_view key,
+                     const std::string& artifact_path) override;
+
+  absl::Status Erase(absl::string_view key) override;
+
+  void Clear() override;
+
+  [[nodiscard]] ArtifactStats GetStats() const override;
+
+ private:
+  ArtifactCache(std::string root_dir, uint64_t max_bytes);
+
+  // LRU list type: stores artifact keys. Front = most recently used.
+  using LruList = std::list<std::string>;
+  using LruIterator = LruList::iterator;
+
+  struct Entry {
+    std::string path;
+    uint64_t size_bytes = 0;
+    LruIterator lru_iterator;
+  };
+
+  [[nodiscard]] std::string PathForKey(absl::string_view key) const;
+  void EraseLocked(absl::string_view key) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EvictIfNeeded() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::string root_dir_;
+  const uint64_t max_bytes_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  LruList lru_list_ ABSL_GUARDED_BY(mutex_);
+  uint64_t total_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t evictions_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t next_staging_id_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_COMMON_ARTIFACT_CACHE_H_
@@ -0,0 +1,158 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/common/artifact_cache.h"
+
+#include <stdlib.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "src/common/content_digest.h"
+
+namespace dcodex {
+namespace {
+
+// Creates a fresh scratch directory so tests never share on-disk state.
+std::string MakeScratchDir() {
+  std::string templ = absl::StrCat(testing::TempDir(), "/artifact_cache_XXXXXX");
+  const char* dir = mkdtemp(templ.data());
+  EXPECT_NE(dir, nullptr);
+  return templ;
+}
+
+// Writes `content` to `path` and returns the path.
+std::string WriteFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+  return path;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+TEST(ArtifactCacheTest, KeyDependsOnEveryComponent) {
+  const std::vector<std::string> flags = {"-std=c++17"};
+  const auto base = ArtifactCacheInterface::ComputeKey("cpp", "v1", flags, "src");
+  ASSERT_TRUE(base.ok()) << base.status();
+
+  const std::vector<std::string> other_flags = {"-std=c++20"};
+  EXPECT_NE(*base, *ArtifactCacheInterface::ComputeKey("c", "v1", flags, "src"));
+  EXPECT_NE(*base, *ArtifactCacheInterface::ComputeKey("cpp", "v2", flags, "src"));
+  EXPECT_NE(*base,
+            *ArtifactCacheInterface::ComputeKey("cpp", "v1", other_flags, "src"));
+  EXPECT_NE(*base, *ArtifactCacheInterface::ComputeKey("cpp", "v1", flags, "src2"));
+  EXPECT_EQ(*base, *ArtifactCacheInterface::ComputeKey("cpp", "v1", flags, "src"));
+  EXPECT_TRUE(Sha256::IsValidHexDigest(*base)) << *base;
+}
+
+TEST(ArtifactCacheTest, StoreThenFetchRoundTrip) {
+  const std::string dir = MakeScratchDir();
+  auto cache = ArtifactCache::Create(dir + "/store", 1 << 20);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  const std::string artifact = WriteFile(dir + "/a.bin", "binary-bytes");
+  ASSERT_TRUE((*cache)->Store("k1", artifact).ok());
+
+  const std::string dest = dir + "/fetched.bin";
+  ASSERT_TRUE((*cache)->Fetch("k1", dest).ok());
+  EXPECT_EQ(ReadFile(dest), "binary-bytes");
+
+  EXPECT_TRUE(absl::IsNotFound((*cache)->Fetch("missing", dir + "/x.bin")));
+
+  const auto stats = (*cache)->GetStats();
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.total_bytes, 12u);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST(ArtifactCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+  const std::string dir = MakeScratchDir();
+  // Budget fits exactly two 10-byte artifacts.
+  auto cache = ArtifactCache::Create(dir + "/store", 20);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  const std::string artifact = WriteFile(dir + "/a.bin", "0123456789");
+  ASSERT_TRUE((*cache)->Store("old", artifact).ok());
+  ASSERT_TRUE((*cache)->Store("mid", artifact).ok());
+
+  // Touch "old" so "mid" becomes the least recently used entry.
+  ASSERT_TRUE((*cache)->Fetch("old", dir + "/touch.bin").ok());
+  ASSERT_TRUE((*cache)->Store("new", artifact).ok());
+
+  EXPECT_TRUE((*cache)->Fetch("old", dir + "/old.bin").ok());
+  EXPECT_TRUE((*cache)->Fetch("new", dir + "/new.bin").ok());
+  EXPECT_TRUE(absl::IsNotFound((*cache)->Fetch("mid", dir + "/mid.bin")));
+
+  const auto stats = (*cache)->GetStats();
+  EXPECT_EQ(stats.entries, 2u);
+  EXPECT_LE(stats.total_bytes, 20u);
+  EXPECT_EQ(stats.evictions, 1);
+}
+
+TEST(ArtifactCacheTest, EraseRemovesOnlyThatKey) {
+  const std::string dir = MakeScratchDir();
+  auto cache = ArtifactCache::Create(dir + "/store", 1 << 20);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  const std::string artifact = WriteFile(dir + "/a.bin", "abc");
+  ASSERT_TRUE((*cache)->Store("keep", artifact).ok());
+  ASSERT_TRUE((*cache)->Store("drop", artifact).ok());
+
+  EXPECT_TRUE((*cache)->Erase("drop").ok());
+  EXPECT_TRUE(absl::IsNotFound((*cache)->Erase("drop")));
+  EXPECT_TRUE(absl::IsNotFound((*cache)->Fetch("drop", dir + "/d.bin")));
+  EXPECT_TRUE((*cache)->Fetch("keep", dir + "/k.bin").ok());
+  EXPECT_EQ((*cache)->GetStats().total_bytes, 3u);
+}
+
+TEST(ArtifactCacheTest, RejectsArtifactLargerThanBudget) {
+  const std::string dir = MakeScratchDir();
+  auto cache = ArtifactCache::Create(dir + "/store", 4);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  const std::string artifact = WriteFile(dir + "/a.bin", "too large");
+  EXPECT_TRUE(absl::IsResourceExhausted((*cache)->Store("k", artifact)));
+  EXPECT_EQ((*cache)->GetStats().entries, 0u);
+}
+
+TEST(ArtifactCacheTest, FetchedLinkSurvivesEviction) {
+  const std::string dir = MakeScratchDir();
+  auto cache = ArtifactCache::Create(dir + "/store", 10);
+  ASSERT_TRUE(cache.ok()) << cache.status();
+
+  ASSERT_TRUE((*cache)->Store("k1", WriteFile(dir + "/a.bin", "aaaaaaaaaa")).ok());
+  const std::string dest = dir + "/in_use.bin";
+  ASSERT_TRUE((*cache)->Fetch("k1", dest).ok());
+
+  // Storing a second artifact evicts k1, but the caller's copy must remain.
+  ASSERT_TRUE((*cache)->Store("k2", WriteFile(dir + "/b.bin", "bbbbbbbbbb")).ok());
+  EXPECT_TRUE(absl::IsNotFound((*cache)->Fetch("k1", dir + "/again.bin")));
+  EXPECT_EQ(ReadFile(dest), "aaaaaaaaaa");
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,255 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/common/blob_store.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+
+namespace dcodex {
+
+// ==============================================================================
+// BlobStore::Lease Implementation
+// ==============================================================================
+
+BlobStore::Lease::~Lease() {
+  if (!path_.empty()) {
+    unlink(path_.c_str());
+  }
+}
+
+BlobStore::Lease& BlobStore::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    if (!path_.empty()) {
+      unlink(path_.c_str());
+    }
+    path_ = std::exchange(other.path_, {});
+    digest_ = std::exchange(other.digest_, {});
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+// ==============================================================================
+// BlobStore Implementation
+// ==============================================================================
+
+absl::StatusOr<std::shared_ptr<BlobStore>> BlobStore::Create(
+    std::string root_dir, uint64_t max_bytes) {
+  if (root_dir.empty()) {
+    return absl::InvalidArgumentError("Blob store directory is empty");
+  }
+  if (max_bytes == 0) {
+    return absl::InvalidArgumentError("Blob store budget must be non-zero");
+  }
+
+  std::shared_ptr<BlobStore> store(new BlobStore(std::move(root_dir), max_bytes));
+
+  std::error_code ec;
+  std::filesystem::create_directories(store->StagingDir(), ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrCat("Failed to create blob store ",
+                                           store->root_dir_, ": ",
+                                           ec.message()));
+  }
+
+  // Uploads and leases in staging belong to requests of a previous process.
+  for (const auto& entry :
+       std::filesystem::directory_iterator(store->StagingDir(), ec)) {
+    std::error_code remove_ec;
+    std::filesystem::remove(entry.path(), remove_ec);
+  }
+
+  // A blob's name is its digest, so blobs survive a restart; anything else
+  // in the directory is not ours to serve.
+  absl::MutexLock lock(&store->mutex_);
+  for (const auto& entry :
+       std::filesystem::directory_iterator(store->root_dir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (entry.path() == store->StagingDir()) {
+      continue;
+    }
+    std::error_code entry_ec;
+    if (!Sha256::IsValidHexDigest(name) || !entry.is_regular_file(entry_ec)) {
+      std::filesystem::remove_all(entry.path(), entry_ec);
+      continue;
+    }
+    const uint64_t size_bytes = entry.file_size(entry_ec);
+    if (!entry_ec) {
+      store->InsertLocked(name, size_bytes);
+    }
+  }
+  store->EvictIfNeeded();
+  return store;
+}
+
+BlobStore::BlobStore(std::string root_dir, uint64_t max_bytes)
+    : root_dir_(std::move(root_dir)), max_bytes_(max_bytes) {}
+
+absl::StatusOr<std::unique_ptr<DigestingFileWriter>> BlobStore::NewUpload()
+    const {
+  return DigestingFileWriter::Create(StagingDir());
+}
+
+absl::StatusOr<std::string> BlobStore::Commit(
+    std::unique_ptr<DigestingFileWriter> upload,
+    absl::string_view expected_digest) {
+  absl::StatusOr<DigestingFileWriter::Written> written = upload->Finish();
+  if (!written.ok()) {
+    return written.status();
+  }
+  if (!expected_digest.empty() && expected_digest != written->sha256) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Blob digest mismatch: expected ", expected_digest,
+                     ", received ", written->sha256));
+  }
+  if (written->size > max_bytes_) {
+    return absl::ResourceExhaustedError(absl::StrFormat(
+        "Blob of %d bytes exceeds the %d byte store budget", written->size,
+        max_bytes_));
+  }
+
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = entries_.find(written->sha256); it != entries_.end()) {
+    // Already stored; `upload` removes the duplicate when it goes away.
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+    return written->sha256;
+  }
+
+  const std::string final_path = PathForDigest(written->sha256);
+  // Stored blobs are shared by every later lease; make them read-only.
+  chmod(written->path.c_str(), 0444);
+  if (std::rename(written->path.c_str(), final_path.c_str()) != 0) {
+    return absl::ErrnoToStatus(errno,
+                               absl::StrCat("rename failed: ", final_path));
+  }
+  upload->Release();
+
+  InsertLocked(written->sha256, written->size);
+  EvictIfNeeded();
+  return written->sha256;
+}
+
+absl::StatusOr<std::string> BlobStore::Put(absl::string_view bytes) {
+  absl::StatusOr<std::unique_ptr<DigestingFileWriter>> upload = NewUpload();
+  if (!upload.ok()) {
+    return upload.status();
+  }
+  if (absl::Status status = (*upload)->Append(bytes); !status.ok()) {
+    return status;
+  }
+  return Commit(*std::move(upload));
+}
+
+bool BlobStore::Contains(absl::string_view digest) {
+  absl::MutexLock lock(&mutex_);
+  const auto it = entries_.find(digest);
+  if (it == entries_.end()) {
+    return false;
+  }
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+  return true;
+}
+
+absl::StatusOr<BlobStore::Lease> BlobStore::Acquire(absl::string_view digest) {
+  absl::MutexLock lock(&mutex_);
+
+  const auto it = entries_.find(digest);
+  if (it == entries_.end()) {
+    misses_++;
+    return absl::NotFoundError(absl::StrCat("No blob with digest ", digest));
+  }
+
+  // Linking under the lock guarantees the blob cannot be evicted between the
+  // index lookup and the moment the caller owns its own link.
+  std::string lease_path =
+      absl::StrCat(StagingDir(), "/lease_", next_lease_id_++);
+  if (link(PathForDigest(digest).c_str(), lease_path.c_str()) != 0) {
+    const int link_errno = errno;
+    // The file vanished; forget it so the client uploads it again.
+    total_bytes_ -= it->second.size_bytes;
+    lru_list_.erase(it->second.lru_iterator);
+    entries_.erase(it);
+    misses_++;
+    return absl::NotFoundError(absl::StrCat(
+        "Blob ", digest, " unavailable: ", std::strerror(link_errno)));
+  }
+
+  hits_++;
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second.lru_iterator);
+  return Lease(std::move(lease_path), std::string(digest),
+               it->second.size_bytes);
+}
+
+absl::StatusOr<std::string> BlobStore::Read(absl::string_view digest) {
+  absl::StatusOr<Lease> lease = Acquire(digest);
+  if (!lease.ok()) {
+    return lease.status();
+  }
+  std::ifstream in(lease->path(), std::ios::binary);
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  if (!in) {
+    return absl::DataLossError(absl::StrCat("Failed to read blob ", digest));
+  }
+  return std::move(contents).str();
+}
+
+BlobStore::Stats BlobStore::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return {entries_.size(), total_bytes_, hits_, misses_, evictions_};
+}
+
+std::string BlobStore::PathForDigest(absl::string_view digest) const {
+  return absl::StrCat(root_dir_, "/", digest);
+}
+
+std::string BlobStore::StagingDir() const {
+  return absl::StrCat(root_dir_, "/staging");
+}
+
+void BlobStore::InsertLocked(absl::string_view digest, uint64_t size_bytes) {
+  lru_list_.push_front(std::string(digest));
+  entries_.emplace(std::string(digest), Entry{size_bytes, lru_list_.begin()});
+  total_bytes_ += size_bytes;
+}
+
+void BlobStore::EvictIfNeeded() {
+  while (total_bytes_ > max_bytes_ && !lru_list_.empty()) {
+    // Copy the digest: erasing the entry destroys the list node holding it.
+    const std::string oldest = lru_list_.back();
+    const auto it = entries_.find(oldest);
+    unlink(PathForDigest(oldest).c_str());
+    total_bytes_ -= it->second.size_bytes;
+    lru_list_.pop_back();
+    entries_.erase(it);
+    evictions_++;
+  }
+}
+
+}  // namespace dcodex
@@ -0,0 +1,156 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SRC_COMMON_BLOB_STORE_H_
+#define SRC_COMMON_BLOB_STORE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "src/common/content_digest.h"
+
+namespace dcodex {
+
+// =============================================================================
+// BlobStore: disk-backed, content-addressed store for request payloads.
+// Blobs are named by the lowercase hex SHA-256 of their bytes, so a client
+// that has uploaded a test input once can reference it by digest on every
+// later request instead of resending it. Unlike ArtifactCache, the address
+// is computed from the content itself and can be checked by the client.
+//
+// Blobs are evicted least recently used first to stay within a byte budget.
+// Readers never open a stored blob directly: Acquire() hands out a private
+// hard link, so eviction cannot pull a file from under a running program.
+// =============================================================================
+class BlobStore {
+ public:
+  // A private link to a stored blob, removed when the lease is destroyed.
+  class Lease {
+   public:
+    Lease() = default;
+    Lease(std::string path, std::string digest, uint64_t size)
+        : path_(std::move(path)), digest_(std::move(digest)), size_(size) {}
+    ~Lease();
+
+    Lease(Lease&& other) noexcept { *this = std::move(other); }
+    Lease& operator=(Lease&& other) noexcept;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+    [[nodiscard]] const std::string& digest() const { return digest_; }
+    [[nodiscard]] uint64_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return path_.empty(); }
+
+   private:
+    std::string path_;
+    std::string digest_;
+    uint64_t size_ = 0;
+  };
+
+  // Opens the store rooted at `root_dir`, creating it if needed. Blobs left
+  // by a previous server process are indexed again, since their names are
+  // their digests.
+  [[nodiscard]] static absl::StatusOr<std::shared_ptr<BlobStore>> Create(
+      std::string root_dir, uint64_t max_bytes);
+
+  // Disallow copy and move operations.
+  BlobStore(const BlobStore&) = delete;
+  BlobStore& operator=(const BlobStore&) = delete;
+  BlobStore(BlobStore&&) = delete;
+  BlobStore& operator=(BlobStore&&) = delete;
+
+  // Starts an upload. The writer's file lives next to the store, so
+  // Commit() publishes it with a rename instead of a copy.
+  [[nodiscard]] absl::StatusOr<std::unique_ptr<DigestingFileWriter>>
+  NewUpload() const;
+
+  // Finishes `upload` (from NewUpload()) and publishes it under its digest,
+  // which is returned. When `expected_digest` is set and does not match, the
+  // upload is discarded with InvalidArgumentError. If the blob is already
+  // stored, the new copy is discarded.
+  absl::StatusOr<std::string> Commit(
+      std::unique_ptr<DigestingFileWriter> upload,
+      absl::string_view expected_digest = "");
+
+  // Stores `bytes` and returns their digest.
+  absl::StatusOr<std::string> Put(absl::string_view bytes);
+
+  // Whether `digest` is stored. Counts as a use for eviction, so a client
+  // that checks before referencing a blob keeps it resident.
+  bool Contains(absl::string_view digest);
+
+  // Links the blob `digest` to a fresh private path. Returns NotFoundError
+  // if it is not stored.
+  [[nodiscard]] absl::StatusOr<Lease> Acquire(absl::string_view digest);
+
+  // Returns the contents of the blob `digest`.
+  [[nodiscard]] absl::StatusOr<std::string> Read(absl::string_view digest);
+
+  // Blob store statistics.
+  struct Stats {
+    size_t entries = 0;
+    uint64_t total_bytes = 0;
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t evictions = 0;
+  };
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  BlobStore(std::string root_dir, uint64_t max_bytes);
+
+  // LRU list type: stores digests. Front = most recently used.
+  using LruList = std::list<std::string>;
+  using LruIterator = LruList::iterator;
+
+  struct Entry {
+    uint64_t size_bytes = 0;
+    LruIterator lru_iterator;
+  };
+
+  [[nodiscard]] std::string PathForDigest(absl::string_view digest) const;
+  // Staging area for uploads and leases, on the same filesystem as the blobs.
+  [[nodiscard]] std::string StagingDir() const;
+  void InsertLocked(absl::string_view digest, uint64_t size_bytes)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EvictIfNeeded() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::string root_dir_;
+  const uint64_t max_bytes_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  LruList lru_list_ ABSL_GUARDED_BY(mutex_);
+  uint64_t total_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t hits_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t misses_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t evictions_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t next_lease_id_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_COMMON_BLOB_STORE_H_
@@ -0,0 +1,134 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/common/blob_store.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "src/common/content_digest.h"
+
+namespace dcodex {
+namespace {
+
+// Creates a fresh scratch directory so tests never share on-disk state.
+std::string MakeScratchDir() {
+  std::string templ = absl::StrCat(testing::TempDir(), "/blob_store_XXXXXX");
+  const char* dir = mkdtemp(templ.data());
+  EXPECT_NE(dir, nullptr);
+  return templ;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+TEST(BlobStoreTest, PutNamesBlobsByTheirSha256) {
+  auto store = BlobStore::Create(MakeScratchDir(), 1 << 20);
+  ASSERT_TRUE(store.ok()) << store.status();
+
+  const auto digest = (*store)->Put("test input");
+  ASSERT_TRUE(digest.ok()) << digest.status();
+  EXPECT_EQ(*digest, Sha256::Of("test input"));
+  EXPECT_TRUE((*store)->Contains(*digest));
+  EXPECT_FALSE((*store)->Contains(Sha256::Of("other input")));
+
+  const auto contents = (*store)->Read(*digest);
+  ASSERT_TRUE(contents.ok()) << contents.status();
+  EXPECT_EQ(*contents, "test input");
+}
+
+TEST(BlobStoreTest, DuplicateUploadsAreStoredOnce) {
+  auto store = BlobStore::Create(MakeScratchDir(), 1 << 20);
+  ASSERT_TRUE(store.ok()) << store.status();
+
+  ASSERT_TRUE((*store)->Put("same bytes").ok());
+  ASSERT_TRUE((*store)->Put("same bytes").ok());
+  const BlobStore::Stats stats = (*store)->GetStats();
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.total_bytes, 10u);
+}
+
+TEST(BlobStoreTest, CommitRejectsUnexpectedDigest) {
+  const std::string dir = MakeScratchDir();
+  auto store = BlobStore::Create(dir, 1 << 20);
+  ASSERT_TRUE(store.ok()) << store.status();
+
+  auto upload = (*store)->NewUpload();
+  ASSERT_TRUE(upload.ok()) << upload.status();
+  ASSERT_TRUE((*upload)->Append("payload").ok());
+  const auto digest =
+      (*store)->Commit(*std::move(upload), Sha256::Of("something else"));
+  EXPECT_EQ(digest.status().code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ((*store)->GetStats().entries, 0u);
+  EXPECT_TRUE(std::filesystem::is_empty(dir + "/staging"));
+}
+
+TEST(BlobStoreTest, LeaseOutlivesEviction) {
+  auto store = BlobStore::Create(MakeScratchDir(), 16);
+  ASSERT_TRUE(store.ok()) << store.status();
+
+  const auto first = (*store)->Put("0123456789");
+  ASSERT_TRUE(first.ok()) << first.status();
+  auto lease = (*store)->Acquire(*first);
+  ASSERT_TRUE(lease.ok()) << lease.status();
+  EXPECT_EQ(lease->size(), 10u);
+
+  // Pushes the first blob over the budget.
+  ASSERT_TRUE((*store)->Put("abcdefghij").ok());
+  EXPECT_FALSE((*store)->Contains(*first));
+  EXPECT_EQ((*store)->GetStats().evictions, 1);
+  EXPECT_EQ(ReadFile(lease->path()), "0123456789");
+
+  const std::string lease_path = lease->path();
+  *lease = BlobStore::Lease();
+  EXPECT_FALSE(std::filesystem::exists(lease_path));
+  EXPECT_EQ((*store)->Acquire(*first).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(BlobStoreTest, ReopenIndexesExistingBlobs) {
+  const std::string dir = MakeScratchDir();
+  std::string digest;
+  {
+    auto store = BlobStore::Create(dir, 1 << 20);
+    ASSERT_TRUE(store.ok()) << store.status();
+    auto put = (*store)->Put("kept across restarts");
+    ASSERT_TRUE(put.ok()) << put.status();
+    digest = *put;
+    std::ofstream(dir + "/not-a-digest") << "junk";
+  }
+
+  auto reopened = BlobStore::Create(dir, 1 << 20);
+  ASSERT_TRUE(reopened.ok()) << reopened.status();
+  EXPECT_TRUE((*reopened)->Contains(digest));
+  EXPECT_EQ((*reopened)->GetStats().entries, 1u);
+  EXPECT_FALSE(std::filesystem::exists(dir + "/not-a-digest"));
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,132 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/common/content_digest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+
+namespace dcodex {
+
+// ==============================================================================
+// Sha256 Implementation
+// ==============================================================================
+
+// EVP rather than the SHA256_* functions, which OpenSSL 3 deprecates; the
+// same calls build against BoringSSL.
+struct Sha256::State {
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  ~State() { EVP_MD_CTX_free(ctx); }
+};
+
+Sha256::Sha256() : state_(std::make_unique<State>()) {
+  EVP_DigestInit_ex(state_->ctx, EVP_sha256(), nullptr);
+}
+
+Sha256::~Sha256() = default;
+
+void Sha256::Update(absl::string_view bytes) {
+  EVP_DigestUpdate(state_->ctx, bytes.data(), bytes.size());
+}
+
+std::string Sha256::HexDigest() {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_DigestFinal_ex(state_->ctx, digest, &length);
+  return absl::BytesToHexString(absl::string_view(
+      reinterpret_cast<const char*>(digest), static_cast<size_t>(length)));
+}
+
+std::string Sha256::Of(absl::string_view bytes) {
+  Sha256 hasher;
+  hasher.Update(bytes);
+  return hasher.HexDigest();
+}
+
+bool Sha256::IsValidHexDigest(absl::string_view digest) {
+  if (digest.size() != 64) {
+    return false;
+  }
+  for (const char c : digest) {
+    if (!absl::ascii_isdigit(static_cast<unsigned char>(c)) &&
+        (c < 'a' || c > 'f')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ==============================================================================
+// DigestingFileWriter Implementation
+// ==============================================================================
+
+absl::StatusOr<std::unique_ptr<DigestingFileWriter>>
+DigestingFileWriter::Create(absl::string_view dir) {
+  std::string path = absl::StrCat(dir, "/upload_XXXXXX");
+  const int fd = mkostemp(path.data(), O_CLOEXEC);
+  if (fd == -1) {
+    return absl::ErrnoToStatus(errno,
+                               absl::StrCat("Failed to create upload in ", dir));
+  }
+  return std::unique_ptr<DigestingFileWriter>(
+      new DigestingFileWriter(std::move(path), fd));
+}
+
+DigestingFileWriter::~DigestingFileWriter() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+  if (!path_.empty()) {
+    unlink(path_.c_str());
+  }
+}
+
+absl::Status DigestingFileWriter::Append(absl::string_view bytes) {
+  if (fd_ == -1) {
+    return absl::FailedPreconditionError("Upload already finished");
+  }
+  hasher_.Update(bytes);
+  size_ += bytes.size();
+  while (!bytes.empty()) {
+    const ssize_t n = write(fd_, bytes.data(), bytes.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return absl::ErrnoToStatus(errno, "Failed to write upload");
+    }
+    bytes.remove_prefix(static_cast<size_t>(n));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<DigestingFileWriter::Written> DigestingFileWriter::Finish() {
+  if (fd_ == -1) {
+    return absl::FailedPreconditionError("Upload already finished");
+  }
+  const int fd = fd_;
+  fd_ = -1;
+  if (close(fd) != 0) {
+    return absl::ErrnoToStatus(errno, "Failed to close upload");
+  }
+  return Written{path_, hasher_.HexDigest(), size_};
+}
+
+}  // namespace dcodex
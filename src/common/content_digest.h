@@ -0,0 +1,107 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_COMMON_CONTENT_DIGEST_H_
+#define SRC_COMMON_CONTENT_DIGEST_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace dcodex {
+
+// =============================================================================
+// Sha256: incremental SHA-256 of a byte stream.
+// Unlike CacheInterface::ComputeHash, the digest is stable across processes
+// and collision resistant, so clients can compute it themselves and it can
+// name content received from untrusted callers.
+// =============================================================================
+class Sha256 {
+ public:
+  Sha256();
+  ~Sha256();
+
+  Sha256(const Sha256&) = delete;
+  Sha256& operator=(const Sha256&) = delete;
+
+  // Feeds the next `bytes` of the stream.
+  void Update(absl::string_view bytes);
+
+  // Returns the lowercase hex digest of everything fed so far. The hasher
+  // cannot be used afterwards.
+  [[nodiscard]] std::string HexDigest();
+
+  // Lowercase hex digest of `bytes`.
+  [[nodiscard]] static std::string Of(absl::string_view bytes);
+
+  // Whether `digest` is well-formed: 64 lowercase hex characters.
+  [[nodiscard]] static bool IsValidHexDigest(absl::string_view digest);
+
+ private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+// =============================================================================
+// DigestingFileWriter: streams a payload into a file while hashing it, so a
+// large upload is never held in memory and its digest is ready when the last
+// chunk lands. The file is removed on destruction unless released.
+// =============================================================================
+class DigestingFileWriter {
+ public:
+  // Creates an empty, uniquely named file in `dir`.
+  [[nodiscard]] static absl::StatusOr<std::unique_ptr<DigestingFileWriter>>
+  Create(absl::string_view dir);
+
+  ~DigestingFileWriter();
+
+  DigestingFileWriter(const DigestingFileWriter&) = delete;
+  DigestingFileWriter& operator=(const DigestingFileWriter&) = delete;
+
+  // Appends `bytes` to the file and the digest.
+  absl::Status Append(absl::string_view bytes);
+
+  // What was written.
+  struct Written {
+    std::string path;
+    std::string sha256;
+    uint64_t size = 0;
+  };
+
+  // Closes the file and returns its path and digest. The file is still
+  // removed when the writer is destroyed; see Release().
+  [[nodiscard]] absl::StatusOr<Written> Finish();
+
+  // Gives up ownership of the file: it is no longer removed on destruction.
+  void Release() { path_.clear(); }
+
+  [[nodiscard]] uint64_t size() const { return size_; }
+
+ private:
+  DigestingFileWriter(std::string path, int fd) : path_(std::move(path)), fd_(fd) {}
+
+  std::string path_;
+  int fd_;
+  uint64_t size_ = 0;
+  Sha256 hasher_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_COMMON_CONTENT_DIGEST_H_
@@ -0,0 +1,101 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/common/content_digest.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace dcodex {
+namespace {
+
+std::string MakeScratchDir() {
+  std::string templ = absl::StrCat(testing::TempDir(), "/content_digest_XXXXXX");
+  const char* dir = mkdtemp(templ.data());
+  EXPECT_NE(dir, nullptr);
+  return templ;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+TEST(Sha256Test, MatchesKnownVectors) {
+  EXPECT_EQ(Sha256::Of(""),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(Sha256::Of("abc"),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(Sha256Test, ChunkingDoesNotChangeTheDigest) {
+  const std::string payload(100000, 'q');
+  Sha256 hasher;
+  for (size_t i = 0; i < payload.size(); i += 4093) {
+    hasher.Update(absl::string_view(payload).substr(i, 4093));
+  }
+  EXPECT_EQ(hasher.HexDigest(), Sha256::Of(payload));
+}
+
+TEST(Sha256Test, ValidatesHexDigests) {
+  EXPECT_TRUE(Sha256::IsValidHexDigest(Sha256::Of("x")));
+  EXPECT_FALSE(Sha256::IsValidHexDigest("abc"));
+  EXPECT_FALSE(Sha256::IsValidHexDigest(std::string(64, 'A')));
+  EXPECT_FALSE(Sha256::IsValidHexDigest(std::string(63, 'a') + "/"));
+}
+
+TEST(DigestingFileWriterTest, WritesAndHashesTheStream) {
+  const std::string dir = MakeScratchDir();
+  auto writer = DigestingFileWriter::Create(dir);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE((*writer)->Append("hello ").ok());
+  ASSERT_TRUE((*writer)->Append("world").ok());
+  EXPECT_EQ((*writer)->size(), 11U);
+
+  const auto written = (*writer)->Finish();
+  ASSERT_TRUE(written.ok()) << written.status();
+  EXPECT_EQ(written->size, 11U);
+  EXPECT_EQ(written->sha256, Sha256::Of("hello world"));
+  EXPECT_EQ(ReadFile(written->path), "hello world");
+  EXPECT_FALSE((*writer)->Append("more").ok());
+
+  // Removed with the writer unless released.
+  writer->reset();
+  EXPECT_NE(access(written->path.c_str(), F_OK), 0);
+}
+
+TEST(DigestingFileWriterTest, ReleasedFileOutlivesTheWriter) {
+  const std::string dir = MakeScratchDir();
+  auto writer = DigestingFileWriter::Create(dir);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE((*writer)->Append("kept").ok());
+  const auto written = (*writer)->Finish();
+  ASSERT_TRUE(written.ok()) << written.status();
+  (*writer)->Release();
+  writer->reset();
+  EXPECT_EQ(ReadFile(written->path), "kept");
+  unlink(written->path.c_str());
+}
+
+}  // namespace
+}  // namespace dcodex
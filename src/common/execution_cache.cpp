@@ -14,6 +14,7 @@
 
 #include "src/common/execution_cache.h"
 
+#include <algorithm>
 #include <list>
 
 #include "absl/hash/hash.h"
@@ -49,6 +50,15 @@ absl::StatusOr<std::string> CacheInterface::ComputeHash(
   return HashToHex(hash);
 }
 
+absl::StatusOr<std::string> CacheInterface::ComputeHash(
+    absl::Span<const absl::string_view> parts) {
+  if (std::all_of(parts.begin(), parts.end(),
+                  [](absl::string_view part) { return part.empty(); })) {
+    return absl::InvalidArgumentError("Code cannot be empty");
+  }
+  return HashToHex(absl::HashOf(parts));
+}
+
 // ==============================================================================
 // ExecutionCache Implementation
 // ==============================================================================
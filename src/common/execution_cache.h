@@ -25,6 +25,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 
 namespace dcodex {
 
@@ -61,6 +62,11 @@ class CacheInterface {
   [[nodiscard]] static absl::StatusOr<std::string> ComputeHash(
       absl::string_view code);
 
+  // Hashes the sequence `parts` without concatenating them; where one part
+  // ends and the next begins is part of the hash. Fails if all are empty.
+  [[nodiscard]] static absl::StatusOr<std::string> ComputeHash(
+      absl::Span<const absl::string_view> parts);
+
   // Clears all expired entries.
   virtual void CleanupExpired() = 0;
 
@@ -0,0 +1,87 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/bounded_executor.h"
+
+#include <utility>
+
+namespace dcodex {
+
+BoundedExecutor::BoundedExecutor(size_t num_threads, size_t max_queued)
+    : max_queued_(max_queued) {
+  const size_t thread_count = num_threads > 0 ? num_threads : 1;
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this] { Run(); });
+  }
+}
+
+BoundedExecutor::~BoundedExecutor() { Shutdown(); }
+
+absl::Status BoundedExecutor::Submit(Task task) {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (stopping_) {
+      return absl::FailedPreconditionError("Executor is shutting down");
+    }
+    if (queue_.size() >= max_queued_) {
+      return absl::ResourceExhaustedError("Executor queue is full");
+    }
+    queue_.push_back(std::move(task));
+  }
+  cv_.Signal();
+  return absl::OkStatus();
+}
+
+void BoundedExecutor::Shutdown() {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+    queue_.clear();
+  }
+  cv_.SignalAll();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+size_t BoundedExecutor::QueueDepth() const {
+  absl::MutexLock lock(&mutex_);
+  return queue_.size();
+}
+
+void BoundedExecutor::Run() {
+  while (true) {
+    Task task;
+    {
+      absl::MutexLock lock(&mutex_);
+      while (queue_.empty() && !stopping_) {
+        cv_.Wait(&mutex_);
+      }
+      if (stopping_) {
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace dcodex
@@ -0,0 +1,72 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_BOUNDED_EXECUTOR_H_
+#define SRC_ENGINE_BOUNDED_EXECUTOR_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// BoundedExecutor: fixed-size thread pool with a bounded FIFO queue.
+// Used for background compiler work that must never pile up unboundedly
+// behind a burst of requests: when the queue is full, Submit() fails fast and
+// the caller falls back to doing the work inline (or not at all).
+// -----------------------------------------------------------------------------
+class BoundedExecutor {
+ public:
+  using Task = std::function<void()>;
+
+  BoundedExecutor(size_t num_threads, size_t max_queued);
+  ~BoundedExecutor();
+
+  BoundedExecutor(const BoundedExecutor&) = delete;
+  BoundedExecutor& operator=(const BoundedExecutor&) = delete;
+
+  // Enqueues `task`. Returns ResourceExhausted when the queue is full and
+  // FailedPrecondition after Shutdown().
+  absl::Status Submit(Task task);
+
+  // Stops accepting tasks, drops queued ones, and joins the threads after
+  // their current task. Idempotent.
+  void Shutdown();
+
+  // Number of tasks waiting to start.
+  [[nodiscard]] size_t QueueDepth() const;
+
+ private:
+  void Run();
+
+  const size_t max_queued_;
+
+  mutable absl::Mutex mutex_;
+  absl::CondVar cv_;
+  std::deque<Task> queue_ ABSL_GUARDED_BY(mutex_);
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_BOUNDED_EXECUTOR_H_
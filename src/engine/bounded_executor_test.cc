@@ -0,0 +1,89 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/bounded_executor.h"
+
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace dcodex {
+namespace {
+
+TEST(BoundedExecutorTest, RunsSubmittedTasks) {
+  std::atomic<int> ran{0};
+  absl::Notification done;
+  BoundedExecutor executor(2, 8);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(executor.Submit([&] {
+                  if (ran.fetch_add(1) == 3) done.Notify();
+                }).ok());
+  }
+  done.WaitForNotification();
+  EXPECT_EQ(ran.load(), 4);
+}
+
+TEST(BoundedExecutorTest, RejectsWhenQueueIsFull) {
+  absl::Notification started;
+  absl::Notification release;
+  BoundedExecutor executor(1, 1);
+
+  // Occupies the only thread.
+  ASSERT_TRUE(executor.Submit([&] {
+                started.Notify();
+                release.WaitForNotification();
+              }).ok());
+  started.WaitForNotification();
+
+  ASSERT_TRUE(executor.Submit([] {}).ok());
+  EXPECT_EQ(executor.QueueDepth(), 1u);
+  EXPECT_EQ(executor.Submit([] {}).code(),
+            absl::StatusCode::kResourceExhausted);
+
+  release.Notify();
+}
+
+TEST(BoundedExecutorTest, ShutdownDropsQueuedTasksAndRejectsNewOnes) {
+  absl::Notification started;
+  absl::Notification release;
+  std::atomic<bool> queued_ran{false};
+  BoundedExecutor executor(1, 4);
+
+  ASSERT_TRUE(executor.Submit([&] {
+                started.Notify();
+                release.WaitForNotification();
+              }).ok());
+  started.WaitForNotification();
+  ASSERT_TRUE(executor.Submit([&] { queued_ran = true; }).ok());
+
+  // Shut down while the first task still holds the only thread, so the
+  // queued task cannot be picked up before it is dropped.
+  std::thread stopper([&] { executor.Shutdown(); });
+  while (executor.QueueDepth() > 0) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  release.Notify();
+  stopper.join();
+  EXPECT_FALSE(queued_ran.load());
+  EXPECT_EQ(executor.Submit([] {}).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+}  // namespace
+}  // namespace dcodex
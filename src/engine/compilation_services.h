@@ -0,0 +1,75 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_COMPILATION_SERVICES_H_
+#define SRC_ENGINE_COMPILATION_SERVICES_H_
+
+#include <memory>
+
+#include "src/common/artifact_cache.h"
+#include "src/engine/bounded_executor.h"
+#include "src/engine/compile_governor.h"
+#include "src/engine/compile_single_flight.h"
+#include "src/engine/fork_server_stub.h"
+#include "src/engine/precompiled_header_manager.h"
+#include "src/engine/tiered_compilation.h"
+
+namespace dcodex {
+
+class PythonZygote;
+
+// -----------------------------------------------------------------------------
+// Parameter Object: CompilationServices
+// Groups the optional, process-wide collaborators used by CompileStep and the
+// execution strategies so that adding one does not ripple a new constructor
+// parameter through every strategy. Every member may be null; a
+// default-constructed instance yields the original compile-every-time
+// behavior.
+// -----------------------------------------------------------------------------
+struct CompilationServices {
+  // Content-addressed store of compiled binaries, shared by all requests.
+  std::shared_ptr<ArtifactCacheInterface> artifact_cache;
+
+  // Startup-built C++ precompiled headers, applied when a request's includes
+  // cover one of the variants.
+  std::shared_ptr<const PrecompiledHeaderManager> pch_manager;
+
+  // Fast-first / optimize-when-hot compile policy. Requires artifact_cache
+  // for promotion; without it every build simply uses the fast profile.
+  std::shared_ptr<TieredCompilationManager> tiering;
+
+  // Deduplicates concurrent compiles of one artifact key, so a request whose
+  // speculative compile is still running waits for it instead of racing it.
+  std::shared_ptr<CompileSingleFlight> single_flight;
+
+  // Host-wide cap on concurrently running compilers. Every compile path,
+  // including background ones, holds a permit while its compiler runs.
+  std::shared_ptr<CompileGovernor> governor;
+
+  // Runs SandboxedProcess::SpeculativeCompile() work while requests wait for
+  // a worker lease. Speculation is off when null or without artifact_cache.
+  std::shared_ptr<BoundedExecutor> speculation_executor;
+
+  // Linked into every C and C++ build so that prepared programs can be run
+  // through a ForkServer instead of exec'ing the binary per run.
+  std::shared_ptr<const ForkServerStub> fork_server_stub;
+
+  // Pre-started interpreters that Python runs are forked from instead of
+  // starting `python3` cold.
+  std::shared_ptr<PythonZygote> python_zygote;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_COMPILATION_SERVICES_H_
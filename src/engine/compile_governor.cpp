@@ -0,0 +1,72 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compile_governor.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+namespace dcodex {
+
+CompileGovernor::CompileGovernor(int permits) : permits_(std::max(1, permits)) {}
+
+int CompileGovernor::DefaultPermits(uint64_t per_compile_bytes) {
+  int permits = static_cast<int>(std::thread::hardware_concurrency());
+  if (permits <= 0) permits = 1;
+
+  const long pages = sysconf(_SC_AVPHYS_PAGES);
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (per_compile_bytes > 0 && pages > 0 && page_size > 0) {
+    const uint64_t available =
+        static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+    permits = static_cast<int>(std::min<uint64_t>(
+        static_cast<uint64_t>(permits), available / per_compile_bytes));
+  }
+  return std::max(1, permits);
+}
+
+CompileGovernor::Permit CompileGovernor::Acquire() {
+  absl::MutexLock lock(&mutex_);
+  const uint64_t ticket = next_ticket_++;
+  auto my_turn = [this, ticket]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return ticket == serving_ && in_use_ < permits_;
+  };
+  if (!my_turn()) {
+    ++total_waits_;
+    mutex_.Await(absl::Condition(&my_turn));
+  }
+  ++serving_;
+  ++in_use_;
+  return Permit(this);
+}
+
+void CompileGovernor::Release() {
+  absl::MutexLock lock(&mutex_);
+  --in_use_;
+}
+
+CompileGovernor::Stats CompileGovernor::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  Stats stats;
+  stats.permits = permits_;
+  stats.in_use = in_use_;
+  stats.waiting = static_cast<int>(next_ticket_ - serving_);
+  stats.total_waits = total_waits_;
+  return stats;
+}
+
+}  // namespace dcodex
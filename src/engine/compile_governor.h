@@ -0,0 +1,91 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_COMPILE_GOVERNOR_H_
+#define SRC_ENGINE_COMPILE_GOVERNOR_H_
+
+#include <cstdint>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// CompileGovernor: host-wide counting semaphore for compiler invocations.
+//
+// Every compile path (compile stage, speculation, tier promotion) takes a
+// permit around the compiler process, so a burst of submissions queues here
+// instead of oversubscribing cores and memory. Waiters are served in arrival
+// order.
+// -----------------------------------------------------------------------------
+class CompileGovernor {
+ public:
+  // RAII permit; released on destruction.
+  class Permit {
+   public:
+    explicit Permit(CompileGovernor* governor) : governor_(governor) {}
+    ~Permit() {
+      if (governor_ != nullptr) governor_->Release();
+    }
+
+    Permit(Permit&& other) noexcept : governor_(other.governor_) {
+      other.governor_ = nullptr;
+    }
+    Permit(const Permit&) = delete;
+    Permit& operator=(const Permit&) = delete;
+    Permit& operator=(Permit&&) = delete;
+
+   private:
+    CompileGovernor* governor_;
+  };
+
+  struct Stats {
+    int permits = 0;
+    int in_use = 0;
+    int waiting = 0;
+    int64_t total_waits = 0;
+  };
+
+  explicit CompileGovernor(int permits);
+
+  CompileGovernor(const CompileGovernor&) = delete;
+  CompileGovernor& operator=(const CompileGovernor&) = delete;
+
+  // Sizes the semaphore from the host: one permit per core, capped so that
+  // every permit holder can use `per_compile_bytes` of currently available
+  // memory. Never less than one.
+  [[nodiscard]] static int DefaultPermits(uint64_t per_compile_bytes);
+
+  // Blocks until a permit is available.
+  [[nodiscard]] Permit Acquire();
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  void Release();
+
+  const int permits_;
+
+  mutable absl::Mutex mutex_;
+  int in_use_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Ticket counters give FIFO ordering among waiters.
+  uint64_t next_ticket_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t serving_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t total_waits_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_COMPILE_GOVERNOR_H_
@@ -0,0 +1,104 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compile_governor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace dcodex {
+namespace {
+
+TEST(CompileGovernorTest, PermitIsReleasedOnDestruction) {
+  CompileGovernor governor(2);
+  {
+    auto a = governor.Acquire();
+    auto b = governor.Acquire();
+    EXPECT_EQ(governor.GetStats().in_use, 2);
+  }
+  const CompileGovernor::Stats stats = governor.GetStats();
+  EXPECT_EQ(stats.permits, 2);
+  EXPECT_EQ(stats.in_use, 0);
+  EXPECT_EQ(stats.total_waits, 0);
+}
+
+TEST(CompileGovernorTest, NonPositivePermitCountIsClampedToOne) {
+  CompileGovernor governor(0);
+  EXPECT_EQ(governor.GetStats().permits, 1);
+}
+
+TEST(CompileGovernorTest, AcquireBlocksAtCapacity) {
+  CompileGovernor governor(1);
+  auto held = std::make_optional(governor.Acquire());
+
+  std::atomic<bool> acquired{false};
+  absl::Notification waiter_started;
+  std::thread waiter([&] {
+    waiter_started.Notify();
+    auto permit = governor.Acquire();
+    acquired = true;
+  });
+  waiter_started.WaitForNotification();
+  while (governor.GetStats().waiting == 0) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_FALSE(acquired.load());
+
+  held.reset();
+  waiter.join();
+  EXPECT_TRUE(acquired.load());
+  EXPECT_EQ(governor.GetStats().total_waits, 1);
+  EXPECT_EQ(governor.GetStats().waiting, 0);
+}
+
+TEST(CompileGovernorTest, NeverExceedsPermits) {
+  constexpr int kPermits = 3;
+  CompileGovernor governor(kPermits);
+  std::atomic<int> running{0};
+  std::atomic<int> peak{0};
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 12; ++i) {
+    threads.emplace_back([&] {
+      auto permit = governor.Acquire();
+      const int now = ++running;
+      int seen = peak.load();
+      while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+      }
+      absl::SleepFor(absl::Milliseconds(5));
+      --running;
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_LE(peak.load(), kPermits);
+  EXPECT_EQ(governor.GetStats().in_use, 0);
+}
+
+TEST(CompileGovernorTest, DefaultPermitsIsAtLeastOne) {
+  EXPECT_GE(CompileGovernor::DefaultPermits(0), 1);
+  // A per-compile budget larger than any host still yields one permit.
+  EXPECT_EQ(CompileGovernor::DefaultPermits(UINT64_MAX), 1);
+}
+
+}  // namespace
+}  // namespace dcodex
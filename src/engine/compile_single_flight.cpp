@@ -0,0 +1,60 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compile_single_flight.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace dcodex {
+
+CompileSingleFlight::Leader::Leader(CompileSingleFlight* owner,
+                                    std::string key,
+                                    std::shared_ptr<absl::Notification> done)
+    : owner_(owner), key_(std::move(key)), done_(std::move(done)) {}
+
+CompileSingleFlight::Leader::~Leader() {
+  owner_->Release(key_);
+  done_->Notify();
+}
+
+std::unique_ptr<CompileSingleFlight::Leader> CompileSingleFlight::JoinOrLead(
+    absl::string_view key) {
+  std::shared_ptr<absl::Notification> pending;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto [it, inserted] =
+        in_flight_.try_emplace(key, std::make_shared<absl::Notification>());
+    if (inserted) {
+      return std::unique_ptr<Leader>(
+          new Leader(this, std::string(key), it->second));
+    }
+    pending = it->second;
+  }
+  pending->WaitForNotification();
+  return nullptr;
+}
+
+size_t CompileSingleFlight::InFlight() const {
+  absl::MutexLock lock(&mutex_);
+  return in_flight_.size();
+}
+
+void CompileSingleFlight::Release(const std::string& key) {
+  absl::MutexLock lock(&mutex_);
+  in_flight_.erase(key);
+}
+
+}  // namespace dcodex
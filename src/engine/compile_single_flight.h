@@ -0,0 +1,80 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_COMPILE_SINGLE_FLIGHT_H_
+#define SRC_ENGINE_COMPILE_SINGLE_FLIGHT_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// CompileSingleFlight: at most one in-flight compile per artifact key.
+//
+// A speculative compile started when the request arrives and the request's
+// own CompileStep race for the same key. The first caller leads and compiles;
+// later callers block until the leader finishes and then look in the artifact
+// cache, instead of running the compiler a second time.
+// -----------------------------------------------------------------------------
+class CompileSingleFlight {
+ public:
+  // Held by the caller that compiles `key`; releases waiters on destruction.
+  class Leader {
+   public:
+    ~Leader();
+
+    Leader(const Leader&) = delete;
+    Leader& operator=(const Leader&) = delete;
+
+   private:
+    friend class CompileSingleFlight;
+    Leader(CompileSingleFlight* owner, std::string key,
+           std::shared_ptr<absl::Notification> done);
+
+    CompileSingleFlight* owner_;
+    std::string key_;
+    std::shared_ptr<absl::Notification> done_;
+  };
+
+  CompileSingleFlight() = default;
+
+  CompileSingleFlight(const CompileSingleFlight&) = delete;
+  CompileSingleFlight& operator=(const CompileSingleFlight&) = delete;
+
+  // Returns a Leader if no compile of `key` is in flight. Otherwise waits for
+  // the in-flight one to finish and returns null; the caller should then
+  // re-check the artifact cache.
+  [[nodiscard]] std::unique_ptr<Leader> JoinOrLead(absl::string_view key);
+
+  // Number of keys currently being compiled.
+  [[nodiscard]] size_t InFlight() const;
+
+ private:
+  void Release(const std::string& key);
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::shared_ptr<absl::Notification>>
+      in_flight_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_COMPILE_SINGLE_FLIGHT_H_
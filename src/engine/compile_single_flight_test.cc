@@ -0,0 +1,72 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compile_single_flight.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace dcodex {
+namespace {
+
+TEST(CompileSingleFlightTest, FirstCallerLeads) {
+  CompileSingleFlight flight;
+  auto leader = flight.JoinOrLead("key");
+  ASSERT_NE(leader, nullptr);
+  EXPECT_EQ(flight.InFlight(), 1u);
+  leader.reset();
+  EXPECT_EQ(flight.InFlight(), 0u);
+
+  // Once released, the key can be led again.
+  EXPECT_NE(flight.JoinOrLead("key"), nullptr);
+}
+
+TEST(CompileSingleFlightTest, DistinctKeysDoNotWait) {
+  CompileSingleFlight flight;
+  auto a = flight.JoinOrLead("a");
+  auto b = flight.JoinOrLead("b");
+  EXPECT_NE(a, nullptr);
+  EXPECT_NE(b, nullptr);
+  EXPECT_EQ(flight.InFlight(), 2u);
+}
+
+TEST(CompileSingleFlightTest, FollowerWaitsForLeader) {
+  CompileSingleFlight flight;
+  auto leader = flight.JoinOrLead("key");
+  ASSERT_NE(leader, nullptr);
+
+  std::atomic<bool> follower_returned{false};
+  absl::Notification follower_started;
+  std::thread follower([&] {
+    follower_started.Notify();
+    EXPECT_EQ(flight.JoinOrLead("key"), nullptr);
+    follower_returned = true;
+  });
+  follower_started.WaitForNotification();
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_FALSE(follower_returned.load());
+
+  leader.reset();
+  follower.join();
+  EXPECT_TRUE(follower_returned.load());
+}
+
+}  // namespace
+}  // namespace dcodex
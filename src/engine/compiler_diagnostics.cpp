@@ -0,0 +1,108 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compiler_diagnostics.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+
+namespace dcodex {
+
+namespace {
+
+using Severity = CompilerDiagnostic::Severity;
+
+struct SeverityMarker {
+  absl::string_view text;
+  Severity severity;
+};
+
+// "fatal error" must precede "error" so the longer marker wins at equal
+// positions.
+constexpr SeverityMarker kSeverityMarkers[] = {
+    {": fatal error: ", Severity::kError},
+    {": error: ", Severity::kError},
+    {": warning: ", Severity::kWarning},
+    {": note: ", Severity::kNote},
+};
+
+// Splits a trailing `:<int>` off `location`, storing the number in `value`.
+bool ConsumeTrailingNumber(absl::string_view& location, int& value) {
+  const size_t colon = location.rfind(':');
+  if (colon == absl::string_view::npos) {
+    return false;
+  }
+  if (!absl::SimpleAtoi(location.substr(colon + 1), &value) || value <= 0) {
+    return false;
+  }
+  location = location.substr(0, colon);
+  return true;
+}
+
+}  // namespace
+
+std::vector<CompilerDiagnostic> ParseCompilerDiagnostics(
+    absl::string_view output, absl::string_view source_path,
+    absl::string_view display_name) {
+  std::vector<CompilerDiagnostic> diagnostics;
+
+  for (absl::string_view line : absl::StrSplit(output, '\n')) {
+    line = absl::StripTrailingAsciiWhitespace(line);
+
+    const SeverityMarker* marker = nullptr;
+    size_t marker_pos = absl::string_view::npos;
+    for (const auto& candidate : kSeverityMarkers) {
+      const size_t pos = line.find(candidate.text);
+      if (pos < marker_pos) {
+        marker = &candidate;
+        marker_pos = pos;
+      }
+    }
+    if (marker == nullptr) {
+      continue;
+    }
+
+    CompilerDiagnostic diag;
+    diag.severity = marker->severity;
+    diag.message = std::string(line.substr(marker_pos + marker->text.size()));
+
+    // Location is `file:line:col`, `file:line`, or a bare tool name.
+    absl::string_view location = line.substr(0, marker_pos);
+    int first = 0;
+    int second = 0;
+    if (ConsumeTrailingNumber(location, second)) {
+      if (ConsumeTrailingNumber(location, first)) {
+        diag.line = first;
+        diag.column = second;
+      } else {
+        diag.line = second;
+      }
+      diag.file = location == source_path ? std::string(display_name)
+                                          : std::string(location);
+    } else if (location == source_path) {
+      diag.file = std::string(display_name);
+    }
+    diagnostics.push_back(std::move(diag));
+  }
+  return diagnostics;
+}
+
+}  // namespace dcodex
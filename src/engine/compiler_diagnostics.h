@@ -0,0 +1,40 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_COMPILER_DIAGNOSTICS_H_
+#define SRC_ENGINE_COMPILER_DIAGNOSTICS_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "src/engine/execution_types.h"
+
+namespace dcodex {
+
+// Parses GCC/Clang plain-text diagnostics into structured records.
+//
+// Recognizes the shared `file:line:col: severity: message` format (column and
+// line optional) and location-less driver messages such as
+// `collect2: error: ld returned 1 exit status`. Context lines (source
+// excerpts, carets, "In function ..." banners) are skipped.
+//
+// Locations in `source_path` (the server's temporary file) are reported as
+// `display_name` so clients see a stable file name.
+[[nodiscard]] std::vector<CompilerDiagnostic> ParseCompilerDiagnostics(
+    absl::string_view output, absl::string_view source_path,
+    absl::string_view display_name);
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_COMPILER_DIAGNOSTICS_H_
@@ -0,0 +1,83 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/compiler_diagnostics.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace dcodex {
+namespace {
+
+using Severity = CompilerDiagnostic::Severity;
+
+constexpr char kSource[] = "/tmp/dcodex_Ab12Cd.cpp";
+
+TEST(CompilerDiagnosticsTest, ParsesClangError) {
+  const auto diags = ParseCompilerDiagnostics(
+      "/tmp/dcodex_Ab12Cd.cpp:1:22: error: expected ';' after return statement\n"
+      "int main() { return 0 }\n"
+      "                     ^\n"
+      "                     ;\n"
+      "1 error generated.\n",
+      kSource, "main.cpp");
+  ASSERT_EQ(diags.size(), 1u);
+  EXPECT_EQ(diags[0].file, "main.cpp");
+  EXPECT_EQ(diags[0].line, 1);
+  EXPECT_EQ(diags[0].column, 22);
+  EXPECT_EQ(diags[0].severity, Severity::kError);
+  EXPECT_EQ(diags[0].message, "expected ';' after return statement");
+}
+
+TEST(CompilerDiagnosticsTest, ParsesGccMixedSeverities) {
+  const auto diags = ParseCompilerDiagnostics(
+      "/tmp/dcodex_Ab12Cd.cpp: In function 'int main()':\n"
+      "/tmp/dcodex_Ab12Cd.cpp:3:7: warning: unused variable 'x' "
+      "[-Wunused-variable]\n"
+      "/tmp/dcodex_Ab12Cd.cpp:4:3: error: 'foo' was not declared in this scope\n"
+      "/usr/include/c++/12/bits/stl_vector.h:10: note: declared here\n"
+      "/tmp/dcodex_Ab12Cd.cpp:1:10: fatal error: nope.h: No such file\n",
+      kSource, "main.cpp");
+  ASSERT_EQ(diags.size(), 4u);
+  EXPECT_EQ(diags[0].severity, Severity::kWarning);
+  EXPECT_EQ(diags[0].line, 3);
+  EXPECT_EQ(diags[1].severity, Severity::kError);
+  EXPECT_EQ(diags[1].message, "'foo' was not declared in this scope");
+  // Locations outside the submission keep their path; no column is reported.
+  EXPECT_EQ(diags[2].severity, Severity::kNote);
+  EXPECT_EQ(diags[2].file, "/usr/include/c++/12/bits/stl_vector.h");
+  EXPECT_EQ(diags[2].line, 10);
+  EXPECT_EQ(diags[2].column, 0);
+  EXPECT_EQ(diags[3].severity, Severity::kError);
+  EXPECT_EQ(diags[3].message, "nope.h: No such file");
+}
+
+TEST(CompilerDiagnosticsTest, DriverMessagesHaveNoLocation) {
+  const auto diags = ParseCompilerDiagnostics(
+      "/usr/bin/ld: main.o: in function `main': undefined reference to `f'\n"
+      "collect2: error: ld returned 1 exit status\n",
+      kSource, "main.cpp");
+  ASSERT_EQ(diags.size(), 1u);
+  EXPECT_TRUE(diags[0].file.empty());
+  EXPECT_EQ(diags[0].line, 0);
+  EXPECT_EQ(diags[0].message, "ld returned 1 exit status");
+}
+
+TEST(CompilerDiagnosticsTest, EmptyOutputYieldsNothing) {
+  EXPECT_TRUE(ParseCompilerDiagnostics("", kSource, "main.cpp").empty());
+}
+
+}  // namespace
+}  // namespace dcodex
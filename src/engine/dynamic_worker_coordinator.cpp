@@ -22,6 +22,14 @@
 #include "absl/synchronization/notification.h"
 
 namespace dcodex {
+namespace {
+
+// The running worker's warm state, set for the lifetime of its thread.
+thread_local WorkerWarmState* current_warm_state = nullptr;
+
+}  // namespace
+
+WorkerWarmState* WorkerWarmState::Current() { return current_warm_state; }
 
 LanguageId ParseLanguageId(const std::string& lang) {
   std::string lower_lang = lang;
@@ -76,6 +84,9 @@ void DynamicWorkerCoordinator::Shutdown() {
 
   for (auto& req : to_notify) {
     req->result = absl::CancelledError("Coordinator shutting down");
+    if (req->detached_notification) {
+      req->task->Abandon(req->result);
+    }
     req->done_notification->Notify();
   }
 
@@ -155,6 +166,7 @@ absl::StatusOr<WorkerTask*> DynamicWorkerCoordinator::LeaseWorker(
     // first (see Worker::Run's post-task dequeue), so lock order is consistent.
     if (best_worker && best_worker->TryAssignLocked(req->task)) {
       active_leases_[req->task.get()] = best_worker;
+      RecordAffinity(lang, *best_worker);
       return req->task.get();
     }
 
@@ -178,25 +190,68 @@ absl::StatusOr<WorkerTask*> DynamicWorkerCoordinator::LeaseWorker(
     done.WaitForNotification();
   }
 
+  RecordWait(start_time);
+
+  if (!req->result.ok()) return req->result;
+  return req->task.get();
+}
+
+absl::Status DynamicWorkerCoordinator::Dispatch(
+    LanguageId lang, std::shared_ptr<WorkerTask> task) {
+  auto req = std::make_shared<PendingRequest>();
+  req->lang = lang;
+  req->task = std::move(task);
+  req->detached_notification = std::make_unique<absl::Notification>();
+  req->done_notification = req->detached_notification.get();
+  req->request_time = absl::Now();
+
+  {
+    absl::MutexLock lock(&mutex_);
+    if (shutting_down_.load(std::memory_order_relaxed)) {
+      return absl::FailedPreconditionError("Coordinator is shutting down");
+    }
+
+    // Same affinity preference as LeaseWorker.
+    Worker* best_worker = nullptr;
+    for (const auto& w : workers_) {
+      if (w->state() == WorkerState::kIdle &&
+          (best_worker == nullptr || w->language() == lang)) {
+        best_worker = w.get();
+        if (w->language() == lang) break;
+      }
+    }
+    if (!best_worker || !best_worker->TryAssignLocked(req->task)) {
+      request_queue_.push_back(std::move(req));
+      return absl::OkStatus();
+    }
+    active_leases_[req->task.get()] = best_worker;
+    RecordAffinity(lang, *best_worker);
+  }
+  RecordWait(req->request_time);
+  return absl::OkStatus();
+}
+
+void DynamicWorkerCoordinator::RecordWait(absl::Time request_time) {
   // Track wait latency for the PoolBalancer's scaling heuristic and system metrics.
-  absl::Duration wait_time = absl::Now() - start_time;
+  absl::Duration wait_time = absl::Now() - request_time;
   double wait_time_ms = absl::ToDoubleMilliseconds(wait_time);
 
   total_wait_time_us_.fetch_add(absl::ToInt64Microseconds(wait_time),
                                 std::memory_order_relaxed);
   completed_requests_.fetch_add(1, std::memory_order_relaxed);
 
-  {
-    absl::MutexLock lock(&stats_mutex_);
-    latency_history_ms_.push_back(wait_time_ms);
-    // Keep only the last 10,000 requests for percentile calculation.
-    if (latency_history_ms_.size() > 10000) {
-      latency_history_ms_.erase(latency_history_ms_.begin());
-    }
+  absl::MutexLock lock(&stats_mutex_);
+  latency_history_ms_.push_back(wait_time_ms);
+  // Keep only the last 10,000 requests for percentile calculation.
+  if (latency_history_ms_.size() > 10000) {
+    latency_history_ms_.erase(latency_history_ms_.begin());
   }
+}
 
-  if (!req->result.ok()) return req->result;
-  return req->task.get();
+void DynamicWorkerCoordinator::RecordAffinity(LanguageId lang,
+                                              const Worker& worker) {
+  (worker.language() == lang ? affinity_hits_ : affinity_misses_)
+      .fetch_add(1, std::memory_order_relaxed);
 }
 
 void DynamicWorkerCoordinator::ReleaseWorker(WorkerTask* task) {
@@ -209,6 +264,7 @@ DynamicWorkerCoordinator::Metrics DynamicWorkerCoordinator::GetMetrics() {
   {
     absl::MutexLock lock(&mutex_);
     m.current_pool_size = static_cast<int>(workers_.size());
+    m.queued_requests = static_cast<int>(request_queue_.size());
     for (const auto& w : workers_) {
       switch (w->state()) {
         case WorkerState::kIdle: m.idle_workers++; break;
@@ -229,6 +285,13 @@ DynamicWorkerCoordinator::Metrics DynamicWorkerCoordinator::GetMetrics() {
       m.p99_latency_ms = sorted[static_cast<size_t>(static_cast<double>(sorted.size()) * 0.99)];
     }
   }
+
+  m.affinity_hits = affinity_hits_.load(std::memory_order_relaxed);
+  m.affinity_misses = affinity_misses_.load(std::memory_order_relaxed);
+  if (const int64_t leases = m.affinity_hits + m.affinity_misses; leases > 0) {
+    m.affinity_hit_rate =
+        static_cast<double>(m.affinity_hits) / static_cast<double>(leases);
+  }
   return m;
 }
 
@@ -284,6 +347,7 @@ void DynamicWorkerCoordinator::AdjustPoolSize() {
           // New workers are always idle, so this always succeeds.
           if (worker->TryAssignLocked(req->task)) {
             active_leases_[req->task.get()] = worker.get();
+            RecordAffinity(req->lang, *worker);
             to_assign.push_back(req);
           } else {
             request_queue_.push_front(req);
@@ -317,6 +381,9 @@ void DynamicWorkerCoordinator::AdjustPoolSize() {
 
   // Notify waiting callers outside the lock.
   for (auto& req : to_assign) {
+    if (req->detached_notification) {
+      RecordWait(req->request_time);
+    }
     req->done_notification->Notify();
   }
 
@@ -366,6 +433,13 @@ void DynamicWorkerCoordinator::Worker::Join() {
 }
 
 void DynamicWorkerCoordinator::Worker::Run() {
+  // Built here rather than in the constructor, which runs under the pool
+  // mutex; a task assigned meanwhile waits for it.
+  if (pool_->options_.warm_state_factory) {
+    warm_state_ = pool_->options_.warm_state_factory(lang_);
+    current_warm_state = warm_state_.get();
+  }
+
   while (true) {
     std::shared_ptr<WorkerTask> current_task;
     {
@@ -410,7 +484,9 @@ void DynamicWorkerCoordinator::Worker::Run() {
       // After recycling, scan the pool queue for a waiting request.
       // Lock order: pool->mutex_ is taken here, worker->mutex_ is taken
       // inside TryAssignLocked — consistent with LeaseWorker path.
-      absl::Notification* pending_notify = nullptr;
+      // Holds the request (and a Dispatch()ed request's notification) alive
+      // until it has been notified.
+      std::shared_ptr<PendingRequest> assigned;
       {
         absl::MutexLock pool_lock(&pool_->mutex_);
         if (!pool_->request_queue_.empty()) {
@@ -418,7 +494,8 @@ void DynamicWorkerCoordinator::Worker::Run() {
           pool_->request_queue_.pop_front();
           if (TryAssignLocked(req->task)) {
             pool_->active_leases_[req->task.get()] = this;
-            pending_notify = req->done_notification;
+            pool_->RecordAffinity(req->lang, *this);
+            assigned = std::move(req);
           } else {
             // Should not happen — worker just became idle.
             pool_->request_queue_.push_front(req);
@@ -426,8 +503,11 @@ void DynamicWorkerCoordinator::Worker::Run() {
         }
       }  // pool_lock released here.
 
-      if (pending_notify) {
-        pending_notify->Notify();
+      if (assigned) {
+        if (assigned->detached_notification) {
+          pool_->RecordWait(assigned->request_time);
+        }
+        assigned->done_notification->Notify();
         continue;  // Loop back to execute the newly assigned task.
       }
     }
@@ -435,8 +515,12 @@ void DynamicWorkerCoordinator::Worker::Run() {
 }
 
 void DynamicWorkerCoordinator::Worker::DoRecycle() {
-  // Production: wipe temp files, reset namespaces, purge memory arenas.
-  // Duration is configurable via Options::recycle_duration.
+  if (warm_state_ != nullptr) {
+    warm_state_->Reset();
+    return;
+  }
+  // Without warm state there is nothing to reset; the duration stands in for
+  // it and is configurable via Options::recycle_duration.
   absl::SleepFor(pool_->options_.recycle_duration);
 }
 
@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <string>
 #include <thread>
@@ -46,6 +47,26 @@ class WorkerTask {
   virtual ~WorkerTask() = default;
   virtual void StartExecution() = 0;
   virtual void PumpWrites() = 0;
+  // Called instead of StartExecution() when a Dispatch()ed task is dropped
+  // because the coordinator shut down before a worker picked it up.
+  virtual void Abandon(const absl::Status& status) { (void)status; }
+};
+
+// State a worker prepares for its language before the tasks it serves, so
+// that they skip that setup; see DynamicWorkerCoordinatorOptions::
+// warm_state_factory. Built and reset on the worker's own thread.
+class WorkerWarmState {
+ public:
+  virtual ~WorkerWarmState() = default;
+
+  // Restores the state after a task, while the worker is recycling. A task
+  // may still be using what it took from the state, e.g. a program the
+  // worker handed to a supervisor.
+  virtual void Reset() = 0;
+
+  // The warm state of the worker whose thread this is, or null on any other
+  // thread. Tasks consult it from StartExecution().
+  static WorkerWarmState* Current();
 };
 
 // Configuration options for the coordinator.
@@ -59,7 +80,13 @@ struct DynamicWorkerCoordinatorOptions {
   // Timeout for LeaseWorker. Zero means no timeout (block forever).
   absl::Duration lease_timeout = absl::ZeroDuration();
   // Duration of async worker recycling phase. Configurable for testing.
+  // Only used by workers without warm state, which have nothing to reset.
   absl::Duration recycle_duration = absl::Milliseconds(10);
+  // Builds each worker's warm state for the worker's language, on the
+  // worker's thread before its first task; recycling then calls Reset()
+  // instead of sleeping recycle_duration. Unset, workers keep no state.
+  std::function<std::unique_ptr<WorkerWarmState>(LanguageId)>
+      warm_state_factory;
 };
 
 // Evolution of the WarmWorkerPool. Supports dynamic resizing,
@@ -80,6 +107,9 @@ class DynamicWorkerCoordinator {
     absl::Notification* done_notification;
     absl::Status result;
     absl::Time request_time;
+    // Owns done_notification for Dispatch()ed requests, which have no
+    // caller blocked on it.
+    std::unique_ptr<absl::Notification> detached_notification;
   };
 
   explicit DynamicWorkerCoordinator(Options options = Options());
@@ -103,6 +133,13 @@ class DynamicWorkerCoordinator {
   absl::StatusOr<WorkerTask*> LeaseWorker(LanguageId lang,
                                            std::shared_ptr<WorkerTask> task);
 
+  // Non-blocking LeaseWorker: hands `task` to an idle worker or queues it,
+  // and returns immediately. Used to move a request between pipeline stages
+  // without the previous stage's worker waiting for a slot. Queued tasks
+  // dropped at shutdown receive WorkerTask::Abandon().
+  // Returns FailedPreconditionError if coordinator is shutting down.
+  absl::Status Dispatch(LanguageId lang, std::shared_ptr<WorkerTask> task);
+
   // Releases the worker associated with the given task back to the pool.
   void ReleaseWorker(WorkerTask* task);
   
@@ -112,9 +149,16 @@ class DynamicWorkerCoordinator {
     int idle_workers;
     int recycling_workers;
     int current_pool_size;
+    int queued_requests;
     int64_t total_requests_served;
     double p50_latency_ms;
     double p99_latency_ms;
+    // Tasks handed to a worker of their own language, whose warm state
+    // matches them, and to a worker of another language.
+    int64_t affinity_hits;
+    int64_t affinity_misses;
+    // affinity_hits over both; 0 before the first task.
+    double affinity_hit_rate;
   };
   Metrics GetMetrics();
 
@@ -148,6 +192,8 @@ class DynamicWorkerCoordinator {
 
     DynamicWorkerCoordinator* pool_;
     LanguageId lang_;
+    // Set by Run() before the first task; only touched by the worker thread.
+    std::unique_ptr<WorkerWarmState> warm_state_;
     std::shared_ptr<WorkerTask> task_ ABSL_GUARDED_BY(mutex_);
     std::atomic<WorkerState> state_{WorkerState::kIdle};
 
@@ -156,6 +202,12 @@ class DynamicWorkerCoordinator {
     std::thread thread_;
   };
 
+  // Feeds the balancer's latency signal and the wait-time percentiles.
+  void RecordWait(absl::Time request_time);
+
+  // Counts a task for `lang` handed to `worker` in the affinity metrics.
+  void RecordAffinity(LanguageId lang, const Worker& worker);
+
   void PoolBalancerLoop();
   void AdjustPoolSize() ABSL_LOCKS_EXCLUDED(mutex_);
 
@@ -168,6 +220,8 @@ class DynamicWorkerCoordinator {
 
   std::atomic<int64_t> total_wait_time_us_{0};
   std::atomic<int64_t> completed_requests_{0};
+  std::atomic<int64_t> affinity_hits_{0};
+  std::atomic<int64_t> affinity_misses_{0};
   
   mutable absl::Mutex stats_mutex_;
   std::vector<double> latency_history_ms_ ABSL_GUARDED_BY(stats_mutex_);
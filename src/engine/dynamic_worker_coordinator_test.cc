@@ -22,6 +22,7 @@
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
 #include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 
 namespace dcodex {
@@ -371,5 +372,177 @@ TEST(DynamicWorkerCoordinatorTest, ConcurrentLeasesAllComplete) {
   coordinator.Shutdown();
 }
 
+// ============================================================================
+// TC-11: Dispatch returns immediately and runs once a worker frees up
+// ============================================================================
+TEST(DynamicWorkerCoordinatorTest, DispatchDoesNotBlockCaller) {
+  DynamicWorkerCoordinator::Options opts;
+  opts.min_workers = 1;
+  opts.max_workers = 1;
+  opts.balance_period = absl::Seconds(60);
+  opts.recycle_duration = absl::ZeroDuration();
+  DynamicWorkerCoordinator coordinator(opts);
+  coordinator.Start();
+
+  std::atomic<int> counter{0};
+  absl::Notification gate, first_done, second_done;
+  auto blocker = std::make_shared<TestTask>(&counter, &gate, &first_done);
+  auto queued = std::make_shared<TestTask>(&counter, nullptr, &second_done);
+
+  ASSERT_TRUE(coordinator.Dispatch(LanguageId::kCpp, blocker).ok());
+  // The only worker is blocked, yet Dispatch still returns at once.
+  ASSERT_TRUE(coordinator.Dispatch(LanguageId::kCpp, queued).ok());
+  EXPECT_EQ(coordinator.GetMetrics().queued_requests, 1);
+
+  gate.Notify();
+  first_done.WaitForNotification();
+  second_done.WaitForNotification();
+  EXPECT_EQ(counter.load(), 2);
+  coordinator.Shutdown();
+}
+
+// ============================================================================
+// TC-12: Dispatched tasks still queued at shutdown are abandoned, not lost
+// ============================================================================
+class AbandonTrackingTask : public TestTask {
+ public:
+  using TestTask::TestTask;
+  void Abandon(const absl::Status& status) override {
+    abandoned_with = status.code();
+  }
+  absl::StatusCode abandoned_with = absl::StatusCode::kOk;
+};
+
+TEST(DynamicWorkerCoordinatorTest, ShutdownAbandonsDispatchedTasks) {
+  DynamicWorkerCoordinator::Options opts;
+  opts.min_workers = 1;
+  opts.max_workers = 1;
+  opts.balance_period = absl::Seconds(60);
+  opts.recycle_duration = absl::ZeroDuration();
+  DynamicWorkerCoordinator coordinator(opts);
+  coordinator.Start();
+
+  std::atomic<int> counter{0};
+  absl::Notification gate;
+  auto blocker = std::make_shared<TestTask>(&counter, &gate);
+  auto queued = std::make_shared<AbandonTrackingTask>(&counter);
+  ASSERT_TRUE(coordinator.Dispatch(LanguageId::kCpp, blocker).ok());
+  ASSERT_TRUE(coordinator.Dispatch(LanguageId::kCpp, queued).ok());
+
+  std::thread releaser([&gate] {
+    absl::SleepFor(absl::Milliseconds(50));
+    gate.Notify();
+  });
+  coordinator.Shutdown();
+  releaser.join();
+
+  EXPECT_EQ(queued->abandoned_with, absl::StatusCode::kCancelled);
+  EXPECT_EQ(counter.load(), 1);
+  EXPECT_FALSE(coordinator.Dispatch(LanguageId::kCpp, queued).ok());
+}
+
+// ============================================================================
+// TC-13: Warm state — built per worker, visible to its tasks, reset on recycle
+// ============================================================================
+class RecordingWarmState : public WorkerWarmState {
+ public:
+  RecordingWarmState(LanguageId language, std::atomic<int>* resets)
+      : lang(language), resets_(resets) {}
+  void Reset() override { resets_->fetch_add(1); }
+  const LanguageId lang;
+
+ private:
+  std::atomic<int>* resets_;
+};
+
+// Records the language of the warm state it runs with.
+class WarmStateProbeTask : public WorkerTask {
+ public:
+  void StartExecution() override {
+    auto* state = dynamic_cast<RecordingWarmState*>(WorkerWarmState::Current());
+    seen = state != nullptr ? state->lang : LanguageId::kUnknown;
+  }
+  void PumpWrites() override { done.Notify(); }
+
+  LanguageId seen = LanguageId::kUnknown;
+  absl::Notification done;
+};
+
+// Waits until every worker of `coordinator` is idle.
+void WaitForIdle(DynamicWorkerCoordinator& coordinator) {
+  const absl::Time deadline = absl::Now() + absl::Seconds(5);
+  while (absl::Now() < deadline) {
+    const auto m = coordinator.GetMetrics();
+    if (m.idle_workers == m.current_pool_size) return;
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+TEST(DynamicWorkerCoordinatorTest, WarmStateServesTasksAndResetsOnRecycle) {
+  auto opts = TestOptions();
+  opts.max_workers = 2;
+  // Would dominate the test if warm workers still slept it.
+  opts.recycle_duration = absl::Seconds(60);
+  std::atomic<int> built{0};
+  std::atomic<int> resets{0};
+  opts.warm_state_factory = [&](LanguageId lang) {
+    built.fetch_add(1);
+    return std::make_unique<RecordingWarmState>(lang, &resets);
+  };
+  DynamicWorkerCoordinator coordinator(opts);
+  coordinator.Start();
+
+  auto task = std::make_shared<WarmStateProbeTask>();
+  auto lease = coordinator.LeaseWorker(LanguageId::kPython, task);
+  ASSERT_TRUE(lease.ok());
+  task->done.WaitForNotification();
+  EXPECT_EQ(task->seen, LanguageId::kPython);
+  coordinator.ReleaseWorker(*lease);
+
+  WaitForIdle(coordinator);
+  EXPECT_EQ(resets.load(), 1);
+  // The idle C++ worker builds its state on its own thread, meanwhile.
+  const absl::Time deadline = absl::Now() + absl::Seconds(5);
+  while (built.load() < 2 && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_EQ(built.load(), 2);
+  // Only worker threads have a warm state.
+  EXPECT_EQ(WorkerWarmState::Current(), nullptr);
+  coordinator.Shutdown();
+}
+
+// ============================================================================
+// TC-14: Affinity hit rate — leases served by a worker of their language
+// ============================================================================
+TEST(DynamicWorkerCoordinatorTest, ReportsAffinityHitRate) {
+  auto opts = TestOptions();
+  opts.max_workers = 2;  // 1 C++, 1 Python, and no more.
+  opts.balance_period = absl::Seconds(60);
+  DynamicWorkerCoordinator coordinator(opts);
+  coordinator.Start();
+
+  EXPECT_EQ(coordinator.GetMetrics().affinity_hit_rate, 0.0);
+  // Both workers are idle for each lease: the first two find their own
+  // language, the third has none to find.
+  for (LanguageId lang :
+       {LanguageId::kCpp, LanguageId::kPython, LanguageId::kUnknown}) {
+    WaitForIdle(coordinator);
+    std::atomic<int> counter{0};
+    absl::Notification done;
+    auto task = std::make_shared<TestTask>(&counter, nullptr, &done);
+    auto lease = coordinator.LeaseWorker(lang, task);
+    ASSERT_TRUE(lease.ok());
+    done.WaitForNotification();
+    coordinator.ReleaseWorker(*lease);
+  }
+
+  const auto m = coordinator.GetMetrics();
+  EXPECT_EQ(m.affinity_hits, 2);
+  EXPECT_EQ(m.affinity_misses, 1);
+  EXPECT_DOUBLE_EQ(m.affinity_hit_rate, 2.0 / 3.0);
+  coordinator.Shutdown();
+}
+
 }  // namespace
 }  // namespace dcodex
@@ -43,10 +43,18 @@ class ExecutionPipeline {
   // Returns the final execution result or an error status.
   [[nodiscard]] absl::StatusOr<ExecutionResult> Run(ExecutionContext& context);
 
+  // Asynchronous form of Run(); see ExecutionStep::ExecuteAsync(). The
+  // pipeline and `context` must outlive the call to `done`.
+  void RunAsync(ExecutionContext& context, ResultCallback done);
+
   // Gets the cache interface (may be nullptr).
   [[nodiscard]] CacheInterface* GetCache() const;
 
  private:
+  // Turns the chain's final status into the pipeline result.
+  static absl::StatusOr<ExecutionResult> Finish(ExecutionContext& context,
+                                                const absl::Status& status);
+
   std::unique_ptr<ExecutionStep> head_;
   ExecutionStep* tail_ = nullptr;
   std::shared_ptr<CacheInterface> cache_;
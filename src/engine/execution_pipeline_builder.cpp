@@ -21,6 +21,7 @@
 
 #include "absl/strings/string_view.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/compilation_services.h"
 #include "src/engine/execution_pipeline.h"
 #include "src/engine/execution_step.h"
 
@@ -40,8 +41,19 @@ ExecutionPipelineBuilder& ExecutionPipelineBuilder::AddCreateSourceFileStep(
 
 ExecutionPipelineBuilder& ExecutionPipelineBuilder::AddCompileStep(
     absl::string_view compiler,
-    std::vector<std::string> compiler_flags) {
-  steps_.push_back(std::make_unique<CompileStep>(compiler, std::move(compiler_flags)));
+    std::vector<std::string> compiler_flags,
+    absl::string_view toolchain_id,
+    CompilationServices services) {
+  steps_.push_back(std::make_unique<CompileStep>(
+      compiler, std::move(compiler_flags), toolchain_id, std::move(services)));
+  return *this;
+}
+
+ExecutionPipelineBuilder& ExecutionPipelineBuilder::AddCompileBytecodeStep(
+    absl::string_view interpreter, absl::string_view toolchain_id,
+    CompilationServices services) {
+  steps_.push_back(std::make_unique<CompileBytecodeStep>(
+      interpreter, toolchain_id, std::move(services)));
   return *this;
 }
 
@@ -21,6 +21,7 @@
 
 #include "absl/strings/string_view.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/compilation_services.h"
 #include "src/engine/execution_pipeline.h"
 #include "src/engine/execution_step.h"
 
@@ -53,10 +54,19 @@ class ExecutionPipelineBuilder {
   ExecutionPipelineBuilder& AddCreateSourceFileStep(absl::string_view extension);
 
   // Adds a compilation step with the specified compiler and flags.
+  // `toolchain_id` and `services` enable compiled-artifact reuse.
   // Returns reference to this for method chaining.
   ExecutionPipelineBuilder& AddCompileStep(
       absl::string_view compiler,
-      std::vector<std::string> compiler_flags);
+      std::vector<std::string> compiler_flags,
+      absl::string_view toolchain_id = "",
+      CompilationServices services = {});
+
+  // Adds a step that swaps a Python source for cached bytecode; see
+  // CompileBytecodeStep. Returns reference to this for method chaining.
+  ExecutionPipelineBuilder& AddCompileBytecodeStep(
+      absl::string_view interpreter, absl::string_view toolchain_id,
+      CompilationServices services);
 
   // Adds a process execution step with optional sandboxing.
   // Returns reference to this for method chaining.
@@ -15,6 +15,7 @@
 #ifndef SRC_ENGINE_EXECUTION_STEP_H_
 #define SRC_ENGINE_EXECUTION_STEP_H_
 
+#include <cstdio>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -22,15 +23,21 @@
 
 #include <unistd.h>
 
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "src/engine/compilation_services.h"
 #include "src/engine/execution_types.h"
 
 namespace dcodex {
 
-// Forward declaration
+// Forward declarations
 class ExecutionContext;
+class ForkServer;
+class OutputVerifier;
+class RunCancellation;
+class SandboxSupervisor;
 
 // -----------------------------------------------------------------------------
 // Chain of Responsibility Pattern (GoF): ExecutionStep Interface
@@ -38,6 +45,9 @@ class ExecutionContext;
 // -----------------------------------------------------------------------------
 class ExecutionStep {
  public:
+  // Receives the status of the remaining chain in the asynchronous form.
+  using Continuation = absl::AnyInvocable<void(absl::Status)>;
+
   ExecutionStep() = default;
   virtual ~ExecutionStep() = default;
 
@@ -56,26 +66,25 @@ class ExecutionStep {
     return next_.get();
   }
 
-  // Executes this step and delegates to the next step if successful.
+  // Executes this step and delegates to the next step if successful and the
+  // step did not mark the context's result as final.
   // Returns OK on success, or an error status on failure.
-  absl::Status Execute(ExecutionContext& context) {
-    // Execute current step logic
-    absl::Status status = ExecuteStep(context);
-    if (!status.ok()) {
-      return status;
-    }
-
-    // Delegate to next step if exists
-    if (next_) {
-      return next_->Execute(context);
-    }
+  absl::Status Execute(ExecutionContext& context);
 
-    return absl::OkStatus();
-  }
+  // Continuation-passing form of Execute(): `done` runs exactly once, after
+  // the rest of the chain, possibly on another thread. `context` must outlive
+  // the call to `done`.
+  void ExecuteAsync(ExecutionContext& context, Continuation done);
 
   // Pure virtual method for the specific step logic.
   virtual absl::Status ExecuteStep(ExecutionContext& context) = 0;
 
+  // Asynchronous step logic. Steps that would block on a child process
+  // override this; the default runs ExecuteStep() inline.
+  virtual void ExecuteStepAsync(ExecutionContext& context, Continuation done) {
+    done(ExecuteStep(context));
+  }
+
   // Returns a descriptive name for this step (used in tracing/logging).
   [[nodiscard]] virtual absl::string_view Name() const = 0;
 
@@ -92,12 +101,21 @@ class ExecutionContext {
   // Input parameters
   std::string code;
   std::string stdin_data;
+  // When set, stdin is read from this file instead of stdin_data.
+  std::string stdin_path;
   OutputCallback callback;
 
   // Intermediate state (set by steps)
   std::string source_file_path;
   std::string binary_path;
   std::vector<std::string> cleanup_paths;
+  // Structured compiler output, copied into the result by the pipeline.
+  std::vector<CompilerDiagnostic> diagnostics;
+
+  // Set by a step whose outcome is final for the request (e.g. a compile
+  // error): the chain stops, but the pipeline reports an OK status so the
+  // result, including diagnostics, reaches the caller.
+  bool result_final = false;
 
   // Execution result (built up by steps)
   ExecutionResult result;
@@ -105,11 +123,28 @@ class ExecutionContext {
 
   // Configuration
   bool sandboxed = true;
-
-  ExecutionContext(absl::string_view code, absl::string_view stdin_data,
+  // Compile-ahead run (ExecutionStrategy::Precompile); per-use accounting
+  // such as tier promotion is left to the Execute() that follows.
+  bool compile_only = false;
+  // When set, ExecuteAsync() hands running programs to this supervisor
+  // instead of blocking the calling thread on their output.
+  SandboxSupervisor* supervisor = nullptr;
+  // When set, RunProcessStep checks the program's stdout against this
+  // instead of passing it to `callback`, and stops the program once it
+  // diverges.
+  OutputVerifier* output_verifier = nullptr;
+  // When set, RunProcessStep attaches the sandboxed program to this while it
+  // runs, so that cancelling the request kills it.
+  RunCancellation* cancellation = nullptr;
+  // When set, RunProcessStep starts the program through this fork server
+  // rather than exec'ing it, falling back to exec if the fork server fails.
+  ForkServer* fork_server = nullptr;
+
+  ExecutionContext(absl::string_view code, const StdinSource& stdin_source,
                    OutputCallback callback)
       : code(code),
-        stdin_data(stdin_data),
+        stdin_data(stdin_source.data),
+        stdin_path(stdin_source.file_path),
         callback(std::move(callback)) {
     trace << "--- Backend Execution Trace ---\n";
   }
@@ -117,14 +152,25 @@ class ExecutionContext {
   ~ExecutionContext() {
     for (const auto& path : cleanup_paths) {
       if (!path.empty()) {
-        unlink(path.c_str());
+        // remove() also takes directories, emptied by the paths before them.
+        remove(path.c_str());
       }
     }
   }
 
-  // Adds a path to be cleaned up when context is destroyed
+  // The program's stdin, as given to the context.
+  [[nodiscard]] StdinSource Stdin() const {
+    return stdin_path.empty() ? StdinSource(stdin_data)
+                              : StdinSource::File(stdin_path, "");
+  }
+
+  // Adds a path to be cleaned up when context is destroyed. A directory must
+  // be added after the files in it.
   void AddCleanupPath(const std::string& path) { cleanup_paths.push_back(path); }
 
+  // Takes `path` off the cleanup list, for a file that outlives the context.
+  void KeepPath(const std::string& path) { std::erase(cleanup_paths, path); }
+
   // Marks the execution as failed with an error message and returns an error status.
   absl::Status Fail(absl::string_view error) {
     result.success = false;
@@ -139,6 +185,33 @@ class ExecutionContext {
   }
 };
 
+inline absl::Status ExecutionStep::Execute(ExecutionContext& context) {
+  // Execute current step logic
+  absl::Status status = ExecuteStep(context);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Delegate to next step if exists
+  if (next_ && !context.result_final) {
+    return next_->Execute(context);
+  }
+
+  return absl::OkStatus();
+}
+
+inline void ExecutionStep::ExecuteAsync(ExecutionContext& context,
+                                        Continuation done) {
+  ExecuteStepAsync(context, [this, &context, done = std::move(done)](
+                                absl::Status status) mutable {
+    if (!status.ok() || !next_ || context.result_final) {
+      done(std::move(status));
+      return;
+    }
+    next_->ExecuteAsync(context, std::move(done));
+  });
+}
+
 // -----------------------------------------------------------------------------
 // Concrete Execution Steps (Command Pattern)
 // Each step handles a single responsibility in the execution pipeline.
@@ -160,19 +233,68 @@ class CreateSourceFileStep : public ExecutionStep {
 
 // Step 2: Compiles source code to a binary (supports C and C++).
 // SRP: Compilation process management.
+// When `services.artifact_cache` is set, a binary previously built from the
+// same toolchain, compiler version, flags and source is reused instead of
+// invoking the compiler, and fresh builds are stored for later requests.
+// When `services.tiering` is set, builds use the fast profile and hot sources
+// are promoted to an optimized build in the background.
 class CompileStep : public ExecutionStep {
  public:
   CompileStep(absl::string_view compiler,
-              std::vector<std::string> compiler_flags)
+              std::vector<std::string> compiler_flags,
+              absl::string_view toolchain_id = "",
+              CompilationServices services = {})
       : compiler_(compiler),
-        compiler_flags_(std::move(compiler_flags)) {}
+        compiler_flags_(std::move(compiler_flags)),
+        toolchain_id_(toolchain_id),
+        services_(std::move(services)) {}
 
   absl::Status ExecuteStep(ExecutionContext& context) override;
   [[nodiscard]] absl::string_view Name() const override { return "Compile"; }
 
  private:
+  // Standard flags plus the tiering manager's optimized profile.
+  [[nodiscard]] std::vector<std::string> OptimizedFlags() const;
+
+  // Counts a use of the fast build and, once the source is hot, queues a
+  // background optimized rebuild.
+  void MaybeSchedulePromotion(ExecutionContext& context,
+                              const std::string& fast_key,
+                              const std::string& optimized_key);
+
   std::string compiler_;
   std::vector<std::string> compiler_flags_;
+  std::string toolchain_id_;
+  CompilationServices services_;
+};
+
+// Step 2 (Python): Compiles the source to bytecode, or reuses the bytecode
+// a previous request compiled from the same source.
+// Requires `services.artifact_cache`, where the .pyc is stored under the
+// interpreter version and the source text. Sources smaller than
+// --python_bytecode_min_bytes compile faster than the extra interpreter
+// start a miss costs, and are run as they are. The run then executes
+// main.pyc from a private directory that also holds the source as main.py,
+// for tracebacks to quote. A source that does not compile is run as it is,
+// so that the interpreter reports the error.
+class CompileBytecodeStep : public ExecutionStep {
+ public:
+  CompileBytecodeStep(absl::string_view interpreter,
+                      absl::string_view toolchain_id,
+                      CompilationServices services)
+      : interpreter_(interpreter),
+        toolchain_id_(toolchain_id),
+        services_(std::move(services)) {}
+
+  absl::Status ExecuteStep(ExecutionContext& context) override;
+  [[nodiscard]] absl::string_view Name() const override {
+    return "CompileBytecode";
+  }
+
+ private:
+  std::string interpreter_;
+  std::string toolchain_id_;
+  CompilationServices services_;
 };
 
 // Step 3: Executes a binary or script with sandboxing.
@@ -182,6 +304,8 @@ class RunProcessStep : public ExecutionStep {
   explicit RunProcessStep(bool sandboxed) : sandboxed_(sandboxed) {}
 
   absl::Status ExecuteStep(ExecutionContext& context) override;
+  // Watches the program on context.supervisor when one is set.
+  void ExecuteStepAsync(ExecutionContext& context, Continuation done) override;
   [[nodiscard]] absl::string_view Name() const override { return "RunProcess"; }
 
  private:
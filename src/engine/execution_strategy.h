@@ -22,12 +22,19 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/compilation_services.h"
 #include "src/engine/execution_pipeline.h"
 #include "src/engine/execution_types.h"
 #include "src/engine/language_toolchain.h"
+#include "src/engine/prepared_program.h"
 
 namespace dcodex {
 
+class ForkServer;
+class OutputVerifier;
+class RunCancellation;
+class SandboxSupervisor;
+
 // -----------------------------------------------------------------------------
 // Strategy Pattern: Interface for different execution strategies (e.g., C, C++, Python).
 // Now accepts CacheInterface via constructor for dependency injection.
@@ -38,20 +45,84 @@ class ExecutionStrategy {
   virtual ~ExecutionStrategy() = default;
 
   // Executes the given code and returns the result or an error status.
+  // When `verifier` is non-null the program's stdout is checked against it
+  // instead of reaching `callback`; the verdict is on the result. When
+  // `cancellation` is non-null the program is attached to it while it runs.
   [[nodiscard]] virtual absl::StatusOr<ExecutionResult> Execute(
-      absl::string_view code, absl::string_view stdin_data,
+      absl::string_view code, const StdinSource& stdin_source,
+      OutputVerifier* verifier, RunCancellation* cancellation,
       OutputCallback callback) = 0;
 
+  // Asynchronous form of Execute(): `done` receives the result, possibly on a
+  // supervisor thread. Strategies that run a program override this to watch
+  // it on `supervisor` (if non-null) instead of blocking on it; the default
+  // runs Execute() inline. `verifier` and `cancellation` must outlive the
+  // call to `done`.
+  virtual void ExecuteAsync(absl::string_view code, const StdinSource& stdin_source,
+                            OutputVerifier* verifier,
+                            RunCancellation* cancellation,
+                            OutputCallback callback,
+                            SandboxSupervisor* supervisor, ResultCallback done) {
+    (void)supervisor;
+    done(Execute(code, stdin_source, verifier, cancellation,
+                 std::move(callback)));
+  }
+
+  // Builds `code` into a program that RunPrepared() can start any number of
+  // times without compiling again: the binary for a compiled language, the
+  // source file for an interpreted one. A compile error is reported as by
+  // Precompile(), with no program.
+  [[nodiscard]] virtual absl::StatusOr<PreparedBuild> Prepare(
+      absl::string_view code, OutputCallback callback) = 0;
+
+  // Runs a program that Prepare() built, with only the run and finalize
+  // steps; otherwise as ExecuteAsync(). `program` must outlive `done`.
+  void RunPrepared(const PreparedProgram& program,
+                   const StdinSource& stdin_source, OutputVerifier* verifier,
+                   RunCancellation* cancellation, OutputCallback callback,
+                   SandboxSupervisor* supervisor, ResultCallback done);
+
   // Returns a unique identifier for this strategy (used for caching).
   [[nodiscard]] virtual absl::string_view GetStrategyId() const = 0;
 
+  // Compiles `code` into the artifact cache without running it, so a later
+  // Execute() of the same code skips the compiler. A compile error is an OK
+  // status with success=false, diagnostics, and the compiler output replayed
+  // through `callback`. Interpreted languages trivially succeed, Python
+  // after storing its bytecode.
+  [[nodiscard]] virtual absl::StatusOr<ExecutionResult> Precompile(
+      absl::string_view code, OutputCallback callback) {
+    (void)code;
+    (void)callback;
+    ExecutionResult result;
+    result.success = true;
+    return result;
+  }
+
   // Factory method to create an execution strategy based on file extension or language.
-  // Accepts optional cache for dependency injection.
+  // Accepts optional cache and compilation services for dependency injection.
   [[nodiscard]] static absl::StatusOr<std::unique_ptr<ExecutionStrategy>> Create(
       absl::string_view filename_or_extension,
-      std::shared_ptr<CacheInterface> cache = nullptr);
+      std::shared_ptr<CacheInterface> cache = nullptr,
+      CompilationServices services = {});
 
  protected:
+  // Runs `pipeline` with ExecutionPipeline::RunAsync() on a context it
+  // allocates, keeping both alive until `done` has run.
+  static void RunPipelineAsync(std::unique_ptr<ExecutionPipeline> pipeline,
+                               absl::string_view code,
+                               const StdinSource& stdin_source,
+                               OutputVerifier* verifier,
+                               RunCancellation* cancellation,
+                               OutputCallback callback,
+                               SandboxSupervisor* supervisor,
+                               ResultCallback done);
+
+  // As above, for a context the caller has already set up.
+  static void RunPipelineAsync(std::unique_ptr<ExecutionPipeline> pipeline,
+                               std::unique_ptr<ExecutionContext> context,
+                               ResultCallback done);
+
   // Helper to create the standard pipeline for a strategy.
   // Accepts optional cache for dependency injection.
   [[nodiscard]] virtual std::unique_ptr<ExecutionPipeline> CreatePipeline(
@@ -67,7 +138,8 @@ class CompiledLanguageStrategy : public ExecutionStrategy {
   // Constructs with a toolchain factory for dependency injection.
   explicit CompiledLanguageStrategy(
       std::unique_ptr<LanguageToolchainFactory> toolchain,
-      std::shared_ptr<CacheInterface> cache = nullptr);
+      std::shared_ptr<CacheInterface> cache = nullptr,
+      CompilationServices services = {});
   ~CompiledLanguageStrategy() override = default;
 
   // Disallow copy and move operations.
@@ -77,11 +149,23 @@ class CompiledLanguageStrategy : public ExecutionStrategy {
   CompiledLanguageStrategy& operator=(CompiledLanguageStrategy&&) = delete;
 
   [[nodiscard]] absl::StatusOr<ExecutionResult> Execute(
-      absl::string_view code, absl::string_view stdin_data,
+      absl::string_view code, const StdinSource& stdin_source,
+      OutputVerifier* verifier, RunCancellation* cancellation,
       OutputCallback callback) override;
 
+  void ExecuteAsync(absl::string_view code, const StdinSource& stdin_source,
+                    OutputVerifier* verifier, RunCancellation* cancellation,
+                    OutputCallback callback, SandboxSupervisor* supervisor,
+                    ResultCallback done) override;
+
   [[nodiscard]] absl::string_view GetStrategyId() const override;
 
+  [[nodiscard]] absl::StatusOr<ExecutionResult> Precompile(
+      absl::string_view code, OutputCallback callback) override;
+
+  [[nodiscard]] absl::StatusOr<PreparedBuild> Prepare(
+      absl::string_view code, OutputCallback callback) override;
+
  protected:
   [[nodiscard]] std::unique_ptr<ExecutionPipeline> CreatePipeline(
       std::shared_ptr<CacheInterface> cache = nullptr) override;
@@ -89,27 +173,31 @@ class CompiledLanguageStrategy : public ExecutionStrategy {
  private:
   std::unique_ptr<LanguageToolchainFactory> toolchain_;
   std::shared_ptr<CacheInterface> cache_;
+  CompilationServices services_;
 };
 
 // C implementation of the ExecutionStrategy.
 // Uses CToolchain for configuration.
 class CExecutionStrategy final : public CompiledLanguageStrategy {
  public:
-  explicit CExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr);
+  explicit CExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr,
+                              CompilationServices services = {});
 };
 
 // C++ implementation of the ExecutionStrategy.
 // Uses CppToolchain for configuration.
 class CppExecutionStrategy final : public CompiledLanguageStrategy {
  public:
-  explicit CppExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr);
+  explicit CppExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr,
+                                CompilationServices services = {});
 };
 
 // Python implementation of the ExecutionStrategy.
 // Uses PythonToolchain for configuration.
 class PythonExecutionStrategy final : public ExecutionStrategy {
  public:
-  explicit PythonExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr);
+  explicit PythonExecutionStrategy(std::shared_ptr<CacheInterface> cache = nullptr,
+                                   CompilationServices services = {});
   ~PythonExecutionStrategy() override = default;
 
   // Disallow copy and move operations.
@@ -119,9 +207,22 @@ class PythonExecutionStrategy final : public ExecutionStrategy {
   PythonExecutionStrategy& operator=(PythonExecutionStrategy&&) = delete;
 
   [[nodiscard]] absl::StatusOr<ExecutionResult> Execute(
-      absl::string_view code, absl::string_view stdin_data,
+      absl::string_view code, const StdinSource& stdin_source,
+      OutputVerifier* verifier, RunCancellation* cancellation,
       OutputCallback callback) override;
 
+  void ExecuteAsync(absl::string_view code, const StdinSource& stdin_source,
+                    OutputVerifier* verifier, RunCancellation* cancellation,
+                    OutputCallback callback, SandboxSupervisor* supervisor,
+                    ResultCallback done) override;
+
+  [[nodiscard]] absl::StatusOr<PreparedBuild> Prepare(
+      absl::string_view code, OutputCallback callback) override;
+
+  // Compiles the bytecode a later Execute() runs; see CompileBytecodeStep.
+  [[nodiscard]] absl::StatusOr<ExecutionResult> Precompile(
+      absl::string_view code, OutputCallback callback) override;
+
   [[nodiscard]] absl::string_view GetStrategyId() const override;
 
  protected:
@@ -129,8 +230,12 @@ class PythonExecutionStrategy final : public ExecutionStrategy {
       std::shared_ptr<CacheInterface> cache) override;
 
  private:
+  // The zygote to fork the next run from, or null to run `python3` cold.
+  [[nodiscard]] std::shared_ptr<ForkServer> PickZygote() const;
+
   std::unique_ptr<LanguageToolchainFactory> toolchain_;
   std::shared_ptr<CacheInterface> cache_;
+  CompilationServices services_;
 };
 
 }  // namespace dcodex
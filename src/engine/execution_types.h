@@ -15,9 +15,14 @@
 #ifndef SRC_ENGINE_EXECUTION_TYPES_H_
 #define SRC_ENGINE_EXECUTION_TYPES_H_
 
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
 
+#include "absl/functional/any_invocable.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 
 namespace dcodex {
@@ -34,6 +39,54 @@ struct ResourceStats {
   long elapsed_time_ms = 0;
 };
 
+// A single structured compiler message (error, warning or note).
+struct CompilerDiagnostic {
+  enum class Severity { kError, kWarning, kNote };
+
+  // Source file as the client knows it (e.g. "main.cpp"), not the server's
+  // temporary path. Empty for driver/linker messages with no location.
+  std::string file;
+  // 1-based; 0 when the compiler did not report a position.
+  int line = 0;
+  int column = 0;
+  Severity severity = Severity::kError;
+  std::string message;
+};
+
+// Expected standard output of a run, checked while the program writes it.
+struct OutputExpectation {
+  enum class Mode {
+    // Byte-for-byte equality.
+    kExact,
+    // Equal sequences of whitespace-separated tokens; how much whitespace
+    // separates them, including any trailing newline, does not matter.
+    kTokens,
+    // Like kTokens, but tokens that both parse as finite numbers match when
+    // within `tolerance` of each other, absolutely or relative to expected.
+    kFloatTolerance,
+  };
+
+  // Must outlive the run.
+  absl::string_view expected;
+  Mode mode = Mode::kExact;
+  double tolerance = 1e-6;
+};
+
+// Outcome of comparing a run's stdout with its OutputExpectation.
+struct OutputVerdict {
+  enum class Kind { kNotChecked, kAccepted, kWrongAnswer };
+
+  Kind kind = Kind::kNotChecked;
+  // For kWrongAnswer: byte offsets of the first difference (the start of the
+  // differing token in the token modes) and its 1-based line in expected.
+  uint64_t expected_offset = 0;
+  uint64_t actual_offset = 0;
+  int line = 0;
+  // A few dozen bytes of each output around the difference.
+  std::string expected_excerpt;
+  std::string actual_excerpt;
+};
+
 // Result of a sandboxed execution.
 struct ExecutionResult {
   bool success = false;
@@ -50,6 +103,34 @@ struct ExecutionResult {
   // Indicates if the process was killed because its combined stdout+stderr
   // output exceeded kMaxOutputBytes.
   bool output_truncated = false;
+  // Compiler errors/warnings for compiled languages, in emission order.
+  std::vector<CompilerDiagnostic> diagnostics;
+  // Set when the run was given an OutputExpectation.
+  OutputVerdict verdict;
+};
+
+// A program's standard input: bytes in memory, or a file on disk (such as a
+// streamed upload) that the sandbox gives to the program without reading it.
+// Converts implicitly from the bytes, which must outlive the StdinSource.
+struct StdinSource {
+  StdinSource() = default;
+  StdinSource(const std::convertible_to<absl::string_view> auto& bytes)
+      : data(bytes) {}
+
+  // Input read from the file at `path`, whose contents hash to `sha256`.
+  static StdinSource File(std::string path, std::string sha256) {
+    StdinSource source;
+    source.file_path = std::move(path);
+    source.file_sha256 = std::move(sha256);
+    return source;
+  }
+
+  [[nodiscard]] bool IsFile() const { return !file_path.empty(); }
+
+  absl::string_view data;
+  std::string file_path;
+  // Stands in for the file's contents in result-cache keys.
+  std::string file_sha256;
 };
 
 // Callback for streaming output.
@@ -57,6 +138,10 @@ using OutputCallback =
     std::function<void(absl::string_view stdout_chunk,
                        absl::string_view stderr_chunk)>;
 
+// Completion of an asynchronous execution.
+using ResultCallback =
+    absl::AnyInvocable<void(absl::StatusOr<ExecutionResult>)>;
+
 }  // namespace dcodex
 
 #endif  // SRC_ENGINE_EXECUTION_TYPES_H_
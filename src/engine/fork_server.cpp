@@ -0,0 +1,286 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/fork_server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "src/common/status_macros.h"
+#include "src/engine/fork_server_stub.h"
+
+extern char** environ;
+
+namespace dcodex {
+
+namespace {
+
+using internal::FileDescriptor;
+using internal::ResourceLimits;
+
+// Waits up to `timeout` for `fd` to become readable.
+bool WaitReadable(int fd, absl::Duration timeout) {
+  struct pollfd pfd = {fd, POLLIN, 0};
+  int ready = 0;
+  do {
+    ready = poll(&pfd, 1, static_cast<int>(absl::ToInt64Milliseconds(timeout)));
+  } while (ready < 0 && errno == EINTR);
+  return ready == 1;
+}
+
+}  // namespace
+
+ForkServer::ForkServer(std::vector<std::string> argv,
+                       absl::Duration handshake_timeout)
+    : argv_(std::move(argv)), handshake_timeout_(handshake_timeout) {}
+
+ForkServer::~ForkServer() {
+  absl::MutexLock lock(&mu_);
+  StopLocked();
+}
+
+absl::Status ForkServer::Start(const ResourceLimits& limits) {
+  absl::MutexLock lock(&mu_);
+  return EnsureStartedLocked(limits);
+}
+
+absl::StatusOr<pid_t> ForkServer::Spawn(int stdin_fd, int stdout_fd,
+                                        int stderr_fd,
+                                        const ResourceLimits& limits,
+                                        absl::string_view target) {
+  absl::MutexLock lock(&mu_);
+  // A fork server that died since the last request (e.g. it was killed) is
+  // restarted once.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    ABSL_RETURN_IF_ERROR(EnsureStartedLocked(limits));
+    absl::StatusOr<pid_t> pid =
+        RequestLocked(stdin_fd, stdout_fd, stderr_fd, limits, target);
+    if (pid.ok() || !absl::IsUnavailable(pid.status())) {
+      return pid;
+    }
+    LOG(WARNING) << "Fork server " << argv_[0] << " exited: " << pid.status();
+    StopLocked();
+  }
+  return absl::UnavailableError(
+      absl::StrCat("Fork server ", argv_[0], " keeps exiting"));
+}
+
+absl::Status ForkServer::EnsureStartedLocked(const ResourceLimits& limits) {
+  if (control_.IsValid()) {
+    return absl::OkStatus();
+  }
+  if (unavailable_) {
+    return absl::FailedPreconditionError(
+        absl::StrCat(argv_[0], " cannot run as a fork server"));
+  }
+  absl::Status started = StartLocked(limits);
+  if (!started.ok()) {
+    unavailable_ = true;
+  }
+  return started;
+}
+
+absl::Status ForkServer::StartLocked(const ResourceLimits& limits) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+    return absl::ErrnoToStatus(errno, "socketpair failed");
+  }
+  FileDescriptor local(sockets[0]);
+  FileDescriptor remote(sockets[1]);
+  // Every message the command sends is then stamped by the kernel with the
+  // sender's pid; see RequestLocked().
+  const int on = 1;
+  if (setsockopt(local.Get(), SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) != 0) {
+    return absl::ErrnoToStatus(errno, "setsockopt(SO_PASSCRED) failed");
+  }
+  // The control socket is the program's stdin; its output goes nowhere, as
+  // nothing the fork server itself prints belongs to any run.
+  FileDescriptor dev_null(open("/dev/null", O_WRONLY | O_CLOEXEC));
+  if (!dev_null.IsValid()) {
+    return absl::ErrnoToStatus(errno, "open /dev/null failed");
+  }
+
+  const std::string prefix = absl::StrCat(kForkServerEnv, "=");
+  const std::string marker = absl::StrCat(prefix, "1");
+  std::vector<char*> envp;
+  for (char** var = environ; *var != nullptr; ++var) {
+    if (!absl::StartsWith(*var, prefix)) {
+      envp.push_back(*var);
+    }
+  }
+  envp.push_back(const_cast<char*>(marker.c_str()));
+  envp.push_back(nullptr);
+
+  // The command's initializers run before the stub's handshake, so the fork
+  // server starts like any run: under its rlimits, leading its own process
+  // group, with default signal state (which its children inherit). Its CPU
+  // time accrues across runs; once over the limit it is killed and the next
+  // Spawn() restarts it.
+  ResourceLimits server_limits = limits;
+  server_limits.namespaces = nullptr;
+  server_limits.environment = envp.data();
+  ABSL_ASSIGN_OR_RETURN(
+      const pid_t pid,
+      internal::ProcessRunner::SpawnProcess(argv_, remote.Get(),
+                                            dev_null.Get(), dev_null.Get(),
+                                            server_limits));
+  remote.Reset();
+  server_pid_ = pid;
+
+  uint32_t magic = 0;
+  if (!WaitReadable(local.Get(), handshake_timeout_) ||
+      recv(local.Get(), &magic, sizeof(magic), 0) != sizeof(magic) ||
+      magic != kForkServerReady) {
+    StopLocked();
+    return absl::FailedPreconditionError(absl::StrCat(
+        argv_[0], " did not start as a fork server (built without the "
+                  "fork server stub?)"));
+  }
+  control_ = std::move(local);
+  return absl::OkStatus();
+}
+
+void ForkServer::StopLocked() {
+  control_.Reset();
+  if (server_pid_ > 0) {
+    // Anything the command started itself outside the protocol shares its
+    // process group; runs lead their own.
+    internal::ProcessRunner::KillProcessGroup(server_pid_);
+    while (waitpid(server_pid_, nullptr, 0) < 0 && errno == EINTR) {
+    }
+    server_pid_ = -1;
+  }
+}
+
+absl::StatusOr<pid_t> ForkServer::RequestLocked(int stdin_fd, int stdout_fd,
+                                                int stderr_fd,
+                                                const ResourceLimits& limits,
+                                                absl::string_view target) {
+  ForkServerRequest request;
+  request.cpu_time_seconds =
+      static_cast<uint64_t>(std::max(limits.cpu_time_seconds, 0));
+  request.address_space_bytes = limits.address_space_bytes;
+  if (target.size() > kForkServerMaxTarget) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Fork server target too long: ", target));
+  }
+
+  const int fds[3] = {stdin_fd, stdout_fd, stderr_fd};
+  union {
+    char buf[CMSG_SPACE(sizeof(fds))];
+    struct cmsghdr align;
+  } control;
+  std::memset(&control, 0, sizeof(control));
+  struct iovec iov[2] = {
+      {&request, sizeof(request)},
+      {const_cast<char*>(target.data()), target.size()}};
+  struct msghdr msg {};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  ssize_t n = 0;
+  do {
+    n = sendmsg(control_.Get(), &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n != static_cast<ssize_t>(sizeof(request) + target.size())) {
+    return absl::UnavailableError(
+        absl::StrCat("Sending to fork server failed: ", strerror(errno)));
+  }
+
+  // The child sends the reply itself, right after the fork, so a child that
+  // dies first or a fork server that never answers ends the wait here.
+  if (!WaitReadable(control_.Get(), handshake_timeout_)) {
+    return absl::UnavailableError("Fork server did not reply");
+  }
+  int32_t reply = 0;
+  union {
+    char buf[CMSG_SPACE(sizeof(struct ucred))];
+    struct cmsghdr align;
+  } reply_control;
+  std::memset(&reply_control, 0, sizeof(reply_control));
+  struct iovec reply_iov = {&reply, sizeof(reply)};
+  struct msghdr reply_msg {};
+  reply_msg.msg_iov = &reply_iov;
+  reply_msg.msg_iovlen = 1;
+  reply_msg.msg_control = reply_control.buf;
+  reply_msg.msg_controllen = sizeof(reply_control.buf);
+  do {
+    n = recvmsg(control_.Get(), &reply_msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n != static_cast<ssize_t>(sizeof(reply))) {
+    return absl::UnavailableError("Fork server closed its control socket");
+  }
+  if (reply <= 0) {
+    return absl::ErrnoToStatus(reply < 0 ? -reply : EPROTO,
+                               "Fork server could not fork");
+  }
+  pid_t sender = -1;
+  for (struct cmsghdr* received = CMSG_FIRSTHDR(&reply_msg);
+       received != nullptr; received = CMSG_NXTHDR(&reply_msg, received)) {
+    if (received->cmsg_level == SOL_SOCKET &&
+        received->cmsg_type == SCM_CREDENTIALS &&
+        received->cmsg_len == CMSG_LEN(sizeof(struct ucred))) {
+      struct ucred credentials;
+      std::memcpy(&credentials, CMSG_DATA(received), sizeof(credentials));
+      sender = credentials.pid;
+    }
+  }
+
+  const pid_t pid = reply;
+  // Only a child of ours can be waited for and killed as a run. The command
+  // is untrusted code, so the reply must come from the child it names: the
+  // kernel vouches for the sender's pid, which only CAP_SYS_ADMIN can forge.
+  // A reply naming any other process (another run, a compiler, the fork
+  // server itself) is rejected, and so is the fork server that sent it.
+  siginfo_t info{};
+  if (sender != pid || pid == server_pid_ ||
+      (waitid(P_PID, static_cast<id_t>(pid), &info,
+              WEXITED | WNOHANG | WNOWAIT) != 0 &&
+       errno == ECHILD)) {
+    StopLocked();
+    unavailable_ = true;
+    return absl::InternalError(absl::StrCat(
+        "Fork server ", argv_[0], " replied with pid ", pid,
+        ", which is not its child"));
+  }
+  // As in ProcessRunner: close the race with a kill issued before the child
+  // ran setpgid() itself.
+  setpgid(pid, pid);
+  return pid;
+}
+
+}  // namespace dcodex
@@ -0,0 +1,105 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_FORK_SERVER_H_
+#define SRC_ENGINE_FORK_SERVER_H_
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// ForkServer: starts runs by forking an already loaded process instead of
+// exec'ing a program.
+//
+// The command is either a compiled binary linked with the ForkServerStub,
+// or the PythonZygote interpreter; both speak the protocol in
+// fork_server_stub.h. On Start() or the first Spawn() the command is started
+// once in fork-server mode; from then on each Spawn() costs a fork of that
+// fully loaded process instead of exec, the dynamic loader and runtime
+// initialization. Children are our own children, each leading its own process
+// group with the requested rlimits and the given stdio, so callers wait for
+// and kill them exactly as they would a child from
+// ProcessRunner::SpawnProcess().
+//
+// Spawn() fails, and callers fall back to SpawnProcess(), when the command
+// does not complete the handshake within `handshake_timeout` (e.g. a binary
+// built without the stub) or the fork server cannot be (re)started.
+// Thread-safe: requests to one fork server are serialized.
+// -----------------------------------------------------------------------------
+class ForkServer {
+ public:
+  explicit ForkServer(std::vector<std::string> argv,
+                      absl::Duration handshake_timeout = absl::Seconds(2));
+  // Kills the fork server process. Children already spawned are unaffected.
+  ~ForkServer();
+
+  ForkServer(const ForkServer&) = delete;
+  ForkServer& operator=(const ForkServer&) = delete;
+
+  // Starts the fork server process now rather than on the first Spawn(),
+  // under `limits`; Spawn() starts it under the run's. OK if it is already
+  // running.
+  absl::Status Start(const internal::ResourceLimits& limits = {});
+
+  // Starts a run with the given stdio and limits, starting the fork server
+  // first if needed. Fails, and stops trusting the fork server, if its reply
+  // names a process that is not our child or was not sent by that child.
+  // `target` is the file the run executes: the C stub ignores it, as its
+  // process is the program, and the Python zygote runs it as the script.
+  // Returns the child's pid.
+  [[nodiscard]] absl::StatusOr<pid_t> Spawn(
+      int stdin_fd, int stdout_fd, int stderr_fd,
+      const internal::ResourceLimits& limits, absl::string_view target = "");
+
+ private:
+  // Start() with mu_ held; a failure marks the fork server unavailable.
+  absl::Status EnsureStartedLocked(const internal::ResourceLimits& limits)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Starts the command in fork-server mode under `limits` and waits for its
+  // handshake.
+  absl::Status StartLocked(const internal::ResourceLimits& limits)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Kills the fork server's process group and reaps it, if running.
+  void StopLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // One request/reply exchange. UNAVAILABLE means the fork server is gone.
+  absl::StatusOr<pid_t> RequestLocked(int stdin_fd, int stdout_fd,
+                                      int stderr_fd,
+                                      const internal::ResourceLimits& limits,
+                                      absl::string_view target)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::vector<std::string> argv_;
+  const absl::Duration handshake_timeout_;
+
+  absl::Mutex mu_;
+  pid_t server_pid_ ABSL_GUARDED_BY(mu_) = -1;
+  internal::FileDescriptor control_ ABSL_GUARDED_BY(mu_);
+  // Set once the command failed to start as a fork server; no more attempts.
+  bool unavailable_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_FORK_SERVER_H_
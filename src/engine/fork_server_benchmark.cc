@@ -0,0 +1,178 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// fork_server_benchmark: measures the per-run cost of starting a compiled
+// C++ program by exec (fork()+exec and clone(CLONE_VM|CLONE_VFORK)+exec)
+// versus forking it from a ForkServer.
+//
+//   bazel run -c opt //src/engine:fork_server_benchmark -- --runs=500
+//
+// The program is built once with the fork server stub. Unlike
+// spawn_benchmark, each sample runs until the child exits, because what the
+// fork server saves (exec, the dynamic loader, libstdc++ initialization)
+// happens in the child after spawn returns.
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/engine/fork_server.h"
+#include "src/engine/fork_server_stub.h"
+#include "src/engine/process_runner.h"
+
+ABSL_FLAG(int, runs, 200, "Runs per start method");
+ABSL_FLAG(std::string, c_compiler, "clang", "Compiler for the stub");
+ABSL_FLAG(std::string, cxx_compiler, "clang++",
+          "Compiler for the benchmarked program");
+
+namespace dcodex {
+namespace {
+
+using internal::FileDescriptor;
+using internal::ProcessRunner;
+using internal::ResourceLimits;
+
+// A typical small submission: iostream, one read, one write.
+constexpr char kProgram[] = R"cc(
+#include <iostream>
+int main() {
+  long n = 0;
+  std::cin >> n;
+  std::cout << n * 2 << '\n';
+  return 0;
+}
+)cc";
+
+struct Latency {
+  absl::Duration p50;
+  absl::Duration p99;
+};
+
+// Starts the program `runs` times through `spawn` and waits for each run to
+// exit. Returns negative latencies if any start fails.
+Latency MeasureRuns(
+    int runs,
+    absl::FunctionRef<absl::StatusOr<pid_t>(int, int, int)> spawn) {
+  FileDescriptor null_in(open("/dev/null", O_RDONLY | O_CLOEXEC));
+  FileDescriptor null_out(open("/dev/null", O_WRONLY | O_CLOEXEC));
+  std::vector<absl::Duration> samples;
+  samples.reserve(static_cast<size_t>(runs));
+  for (int i = 0; i < runs; ++i) {
+    const absl::Time start = absl::Now();
+    const absl::StatusOr<pid_t> pid =
+        spawn(null_in.Get(), null_out.Get(), null_out.Get());
+    if (!pid.ok()) {
+      LOG(ERROR) << "Start failed: " << pid.status();
+      return {absl::Seconds(-1), absl::Seconds(-1)};
+    }
+    int status = 0;
+    waitpid(*pid, &status, 0);
+    samples.push_back(absl::Now() - start);
+  }
+  std::sort(samples.begin(), samples.end());
+  return {samples[samples.size() / 2], samples[samples.size() * 99 / 100]};
+}
+
+int RunBenchmark() {
+  const int runs = std::max(1, absl::GetFlag(FLAGS_runs));
+  char dir_template[] = "/tmp/dcodex_fork_bench_XXXXXX";
+  const char* dir = mkdtemp(dir_template);
+  if (dir == nullptr) {
+    LOG(ERROR) << "mkdtemp failed";
+    return 1;
+  }
+
+  const absl::StatusOr<std::shared_ptr<const ForkServerStub>> stub =
+      ForkServerStub::Create(dir, absl::GetFlag(FLAGS_c_compiler));
+  if (!stub.ok()) {
+    LOG(ERROR) << "Building the stub failed: " << stub.status();
+    return 1;
+  }
+  const std::string source = absl::StrCat(dir, "/program.cpp");
+  const std::string binary = absl::StrCat(dir, "/program");
+  std::ofstream(source) << kProgram;
+  const std::string build =
+      absl::StrCat(absl::GetFlag(FLAGS_cxx_compiler), " -O2 ", source, " ",
+                   (*stub)->object_path(), " -o ", binary);
+  if (std::system(build.c_str()) != 0) {
+    LOG(ERROR) << "Building the program failed: " << build;
+    return 1;
+  }
+
+  // Any rlimit routes SpawnProcess to the sandboxed exec paths, as for a
+  // real run.
+  const ResourceLimits limits{60, 0, absl::ZeroDuration()};
+  const std::vector<std::string> argv = {binary};
+  auto exec_with = [&](ProcessRunner::SpawnMethod method) {
+    return [&, method](int in, int out, int err) {
+      return ProcessRunner::SpawnProcess(argv, in, out, err, limits, method);
+    };
+  };
+  ForkServer fork_server({binary});
+
+  const Latency fork_latency =
+      MeasureRuns(runs, exec_with(ProcessRunner::SpawnMethod::kFork));
+  const Latency clone_latency =
+      MeasureRuns(runs, exec_with(ProcessRunner::SpawnMethod::kCloneVfork));
+  const Latency server_latency =
+      MeasureRuns(runs, [&](int in, int out, int err) {
+        return fork_server.Spawn(in, out, err, limits);
+      });
+  if (fork_latency.p50 < absl::ZeroDuration() ||
+      clone_latency.p50 < absl::ZeroDuration() ||
+      server_latency.p50 < absl::ZeroDuration()) {
+    return 1;
+  }
+
+  absl::PrintF("%-22s %10s %10s %8s\n", "method", "p50_us", "p99_us",
+               "speedup");
+  const auto print_row = [&](const char* name, const Latency& latency) {
+    absl::PrintF("%-22s %10.1f %10.1f %7.2fx\n", name,
+                 absl::ToDoubleMicroseconds(latency.p50),
+                 absl::ToDoubleMicroseconds(latency.p99),
+                 absl::FDivDuration(fork_latency.p50, latency.p50));
+  };
+  print_row("fork+exec", fork_latency);
+  print_row("clone_vfork+exec", clone_latency);
+  print_row("fork_server", server_latency);
+  std::filesystem::remove_all(dir);
+  return 0;
+}
+
+}  // namespace
+}  // namespace dcodex
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::ParseCommandLine(argc, argv);
+  return dcodex::RunBenchmark();
+}
@@ -0,0 +1,182 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/fork_server_stub.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "src/common/status_macros.h"
+#include "src/engine/startup_command.h"
+
+namespace dcodex {
+
+namespace {
+
+// The stub, in C so that one object links into both C and C++ programs.
+// Protocol constants must match fork_server_stub.h.
+//
+// Children are created with clone(CLONE_PARENT) rather than fork(), so they
+// are children of the DCodeX server, not of the fork server: wait4(), pidfds
+// and the SandboxSupervisor treat them like any other spawned program. The
+// raw syscall skips glibc's fork handlers, which is safe because the fork
+// server is single-threaded and idle in recvmsg() whenever it clones.
+// Every child shares the fork server's address-space layout (no fresh ASLR
+// per run).
+constexpr char kStubSource[] = R"c(
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct dcodex_fork_request {
+  uint64_t cpu_time_seconds;
+  uint64_t address_space_bytes;
+};
+
+static int dcodex_receive(int sock, struct dcodex_fork_request* request,
+                          int fds[3]) {
+  union {
+    char buf[CMSG_SPACE(3 * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov = {request, sizeof(*request)};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  ssize_t n;
+  do {
+    n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  /* Any target after the limits is discarded: this process is the program. */
+  if (n != (ssize_t)sizeof(*request)) return -1;
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+    return -1;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+  return 0;
+}
+
+static void dcodex_close_from(int first) {
+#ifdef SYS_close_range
+  if (syscall(SYS_close_range, first, ~0u, 0) == 0) return;
+#endif
+  for (int fd = first; fd < 1024; ++fd) close(fd);
+}
+
+static void dcodex_limit(int resource, uint64_t value) {
+  if (value == 0) return;
+  struct rlimit limit = {(rlim_t)value, (rlim_t)value};
+  setrlimit(resource, &limit);
+}
+
+__attribute__((constructor(101))) static void dcodex_fork_server(void) {
+  if (getenv("DCODEX_FORK_SERVER") == NULL) return;
+  unsetenv("DCODEX_FORK_SERVER");
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  // Descriptors the server did not mean to pass (e.g. other runs' pipes)
+  // would otherwise be held open for the fork server's lifetime.
+  dcodex_close_from(3);
+  const int sock = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 3);
+  const uint32_t ready = 0x44434653u;
+  if (sock < 0 || write(sock, &ready, sizeof(ready)) != sizeof(ready)) {
+    _exit(127);
+  }
+
+  for (;;) {
+    struct dcodex_fork_request request;
+    int fds[3];
+    if (dcodex_receive(sock, &request, fds) != 0) _exit(0);
+
+    const pid_t pid = (pid_t)syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0,
+                                     0, 0);
+    if (pid == 0) {
+      /* The child replies with its own pid, which the kernel vouches for. */
+      const int32_t self = (int32_t)syscall(SYS_getpid);
+      if (send(sock, &self, sizeof(self), MSG_NOSIGNAL) != sizeof(self)) {
+        _exit(127);
+      }
+      dcodex_limit(RLIMIT_CPU, request.cpu_time_seconds);
+      dcodex_limit(RLIMIT_AS, request.address_space_bytes);
+      setpgid(0, 0);
+      if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(fds[1], STDOUT_FILENO) < 0 ||
+          dup2(fds[2], STDERR_FILENO) < 0) {
+        _exit(127);
+      }
+      dcodex_close_from(3);
+      return;  // into the program's own initializers and main()
+    }
+
+    const int32_t reply = -(int32_t)errno;
+    close(fds[0]);
+    close(fds[1]);
+    close(fds[2]);
+    if (pid < 0 &&
+        send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)) {
+      _exit(0);
+    }
+  }
+}
+)c";
+
+}  // namespace
+
+absl::StatusOr<std::shared_ptr<const ForkServerStub>> ForkServerStub::Create(
+    const std::string& dir, const std::string& compiler) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrCat(
+        "Failed to create fork server directory ", dir, ": ", ec.message()));
+  }
+
+  const std::string source_path = absl::StrCat(dir, "/fork_server_stub.c");
+  const std::string object_path = absl::StrCat(dir, "/fork_server_stub.o");
+  {
+    std::ofstream out(source_path, std::ios::trunc);
+    out << kStubSource;
+    if (!out) {
+      return absl::UnknownError(absl::StrCat("Cannot write ", source_path));
+    }
+  }
+  // Position-independent so it links into PIE and non-PIE programs alike.
+  ABSL_RETURN_IF_ERROR(RunStartupCommand(
+      {compiler, "-O2", "-fPIC", "-c", source_path, "-o", object_path},
+      object_path + ".log"));
+  return std::shared_ptr<const ForkServerStub>(new ForkServerStub(object_path));
+}
+
+}  // namespace dcodex
@@ -0,0 +1,80 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_FORK_SERVER_STUB_H_
+#define SRC_ENGINE_FORK_SERVER_STUB_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/status/statusor.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// ForkServerStub: the object file CompileStep links into every C and C++
+// program so that ForkServer can start it without exec.
+//
+// The stub is a constructor that runs before the program's own static
+// initializers and main(). Normally it returns at once. Started by a
+// ForkServer, which sets kForkServerEnv, it instead serves fork requests on
+// its stdin socket. Each request forks a child that applies the request's
+// limits, takes the passed descriptors as its stdio, and returns from the
+// constructor into the program. The dynamic loader and libc/libstdc++
+// initialization have already run in the server, so children skip them.
+//
+// Built once at startup; immutable and safe to share across threads.
+// -----------------------------------------------------------------------------
+class ForkServerStub {
+ public:
+  // Compiles the stub with the C compiler `compiler` into `dir`.
+  [[nodiscard]] static absl::StatusOr<std::shared_ptr<const ForkServerStub>>
+  Create(const std::string& dir, const std::string& compiler);
+
+  // Path of the object file to pass to the compiler driver when linking.
+  [[nodiscard]] const std::string& object_path() const { return object_path_; }
+
+ private:
+  explicit ForkServerStub(std::string object_path)
+      : object_path_(std::move(object_path)) {}
+
+  const std::string object_path_;
+};
+
+// The protocol between ForkServer and the stub; the stub's C source repeats
+// these values.
+//
+// Set in the environment of a program started as a fork server. The stub
+// removes it before any child runs.
+inline constexpr char kForkServerEnv[] = "DCODEX_FORK_SERVER";
+// Written by the stub on its control socket once it is ready for requests.
+inline constexpr uint32_t kForkServerReady = 0x44434653;  // "DCFS"
+
+// One request: this payload, followed by the run's target file (at most
+// kForkServerMaxTarget bytes), plus the child's stdin, stdout and stderr as
+// SCM_RIGHTS. The reply is an int32_t: the child's pid, sent by the child
+// itself so that ForkServer can check it against the sender's credentials,
+// or a negated errno sent by the fork server when it cannot fork.
+// Zero limits are not applied.
+struct ForkServerRequest {
+  uint64_t cpu_time_seconds = 0;     // RLIMIT_CPU
+  uint64_t address_space_bytes = 0;  // RLIMIT_AS
+};
+inline constexpr size_t kForkServerMaxTarget = 4096;
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_FORK_SERVER_STUB_H_
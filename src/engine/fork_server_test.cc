@@ -0,0 +1,234 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/fork_server.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "src/engine/fork_server_stub.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+namespace {
+
+using internal::PipePair;
+using internal::ResourceLimits;
+
+class ForkServerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = absl::StrCat(testing::TempDir(), "/fork_server_XXXXXX");
+    ASSERT_NE(mkdtemp(dir_.data()), nullptr);
+    auto stub = ForkServerStub::Create(dir_, "clang");
+    ASSERT_TRUE(stub.ok()) << stub.status();
+    stub_ = *std::move(stub);
+  }
+
+  // Compiles C `source` into a binary, linked with the stub unless
+  // `with_stub` is false.
+  std::string Build(const std::string& name, const std::string& source,
+                    bool with_stub = true) {
+    const std::string source_path = absl::StrCat(dir_, "/", name, ".c");
+    const std::string binary = absl::StrCat(dir_, "/", name);
+    std::ofstream(source_path) << source;
+    const std::string command = absl::StrCat(
+        "clang -O1 ", source_path, " ",
+        with_stub ? stub_->object_path() : "", " -o ", binary);
+    EXPECT_EQ(system(command.c_str()), 0) << command;
+    return binary;
+  }
+
+  // Runs the program once through `server` with `input` on stdin. Returns
+  // its stdout and stores its wait status in `status`.
+  static std::string Run(ForkServer& server, const std::string& input,
+                         int& status, const ResourceLimits& limits = {}) {
+    auto stdin_file = internal::ProcessRunner::CreateInputFile(input);
+    EXPECT_TRUE(stdin_file.ok()) << stdin_file.status();
+    PipePair out;
+    EXPECT_TRUE(out.Create());
+    auto pid = server.Spawn(stdin_file->Get(), out.WriteFd(), out.WriteFd(),
+                            limits);
+    EXPECT_TRUE(pid.ok()) << pid.status();
+    out.CloseWrite();
+    std::string output;
+    char buf[256];
+    ssize_t n = 0;
+    while ((n = read(out.ReadFd(), buf, sizeof(buf))) > 0) {
+      output.append(buf, static_cast<size_t>(n));
+    }
+    // The child is ours to reap, as with ProcessRunner::SpawnProcess().
+    EXPECT_EQ(waitpid(*pid, &status, 0), *pid);
+    return output;
+  }
+
+  std::string dir_;
+  std::shared_ptr<const ForkServerStub> stub_;
+};
+
+TEST_F(ForkServerTest, RunsWithGivenStdio) {
+  ForkServer server({Build("echo", R"(
+#include <stdio.h>
+int main(void) {
+  int x = 0;
+  if (scanf("%d", &x) != 1) return 3;
+  printf("got %d\n", x * 2);
+  return 0;
+}
+)")});
+  int status = 0;
+  EXPECT_EQ(Run(server, "21\n", status), "got 42\n");
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  EXPECT_EQ(Run(server, "5\n", status), "got 10\n");
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+TEST_F(ForkServerTest, EachRunStartsFromFreshGlobals) {
+  // Initializers run in every child, after the fork, not once in the server.
+  ForkServer server({Build("counter", R"(
+#include <stdio.h>
+static int initialized = 0;
+__attribute__((constructor)) static void init(void) { ++initialized; }
+int main(void) {
+  static int calls = 0;
+  printf("%d %d\n", initialized, ++calls);
+  return 0;
+}
+)")});
+  int status = 0;
+  EXPECT_EQ(Run(server, "", status), "1 1\n");
+  EXPECT_EQ(Run(server, "", status), "1 1\n");
+}
+
+TEST_F(ForkServerTest, AppliesRequestedLimits) {
+  ForkServer server({Build("spin", R"(
+int main(void) {
+  volatile unsigned long n = 0;
+  for (;;) ++n;
+}
+)")});
+  int status = 0;
+  Run(server, "", status, ResourceLimits{1, 0, absl::ZeroDuration()});
+  ASSERT_TRUE(WIFSIGNALED(status));
+  EXPECT_TRUE(WTERMSIG(status) == SIGXCPU || WTERMSIG(status) == SIGKILL)
+      << WTERMSIG(status);
+}
+
+TEST_F(ForkServerTest, StartsServerUnderRunLimits) {
+  // An initializer ordered before the stub's runs in the fork server itself.
+  ForkServer server({Build("early_spin", R"(
+__attribute__((constructor(100))) static void spin(void) {
+  volatile unsigned long n = 0;
+  for (;;) ++n;
+}
+int main(void) { return 0; }
+)")},
+                    /*handshake_timeout=*/absl::Seconds(60));
+  PipePair out;
+  ASSERT_TRUE(out.Create());
+  const absl::Time start = absl::Now();
+  auto pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(),
+                          ResourceLimits{1, 0, absl::ZeroDuration()});
+  EXPECT_FALSE(pid.ok());
+  // Killed by RLIMIT_CPU rather than waited out.
+  EXPECT_LT(absl::Now() - start, absl::Seconds(30));
+}
+
+TEST_F(ForkServerTest, RejectsReplyNamingAnotherProcess) {
+  // Speaks the protocol, but names its parent (this test) as the child.
+  ForkServer server({Build("liar", absl::StrCat(R"(
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+int main(void) {
+  uint32_t ready = )", kForkServerReady, R"(u;
+  send(0, &ready, sizeof(ready), 0);
+  char request[8192];
+  while (recv(0, request, sizeof(request), 0) > 0) {
+    int32_t reply = (int32_t)getppid();
+    send(0, &reply, sizeof(reply), 0);
+  }
+  return 0;
+}
+)"),
+                          /*with_stub=*/false)});
+  PipePair out;
+  ASSERT_TRUE(out.Create());
+  auto pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(), {});
+  ASSERT_FALSE(pid.ok());
+  EXPECT_EQ(pid.status().code(), absl::StatusCode::kInternal);
+  // The fork server is no longer trusted with requests.
+  pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(), {});
+  EXPECT_EQ(pid.status().code(), absl::StatusCode::kFailedPrecondition);
+}
+
+TEST_F(ForkServerTest, RejectsReplyNamingAnotherChild) {
+  // A child of ours that is not the requested run, e.g. another run.
+  const pid_t victim = fork();
+  ASSERT_GE(victim, 0);
+  if (victim == 0) {
+    pause();
+    _exit(0);
+  }
+  // Code that runs before the stub can speak the protocol too.
+  ForkServer server({Build("impostor", absl::StrCat(R"(
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+__attribute__((constructor(100))) static void impostor(void) {
+  uint32_t ready = )", kForkServerReady, R"(u;
+  send(0, &ready, sizeof(ready), 0);
+  char request[8192];
+  while (recv(0, request, sizeof(request), 0) > 0) {
+    int32_t reply = )", victim, R"(;
+    send(0, &reply, sizeof(reply), 0);
+  }
+  _exit(0);
+}
+int main(void) { return 0; }
+)"))});
+  PipePair out;
+  ASSERT_TRUE(out.Create());
+  auto pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(), {});
+  kill(victim, SIGKILL);
+  waitpid(victim, nullptr, 0);
+  ASSERT_FALSE(pid.ok());
+  EXPECT_EQ(pid.status().code(), absl::StatusCode::kInternal);
+}
+
+TEST_F(ForkServerTest, FailsForBinaryWithoutStub) {
+  ForkServer server({Build("plain", "int main(void) { return 0; }\n",
+                          /*with_stub=*/false)});
+  PipePair out;
+  ASSERT_TRUE(out.Create());
+  auto pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(), {});
+  EXPECT_FALSE(pid.ok());
+  // Not retried: later runs fall back to exec without waiting.
+  pid = server.Spawn(STDIN_FILENO, out.WriteFd(), out.WriteFd(), {});
+  EXPECT_EQ(pid.status().code(), absl::StatusCode::kFailedPrecondition);
+}
+
+}  // namespace
+}  // namespace dcodex
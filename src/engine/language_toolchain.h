@@ -35,7 +35,7 @@ class LanguageToolchainFactory {
   // Returns the file extension for this language (e.g., ".c", ".cpp", ".py").
   [[nodiscard]] virtual absl::string_view GetFileExtension() const = 0;
 
-  // Returns the compiler/interpreter executable name (e.g., "clang", "python").
+  // Returns the compiler/interpreter executable (e.g., "clang", "python3").
   [[nodiscard]] virtual absl::string_view GetExecutable() const = 0;
 
   // Returns the standard flags for compilation (e.g., "-std=c17", "-Wall").
@@ -104,7 +104,7 @@ class PythonToolchain final : public LanguageToolchainFactory {
   ~PythonToolchain() override = default;
 
   [[nodiscard]] absl::string_view GetFileExtension() const override { return ".py"; }
-  [[nodiscard]] absl::string_view GetExecutable() const override { return "python"; }
+  [[nodiscard]] absl::string_view GetExecutable() const override { return "python3"; }
   [[nodiscard]] std::vector<std::string> GetStandardFlags() const override;
   [[nodiscard]] absl::string_view GetLanguageId() const override { return "python"; }
   [[nodiscard]] bool RequiresCompilation() const override { return false; }
@@ -0,0 +1,249 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/engine/output_verifier.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/string_view.h"
+
+namespace dcodex {
+namespace {
+
+// Stdout bytes kept from earlier chunks for the actual-side excerpt.
+constexpr size_t kRecentBytes = 2 * OutputVerifier::kExcerptContextBytes;
+
+// Longest actual token compared numerically against a shorter expected one
+// in kFloatTolerance mode ("1e-9" may legitimately be printed as
+// "0.000000001").
+constexpr size_t kMaxNumericTokenBytes = 128;
+
+bool IsSpace(char c) { return absl::ascii_isspace(static_cast<unsigned char>(c)); }
+
+// Parses all of `token` as a finite double.
+bool ParseFinite(absl::string_view token, double& value) {
+  const char* end = token.data() + token.size();
+  const auto [ptr, ec] = std::from_chars(token.data(), end, value);
+  return ec == std::errc() && ptr == end && std::isfinite(value);
+}
+
+}  // namespace
+
+OutputVerifier::OutputVerifier(OutputExpectation expectation)
+    : expectation_(std::move(expectation)) {}
+
+bool OutputVerifier::Consume(absl::string_view chunk) {
+  if (diverged()) {
+    return false;
+  }
+  if (chunk.empty()) {
+    return true;
+  }
+  if (expectation_.mode == OutputExpectation::Mode::kExact) {
+    ConsumeExact(chunk);
+  } else {
+    ConsumeTokens(chunk);
+  }
+  if (diverged()) {
+    return false;
+  }
+  Remember(chunk);
+  consumed_ += chunk.size();
+  return true;
+}
+
+void OutputVerifier::ConsumeExact(absl::string_view chunk) {
+  const absl::string_view expected = expectation_.expected;
+  const size_t n = std::min(chunk.size(), expected.size() - matched_);
+  if (std::memcmp(chunk.data(), expected.data() + matched_, n) != 0) {
+    const size_t i = static_cast<size_t>(
+        std::mismatch(chunk.begin(), chunk.begin() + n,
+                      expected.begin() + matched_)
+            .first -
+        chunk.begin());
+    Diverge(matched_ + i, consumed_ + i, chunk);
+    return;
+  }
+  matched_ += n;
+  if (n < chunk.size()) {
+    // Output continues past the end of the expectation.
+    Diverge(matched_, consumed_ + n, chunk);
+  }
+}
+
+void OutputVerifier::ConsumeTokens(absl::string_view chunk) {
+  const absl::string_view expected = expectation_.expected;
+  const bool tolerant =
+      expectation_.mode == OutputExpectation::Mode::kFloatTolerance;
+  size_t i = 0;
+  while (i < chunk.size()) {
+    if (!in_token_) {
+      while (i < chunk.size() && IsSpace(chunk[i])) ++i;
+      if (i == chunk.size()) {
+        return;
+      }
+      if (!BeginToken(consumed_ + i)) {
+        Diverge(expected.size(), consumed_ + i, chunk);
+        return;
+      }
+    }
+    size_t j = i;
+    while (j < chunk.size() && !IsSpace(chunk[j])) ++j;
+    const absl::string_view piece = chunk.substr(i, j - i);
+    const size_t expected_len = expected_token_end_ - expected_token_begin_;
+    const size_t at = token_.size();
+    // Without tolerance the token must be a prefix of the expected one all
+    // along, so a wrong token is caught before it is complete.
+    const bool wrong =
+        tolerant
+            ? at + piece.size() > std::max(expected_len, kMaxNumericTokenBytes)
+            : at + piece.size() > expected_len ||
+                  std::memcmp(piece.data(),
+                              expected.data() + expected_token_begin_ + at,
+                              piece.size()) != 0;
+    if (wrong) {
+      Diverge(expected_token_begin_, token_offset_, chunk);
+      return;
+    }
+    token_.append(piece);
+    i = j;
+    if (j < chunk.size()) {
+      in_token_ = false;
+      if (!TokenMatches()) {
+        Diverge(expected_token_begin_, token_offset_, chunk);
+        return;
+      }
+    }
+  }
+}
+
+bool OutputVerifier::BeginToken(uint64_t offset) {
+  const absl::string_view expected = expectation_.expected;
+  size_t pos = expected_pos_;
+  while (pos < expected.size() && IsSpace(expected[pos])) ++pos;
+  expected_pos_ = pos;
+  if (pos == expected.size()) {
+    return false;
+  }
+  expected_token_begin_ = pos;
+  while (pos < expected.size() && !IsSpace(expected[pos])) ++pos;
+  expected_token_end_ = pos;
+  expected_pos_ = pos;
+  in_token_ = true;
+  token_.clear();
+  token_offset_ = offset;
+  return true;
+}
+
+bool OutputVerifier::TokenMatches() const {
+  const absl::string_view want = expectation_.expected.substr(
+      expected_token_begin_, expected_token_end_ - expected_token_begin_);
+  if (token_ == want) {
+    return true;
+  }
+  if (expectation_.mode != OutputExpectation::Mode::kFloatTolerance) {
+    return false;
+  }
+  double actual = 0;
+  double expected = 0;
+  if (!ParseFinite(token_, actual) || !ParseFinite(want, expected)) {
+    return false;
+  }
+  const double diff = std::fabs(actual - expected);
+  return diff <= expectation_.tolerance ||
+         diff <= expectation_.tolerance * std::fabs(expected);
+}
+
+OutputVerdict OutputVerifier::Finish() {
+  if (diverged()) {
+    return verdict_;
+  }
+  const absl::string_view expected = expectation_.expected;
+  if (expectation_.mode == OutputExpectation::Mode::kExact) {
+    if (matched_ < expected.size()) {
+      Diverge(matched_, consumed_, "");
+    }
+  } else {
+    if (in_token_) {
+      in_token_ = false;
+      if (!TokenMatches()) {
+        Diverge(expected_token_begin_, token_offset_, "");
+      }
+    }
+    if (!diverged()) {
+      size_t pos = expected_pos_;
+      while (pos < expected.size() && IsSpace(expected[pos])) ++pos;
+      if (pos < expected.size()) {
+        Diverge(pos, consumed_, "");
+      }
+    }
+  }
+  if (!diverged()) {
+    verdict_.kind = OutputVerdict::Kind::kAccepted;
+  }
+  return verdict_;
+}
+
+void OutputVerifier::Diverge(uint64_t expected_offset, uint64_t actual_offset,
+                             absl::string_view chunk) {
+  constexpr size_t kContext = kExcerptContextBytes;
+  const absl::string_view expected = expectation_.expected;
+  verdict_.kind = OutputVerdict::Kind::kWrongAnswer;
+  verdict_.expected_offset = expected_offset;
+  verdict_.actual_offset = actual_offset;
+  verdict_.line =
+      1 + static_cast<int>(std::count(
+              expected.begin(),
+              expected.begin() + static_cast<ptrdiff_t>(expected_offset),
+              '\n'));
+
+  const size_t expected_from =
+      expected_offset > kContext ? expected_offset - kContext : 0;
+  verdict_.expected_excerpt =
+      std::string(expected.substr(expected_from, expected_offset - expected_from + kContext));
+
+  // The actual side is stitched from `recent_` and the head of `chunk`.
+  const uint64_t window_begin = consumed_ - recent_.size();
+  const uint64_t from = std::max(
+      window_begin, actual_offset > kContext ? actual_offset - kContext : 0);
+  const uint64_t to = std::min<uint64_t>(consumed_ + chunk.size(),
+                                         actual_offset + kContext);
+  std::string window = recent_;
+  if (to > consumed_) {
+    window.append(chunk.substr(0, to - consumed_));
+  }
+  verdict_.actual_excerpt =
+      from < to ? window.substr(from - window_begin, to - from) : "";
+}
+
+void OutputVerifier::Remember(absl::string_view chunk) {
+  if (chunk.size() >= kRecentBytes) {
+    recent_.assign(chunk.substr(chunk.size() - kRecentBytes));
+    return;
+  }
+  recent_.append(chunk);
+  if (recent_.size() > kRecentBytes) {
+    recent_.erase(0, recent_.size() - kRecentBytes);
+  }
+}
+
+}  // namespace dcodex
@@ -0,0 +1,104 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SRC_ENGINE_OUTPUT_VERIFIER_H_
+#define SRC_ENGINE_OUTPUT_VERIFIER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "src/engine/execution_types.h"
+
+namespace dcodex {
+
+// Compares a program's stdout with an OutputExpectation as it is produced,
+// so a run can be stopped at the first wrong byte instead of after it has
+// written everything.
+//
+// Exact mode compares each chunk against the matching slice of the expected
+// output with memcmp(). The token modes keep only the token that straddles a
+// chunk boundary, bounded by the length of the expected token it is matched
+// against. Not thread-safe; chunks must be consumed in stream order.
+class OutputVerifier {
+ public:
+  // Bytes of each output kept on either side of a difference.
+  static constexpr size_t kExcerptContextBytes = 32;
+
+  explicit OutputVerifier(OutputExpectation expectation);
+
+  OutputVerifier(const OutputVerifier&) = delete;
+  OutputVerifier& operator=(const OutputVerifier&) = delete;
+
+  // Compares the next chunk of stdout. Returns false once the output has
+  // diverged from the expectation; later chunks are ignored.
+  bool Consume(absl::string_view chunk);
+
+  [[nodiscard]] bool diverged() const {
+    return verdict_.kind == OutputVerdict::Kind::kWrongAnswer;
+  }
+
+  // Ends the stream and returns the verdict for everything consumed. Output
+  // that stops short of the expectation is a wrong answer.
+  [[nodiscard]] OutputVerdict Finish();
+
+ private:
+  // Exact mode: matches `chunk` against the expected bytes at `matched_`.
+  void ConsumeExact(absl::string_view chunk);
+
+  // Token modes: matches the tokens of `chunk`, continuing `token_`.
+  void ConsumeTokens(absl::string_view chunk);
+
+  // Starts matching a new actual token at absolute offset `offset`, pairing
+  // it with the next expected token. False if expected has no more tokens.
+  bool BeginToken(uint64_t offset);
+
+  // Compares the complete actual token in `token_` with the expected one.
+  [[nodiscard]] bool TokenMatches() const;
+
+  // Records a difference at the given offsets; `chunk` is the stdout chunk
+  // being consumed (empty from Finish()).
+  void Diverge(uint64_t expected_offset, uint64_t actual_offset,
+               absl::string_view chunk);
+
+  // Keeps the last bytes of `chunk` in `recent_` for excerpts.
+  void Remember(absl::string_view chunk);
+
+  OutputExpectation expectation_;
+  OutputVerdict verdict_;
+
+  // Stdout bytes consumed before the current chunk.
+  uint64_t consumed_ = 0;
+  // The last bytes before the current chunk, ending at `consumed_`.
+  std::string recent_;
+
+  // Exact mode: expected bytes matched so far.
+  size_t matched_ = 0;
+
+  // Token modes: where the next expected token is searched for, and the
+  // expected token the current actual token is paired with.
+  size_t expected_pos_ = 0;
+  size_t expected_token_begin_ = 0;
+  size_t expected_token_end_ = 0;
+  // The actual token being read, and where it started in stdout.
+  bool in_token_ = false;
+  std::string token_;
+  uint64_t token_offset_ = 0;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_OUTPUT_VERIFIER_H_
@@ -0,0 +1,167 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/engine/output_verifier.h"
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+
+namespace dcodex {
+namespace {
+
+using Kind = OutputVerdict::Kind;
+using Mode = OutputExpectation::Mode;
+
+OutputExpectation Expect(absl::string_view expected, Mode mode = Mode::kExact,
+                         double tolerance = 1e-6) {
+  OutputExpectation expectation;
+  expectation.expected = expected;
+  expectation.mode = mode;
+  expectation.tolerance = tolerance;
+  return expectation;
+}
+
+// Feeds `output` to `verifier` one byte at a time, the worst case for
+// chunk-boundary handling.
+bool ConsumeBytewise(OutputVerifier& verifier, absl::string_view output) {
+  for (const char c : output) {
+    if (!verifier.Consume(absl::string_view(&c, 1))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(OutputVerifierTest, ExactAcceptsIdenticalOutputAcrossChunks) {
+  OutputVerifier verifier(Expect("1 2 3\n4 5 6\n"));
+  EXPECT_TRUE(verifier.Consume("1 2 3"));
+  EXPECT_TRUE(verifier.Consume("\n4 5 6\n"));
+  EXPECT_EQ(verifier.Finish().kind, Kind::kAccepted);
+}
+
+TEST(OutputVerifierTest, ExactReportsFirstDifferenceWithExcerpts) {
+  OutputVerifier verifier(Expect("line one\nline two\n"));
+  EXPECT_TRUE(verifier.Consume("line one\n"));
+  EXPECT_FALSE(verifier.Consume("line 2wo\n"));
+  EXPECT_TRUE(verifier.diverged());
+  // Later output is ignored.
+  EXPECT_FALSE(verifier.Consume("more"));
+
+  const OutputVerdict verdict = verifier.Finish();
+  EXPECT_EQ(verdict.kind, Kind::kWrongAnswer);
+  EXPECT_EQ(verdict.expected_offset, 14u);
+  EXPECT_EQ(verdict.actual_offset, 14u);
+  EXPECT_EQ(verdict.line, 2);
+  EXPECT_EQ(verdict.expected_excerpt, "line one\nline two\n");
+  EXPECT_EQ(verdict.actual_excerpt, "line one\nline 2wo\n");
+}
+
+TEST(OutputVerifierTest, ExactRejectsExtraAndMissingOutput) {
+  OutputVerifier extra(Expect("42\n"));
+  EXPECT_FALSE(extra.Consume("42\n\n"));
+  EXPECT_EQ(extra.Finish().expected_offset, 3u);
+
+  OutputVerifier missing(Expect("42\n"));
+  EXPECT_TRUE(missing.Consume("42"));
+  const OutputVerdict verdict = missing.Finish();
+  EXPECT_EQ(verdict.kind, Kind::kWrongAnswer);
+  EXPECT_EQ(verdict.actual_offset, 2u);
+}
+
+TEST(OutputVerifierTest, ExactAcceptsEmptyExpectation) {
+  OutputVerifier verifier(Expect(""));
+  EXPECT_EQ(verifier.Finish().kind, Kind::kAccepted);
+}
+
+TEST(OutputVerifierTest, TokensIgnoreWhitespace) {
+  OutputVerifier verifier(Expect("1 2\n3\n", Mode::kTokens));
+  EXPECT_TRUE(ConsumeBytewise(verifier, "  1\t2 3"));
+  EXPECT_EQ(verifier.Finish().kind, Kind::kAccepted);
+}
+
+TEST(OutputVerifierTest, TokensRejectTokenSplitAcrossChunks) {
+  OutputVerifier verifier(Expect("hello world\n", Mode::kTokens));
+  EXPECT_TRUE(verifier.Consume("hello wor"));
+  EXPECT_FALSE(verifier.Consume("ms\n"));
+  const OutputVerdict verdict = verifier.Finish();
+  EXPECT_EQ(verdict.kind, Kind::kWrongAnswer);
+  EXPECT_EQ(verdict.expected_offset, 6u);
+  EXPECT_EQ(verdict.actual_offset, 6u);
+  EXPECT_EQ(verdict.actual_excerpt, "hello worms\n");
+}
+
+TEST(OutputVerifierTest, TokensRejectLongerAndShorterTokens) {
+  OutputVerifier longer(Expect("12 3", Mode::kTokens));
+  EXPECT_FALSE(longer.Consume("123"));
+
+  OutputVerifier shorter(Expect("12 3", Mode::kTokens));
+  EXPECT_FALSE(shorter.Consume("1 3"));
+
+  OutputVerifier truncated(Expect("12 3", Mode::kTokens));
+  EXPECT_TRUE(truncated.Consume("12 "));
+  EXPECT_EQ(truncated.Finish().kind, Kind::kWrongAnswer);
+}
+
+TEST(OutputVerifierTest, TokensRejectExtraToken) {
+  OutputVerifier verifier(Expect("a b\n", Mode::kTokens));
+  EXPECT_FALSE(verifier.Consume("a b c\n"));
+  const OutputVerdict verdict = verifier.Finish();
+  EXPECT_EQ(verdict.expected_offset, 4u);
+  EXPECT_EQ(verdict.actual_offset, 4u);
+}
+
+TEST(OutputVerifierTest, FloatToleranceAcceptsCloseNumbers) {
+  OutputVerifier verifier(
+      Expect("3.14159265 1e-9 1000000\n", Mode::kFloatTolerance, 1e-6));
+  EXPECT_TRUE(ConsumeBytewise(verifier, "3.1415929 0.000000001 1000000.5\n"));
+  EXPECT_EQ(verifier.Finish().kind, Kind::kAccepted);
+}
+
+TEST(OutputVerifierTest, FloatToleranceRejectsDistantNumbersAndWords) {
+  OutputVerifier distant(Expect("0.5\n", Mode::kFloatTolerance, 1e-6));
+  EXPECT_FALSE(distant.Consume("0.6\n"));
+
+  OutputVerifier words(Expect("YES\n", Mode::kFloatTolerance, 1e-6));
+  EXPECT_FALSE(words.Consume("yes\n"));
+
+  OutputVerifier not_a_number(Expect("1\n", Mode::kFloatTolerance, 1e-6));
+  EXPECT_FALSE(not_a_number.Consume("nan\n"));
+}
+
+TEST(OutputVerifierTest, FloatToleranceBoundsBufferedToken) {
+  OutputVerifier verifier(Expect("1\n", Mode::kFloatTolerance));
+  EXPECT_FALSE(verifier.Consume(std::string(1000, '1')));
+}
+
+TEST(OutputVerifierTest, ExcerptsAreBounded) {
+  const std::string expected(10000, 'a');
+  std::string actual = expected;
+  actual[5000] = 'b';
+  OutputVerifier verifier(Expect(expected));
+  EXPECT_FALSE(verifier.Consume(actual));
+  const OutputVerdict verdict = verifier.Finish();
+  EXPECT_EQ(verdict.expected_offset, 5000u);
+  EXPECT_EQ(verdict.line, 1);
+  EXPECT_EQ(verdict.expected_excerpt.size(),
+            2 * OutputVerifier::kExcerptContextBytes);
+  EXPECT_EQ(verdict.actual_excerpt.size(),
+            2 * OutputVerifier::kExcerptContextBytes);
+  EXPECT_EQ(verdict.actual_excerpt[OutputVerifier::kExcerptContextBytes], 'b');
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,149 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// pch_benchmark: measures C++ compile latency with and without precompiled
+// headers over a directory of sources (default: examples/cpp).
+//
+//   bazel run //src/engine:pch_benchmark -- --corpus_dir=$PWD/examples/cpp
+//
+// Each source is compiled through the real CreateSourceFile -> Compile chain,
+// once with an empty CompilationServices (baseline) and once with a
+// PrecompiledHeaderManager. The artifact cache is deliberately left unset so
+// every iteration invokes the compiler.
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/execution_pipeline_builder.h"
+#include "src/engine/execution_step.h"
+#include "src/engine/language_toolchain.h"
+#include "src/engine/precompiled_header_manager.h"
+
+ABSL_FLAG(std::string, corpus_dir, "examples/cpp",
+          "Directory of .cpp sources to compile");
+ABSL_FLAG(std::string, pch_dir, "/tmp/dcodex_pch_benchmark",
+          "Scratch directory for the benchmark's precompiled headers");
+ABSL_FLAG(int, iterations, 5, "Compiles per source and mode");
+
+namespace dcodex {
+namespace {
+
+// Returns the median compile latency of `code` over `iterations` runs, or
+// a negative duration if any compile fails.
+absl::Duration MedianCompileLatency(const LanguageToolchainFactory& toolchain,
+                                    const CompilationServices& services,
+                                    const std::string& code, int iterations) {
+  std::vector<absl::Duration> samples;
+  for (int i = 0; i < iterations; ++i) {
+    auto pipeline =
+        ExecutionPipelineBuilder()
+            .AddCreateSourceFileStep(toolchain.GetFileExtension())
+            .AddCompileStep(toolchain.GetExecutable(),
+                            toolchain.GetStandardFlags(),
+                            toolchain.GetLanguageId(), services)
+            .Build();
+    ExecutionContext context(code, "", [](absl::string_view, absl::string_view) {});
+    const absl::Time start = absl::Now();
+    const auto result = pipeline->Run(context);
+    samples.push_back(absl::Now() - start);
+    if (!result.ok() || !result->success) {
+      return absl::Seconds(-1);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+int RunBenchmark() {
+  const auto toolchain = LanguageToolchainFactory::CreateCpp();
+  const int iterations = std::max(1, absl::GetFlag(FLAGS_iterations));
+
+  const absl::Time build_start = absl::Now();
+  auto pch_manager = PrecompiledHeaderManager::Create(
+      absl::GetFlag(FLAGS_pch_dir), std::string(toolchain->GetExecutable()),
+      toolchain->GetStandardFlags());
+  if (!pch_manager.ok()) {
+    LOG(ERROR) << "PCH setup failed: " << pch_manager.status();
+    return 1;
+  }
+  absl::PrintF("Built %d PCH variants in %s\n\n", (*pch_manager)->variant_count(),
+               absl::FormatDuration(absl::Now() - build_start));
+
+  CompilationServices baseline;
+  CompilationServices with_pch;
+  with_pch.pch_manager = *pch_manager;
+
+  std::vector<std::filesystem::path> sources;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(absl::GetFlag(FLAGS_corpus_dir))) {
+    if (entry.path().extension() == ".cpp") sources.push_back(entry.path());
+  }
+  std::sort(sources.begin(), sources.end());
+
+  absl::PrintF("%-32s %-18s %12s %12s %8s\n", "source", "variant",
+               "baseline_ms", "pch_ms", "speedup");
+  absl::Duration total_baseline, total_pch;
+  for (const auto& path : sources) {
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string code = buffer.str();
+
+    const auto selection = (*pch_manager)->Select(
+        toolchain->GetExecutable(), toolchain->GetStandardFlags(), code);
+    const absl::Duration base =
+        MedianCompileLatency(*toolchain, baseline, code, iterations);
+    const absl::Duration pch =
+        MedianCompileLatency(*toolchain, with_pch, code, iterations);
+    if (base < absl::ZeroDuration() || pch < absl::ZeroDuration()) {
+      absl::PrintF("%-32s compile failed\n", path.filename().string());
+      continue;
+    }
+    total_baseline += base;
+    total_pch += pch;
+    absl::PrintF("%-32s %-18s %12.1f %12.1f %7.2fx\n", path.filename().string(),
+                 selection ? selection->name : "-",
+                 absl::ToDoubleMilliseconds(base),
+                 absl::ToDoubleMilliseconds(pch), absl::FDivDuration(base, pch));
+  }
+  if (total_pch > absl::ZeroDuration()) {
+    absl::PrintF("%-32s %-18s %12.1f %12.1f %7.2fx\n", "TOTAL", "",
+                 absl::ToDoubleMilliseconds(total_baseline),
+                 absl::ToDoubleMilliseconds(total_pch),
+                 absl::FDivDuration(total_baseline, total_pch));
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace dcodex
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::ParseCommandLine(argc, argv);
+  return dcodex::RunBenchmark();
+}
@@ -0,0 +1,177 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/precompiled_header_manager.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "src/engine/startup_command.h"
+
+namespace dcodex {
+
+namespace {
+
+// Extracts the header name from an `#include <x>` / `#include "x"` body.
+std::optional<std::string> ParseIncludeTarget(absl::string_view rest) {
+  rest = absl::StripLeadingAsciiWhitespace(rest);
+  if (rest.size() < 2) return std::nullopt;
+  const char close = rest.front() == '<' ? '>' : rest.front() == '"' ? '"' : 0;
+  if (close == 0) return std::nullopt;
+  const size_t end = rest.find(close, 1);
+  if (end == absl::string_view::npos) return std::nullopt;
+  return std::string(rest.substr(1, end - 1));
+}
+
+}  // namespace
+
+std::vector<PrecompiledHeaderManager::VariantSpec>
+PrecompiledHeaderManager::DefaultVariants() {
+  return {
+      {"stdcxx", {"bits/stdc++.h"}},
+      {"iostream", {"iostream"}},
+      {"iostream_vector", {"iostream", "vector"}},
+      {"competitive", {"algorithm", "iostream", "numeric", "string", "vector"}},
+  };
+}
+
+absl::StatusOr<std::shared_ptr<PrecompiledHeaderManager>>
+PrecompiledHeaderManager::Create(std::string pch_dir, std::string compiler,
+                                 std::vector<std::string> flags,
+                                 std::vector<VariantSpec> variants) {
+  std::error_code ec;
+  std::filesystem::create_directories(pch_dir, ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrCat(
+        "Failed to create PCH directory ", pch_dir, ": ", ec.message()));
+  }
+
+  std::vector<BuiltVariant> built;
+  for (auto& spec : variants) {
+    const std::string header_path = absl::StrCat(pch_dir, "/", spec.name, ".hpp");
+    {
+      std::ofstream out(header_path, std::ios::trunc);
+      for (const auto& header : spec.headers) {
+        out << "#include <" << header << ">\n";
+      }
+      if (!out) {
+        LOG(WARNING) << "Skipping PCH variant " << spec.name
+                     << ": cannot write " << header_path;
+        continue;
+      }
+    }
+
+    // Given `-include <header>`, GCC looks for `<header>.gch` and Clang for
+    // `<header>.pch`; publish the output under both names.
+    const std::string gch_path = header_path + ".gch";
+    const std::string pch_path = header_path + ".pch";
+    std::vector<std::string> argv = {compiler};
+    argv.insert(argv.end(), flags.begin(), flags.end());
+    argv.insert(argv.end(), {"-x", "c++-header", header_path, "-o", gch_path});
+
+    if (absl::Status status = RunStartupCommand(argv, header_path + ".log");
+        !status.ok()) {
+      LOG(WARNING) << "Skipping PCH variant " << spec.name << ": " << status;
+      continue;
+    }
+    std::filesystem::remove(pch_path, ec);
+    std::filesystem::create_hard_link(gch_path, pch_path, ec);
+
+    LOG(INFO) << "Built PCH variant " << spec.name << " ("
+              << absl::StrJoin(spec.headers, ", ") << ")";
+    built.push_back({std::move(spec.name), std::move(spec.headers), header_path});
+  }
+
+  std::stable_sort(built.begin(), built.end(),
+                   [](const BuiltVariant& a, const BuiltVariant& b) {
+                     return a.headers.size() > b.headers.size();
+                   });
+  return std::shared_ptr<PrecompiledHeaderManager>(new PrecompiledHeaderManager(
+      std::move(compiler), std::move(flags), std::move(built)));
+}
+
+PrecompiledHeaderManager::PrecompiledHeaderManager(
+    std::string compiler, std::vector<std::string> flags,
+    std::vector<BuiltVariant> variants)
+    : compiler_(std::move(compiler)),
+      flags_(std::move(flags)),
+      variants_(std::move(variants)) {}
+
+std::optional<PrecompiledHeaderManager::Selection>
+PrecompiledHeaderManager::Select(absl::string_view compiler,
+                                 absl::Span<const std::string> flags,
+                                 absl::string_view source) const {
+  // A PCH is only valid for the exact configuration it was built with.
+  if (variants_.empty() || compiler != compiler_ ||
+      !std::equal(flags.begin(), flags.end(), flags_.begin(), flags_.end())) {
+    return std::nullopt;
+  }
+
+  const auto includes = ScanIncludes(source);
+  if (!includes.has_value()) {
+    return std::nullopt;
+  }
+
+  for (const auto& variant : variants_) {
+    const bool covered = std::all_of(
+        variant.headers.begin(), variant.headers.end(),
+        [&](const std::string& header) { return includes->contains(header); });
+    if (covered) {
+      return Selection{variant.name, {"-include", variant.header_path}};
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<absl::flat_hash_set<std::string>>
+PrecompiledHeaderManager::ScanIncludes(absl::string_view source) {
+  absl::flat_hash_set<std::string> includes;
+  bool saw_other_directive = false;
+
+  for (absl::string_view line : absl::StrSplit(source, '\n')) {
+    line = absl::StripLeadingAsciiWhitespace(line);
+    if (!absl::ConsumePrefix(&line, "#")) {
+      continue;
+    }
+    line = absl::StripLeadingAsciiWhitespace(line);
+    if (!absl::ConsumePrefix(&line, "include")) {
+      saw_other_directive = true;
+      continue;
+    }
+    const auto target = ParseIncludeTarget(line);
+    if (!target.has_value()) {
+      continue;
+    }
+    if (saw_other_directive) {
+      return std::nullopt;
+    }
+    includes.insert(*target);
+  }
+  return includes;
+}
+
+}  // namespace dcodex
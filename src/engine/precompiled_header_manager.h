@@ -0,0 +1,101 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_PRECOMPILED_HEADER_MANAGER_H_
+#define SRC_ENGINE_PRECOMPILED_HEADER_MANAGER_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// PrecompiledHeaderManager: builds a fixed set of C++ precompiled header
+// variants once at startup and picks one per request.
+//
+// Each variant is a generated header of `#include` lines compiled with the
+// exact compiler and flags CompileStep will later use. A variant is only
+// applied when every header it contains is also included by the request, so
+// the PCH never makes names visible that the submission did not ask for.
+//
+// The manager is immutable after Create() and safe to share across threads.
+// -----------------------------------------------------------------------------
+class PrecompiledHeaderManager {
+ public:
+  // A named set of standard headers to precompile together.
+  struct VariantSpec {
+    std::string name;
+    std::vector<std::string> headers;
+  };
+
+  // The variant chosen for a request and the flags that apply it.
+  struct Selection {
+    std::string name;
+    std::vector<std::string> flags;
+  };
+
+  // Variants covering the common competitive-programming prologues.
+  [[nodiscard]] static std::vector<VariantSpec> DefaultVariants();
+
+  // Builds every variant under `pch_dir` with `compiler` and `flags`.
+  // Variants that fail to build (e.g. <bits/stdc++.h> under libc++) are
+  // skipped with a warning; only an unusable directory is an error.
+  [[nodiscard]] static absl::StatusOr<std::shared_ptr<PrecompiledHeaderManager>>
+  Create(std::string pch_dir, std::string compiler,
+         std::vector<std::string> flags,
+         std::vector<VariantSpec> variants = DefaultVariants());
+
+  // Returns the largest variant usable for `source` when compiled with
+  // `compiler` and `flags`, or nullopt if none applies.
+  [[nodiscard]] std::optional<Selection> Select(
+      absl::string_view compiler, absl::Span<const std::string> flags,
+      absl::string_view source) const;
+
+  // Returns the headers named by the leading `#include` directives of
+  // `source`, or nullopt if any other preprocessor directive precedes an
+  // include (a macro or conditional could change what the headers expand to).
+  [[nodiscard]] static std::optional<absl::flat_hash_set<std::string>>
+  ScanIncludes(absl::string_view source);
+
+  // Number of variants that were built successfully.
+  [[nodiscard]] size_t variant_count() const { return variants_.size(); }
+
+ private:
+  struct BuiltVariant {
+    std::string name;
+    std::vector<std::string> headers;
+    // Generated header passed via -include; the compiler locates the PCH
+    // next to it.
+    std::string header_path;
+  };
+
+  PrecompiledHeaderManager(std::string compiler, std::vector<std::string> flags,
+                           std::vector<BuiltVariant> variants);
+
+  const std::string compiler_;
+  const std::vector<std::string> flags_;
+  // Sorted by descending header count so the first match is the largest.
+  const std::vector<BuiltVariant> variants_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_PRECOMPILED_HEADER_MANAGER_H_
@@ -0,0 +1,89 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/precompiled_header_manager.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace dcodex {
+namespace {
+
+TEST(PrecompiledHeaderManagerTest, ScanIncludesCollectsLeadingIncludes) {
+  const auto includes = PrecompiledHeaderManager::ScanIncludes(R"(
+// comment
+#include <iostream>
+  #  include <vector>
+#include "local.h"
+int main() { return 0; }
+)");
+  ASSERT_TRUE(includes.has_value());
+  EXPECT_TRUE(includes->contains("iostream"));
+  EXPECT_TRUE(includes->contains("vector"));
+  EXPECT_TRUE(includes->contains("local.h"));
+  EXPECT_EQ(includes->size(), 3u);
+}
+
+TEST(PrecompiledHeaderManagerTest, ScanIncludesRejectsMacroBeforeInclude) {
+  // _GLIBCXX_DEBUG changes what <vector> expands to; a PCH built without it
+  // would silently drop the debug containers.
+  EXPECT_FALSE(PrecompiledHeaderManager::ScanIncludes(
+                   "#define _GLIBCXX_DEBUG\n#include <vector>\n")
+                   .has_value());
+  EXPECT_FALSE(PrecompiledHeaderManager::ScanIncludes(
+                   "#ifdef LOCAL\n#include <cstdio>\n#endif\n")
+                   .has_value());
+  // Macros after the last include are harmless.
+  EXPECT_TRUE(PrecompiledHeaderManager::ScanIncludes(
+                  "#include <vector>\n#define N 100\n")
+                  .has_value());
+}
+
+TEST(PrecompiledHeaderManagerTest, SelectsLargestCoveredVariant) {
+  std::string dir = absl::StrCat(testing::TempDir(), "/pch_XXXXXX");
+  ASSERT_NE(mkdtemp(dir.data()), nullptr);
+
+  const std::vector<std::string> flags = {"-std=c++17"};
+  auto manager = PrecompiledHeaderManager::Create(
+      dir, "clang++", flags,
+      {{"cstdio", {"cstdio"}},
+       {"cstdio_cstdlib", {"cstdio", "cstdlib"}},
+       {"broken", {"no_such_header_for_dcodex.h"}}});
+  ASSERT_TRUE(manager.ok()) << manager.status();
+  EXPECT_EQ((*manager)->variant_count(), 2u) << "broken variant must be skipped";
+
+  const auto both = (*manager)->Select(
+      "clang++", flags, "#include <cstdlib>\n#include <cstdio>\n");
+  ASSERT_TRUE(both.has_value());
+  EXPECT_EQ(both->name, "cstdio_cstdlib");
+  ASSERT_EQ(both->flags.size(), 2u);
+  EXPECT_EQ(both->flags[0], "-include");
+
+  const auto one = (*manager)->Select("clang++", flags, "#include <cstdio>\n");
+  ASSERT_TRUE(one.has_value());
+  EXPECT_EQ(one->name, "cstdio");
+
+  EXPECT_FALSE((*manager)->Select("clang++", flags, "#include <string>\n"));
+  EXPECT_FALSE((*manager)->Select("clang++", {"-std=c++20"},
+                                  "#include <cstdio>\n"));
+  EXPECT_FALSE((*manager)->Select("g++", flags, "#include <cstdio>\n"));
+}
+
+}  // namespace
+}  // namespace dcodex
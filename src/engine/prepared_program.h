@@ -0,0 +1,87 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SRC_ENGINE_PREPARED_PROGRAM_H_
+#define SRC_ENGINE_PREPARED_PROGRAM_H_
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/engine/execution_types.h"
+
+namespace dcodex {
+
+class ForkServer;
+
+// A program built once to be run many times without recompiling: a compiled
+// binary, or the source file of an interpreted language. Owns the file and
+// removes it when destroyed, so a run that still holds the program keeps it
+// on disk after its handle has expired. A compiled program linked with the
+// ForkServerStub also owns the ForkServer its runs are started from.
+// `extra_paths` are further files the program needs, such as the source
+// next to Python bytecode; they are removed after path(), in order, and may
+// include directories emptied by the paths before them.
+class PreparedProgram {
+ public:
+  PreparedProgram(std::string language_id, std::string path, bool compiled,
+                  std::shared_ptr<ForkServer> fork_server = nullptr,
+                  std::vector<std::string> extra_paths = {})
+      : language_id_(std::move(language_id)),
+        path_(std::move(path)),
+        compiled_(compiled),
+        fork_server_(std::move(fork_server)),
+        extra_paths_(std::move(extra_paths)) {}
+
+  ~PreparedProgram() {
+    unlink(path_.c_str());
+    for (const std::string& path : extra_paths_) {
+      remove(path.c_str());
+    }
+  }
+
+  PreparedProgram(const PreparedProgram&) = delete;
+  PreparedProgram& operator=(const PreparedProgram&) = delete;
+
+  // The ExecutionStrategy id that built the program (e.g. "cpp").
+  [[nodiscard]] const std::string& language_id() const { return language_id_; }
+  [[nodiscard]] const std::string& path() const { return path_; }
+  // Whether path() is a binary rather than a source file for an interpreter.
+  [[nodiscard]] bool compiled() const { return compiled_; }
+  // Null unless runs can be forked; ForkServer is itself thread-safe.
+  [[nodiscard]] ForkServer* fork_server() const { return fork_server_.get(); }
+
+ private:
+  std::string language_id_;
+  std::string path_;
+  bool compiled_;
+  std::shared_ptr<ForkServer> fork_server_;
+  std::vector<std::string> extra_paths_;
+};
+
+// Outcome of preparing a program. A compile error is a result with
+// success=false and diagnostics, and no program.
+struct PreparedBuild {
+  ExecutionResult result;
+  std::shared_ptr<const PreparedProgram> program;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_PREPARED_PROGRAM_H_
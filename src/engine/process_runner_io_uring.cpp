@@ -0,0 +1,395 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// io_uring backend for ProcessRunner::ReadOutput(). Declared in
+// process_runner.h; kept out of line because it owns ring setup and the
+// kernel ABI plumbing that the epoll/kqueue path does not need.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/common/status_macros.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex::internal {
+
+#ifdef __linux__
+
+namespace {
+
+// Submission slots. In flight at once: two reads, the exit poll, and at most
+// a deadline and a drain timer.
+constexpr unsigned kRingEntries = 8;
+
+// Read size per pipe. Both buffers are registered with the ring once, so the
+// kernel pins them up front instead of mapping user pages on every read.
+constexpr size_t kReadBufferBytes = 64 * 1024;
+
+// user_data tags. Timers carry a generation above the tag bits so that a
+// superseded timer's completion is recognised and ignored.
+enum Tag : uint64_t { kStdout = 0, kStderr = 1, kExit = 2, kTimer = 3 };
+constexpr uint64_t kTagMask = 3;
+
+// ---------------------------------------------------------------------------
+// Ring: one io_uring instance with its mapped queues and registered buffers.
+// ---------------------------------------------------------------------------
+class Ring {
+ public:
+  static absl::StatusOr<std::unique_ptr<Ring>> Create(int buffers) {
+    struct io_uring_params params {};
+    auto ring = std::unique_ptr<Ring>(new Ring());
+    ring->fd_.Reset(static_cast<int>(
+        syscall(__NR_io_uring_setup, kRingEntries, &params)));
+    if (!ring->fd_.IsValid()) {
+      return absl::ErrnoToStatus(errno, "io_uring_setup failed");
+    }
+    ABSL_RETURN_IF_ERROR(ring->MapQueues(params));
+    ABSL_RETURN_IF_ERROR(ring->RegisterBuffers(buffers));
+    return ring;
+  }
+
+  ~Ring() {
+    // Closing the ring cancels whatever is still in flight. The buffers are
+    // unmapped rather than freed, so a read the kernel completes late lands
+    // in pages no allocation can reuse.
+    fd_.Reset();
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_bytes_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_bytes_);
+    }
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_bytes_);
+    if (buffers_ != MAP_FAILED) munmap(buffers_, buffers_bytes_);
+  }
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  // Whether the kernel implements every opcode the output loop uses.
+  bool SupportsOutputLoop() const {
+    constexpr size_t kOps = 256;
+    std::unique_ptr<char[]> storage(
+        new char[sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op)]());
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.get());
+    if (syscall(__NR_io_uring_register, fd_.Get(), IORING_REGISTER_PROBE,
+                probe, kOps) < 0) {
+      return false;
+    }
+    for (const int op : {IORING_OP_READ_FIXED, IORING_OP_POLL_ADD,
+                         IORING_OP_TIMEOUT}) {
+      if (op > probe->last_op ||
+          !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  char* buffer(int index) const {
+    return static_cast<char*>(buffers_) +
+           static_cast<size_t>(index) * kReadBufferBytes;
+  }
+
+  // A zeroed submission entry queued for the next Submit(); the ring is
+  // sized so that the output loop never runs out.
+  io_uring_sqe* NextSqe() {
+    const unsigned head =
+        std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+    if (sqe_tail_ - head >= *sq_entries_) {
+      return nullptr;
+    }
+    const unsigned index = sqe_tail_ & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+  }
+
+  // Publishes every queued entry and waits for at least one completion, in a
+  // single io_uring_enter(). Returns false with errno set on failure.
+  bool SubmitAndWait() {
+    std::atomic_ref<unsigned>(*sq_tail_).store(sqe_tail_,
+                                               std::memory_order_release);
+    const unsigned to_submit = sqe_tail_ - submitted_;
+    const long rc = syscall(__NR_io_uring_enter, fd_.Get(), to_submit, 1U,
+                            IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (rc < 0) {
+      return false;
+    }
+    submitted_ += static_cast<unsigned>(rc);
+    return true;
+  }
+
+  // Calls `fn` for each available completion, then releases them.
+  template <typename Fn>
+  void DrainCompletions(Fn&& fn) {
+    unsigned head = *cq_head_;
+    const unsigned tail =
+        std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      fn(cqes_[head & *cq_mask_]);
+    }
+    std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+  }
+
+ private:
+  Ring() = default;
+
+  absl::Status MapQueues(const io_uring_params& params) {
+    sq_ring_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_bytes_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_bytes_ = cq_ring_bytes_ = std::max(sq_ring_bytes_, cq_ring_bytes_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_bytes_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_.Get(), IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap of io_uring SQ ring failed");
+    }
+    cq_ring_ = single_mmap
+                   ? sq_ring_
+                   : mmap(nullptr, cq_ring_bytes_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd_.Get(),
+                          IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap of io_uring CQ ring failed");
+    }
+    sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_.Get(), IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap of io_uring SQEs failed");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqe_tail_ = submitted_ = *sq_tail_;
+    return absl::OkStatus();
+  }
+
+  absl::Status RegisterBuffers(int count) {
+    buffers_bytes_ = static_cast<size_t>(count) * kReadBufferBytes;
+    buffers_ = mmap(nullptr, buffers_bytes_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers_ == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap of read buffers failed");
+    }
+    std::vector<struct iovec> iovs(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+      iovs[static_cast<size_t>(i)] = {buffer(i), kReadBufferBytes};
+    }
+    if (syscall(__NR_io_uring_register, fd_.Get(), IORING_REGISTER_BUFFERS,
+                iovs.data(), static_cast<unsigned>(count)) < 0) {
+      // Typically ENOMEM from RLIMIT_MEMLOCK on older kernels.
+      return absl::ErrnoToStatus(errno, "io_uring buffer registration failed");
+    }
+    return absl::OkStatus();
+  }
+
+  FileDescriptor fd_;
+  void* sq_ring_ = MAP_FAILED;
+  void* cq_ring_ = MAP_FAILED;
+  size_t sq_ring_bytes_ = 0;
+  size_t cq_ring_bytes_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_bytes_ = 0;
+  void* buffers_ = MAP_FAILED;
+  size_t buffers_bytes_ = 0;
+
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_entries_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+  // Entries queued locally and entries the kernel has consumed.
+  unsigned sqe_tail_ = 0;
+  unsigned submitted_ = 0;
+};
+
+}  // namespace
+
+bool ProcessRunner::IoUringSupported() {
+  static const bool supported = [] {
+    auto ring = Ring::Create(/*buffers=*/1);
+    return ring.ok() && (*ring)->SupportsOutputLoop();
+  }();
+  return supported;
+}
+
+absl::StatusOr<ProcessRunner::ReadOutcome> ProcessRunner::ReadOutputIoUring(
+    int stdout_fd, int stderr_fd, pid_t child_pid, absl::Time deadline,
+    const OutputCallback& callback) {
+  ABSL_ASSIGN_OR_RETURN(std::unique_ptr<Ring> ring, Ring::Create(2));
+  FileDescriptor pidfd(OpenPidFd(child_pid));
+  if (!pidfd.IsValid()) {
+    return absl::ErrnoToStatus(errno, "pidfd_open failed");
+  }
+
+  // Reads wait in the kernel; on a non-blocking pipe they would complete
+  // with EAGAIN instead.
+  const int fds[2] = {stdout_fd, stderr_fd};
+  for (const int fd : fds) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags != -1 && (flags & O_NONBLOCK)) {
+      fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+  }
+
+  ReadOutcome outcome;
+  bool open[2] = {true, true};
+  bool child_exited = false;
+  size_t total_bytes = 0;
+  uint64_t timer_generation = 0;
+  struct __kernel_timespec timer_ts {};
+
+  const auto arm_read = [&](int index) {
+    io_uring_sqe* sqe = ring->NextSqe();
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fds[index];
+    sqe->addr = reinterpret_cast<uint64_t>(ring->buffer(index));
+    sqe->len = static_cast<uint32_t>(kReadBufferBytes);
+    sqe->buf_index = static_cast<uint16_t>(index);
+    sqe->user_data = static_cast<__u64>(index);
+  };
+  // Replaces any pending timer; the kernel copies `timer_ts` on submission.
+  const auto arm_timer = [&](absl::Time when) {
+    const absl::Duration remaining =
+        std::max(when - absl::Now(), absl::ZeroDuration());
+    timer_ts.tv_sec = absl::ToInt64Seconds(remaining);
+    timer_ts.tv_nsec = absl::ToInt64Nanoseconds(
+        remaining - absl::Seconds(timer_ts.tv_sec));
+    io_uring_sqe* sqe = ring->NextSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&timer_ts);
+    sqe->len = 1;
+    sqe->user_data = (++timer_generation << 2) | kTimer;
+  };
+
+  arm_read(kStdout);
+  arm_read(kStderr);
+  io_uring_sqe* exit_sqe = ring->NextSqe();
+  exit_sqe->opcode = IORING_OP_POLL_ADD;
+  exit_sqe->fd = pidfd.Get();
+  exit_sqe->poll32_events = POLLIN;
+  exit_sqe->user_data = kExit;
+  if (deadline != absl::InfiniteFuture()) {
+    arm_timer(deadline);
+  }
+
+  const uint64_t max_output_bytes =
+      absl::GetFlag(FLAGS_sandbox_max_output_bytes);
+  bool drained = false;
+  while ((open[0] || open[1]) && !drained) {
+    if (!ring->SubmitAndWait()) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    ring->DrainCompletions([&](const io_uring_cqe& cqe) {
+      const auto tag = static_cast<Tag>(cqe.user_data & kTagMask);
+      switch (tag) {
+        case kStdout:
+        case kStderr: {
+          const int index = static_cast<int>(tag);
+          if (!open[index]) break;
+          if (cqe.res > 0) {
+            total_bytes += static_cast<size_t>(cqe.res);
+            DeliverChunk(callback, tag == kStdout,
+                         absl::string_view(ring->buffer(index),
+                                           static_cast<size_t>(cqe.res)));
+            arm_read(index);
+          } else if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+            arm_read(index);
+          } else {
+            open[index] = false;  // EOF or error.
+          }
+          break;
+        }
+        case kExit:
+          child_exited = true;
+          KillProcessGroup(child_pid);
+          arm_timer(absl::Now() + absl::Milliseconds(kExitDrainMs));
+          break;
+        case kTimer:
+          if ((cqe.user_data >> 2) != timer_generation) break;  // Superseded.
+          if (!child_exited) {
+            // Deadline: the exit poll that follows the kill starts the drain.
+            outcome.timed_out = true;
+            KillProcessGroup(child_pid);
+          } else {
+            drained = true;  // A descendant escaped the group; give up.
+          }
+          break;
+      }
+    });
+
+    if (total_bytes >= max_output_bytes) {
+      KillProcessGroup(child_pid);
+      outcome.truncated = true;
+      callback("", TruncationNotice(max_output_bytes));
+      break;
+    }
+  }
+  return outcome;
+}
+
+#else  // !__linux__
+
+bool ProcessRunner::IoUringSupported() { return false; }
+
+absl::StatusOr<ProcessRunner::ReadOutcome> ProcessRunner::ReadOutputIoUring(
+    int stdout_fd, int stderr_fd, pid_t child_pid, absl::Time deadline,
+    const OutputCallback& callback) {
+  (void)stdout_fd;
+  (void)stderr_fd;
+  (void)child_pid;
+  (void)deadline;
+  (void)callback;
+  return absl::UnimplementedError("io_uring requires Linux");
+}
+
+#endif  // __linux__
+
+}  // namespace dcodex::internal
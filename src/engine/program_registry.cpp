@@ -0,0 +1,118 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/engine/program_registry.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/random/distributions.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+namespace dcodex {
+
+ProgramRegistry::ProgramRegistry(size_t max_programs, absl::Duration ttl)
+    : max_programs_(std::max<size_t>(1, max_programs)),
+      ttl_(ttl),
+      sweeper_(&ProgramRegistry::SweepLoop, this) {}
+
+ProgramRegistry::~ProgramRegistry() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+    sweep_cv_.SignalAll();
+  }
+  sweeper_.join();
+}
+
+std::string ProgramRegistry::Register(
+    std::shared_ptr<const PreparedProgram> program) {
+  const absl::Time now = absl::Now();
+  absl::MutexLock lock(&mutex_);
+  DropExpiredLocked(now);
+  if (entries_.size() >= max_programs_) {
+    // Every lease has the same TTL, so the soonest to expire is the least
+    // recently used.
+    const auto oldest = std::min_element(
+        entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+          return a.second.expires < b.second.expires;
+        });
+    entries_.erase(oldest);
+    ++evicted_;
+  }
+
+  std::string handle;
+  do {
+    handle = absl::StrFormat("%016x%016x", absl::Uniform<uint64_t>(bitgen_),
+                             absl::Uniform<uint64_t>(bitgen_));
+  } while (entries_.contains(handle));
+  entries_.emplace(handle, Entry{std::move(program), now + ttl_});
+  ++registered_;
+  return handle;
+}
+
+absl::StatusOr<std::shared_ptr<const PreparedProgram>> ProgramRegistry::Acquire(
+    absl::string_view handle) {
+  const absl::Time now = absl::Now();
+  absl::MutexLock lock(&mutex_);
+  const auto it = entries_.find(handle);
+  if (it == entries_.end()) {
+    return absl::NotFoundError(
+        absl::StrCat("Unknown program handle '", handle, "'"));
+  }
+  if (it->second.expires < now) {
+    entries_.erase(it);
+    ++expired_;
+    return absl::NotFoundError(
+        absl::StrCat("Program handle '", handle, "' has expired"));
+  }
+  it->second.expires = now + ttl_;
+  return it->second.program;
+}
+
+ProgramRegistry::Stats ProgramRegistry::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  Stats stats;
+  stats.programs = entries_.size();
+  stats.registered = registered_;
+  stats.expired = expired_;
+  stats.evicted = evicted_;
+  return stats;
+}
+
+void ProgramRegistry::DropExpiredLocked(absl::Time now) {
+  expired_ += static_cast<int64_t>(absl::erase_if(
+      entries_, [now](const auto& entry) { return entry.second.expires < now; }));
+}
+
+void ProgramRegistry::SweepLoop() {
+  // Without it, a handle nobody uses again would keep its fork server
+  // running until the next Register() or Acquire().
+  const absl::Duration period = std::max(ttl_ / 2, absl::Milliseconds(1));
+  absl::MutexLock lock(&mutex_);
+  while (!stopping_) {
+    sweep_cv_.WaitWithTimeout(&mutex_, period);
+    if (!stopping_) {
+      DropExpiredLocked(absl::Now());
+    }
+  }
+}
+
+}  // namespace dcodex
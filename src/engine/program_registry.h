@@ -0,0 +1,104 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SRC_ENGINE_PROGRAM_REGISTRY_H_
+#define SRC_ENGINE_PROGRAM_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "src/engine/prepared_program.h"
+
+namespace dcodex {
+
+// =============================================================================
+// ProgramRegistry: server-held handles to prepared programs.
+// A client compiles once, gets a handle, and runs the program by handle with
+// new stdin as often as it likes, without resending or rehashing the source.
+// Each handle is leased for a TTL that every use renews; expired handles are
+// dropped on use and by a background sweep every half TTL, so an idle
+// program's file and fork server go within 1.5 TTLs of its last use. At
+// capacity the least recently used one is evicted. Programs are shared, so a
+// run in flight keeps its file past eviction.
+// All methods are thread-safe.
+// =============================================================================
+class ProgramRegistry {
+ public:
+  struct Stats {
+    size_t programs = 0;
+    int64_t registered = 0;
+    int64_t expired = 0;
+    int64_t evicted = 0;
+  };
+
+  // Keeps at most `max_programs` programs, each for `ttl` after its last use.
+  ProgramRegistry(size_t max_programs, absl::Duration ttl);
+  // Stops the sweep; programs still registered are released.
+  ~ProgramRegistry();
+
+  // Disallow copy and move operations.
+  ProgramRegistry(const ProgramRegistry&) = delete;
+  ProgramRegistry& operator=(const ProgramRegistry&) = delete;
+
+  [[nodiscard]] absl::Duration ttl() const { return ttl_; }
+
+  // Adds `program` and returns its new, unguessable handle.
+  std::string Register(std::shared_ptr<const PreparedProgram> program);
+
+  // The program behind `handle`, renewing its lease. NOT_FOUND if the handle
+  // is unknown or has expired.
+  [[nodiscard]] absl::StatusOr<std::shared_ptr<const PreparedProgram>> Acquire(
+      absl::string_view handle);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  struct Entry {
+    std::shared_ptr<const PreparedProgram> program;
+    absl::Time expires;
+  };
+
+  // Drops every entry whose lease ended before `now`.
+  void DropExpiredLocked(absl::Time now) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Body of sweeper_: drops expired entries every half TTL until stopping_.
+  void SweepLoop();
+
+  const size_t max_programs_;
+  const absl::Duration ttl_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  absl::BitGen bitgen_ ABSL_GUARDED_BY(mutex_);
+  int64_t registered_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t expired_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t evicted_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::CondVar sweep_cv_;  // For interruptible sleep in the sweep.
+  std::thread sweeper_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_PROGRAM_REGISTRY_H_
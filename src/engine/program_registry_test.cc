@@ -0,0 +1,132 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/engine/program_registry.h"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "src/engine/prepared_program.h"
+
+namespace dcodex {
+namespace {
+
+// A prepared program backed by a fresh temporary file.
+std::shared_ptr<const PreparedProgram> MakeProgram() {
+  char path[] = "/tmp/dcodex_program_test_XXXXXX";
+  const int fd = mkstemp(path);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  return std::make_shared<const PreparedProgram>("cpp", path,
+                                                 /*compiled=*/true);
+}
+
+bool Exists(const std::string& path) { return access(path.c_str(), F_OK) == 0; }
+
+TEST(ProgramRegistryTest, HandleResolvesToProgram) {
+  ProgramRegistry registry(4, absl::Minutes(1));
+  auto program = MakeProgram();
+  const std::string handle = registry.Register(program);
+  EXPECT_EQ(handle.size(), 32u);
+
+  auto acquired = registry.Acquire(handle);
+  ASSERT_TRUE(acquired.ok()) << acquired.status();
+  EXPECT_EQ(acquired->get(), program.get());
+  EXPECT_EQ(registry.GetStats().programs, 1u);
+}
+
+TEST(ProgramRegistryTest, HandlesAreDistinct) {
+  ProgramRegistry registry(4, absl::Minutes(1));
+  EXPECT_NE(registry.Register(MakeProgram()), registry.Register(MakeProgram()));
+}
+
+TEST(ProgramRegistryTest, UnknownHandleIsNotFound) {
+  ProgramRegistry registry(4, absl::Minutes(1));
+  EXPECT_TRUE(absl::IsNotFound(registry.Acquire("nope").status()));
+}
+
+TEST(ProgramRegistryTest, LeaseExpiresUnlessRenewed) {
+  ProgramRegistry registry(4, absl::Milliseconds(200));
+  auto program = MakeProgram();
+  const std::string path = program->path();
+  const std::string handle = registry.Register(std::move(program));
+
+  // Each use renews the lease, so steady use outlives the TTL.
+  for (int i = 0; i < 4; ++i) {
+    absl::SleepFor(absl::Milliseconds(100));
+    ASSERT_TRUE(registry.Acquire(handle).ok()) << "use " << i;
+  }
+  absl::SleepFor(absl::Milliseconds(300));
+  EXPECT_TRUE(absl::IsNotFound(registry.Acquire(handle).status()));
+  EXPECT_EQ(registry.GetStats().expired, 1);
+  // The registry held the only reference.
+  EXPECT_FALSE(Exists(path));
+}
+
+TEST(ProgramRegistryTest, IdleProgramIsSweptWithoutFurtherUse) {
+  ProgramRegistry registry(4, absl::Milliseconds(100));
+  auto program = MakeProgram();
+  const std::string path = program->path();
+  registry.Register(std::move(program));
+
+  // No Register() or Acquire() after this: the sweep alone releases it.
+  const absl::Time deadline = absl::Now() + absl::Seconds(5);
+  while (Exists(path) && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_FALSE(Exists(path));
+  EXPECT_EQ(registry.GetStats().programs, 0u);
+  EXPECT_EQ(registry.GetStats().expired, 1);
+}
+
+TEST(ProgramRegistryTest, EvictsLeastRecentlyUsedAtCapacity) {
+  ProgramRegistry registry(2, absl::Minutes(1));
+  const std::string first = registry.Register(MakeProgram());
+  absl::SleepFor(absl::Milliseconds(2));
+  const std::string second = registry.Register(MakeProgram());
+  absl::SleepFor(absl::Milliseconds(2));
+  ASSERT_TRUE(registry.Acquire(first).ok());
+
+  registry.Register(MakeProgram());
+  EXPECT_TRUE(registry.Acquire(first).ok());
+  EXPECT_TRUE(absl::IsNotFound(registry.Acquire(second).status()));
+  EXPECT_EQ(registry.GetStats().evicted, 1);
+  EXPECT_EQ(registry.GetStats().programs, 2u);
+}
+
+TEST(ProgramRegistryTest, RunningProgramOutlivesEviction) {
+  ProgramRegistry registry(1, absl::Minutes(1));
+  const std::string handle = registry.Register(MakeProgram());
+  auto running = registry.Acquire(handle);
+  ASSERT_TRUE(running.ok());
+
+  registry.Register(MakeProgram());
+  EXPECT_TRUE(absl::IsNotFound(registry.Acquire(handle).status()));
+  const std::string path = (*running)->path();
+  EXPECT_TRUE(Exists(path));
+  running->reset();
+  EXPECT_FALSE(Exists(path));
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,174 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/python_zygote.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+
+namespace dcodex {
+
+namespace {
+
+// The zygote loop, run with `python3 -u -c`. argv: the clone syscall number
+// and flags (only the C side knows them for this platform), then the modules
+// to preload. Like the C stub in fork_server_stub.cpp, children are created
+// with clone(CLONE_PARENT) so they are the server's children; the
+// PyOS_*Fork() calls do what os.fork() does around it, e.g. reseeding
+// `random` in each child. Protocol constants must match fork_server_stub.h.
+constexpr char kZygoteSource[] = R"py(
+import atexit, ctypes, os, resource, runpy, socket, struct, sys
+
+SYS_CLONE, CLONE_FLAGS = int(sys.argv[1]), int(sys.argv[2])
+for name in sys.argv[3:]:
+    try:
+        __import__(name)
+    except Exception:
+        pass
+# runpy imports and initializes most of its machinery on first use; pay for
+# that here rather than in every child.
+runpy.run_path(os.devnull)
+os.environ.pop("DCODEX_FORK_SERVER", None)
+
+LIBC = ctypes.CDLL(None, use_errno=True)
+API = ctypes.pythonapi
+LIBC.prctl(1, 9)  # PR_SET_PDEATHSIG, SIGKILL
+MAX_FD = resource.getrlimit(resource.RLIMIT_NOFILE)[0]
+REQUEST = struct.Struct("=QQ")
+# Frames of this loop and of runpy, which a cold start would not have.
+ZYGOTE_FILES = {"<string>", "<frozen runpy>", getattr(runpy, "__file__", None)}
+
+def exit_status(request):
+    # As the interpreter maps SystemExit to an exit status.
+    if request.code is None:
+        return 0
+    if isinstance(request.code, int):
+        return request.code & 0xFF
+    print(request.code, file=sys.stderr)
+    return 1
+
+def finish(status):
+    # The parts of interpreter shutdown a program can observe. The rest,
+    # tearing down every module and object, is most of a short run's cost
+    # and is wasted on a process that is about to exit.
+    if "threading" in sys.modules:
+        sys.modules["threading"]._shutdown()
+    atexit._run_exitfuncs()
+    for stream in (sys.stdout, sys.stderr):
+        try:
+            stream.flush()
+        except Exception:
+            status = 120
+    os._exit(status)
+
+def run_child(cpu, mem, fds, script):
+    if cpu:
+        resource.setrlimit(resource.RLIMIT_CPU, (cpu, cpu))
+    if mem:
+        resource.setrlimit(resource.RLIMIT_AS, (mem, mem))
+    os.setpgid(0, 0)
+    for target, fd in enumerate(fds):
+        os.dup2(fd, target)
+    os.closerange(3, MAX_FD)
+    sys.argv = [script]
+    sys.path[0] = os.path.dirname(script)
+    try:
+        runpy.run_path(script, run_name="__main__")
+        status = 0
+    except SystemExit as request:
+        status = exit_status(request)
+    except BaseException:
+        kind, value, tb = sys.exc_info()
+        # Report it as `python3 script` would, without the zygote's frames.
+        while (tb is not None and
+               tb.tb_frame.f_code.co_filename in ZYGOTE_FILES):
+            tb = tb.tb_next
+        sys.excepthook(kind, value.with_traceback(tb), tb)
+        status = 1
+    finish(status)
+
+os.closerange(3, MAX_FD)
+sock = socket.socket(fileno=os.dup(0))
+sock.send(struct.pack("=I", 0x44434653))
+while True:
+    try:
+        msg, fds, _, _ = socket.recv_fds(sock, REQUEST.size + 4096, 3)
+    except OSError:
+        os._exit(0)
+    if len(msg) < REQUEST.size or len(fds) != 3:
+        os._exit(0)
+    cpu, mem = REQUEST.unpack_from(msg)
+    script = msg[REQUEST.size:].decode()
+    API.PyOS_BeforeFork()
+    pid = LIBC.syscall(SYS_CLONE, CLONE_FLAGS, 0, 0, 0, 0)
+    error = ctypes.get_errno()
+    if pid == 0:
+        API.PyOS_AfterFork_Child()
+        # The child replies with its own pid, which the kernel vouches for.
+        sock.send(struct.pack("=i", os.getpid()))
+        sock.close()
+        run_child(cpu, mem, fds, script)
+    API.PyOS_AfterFork_Parent()
+    for fd in fds:
+        os.close(fd)
+    if pid < 0:
+        sock.send(struct.pack("=i", -error))
+)py";
+
+// Preloading heavy modules can take a while; only a hung interpreter should
+// time out.
+constexpr absl::Duration kHandshakeTimeout = absl::Seconds(30);
+
+}  // namespace
+
+PythonZygote::PythonZygote(int zygotes,
+                           std::vector<std::string> preload_modules)
+    : preload_modules_(std::move(preload_modules)) {
+  std::vector<std::string> argv = {
+      "python3", "-u", "-c", kZygoteSource, absl::StrCat(SYS_clone),
+      absl::StrCat(CLONE_PARENT | SIGCHLD)};
+  argv.insert(argv.end(), preload_modules_.begin(), preload_modules_.end());
+  for (int i = 0; i < std::max(1, zygotes); ++i) {
+    zygotes_.push_back(std::make_shared<ForkServer>(argv, kHandshakeTimeout));
+  }
+}
+
+absl::Status PythonZygote::Start() {
+  absl::Status first_error;
+  for (const auto& zygote : zygotes_) {
+    if (absl::Status started = zygote->Start(); !started.ok()) {
+      LOG(WARNING) << "Python zygote failed to start: " << started;
+      first_error.Update(started);
+    }
+  }
+  return first_error;
+}
+
+std::shared_ptr<ForkServer> PythonZygote::Pick() {
+  return zygotes_[next_.fetch_add(1, std::memory_order_relaxed) %
+                  zygotes_.size()];
+}
+
+}  // namespace dcodex
@@ -0,0 +1,74 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_PYTHON_ZYGOTE_H_
+#define SRC_ENGINE_PYTHON_ZYGOTE_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/engine/fork_server.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// PythonZygote: interpreters that have already started up and imported a set
+// of hot modules, each forking a child per Python run.
+//
+// Each zygote is `python3 -u` running a small loop that speaks the
+// ForkServer protocol. A child applies the run's rlimits, leads its own
+// process group, takes the run's stdio, drops every other descriptor, and
+// runs the target script, source or .pyc, as __main__ the way `python3 -u
+// script.py` would: same sys.argv and sys.path[0], traceback and exit
+// status. What it skips is interpreter start-up, site and the preloaded
+// imports.
+//
+// Differences from a cold start: modules in `preload_modules` are already in
+// sys.modules, and the zygote's start-up settings (environment, locale) were
+// fixed when it started. At exit, the child joins non-daemon threads, runs
+// atexit handlers and flushes stdio, but skips the interpreter's teardown,
+// so objects still alive then are not finalized. Runs are spread over the
+// zygotes round-robin; a zygote serializes only the fork itself.
+// -----------------------------------------------------------------------------
+class PythonZygote {
+ public:
+  // `zygotes` (at least 1) interpreters, started lazily; see Start().
+  PythonZygote(int zygotes, std::vector<std::string> preload_modules);
+
+  PythonZygote(const PythonZygote&) = delete;
+  PythonZygote& operator=(const PythonZygote&) = delete;
+
+  // Starts every zygote now, so the first runs do not pay for it. Returns the
+  // first error; runs on a zygote that failed fall back to `python3 -u`.
+  absl::Status Start();
+
+  // The zygote for the next run. Pass the script as ForkServer::Spawn()'s
+  // target.
+  [[nodiscard]] std::shared_ptr<ForkServer> Pick();
+
+  [[nodiscard]] const std::vector<std::string>& preload_modules() const {
+    return preload_modules_;
+  }
+
+ private:
+  const std::vector<std::string> preload_modules_;
+  std::vector<std::shared_ptr<ForkServer>> zygotes_;
+  std::atomic<size_t> next_{0};
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_PYTHON_ZYGOTE_H_
@@ -0,0 +1,204 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// python_zygote_benchmark: measures the per-run cost of a tiny Python
+// snippet started cold (`python3 -u`) versus forked from a PythonZygote, and,
+// where the interpreter has them, run in a fresh sub-interpreter.
+//
+//   bazel run -c opt //src/engine:python_zygote_benchmark -- --runs=500
+//
+// Each sample runs until the snippet has exited. The sub-interpreter row is
+// measured inside one interpreter, without stdio wiring or a process to
+// wait for, so it is a lower bound for a host that ran snippets that way.
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/engine/process_runner.h"
+#include "src/engine/python_zygote.h"
+
+ABSL_FLAG(int, runs, 200, "Runs per start method");
+
+namespace dcodex {
+namespace {
+
+using internal::FileDescriptor;
+using internal::ProcessRunner;
+using internal::ResourceLimits;
+
+// A REPL-style snippet: a little arithmetic and one print.
+constexpr char kSnippet[] = "x = sum(range(100))\nprint(x)\n";
+
+// Runs `argv[1]` `argv[2]` times, each in a new sub-interpreter, and prints
+// the p50 and p99 in microseconds; prints nothing without sub-interpreters.
+constexpr char kSubinterpreterProbe[] = R"py(
+import os, sys, time
+try:
+    import _xxsubinterpreters as interpreters
+except ImportError:
+    sys.exit(0)
+source, runs = open(sys.argv[1]).read(), int(sys.argv[2])
+# The snippets print to fd 1 too; keep the result line apart from them.
+result = os.fdopen(os.dup(1), "w")
+os.dup2(os.open(os.devnull, os.O_WRONLY), 1)
+samples = []
+for _ in range(runs):
+    start = time.perf_counter()
+    interp = interpreters.create()
+    interpreters.run_string(interp, source)
+    interpreters.destroy(interp)
+    samples.append(time.perf_counter() - start)
+samples.sort()
+print(samples[len(samples) // 2] * 1e6, samples[len(samples) * 99 // 100] * 1e6,
+      file=result)
+)py";
+
+struct Latency {
+  absl::Duration p50;
+  absl::Duration p99;
+};
+
+// Starts the snippet `runs` times through `spawn` and waits for each run to
+// exit. Returns negative latencies if any start fails.
+Latency MeasureRuns(
+    int runs,
+    absl::FunctionRef<absl::StatusOr<pid_t>(int, int, int)> spawn) {
+  FileDescriptor null_in(open("/dev/null", O_RDONLY | O_CLOEXEC));
+  FileDescriptor null_out(open("/dev/null", O_WRONLY | O_CLOEXEC));
+  std::vector<absl::Duration> samples;
+  samples.reserve(static_cast<size_t>(runs));
+  for (int i = 0; i < runs; ++i) {
+    const absl::Time start = absl::Now();
+    const absl::StatusOr<pid_t> pid =
+        spawn(null_in.Get(), null_out.Get(), null_out.Get());
+    if (!pid.ok()) {
+      LOG(ERROR) << "Start failed: " << pid.status();
+      return {absl::Seconds(-1), absl::Seconds(-1)};
+    }
+    int status = 0;
+    waitpid(*pid, &status, 0);
+    samples.push_back(absl::Now() - start);
+  }
+  std::sort(samples.begin(), samples.end());
+  return {samples[samples.size() / 2], samples[samples.size() * 99 / 100]};
+}
+
+// The sub-interpreter latencies, or nullopt where there are none.
+std::optional<Latency> MeasureSubinterpreters(const std::string& script,
+                                              int runs) {
+  const std::string probe = absl::StrCat(
+      std::filesystem::path(script).parent_path().string(), "/probe.py");
+  std::ofstream(probe) << kSubinterpreterProbe;
+  const std::string command =
+      absl::StrCat("python3 ", probe, " ", script, " ", runs);
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return std::nullopt;
+  }
+  char line[128] = {};
+  const bool read = fgets(line, sizeof(line), pipe) != nullptr;
+  pclose(pipe);
+  std::vector<std::string> fields =
+      absl::StrSplit(line, ' ', absl::SkipWhitespace());
+  double p50_us = 0;
+  double p99_us = 0;
+  if (!read || fields.size() != 2 ||
+      !absl::SimpleAtod(fields[0], &p50_us) ||
+      !absl::SimpleAtod(fields[1], &p99_us)) {
+    return std::nullopt;
+  }
+  return Latency{absl::Microseconds(p50_us), absl::Microseconds(p99_us)};
+}
+
+int RunBenchmark() {
+  const int runs = std::max(1, absl::GetFlag(FLAGS_runs));
+  char dir_template[] = "/tmp/dcodex_zygote_bench_XXXXXX";
+  const char* dir = mkdtemp(dir_template);
+  if (dir == nullptr) {
+    LOG(ERROR) << "mkdtemp failed";
+    return 1;
+  }
+  const std::string script = absl::StrCat(dir, "/snippet.py");
+  std::ofstream(script) << kSnippet;
+
+  // Any rlimit routes SpawnProcess to the sandboxed exec path, as for a real
+  // run.
+  const ResourceLimits limits{60, 0, absl::ZeroDuration()};
+  const std::vector<std::string> argv = {"python3", "-u", script};
+  PythonZygote zygote(1, {});
+  if (const absl::Status started = zygote.Start(); !started.ok()) {
+    LOG(ERROR) << "Starting the zygote failed: " << started;
+    return 1;
+  }
+
+  const Latency cold_latency = MeasureRuns(runs, [&](int in, int out, int err) {
+    return ProcessRunner::SpawnProcess(argv, in, out, err, limits);
+  });
+  const Latency zygote_latency =
+      MeasureRuns(runs, [&](int in, int out, int err) {
+        return zygote.Pick()->Spawn(in, out, err, limits, script);
+      });
+  if (cold_latency.p50 < absl::ZeroDuration() ||
+      zygote_latency.p50 < absl::ZeroDuration()) {
+    return 1;
+  }
+  const std::optional<Latency> subinterpreter_latency =
+      MeasureSubinterpreters(script, runs);
+
+  absl::PrintF("%-22s %10s %10s %8s\n", "method", "p50_us", "p99_us",
+               "speedup");
+  const auto print_row = [&](const char* name, const Latency& latency) {
+    absl::PrintF("%-22s %10.1f %10.1f %7.2fx\n", name,
+                 absl::ToDoubleMicroseconds(latency.p50),
+                 absl::ToDoubleMicroseconds(latency.p99),
+                 absl::FDivDuration(cold_latency.p50, latency.p50));
+  };
+  print_row("python3 -u", cold_latency);
+  print_row("zygote", zygote_latency);
+  if (subinterpreter_latency.has_value()) {
+    print_row("sub-interpreter", *subinterpreter_latency);
+  }
+  std::filesystem::remove_all(dir);
+  return 0;
+}
+
+}  // namespace
+}  // namespace dcodex
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::ParseCommandLine(argc, argv);
+  return dcodex::RunBenchmark();
+}
@@ -0,0 +1,173 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/python_zygote.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+namespace {
+
+using internal::PipePair;
+using internal::ResourceLimits;
+
+class PythonZygoteTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = absl::StrCat(testing::TempDir(), "/python_zygote_XXXXXX");
+    ASSERT_NE(mkdtemp(dir_.data()), nullptr);
+  }
+
+  std::string Script(const std::string& name, const std::string& source) {
+    const std::string path = absl::StrCat(dir_, "/", name, ".py");
+    std::ofstream(path) << source;
+    return path;
+  }
+
+  // Runs `script` once through `zygote` with `input` on stdin. Returns its
+  // stdout and stderr and stores its wait status in `status`.
+  static std::string Run(PythonZygote& zygote, const std::string& script,
+                         const std::string& input, int& status,
+                         const ResourceLimits& limits = {}) {
+    auto stdin_file = internal::ProcessRunner::CreateInputFile(input);
+    EXPECT_TRUE(stdin_file.ok()) << stdin_file.status();
+    PipePair out;
+    EXPECT_TRUE(out.Create());
+    auto pid = zygote.Pick()->Spawn(stdin_file->Get(), out.WriteFd(),
+                                    out.WriteFd(), limits, script);
+    EXPECT_TRUE(pid.ok()) << pid.status();
+    out.CloseWrite();
+    std::string output;
+    char buf[256];
+    ssize_t n = 0;
+    while ((n = read(out.ReadFd(), buf, sizeof(buf))) > 0) {
+      output.append(buf, static_cast<size_t>(n));
+    }
+    EXPECT_EQ(waitpid(*pid, &status, 0), *pid);
+    return output;
+  }
+
+  std::string dir_;
+};
+
+TEST_F(PythonZygoteTest, RunsScriptAsMain) {
+  PythonZygote zygote(2, {"heapq"});
+  ASSERT_TRUE(zygote.Start().ok());
+  const std::string script = Script("double", R"(
+import sys
+print(__name__, sys.argv[0].endswith("double.py"), int(input()) * 2)
+print("heapq" in sys.modules)
+)");
+  int status = 0;
+  // Twice, so that both zygotes serve a run.
+  for (const char* input : {"21\n", "5\n"}) {
+    const std::string expected =
+        absl::StrCat("__main__ True ", atoi(input) * 2, "\nTrue\n");
+    EXPECT_EQ(Run(zygote, script, input, status), expected);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+}
+
+TEST_F(PythonZygoteTest, ReportsExitStatusAndTraceback) {
+  PythonZygote zygote(1, {});
+  int status = 0;
+  EXPECT_EQ(Run(zygote, Script("exit", "import sys\nsys.exit(3)\n"), "",
+                status),
+            "");
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 3);
+
+  const std::string output =
+      Run(zygote, Script("raise", "x = 1\nraise ValueError('bad')\n"), "",
+          status);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+  EXPECT_NE(output.find("raise.py\", line 2"), std::string::npos) << output;
+  EXPECT_NE(output.find("ValueError: bad"), std::string::npos) << output;
+  // Only the script's frames, as `python3 script.py` would print.
+  EXPECT_EQ(output.find("runpy"), std::string::npos) << output;
+}
+
+TEST_F(PythonZygoteTest, ShutsDownAsInterpreterWould) {
+  PythonZygote zygote(1, {});
+  int status = 0;
+  const std::string output = Run(zygote, Script("shutdown", R"(
+import atexit, sys, threading, time
+atexit.register(lambda: print("atexit ran"))
+def late():
+    time.sleep(0.1)
+    print("thread joined")
+threading.Thread(target=late).start()
+sys.stdout.write("buffered ")
+sys.exit("bye")
+)"),
+                                 "", status);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+  EXPECT_NE(output.find("bye"), std::string::npos) << output;
+  EXPECT_NE(output.find("buffered "), std::string::npos) << output;
+  EXPECT_NE(output.find("thread joined\natexit ran\n"), std::string::npos)
+      << output;
+}
+
+TEST_F(PythonZygoteTest, RunsBytecode) {
+  PythonZygote zygote(1, {});
+  const std::string source =
+      Script("main", "print('from bytecode')\nraise ValueError('bad')\n");
+  const std::string bytecode = absl::StrCat(dir_, "/main.pyc");
+  const std::string command =
+      absl::StrCat("python3 -c \"import py_compile; py_compile.compile('",
+                   source, "', '", bytecode, "', 'main.py')\"");
+  ASSERT_EQ(system(command.c_str()), 0) << command;
+  int status = 0;
+  const std::string output = Run(zygote, bytecode, "", status);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+  EXPECT_EQ(output.rfind("from bytecode\n", 0), 0u) << output;
+  // The source line is found next to the bytecode, as for a cold start.
+  EXPECT_NE(output.find("File \"main.py\", line 2"), std::string::npos)
+      << output;
+  EXPECT_NE(output.find("raise ValueError('bad')"), std::string::npos)
+      << output;
+}
+
+TEST_F(PythonZygoteTest, ChildrenDoNotShareRandomState) {
+  PythonZygote zygote(1, {"random"});
+  const std::string script =
+      Script("rand", "import random\nprint(random.getrandbits(64))\n");
+  int status = 0;
+  EXPECT_NE(Run(zygote, script, "", status), Run(zygote, script, "", status));
+}
+
+TEST_F(PythonZygoteTest, AppliesRequestedLimits) {
+  PythonZygote zygote(1, {});
+  int status = 0;
+  Run(zygote, Script("spin", "while True:\n    pass\n"), "", status,
+      ResourceLimits{1, 0, absl::ZeroDuration()});
+  ASSERT_TRUE(WIFSIGNALED(status));
+  EXPECT_TRUE(WTERMSIG(status) == SIGXCPU || WTERMSIG(status) == SIGKILL)
+      << WTERMSIG(status);
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,47 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/run_cancellation.h"
+
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+
+void RunCancellation::Cancel() {
+  absl::MutexLock lock(&mutex_);
+  cancelled_ = true;
+  for (const pid_t pid : pids_) {
+    internal::ProcessRunner::KillProcessGroup(pid);
+  }
+}
+
+bool RunCancellation::cancelled() const {
+  absl::MutexLock lock(&mutex_);
+  return cancelled_;
+}
+
+void RunCancellation::Attach(pid_t pid) {
+  absl::MutexLock lock(&mutex_);
+  pids_.insert(pid);
+  if (cancelled_) {
+    internal::ProcessRunner::KillProcessGroup(pid);
+  }
+}
+
+void RunCancellation::Detach(pid_t pid) {
+  absl::MutexLock lock(&mutex_);
+  pids_.erase(pid);
+}
+
+}  // namespace dcodex
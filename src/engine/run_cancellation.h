@@ -0,0 +1,61 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_RUN_CANCELLATION_H_
+#define SRC_ENGINE_RUN_CANCELLATION_H_
+
+#include <sys/types.h>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+
+namespace dcodex {
+
+// =============================================================================
+// RunCancellation: stops the programs of a request whose client went away.
+// The run path attaches each sandboxed program once it is spawned and
+// detaches it before reaping it, so a pid in the set is never recycled.
+// Cancel() kills the process groups attached so far and any attached later;
+// the runs then complete as killed programs. All methods are thread-safe.
+// =============================================================================
+class RunCancellation {
+ public:
+  RunCancellation() = default;
+
+  // Disallow copy and move operations.
+  RunCancellation(const RunCancellation&) = delete;
+  RunCancellation& operator=(const RunCancellation&) = delete;
+
+  // Kills every attached process group, now and on attach.
+  void Cancel();
+
+  [[nodiscard]] bool cancelled() const;
+
+  // Tracks `pid`, a process group leader that has not been reaped. Kills it
+  // at once if the run was already cancelled.
+  void Attach(pid_t pid);
+
+  // Stops tracking `pid`. Must be called before the caller reaps it.
+  void Detach(pid_t pid);
+
+ private:
+  mutable absl::Mutex mutex_;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::flat_hash_set<pid_t> pids_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_RUN_CANCELLATION_H_
@@ -18,9 +18,14 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
+#include <optional>
 #include <sstream>
 
+#include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
@@ -30,26 +35,66 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "src/common/artifact_cache.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/compile_governor.h"
+#include "src/engine/compile_single_flight.h"
+#include "src/engine/compiler_diagnostics.h"
 #include "src/engine/execution_pipeline.h"
 #include "src/engine/execution_pipeline_builder.h"
 #include "src/engine/execution_step.h"
 #include "src/engine/execution_strategy.h"
 #include "src/engine/execution_types.h"
+#include "src/engine/fork_server.h"
 #include "src/engine/language_toolchain.h"
+#include "src/engine/output_verifier.h"
+#include "src/engine/prepared_program.h"
 #include "src/engine/process_runner.h"
-#include "src/engine/process_timeout_manager.h"
+#include "src/engine/python_zygote.h"
+#include "src/engine/run_cancellation.h"
+#include "src/engine/sandbox_supervisor.h"
+#include "src/engine/sandbox_warm_state.h"
 #include "src/engine/temp_file_manager.h"
+#include "src/engine/tiered_compilation.h"
 
 ABSL_FLAG(int, sandbox_cpu_time_limit_seconds, 1,
           "CPU time limit in seconds for sandboxed execution");
 ABSL_FLAG(int, sandbox_wall_clock_timeout_seconds, 2,
           "Wall-clock timeout in seconds for sandboxed execution");
+ABSL_FLAG(absl::Duration, sandbox_wall_clock_timeout, absl::ZeroDuration(),
+          "Wall-clock timeout for sandboxed execution with sub-second "
+          "resolution (e.g. 300ms); overrides "
+          "--sandbox_wall_clock_timeout_seconds when non-zero");
 ABSL_FLAG(uint64_t, sandbox_memory_limit_bytes, 4ULL * 1024 * 1024 * 1024,
           "Memory limit in bytes for sandboxed execution");
 ABSL_FLAG(uint64_t, sandbox_max_output_bytes, 10 * 1024,
           "Maximum combined stdout+stderr output in bytes");
+ABSL_FLAG(uint64_t, sandbox_pipe_buffer_bytes, 256 * 1024,
+          "Kernel buffer size for sandbox stdout/stderr pipes (Linux; 0 keeps "
+          "the 64 KB default)");
+ABSL_FLAG(uint64_t, sandbox_stdin_pipe_max_bytes, 1024 * 1024,
+          "Largest stdin passed through a pipe; larger inputs are served to "
+          "the program from a memfd (a temporary file off Linux)");
+ABSL_FLAG(bool, sandbox_io_uring, false,
+          "Capture child output with io_uring where the kernel supports it "
+          "(falls back to epoll otherwise). Applies only to output read on "
+          "the spawning thread: compilers, and programs when "
+          "--sandbox_supervisor_threads=0. Supervised programs are always read "
+          "with epoll. Each capture sets up its own ring, so this pays off "
+          "only for heavy output");
+ABSL_FLAG(int, compile_cpu_time_limit_seconds, 20,
+          "CPU time limit in seconds for one compiler invocation");
+ABSL_FLAG(int, compile_wall_clock_timeout_seconds, 30,
+          "Wall-clock timeout in seconds for one compiler invocation");
+ABSL_FLAG(uint64_t, compile_memory_limit_bytes, 2ULL * 1024 * 1024 * 1024,
+          "Address-space limit in bytes for one compiler invocation");
+ABSL_FLAG(uint64_t, python_bytecode_min_bytes, 32 * 1024,
+          "Smallest Python source run from cached bytecode (requires the "
+          "artifact cache); smaller sources are compiled by each run");
 
 namespace dcodex {
 
@@ -57,9 +102,14 @@ namespace {
 
 using internal::ProcessRunner;
 using internal::TempFileManager;
+using internal::FileDescriptor;
 using internal::PipePair;
+using internal::ResourceLimits;
 using internal::ScopedProcess;
 
+// Name under which the submitted source appears in compiler diagnostics.
+constexpr absl::string_view kDiagnosticSourceStem = "main";
+
 // --- SRP: Global Cache Management ---
 // REMOVED: CacheHolder singleton in favor of DI.
 
@@ -84,7 +134,7 @@ ResourceStats ComputeResourceStats(const struct rusage& usage,
 // Handles low-level process execution with sandboxing support.
 // Sandboxed path: fork+exec with setrlimit() in child (real enforcement).
 // Non-sandboxed path: posix_spawnp for fast compilation without limits.
-// Wall-clock timeout enforced via gRPC Alarm.
+// Wall-clock timeout enforced by the output loop's own deadline.
 // -----------------------------------------------------------------------------
 
 // Formats the command trace with appropriate coloring.
@@ -95,24 +145,76 @@ void FormatCommandTrace(std::stringstream& trace, bool sandboxed,
         << context << ": " << cmd_str << "\n";
 }
 
-// Creates pipe pairs for stdin, stdout, and stderr.
-absl::Status CreatePipes(PipePair& stdin_p, PipePair& stdout_p,
-                         PipePair& stderr_p, std::stringstream& trace) {
-  if (!stdin_p.Create() || !stdout_p.Create() || !stderr_p.Create()) {
+// Creates pipe pairs for stdout and stderr, enlarged to
+// --sandbox_pipe_buffer_bytes so a chatty program blocks, and wakes the
+// reader, less often.
+absl::Status CreatePipes(PipePair& stdout_p, PipePair& stderr_p,
+                         std::stringstream& trace) {
+  if (!stdout_p.Create() || !stderr_p.Create()) {
     trace << "[FAIL] Pipe creation failed\n";
     return absl::InternalError("Pipe creation failed");
   }
+  if (const uint64_t capacity = absl::GetFlag(FLAGS_sandbox_pipe_buffer_bytes);
+      capacity > 0) {
+    // Best effort: a refused resize keeps the 64 KB default.
+    (void)stdout_p.SetCapacity(capacity);
+    (void)stderr_p.SetCapacity(capacity);
+  }
   return absl::OkStatus();
 }
 
-// Writes input data to the stdin pipe.
-void FeedStdin(PipePair& stdin_p, absl::string_view input,
-               std::stringstream& trace) {
-  if (!input.empty()) {
-    trace << absl::StrFormat("[INFO] Feeding %zu bytes to stdin\n", input.size());
-    write(stdin_p.WriteFd(), input.data(), input.size());
+// Default pipe capacity on Linux; stdin pipes are only resized above it.
+constexpr size_t kDefaultPipeBytes = 64 * 1024;
+
+// Returns the descriptor the child reads its stdin from, with all of the input
+// already available on it, so nothing has to be fed while the child runs. A
+// file-backed input is opened read-only and given to the child as is.
+// Input up to --sandbox_stdin_pipe_max_bytes is written into a pipe sized to
+// hold it; the write is non-blocking, and if the pipe cannot take it all,
+// or the input is larger, it is served from a memfd instead.
+absl::StatusOr<FileDescriptor> PrepareStdin(const StdinSource& stdin_source,
+                                            std::stringstream& trace) {
+  if (stdin_source.IsFile()) {
+    trace << absl::StrFormat("[INFO] Serving stdin from %s\n",
+                             stdin_source.file_path);
+    FileDescriptor file(open(stdin_source.file_path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!file.IsValid()) {
+      const absl::Status status =
+          absl::ErrnoToStatus(errno, "Failed to open stdin file");
+      trace << "[FAIL] " << status.message() << "\n";
+      return status;
+    }
+    return file;
+  }
+  const absl::string_view input = stdin_source.data;
+  if (input.size() <= absl::GetFlag(FLAGS_sandbox_stdin_pipe_max_bytes)) {
+    PipePair stdin_p;
+    if (!stdin_p.Create()) {
+      trace << "[FAIL] Pipe creation failed\n";
+      return absl::InternalError("Pipe creation failed");
+    }
+    if (input.size() > kDefaultPipeBytes) {
+      (void)stdin_p.SetCapacity(input.size());
+    }
+    ProcessRunner::SetNonBlocking(stdin_p.WriteFd());
+    const ssize_t n =
+        input.empty() ? 0 : write(stdin_p.WriteFd(), input.data(), input.size());
+    if (n >= 0 && static_cast<size_t>(n) == input.size()) {
+      if (!input.empty()) {
+        trace << absl::StrFormat("[INFO] Feeding %zu bytes to stdin\n",
+                                 input.size());
+      }
+      stdin_p.CloseWrite();
+      return FileDescriptor(stdin_p.ReleaseRead());
+    }
+  }
+  trace << absl::StrFormat("[INFO] Serving %zu bytes of stdin from a file\n",
+                           input.size());
+  absl::StatusOr<FileDescriptor> file = ProcessRunner::CreateInputFile(input);
+  if (!file.ok()) {
+    trace << "[FAIL] " << file.status().message() << "\n";
   }
-  stdin_p.CloseWrite();
+  return file;
 }
 
 // Formats the process exit error message.
@@ -148,75 +250,231 @@ ExecutionResult BuildExecutionResult(int status, const struct rusage& usage,
   return res;
 }
 
-absl::StatusOr<ExecutionResult> RunCommandWithSandbox(
+// Checks the program's stdout against `verifier` instead of passing it on,
+// killing the program's process group at the first difference. stderr is
+// still forwarded to `callback`.
+OutputCallback VerifyStdout(OutputCallback callback, OutputVerifier* verifier,
+                            pid_t pid) {
+  return [callback = std::move(callback), verifier, pid](
+             absl::string_view out, absl::string_view err) {
+    if (!out.empty() && !verifier->diverged() && !verifier->Consume(out)) {
+      ProcessRunner::KillProcessGroup(pid);
+    }
+    if (!err.empty() && callback) {
+      callback("", err);
+    }
+  };
+}
+
+// Finishes `verifier` into `res`. A wrong answer is what failed the run when
+// the verifier stopped it or the program otherwise succeeded; a program that
+// crashed or timed out keeps that error.
+void RecordVerdict(OutputVerifier& verifier, ExecutionResult& res) {
+  const bool stopped = verifier.diverged();
+  res.verdict = verifier.Finish();
+  if (res.verdict.kind != OutputVerdict::Kind::kWrongAnswer ||
+      (!stopped && !res.success)) {
+    return;
+  }
+  res.success = false;
+  res.error_message = absl::StrFormat(
+      "Wrong answer: output differs from expected at line %d",
+      res.verdict.line);
+}
+
+// A spawned command whose stdin is fully available to it; only its output
+// remains.
+struct LaunchedCommand {
+  ScopedProcess process;
+  PipePair stdout_p;
+  PipePair stderr_p;
+  absl::Time start;
+  absl::Time deadline = absl::InfiniteFuture();
+};
+
+// With a `fork_server`, the command is started by it when possible, with
+// argv.back() (the binary itself, or the script for the Python zygote) as
+// the target.
+absl::StatusOr<LaunchedCommand> LaunchCommand(
     absl::string_view context, const std::vector<std::string>& argv,
-    absl::string_view input, bool sandboxed, OutputCallback callback,
-    std::stringstream& trace) {
+    const StdinSource& input, bool sandboxed, const ResourceLimits& limits,
+    std::stringstream& trace, ForkServer* fork_server) {
   const std::string cmd_str = absl::StrJoin(argv, " ");
   FormatCommandTrace(trace, sandboxed, context, cmd_str);
   LOG(INFO) << (sandboxed ? "Sandboxed" : "Local") << " exec: " << cmd_str;
 
-  PipePair stdin_p, stdout_p, stderr_p;
-  ABSL_RETURN_IF_ERROR(CreatePipes(stdin_p, stdout_p, stderr_p, trace));
+  ABSL_ASSIGN_OR_RETURN(FileDescriptor stdin_fd, PrepareStdin(input, trace));
+  LaunchedCommand launched;
+  // A worker's warm state has the pipes and the toolchain's path ready.
+  SandboxWarmState* const warm = SandboxWarmState::Current();
+  if (warm == nullptr || !warm->TakePipes(launched.stdout_p, launched.stderr_p)) {
+    ABSL_RETURN_IF_ERROR(
+        CreatePipes(launched.stdout_p, launched.stderr_p, trace));
+  }
+
+  launched.start = absl::Now();
+
+  // Sandboxed runs on a worker with namespaces join them. Fork servers
+  // cannot place their children there, so those runs exec instead.
+  ResourceLimits joined_limits;
+  const ResourceLimits* spawn_limits = &limits;
+  if (sandboxed && warm != nullptr && warm->namespaces() != nullptr) {
+    joined_limits = limits;
+    joined_limits.namespaces = &warm->namespaces()->join();
+    spawn_limits = &joined_limits;
+    if (fork_server != nullptr) {
+      trace << "[INFO] Running in worker namespaces, not the fork server\n";
+      fork_server = nullptr;
+    }
+  }
 
-  const absl::Time start = absl::Now();
+  std::optional<pid_t> forked_pid;
+  if (fork_server != nullptr) {
+    absl::StatusOr<pid_t> forked =
+        fork_server->Spawn(stdin_fd.Get(), launched.stdout_p.WriteFd(),
+                           launched.stderr_p.WriteFd(), limits, argv.back());
+    if (forked.ok()) {
+      forked_pid = *forked;
+      trace << "[INFO] Forked from fork server\n";
+    } else {
+      trace << "[WARN] Fork server unavailable, exec'ing instead: "
+            << forked.status().message() << "\n";
+    }
+  }
   
   // Spawn the child process.
-  //   sandboxed=false → posix_spawnp (fast, no rlimits — used for compilation)
-  //   sandboxed=true  → fork+exec with setrlimit in child (real enforcement)
-  ABSL_ASSIGN_OR_RETURN(const pid_t raw_pid, ProcessRunner::SpawnProcess(
-      absl::MakeSpan(argv),
-      stdin_p.ReadFd(),
-      stdout_p.WriteFd(),
-      stderr_p.WriteFd(),
-      sandboxed));
+  //   fork server → fork of the already loaded program (no exec)
+  //   namespaces  → clone into the worker's namespaces + exec
+  //   no rlimits  → posix_spawnp (fast)
+  //   rlimits     → clone(CLONE_VFORK)/fork + exec with setrlimit in child
+  //                 (real enforcement)
+  pid_t raw_pid = -1;
+  if (forked_pid.has_value()) {
+    raw_pid = *forked_pid;
+  } else {
+    const std::string* resolved =
+        warm != nullptr ? warm->ResolvedPath(argv.front()) : nullptr;
+    std::vector<std::string> resolved_argv;
+    if (resolved != nullptr) {
+      resolved_argv = argv;
+      resolved_argv.front() = *resolved;
+    }
+    ABSL_ASSIGN_OR_RETURN(raw_pid, ProcessRunner::SpawnProcess(
+        absl::MakeSpan(resolved != nullptr ? resolved_argv : argv),
+        stdin_fd.Get(),
+        launched.stdout_p.WriteFd(),
+        launched.stderr_p.WriteFd(),
+        *spawn_limits));
+  }
   
   // Wrap the process in RAII to ensure cleanup on any exit path
-  ScopedProcess process(raw_pid);
+  launched.process = ScopedProcess(raw_pid);
   
-  stdin_p.CloseRead();
-  stdout_p.CloseWrite();
-  stderr_p.CloseWrite();
-  FeedStdin(stdin_p, input, trace);
-
-  // Use gRPC Alarm-based timeout manager instead of fork-based watcher
-  auto timed_out_flag = std::make_shared<std::atomic<bool>>(false);
-  std::unique_ptr<ProcessTimeoutManager> timeout_manager;
-
-  if (sandboxed) {
-    const absl::Duration timeout = absl::Seconds(
-        absl::GetFlag(FLAGS_sandbox_wall_clock_timeout_seconds));
-    timeout_manager = std::make_unique<ProcessTimeoutManager>(
-        process.Get(), timeout, [timed_out_flag, pid = process.Get()]() {
-          timed_out_flag->store(true);
-          if (kill(pid, 0) == 0) {
-            kill(pid, SIGKILL);
-          }
-        });
-    timeout_manager->Start();
-    trace << absl::StrFormat("[INFO] gRPC Alarm timeout armed for %ld seconds\n",
-                             absl::ToInt64Seconds(timeout));
-  }
-
-  bool truncated = false;
-  ProcessRunner::ReadOutput(stdout_p.ReadFd(), stderr_p.ReadFd(), process.Get(), 
-                            callback, truncated);
-
-  if (timeout_manager) {
-    timeout_manager->Cancel();
+  stdin_fd.Reset();
+  launched.stdout_p.CloseWrite();
+  launched.stderr_p.CloseWrite();
+
+  // The wall-clock deadline is measured from spawn and enforced by whichever
+  // event loop reads the child's output.
+  if (limits.wall_timeout > absl::ZeroDuration()) {
+    launched.deadline = launched.start + limits.wall_timeout;
+    trace << absl::StrFormat("[INFO] Wall-clock deadline armed for %s\n",
+                             absl::FormatDuration(limits.wall_timeout));
   }
+  return launched;
+}
+
+// With a `verifier`, stdout is checked against it rather than passed to
+// `callback`; see VerifyStdout(). With a `cancellation`, the command is
+// attached to it until it is reaped.
+absl::StatusOr<ExecutionResult> RunCommandWithSandbox(
+    absl::string_view context, const std::vector<std::string>& argv,
+    const StdinSource& input, bool sandboxed, const ResourceLimits& limits,
+    OutputCallback callback, std::stringstream& trace,
+    OutputVerifier* verifier = nullptr, ForkServer* fork_server = nullptr,
+    RunCancellation* cancellation = nullptr) {
+  ABSL_ASSIGN_OR_RETURN(
+      LaunchedCommand launched,
+      LaunchCommand(context, argv, input, sandboxed, limits, trace,
+                    fork_server));
+  if (cancellation != nullptr) {
+    cancellation->Attach(launched.process.Get());
+  }
+  if (verifier != nullptr) {
+    callback = VerifyStdout(std::move(callback), verifier,
+                            launched.process.Get());
+  }
+
+  const ProcessRunner::ReadOutcome outcome = ProcessRunner::ReadOutput(
+      launched.stdout_p.ReadFd(), launched.stderr_p.ReadFd(),
+      launched.process.Get(), launched.deadline, callback);
 
   int status = 0;
   struct rusage usage {};
   
   // Wait for the process and collect resource usage
-  wait4(process.Get(), &status, 0, &usage);
+  if (cancellation != nullptr) {
+    cancellation->Detach(launched.process.Get());
+  }
+  wait4(launched.process.Get(), &status, 0, &usage);
   
   // Release ownership since we've reaped it
-  (void)process.Release();
+  (void)launched.process.Release();
 
-  return BuildExecutionResult(status, usage, start, timed_out_flag->load(),
-                              truncated);
+  ExecutionResult res = BuildExecutionResult(
+      status, usage, launched.start, outcome.timed_out, outcome.truncated);
+  if (verifier != nullptr) {
+    RecordVerdict(*verifier, res);
+  }
+  return res;
+}
+
+// Like RunCommandWithSandbox(), but hands the running command to
+// `supervisor` and delivers the result to `done` from its thread.
+void RunCommandSupervised(SandboxSupervisor& supervisor,
+                          absl::string_view context,
+                          const std::vector<std::string>& argv,
+                          const StdinSource& input, bool sandboxed,
+                          const ResourceLimits& limits, OutputCallback callback,
+                          OutputVerifier* verifier,
+                          RunCancellation* cancellation,
+                          std::stringstream& trace, ForkServer* fork_server,
+                          ResultCallback done) {
+  absl::StatusOr<LaunchedCommand> launched = LaunchCommand(
+      context, argv, input, sandboxed, limits, trace, fork_server);
+  if (!launched.ok()) {
+    done(launched.status());
+    return;
+  }
+
+  SandboxSupervisor::Child child;
+  child.pid = launched->process.Release();
+  child.stdout_fd = launched->stdout_p.ReleaseRead();
+  child.stderr_fd = launched->stderr_p.ReleaseRead();
+  child.deadline = launched->deadline;
+  child.cancellation = cancellation;
+  if (cancellation != nullptr) {
+    cancellation->Attach(child.pid);
+  }
+  child.callback = verifier != nullptr
+                       ? VerifyStdout(std::move(callback), verifier, child.pid)
+                       : std::move(callback);
+  const absl::Time start = launched->start;
+  // `done` is consumed only on success; Watch() fails before taking it.
+  auto shared_done = std::make_shared<ResultCallback>(std::move(done));
+  const absl::Status watched = supervisor.Watch(
+      std::move(child),
+      [start, verifier, shared_done](const SandboxSupervisor::Exit& exit) {
+        ExecutionResult res = BuildExecutionResult(
+            exit.status, exit.usage, start, exit.timed_out, exit.truncated);
+        if (verifier != nullptr) {
+          RecordVerdict(*verifier, res);
+        }
+        (*shared_done)(std::move(res));
+      });
+  if (!watched.ok()) {
+    (*shared_done)(watched);
+  }
 }
 
 // Formats the result trace with appropriate coloring based on status.
@@ -259,85 +517,92 @@ absl::StatusOr<ExecutionResult> HandleExecutionResult(
   return res;
 }
 
-}  // namespace
-
-// -----------------------------------------------------------------------------
-// ProcessTimeoutManager Implementation
-// -----------------------------------------------------------------------------
-
-struct ProcessTimeoutState {
-  ProcessTimeoutState(absl::Duration timeout, ProcessTimeoutManager::TimeoutCallback callback)
-      : timeout(timeout), callback(std::move(callback)) {}
-
-  absl::Duration timeout;
-  ProcessTimeoutManager::TimeoutCallback callback;
-  grpc::Alarm alarm;
-  std::mutex mutex;
-  bool started = false;
-  bool triggered = false;
-  bool cancelled = false;
-};
-
-ProcessTimeoutManager::ProcessTimeoutManager(pid_t pid, absl::Duration timeout,
-                                             TimeoutCallback callback)
-    : timeout_(timeout), callback_(std::move(callback)) {
-  (void)pid;
-  state_ = std::make_shared<ProcessTimeoutState>(timeout, std::move(callback_));
-}
-
-ProcessTimeoutManager::~ProcessTimeoutManager() { Cancel(); }
+// Returns the `--version` banner of `compiler`, memoized per process.
+// The banner is part of every artifact key, so binaries built by different
+// compilers never share one. Being memoized, it is read once per process: a
+// toolchain upgraded on the host is only noticed after a restart, which also
+// empties the artifact cache.
+std::string ResolveCompilerVersion(const std::string& compiler) {
+  static absl::Mutex mutex(absl::kConstInit);
+  static auto* const versions =
+      new absl::flat_hash_map<std::string, std::string>();
+  {
+    absl::MutexLock lock(&mutex);
+    if (const auto it = versions->find(compiler); it != versions->end()) {
+      return it->second;
+    }
+  }
 
-void ProcessTimeoutManager::Start() {
-  std::lock_guard<std::mutex> lock(state_->mutex);
-  if (state_->started || state_->cancelled) {
-    return;
+  std::string banner;
+  std::stringstream probe_trace;
+  const absl::StatusOr<ExecutionResult> res = RunCommandWithSandbox(
+      "CompilerVersion", {compiler, "--version"}, "", false, ResourceLimits{},
+      [&banner](absl::string_view out, absl::string_view) {
+        banner.append(out);
+      },
+      probe_trace);
+  // An unresolvable version still yields a usable (if coarser) key; it is
+  // not cached so a transient failure is retried on the next compile.
+  if (!res.ok() || !res->success || banner.empty()) {
+    return "unknown";
   }
-  state_->started = true;
 
-  auto deadline = absl::ToChronoTime(absl::Now() + state_->timeout);
-  
-  std::weak_ptr<ProcessTimeoutState> weak_state = state_;
-  state_->alarm.Set(deadline, [weak_state](bool ok) {
-    auto state = weak_state.lock();
-    if (!state) {
-      return;
-    }
-    {
-      std::lock_guard<std::mutex> lock(state->mutex);
-      if (state->cancelled || !ok) {
-        return;
-      }
-      state->triggered = true;
-    }
-    if (state->callback) {
-      state->callback();
-    }
-  });
+  absl::MutexLock lock(&mutex);
+  return versions->try_emplace(compiler, absl::StripAsciiWhitespace(banner))
+      .first->second;
 }
 
-void ProcessTimeoutManager::Cancel() {
-  std::lock_guard<std::mutex> lock(state_->mutex);
-  if (state_->cancelled || state_->triggered) {
-    return;
+// Background half of tiered compilation: rebuilds `code` with the optimized
+// profile, publishes it under `optimized_key`, and retires the fast build.
+bool BuildOptimizedArtifact(ArtifactCacheInterface& cache,
+                            CompileGovernor* governor,
+                            const std::string& compiler,
+                            const std::vector<std::string>& flags,
+                            const std::string& code,
+                            const std::string& extension,
+                            const std::string& fast_key,
+                            const std::string& optimized_key) {
+  const absl::StatusOr<std::string> source_path =
+      TempFileManager::WriteTempFile(extension, code);
+  if (!source_path.ok()) {
+    LOG(WARNING) << "Promotion failed: " << source_path.status();
+    return false;
   }
-  state_->cancelled = true;
-  state_->alarm.Cancel();
-}
+  const std::string binary_path = *source_path + ".bin";
+  absl::Cleanup cleanup = [&] {
+    unlink(source_path->c_str());
+    unlink(binary_path.c_str());
+  };
 
-bool ProcessTimeoutManager::IsTriggered() const {
-  std::lock_guard<std::mutex> lock(state_->mutex);
-  return state_->triggered;
-}
+  std::vector<std::string> argv = {compiler};
+  argv.insert(argv.end(), flags.begin(), flags.end());
+  argv.insert(argv.end(), {*source_path, "-o", binary_path});
 
-bool ProcessTimeoutManager::IsCancelled() const {
-  std::lock_guard<std::mutex> lock(state_->mutex);
-  return state_->cancelled;
+  std::stringstream trace;
+  std::optional<CompileGovernor::Permit> permit;
+  if (governor != nullptr) {
+    permit.emplace(governor->Acquire());
+  }
+  const absl::StatusOr<ExecutionResult> res = RunCommandWithSandbox(
+      "Promote", argv, "", false, ProcessRunner::CompileLimits(),
+      [](absl::string_view, absl::string_view) {}, trace);
+  permit.reset();
+  if (!res.ok() || !res->success) {
+    LOG(WARNING) << "Optimized rebuild failed for " << fast_key;
+    return false;
+  }
+  if (const absl::Status stored = cache.Store(optimized_key, binary_path);
+      !stored.ok()) {
+    LOG(WARNING) << "Optimized artifact not cached: " << stored;
+    return false;
+  }
+  // Lookups try the optimized key first, so the fast build is now dead
+  // weight in the byte budget.
+  (void)cache.Erase(fast_key);
+  return true;
 }
 
-void ProcessTimeoutManager::OnAlarmTriggered(bool ok) {
-  // This is no longer used as we use a lambda in Start()
-  (void)ok;
-}
+}  // namespace
 
 // -----------------------------------------------------------------------------
 // ExecutionPipeline Implementation
@@ -364,8 +629,23 @@ absl::StatusOr<ExecutionResult> ExecutionPipeline::Run(ExecutionContext& context
   if (!head_) {
     return context.result;
   }
-  
-  const absl::Status status = head_->Execute(context);
+  return Finish(context, head_->Execute(context));
+}
+
+void ExecutionPipeline::RunAsync(ExecutionContext& context,
+                                 ResultCallback done) {
+  if (!head_) {
+    done(context.result);
+    return;
+  }
+  head_->ExecuteAsync(context, [&context, done = std::move(done)](
+                                   absl::Status status) mutable {
+    done(Finish(context, status));
+  });
+}
+
+absl::StatusOr<ExecutionResult> ExecutionPipeline::Finish(
+    ExecutionContext& context, const absl::Status& status) {
   if (!status.ok()) {
     // Error handling is now done within the steps or decorators, but we ensure
     // the result error message is set if it's empty.
@@ -376,6 +656,7 @@ absl::StatusOr<ExecutionResult> ExecutionPipeline::Run(ExecutionContext& context
     return status;
   }
   
+  context.result.diagnostics = std::move(context.diagnostics);
   context.result.backend_trace = context.trace.str();
   return context.result;
 }
@@ -385,8 +666,12 @@ absl::StatusOr<ExecutionResult> ExecutionPipeline::Run(ExecutionContext& context
 // -----------------------------------------------------------------------------
 
 absl::Status CreateSourceFileStep::ExecuteStep(ExecutionContext& context) {
-  ABSL_ASSIGN_OR_RETURN(context.source_file_path,
-                        TempFileManager::WriteTempFile(extension_, context.code));
+  SandboxWarmState* const warm = SandboxWarmState::Current();
+  ABSL_ASSIGN_OR_RETURN(
+      context.source_file_path,
+      warm != nullptr && !warm->workspace().empty()
+          ? warm->WriteFile(extension_, context.code)
+          : TempFileManager::WriteTempFile(extension_, context.code));
   context.trace << "[OK] Created source file: " << context.source_file_path
                 << "\n";
   context.AddCleanupPath(context.source_file_path);
@@ -394,9 +679,31 @@ absl::Status CreateSourceFileStep::ExecuteStep(ExecutionContext& context) {
 }
 
 absl::Status CompileStep::ExecuteStep(ExecutionContext& context) {
+  TieredCompilationManager* const tiering = services_.tiering.get();
+
+  // Effective flags: the toolchain's standard flags, the fast-tier profile
+  // when tiering, and any PCH selection. All of them are part of the
+  // artifact key below.
+  std::vector<std::string> flags = compiler_flags_;
+  if (tiering != nullptr) {
+    const auto& fast_flags =
+        tiering->FlagsFor(TieredCompilationManager::Tier::kFast);
+    flags.insert(flags.end(), fast_flags.begin(), fast_flags.end());
+  }
+  if (services_.pch_manager) {
+    if (auto pch = services_.pch_manager->Select(compiler_, flags,
+                                                  context.code)) {
+      context.trace << "[INFO] Precompiled header: " << pch->name << "\n";
+      flags.insert(flags.end(), pch->flags.begin(), pch->flags.end());
+    }
+  }
+  if (services_.fork_server_stub) {
+    flags.push_back(services_.fork_server_stub->object_path());
+  }
+
   // Build the compile command
   std::vector<std::string> argv = {compiler_};
-  for (const auto& flag : compiler_flags_) {
+  for (const auto& flag : flags) {
     argv.push_back(flag);
   }
   argv.push_back(context.source_file_path);
@@ -408,95 +715,425 @@ absl::Status CompileStep::ExecuteStep(ExecutionContext& context) {
   context.trace << "[INFO] Binary target: " << context.binary_path << "\n";
   context.AddCleanupPath(context.binary_path);
 
-  // First compile attempt (null callback to suppress output)
-  auto null_cb = [](absl::string_view, absl::string_view) {};
+  ArtifactCacheInterface* const artifact_cache = services_.artifact_cache.get();
+  absl::StatusOr<std::string> artifact_key =
+      absl::FailedPreconditionError("Artifact cache disabled");
+  absl::StatusOr<std::string> optimized_key =
+      absl::FailedPreconditionError("Tiered compilation disabled");
+  if (artifact_cache != nullptr) {
+    const std::string compiler_version = ResolveCompilerVersion(compiler_);
+    artifact_key = ArtifactCacheInterface::ComputeKey(
+        toolchain_id_, compiler_version, flags, context.code);
+    if (tiering != nullptr) {
+      optimized_key = ArtifactCacheInterface::ComputeKey(
+          toolchain_id_, compiler_version, OptimizedFlags(), context.code);
+    }
+  }
+
+  auto reuse_artifact = [&]() {
+    // A promoted (optimized) build supersedes the fast one.
+    if (optimized_key.ok() &&
+        artifact_cache->Fetch(*optimized_key, context.binary_path).ok()) {
+      context.trace << "\033[92m[CACHE]\033[0m Reusing optimized artifact "
+                    << *optimized_key << "\n";
+      tiering->RecordCacheHit(TieredCompilationManager::Tier::kOptimized);
+      return true;
+    }
+    if (artifact_key.ok() &&
+        artifact_cache->Fetch(*artifact_key, context.binary_path).ok()) {
+      context.trace << "\033[92m[CACHE]\033[0m Reusing compiled artifact "
+                    << *artifact_key << "\n";
+      if (tiering != nullptr) {
+        tiering->RecordCacheHit(TieredCompilationManager::Tier::kFast);
+        if (optimized_key.ok()) {
+          MaybeSchedulePromotion(context, *artifact_key, *optimized_key);
+        }
+      }
+      return true;
+    }
+    return false;
+  };
+  if (reuse_artifact()) {
+    context.result.success = true;
+    return absl::OkStatus();
+  }
+
+  // If a speculative compile of this source is already running, wait for it
+  // rather than starting a second compiler. Should it fail, fall through and
+  // compile here so the client gets this run's diagnostics.
+  std::unique_ptr<CompileSingleFlight::Leader> leader;
+  if (artifact_key.ok() && services_.single_flight) {
+    leader = services_.single_flight->JoinOrLead(*artifact_key);
+    if (leader == nullptr) {
+      context.trace << "[INFO] Joined in-flight compile\n";
+      if (reuse_artifact()) {
+        context.result.success = true;
+        return absl::OkStatus();
+      }
+    }
+  }
+
+  // Single compile with output buffered: a successful build stays silent,
+  // while a failed one replays the compiler's output to the client.
+  std::string compiler_stdout;
+  std::string compiler_stderr;
+  auto buffer_cb = [&](absl::string_view out, absl::string_view err) {
+    compiler_stdout.append(out);
+    compiler_stderr.append(err);
+  };
+  std::optional<CompileGovernor::Permit> permit;
+  if (services_.governor) {
+    const absl::Time queued = absl::Now();
+    permit.emplace(services_.governor->Acquire());
+    if (const absl::Duration waited = absl::Now() - queued;
+        waited >= absl::Milliseconds(1)) {
+      context.trace << "[INFO] Waited " << absl::FormatDuration(waited)
+                    << " for a compile slot\n";
+    }
+  }
   ABSL_ASSIGN_OR_RETURN(const ExecutionResult comp_res,
                         RunCommandWithSandbox("Compile", argv, "", false,
-                                              null_cb, context.trace));
+                                              ProcessRunner::CompileLimits(),
+                                              buffer_cb, context.trace));
+  permit.reset();
   
   ABSL_ASSIGN_OR_RETURN(const ExecutionResult handled_res,
                         HandleExecutionResult("Compile", comp_res, context.trace));
 
+  const std::string display_name = absl::StrCat(
+      kDiagnosticSourceStem,
+      std::filesystem::path(context.source_file_path).extension().string());
+  context.diagnostics = ParseCompilerDiagnostics(
+      absl::StrCat(compiler_stdout, compiler_stderr), context.source_file_path,
+      display_name);
+
   if (!handled_res.success) {
-    context.trace << "[FAIL] Compilation failed - capturing detailed errors\n";
-    // Re-run with actual callback to capture error output
-    ABSL_ASSIGN_OR_RETURN(const ExecutionResult err_res,
-                          RunCommandWithSandbox("Compile", argv, "", false,
-                                                context.callback, context.trace));
-    
-    ABSL_ASSIGN_OR_RETURN(const ExecutionResult handled_err,
-                          HandleExecutionResult("Compile", err_res, context.trace));
-    
-    if (handled_err.error_message.empty()) {
-      context.SetError("Compilation failed");
-    } else {
-      context.SetError(handled_err.error_message);
+    context.trace << "[FAIL] Compilation failed\n";
+    if (context.callback &&
+        (!compiler_stdout.empty() || !compiler_stderr.empty())) {
+      context.callback(compiler_stdout, compiler_stderr);
+    }
+    context.result = handled_res;
+    context.SetError(absl::StrCat("Compilation failed: ",
+                                  handled_res.error_message));
+    // A compile error is the request's answer, not an engine failure.
+    context.result_final = true;
+    return absl::OkStatus();
+  }
+
+  if (artifact_key.ok()) {
+    if (const absl::Status stored =
+            artifact_cache->Store(*artifact_key, context.binary_path);
+        !stored.ok()) {
+      context.trace << "[WARN] Artifact not cached: " << stored.message()
+                    << "\n";
+    }
+  }
+  if (tiering != nullptr) {
+    tiering->RecordFastCompile();
+    if (artifact_key.ok() && optimized_key.ok()) {
+      MaybeSchedulePromotion(context, *artifact_key, *optimized_key);
     }
-    context.result = handled_err;
-    return absl::InternalError(context.result.error_message);
   }
 
   context.result = handled_res;
   return absl::OkStatus();
 }
 
-absl::Status RunProcessStep::ExecuteStep(ExecutionContext& context) {
-  std::vector<std::string> argv;
-  
+std::vector<std::string> CompileStep::OptimizedFlags() const {
+  std::vector<std::string> flags = compiler_flags_;
+  const auto& optimized = services_.tiering->FlagsFor(
+      TieredCompilationManager::Tier::kOptimized);
+  flags.insert(flags.end(), optimized.begin(), optimized.end());
+  if (services_.fork_server_stub) {
+    flags.push_back(services_.fork_server_stub->object_path());
+  }
+  return flags;
+}
+
+namespace {
+
+// Compiles argv[1] into argv[2], naming the code main.py. Unchecked-hash
+// bytecode carries no source mtime, so one source always yields the same
+// file. Part of the artifact key: changing it retires stored bytecode.
+constexpr char kCompileBytecodeSource[] =
+    "import py_compile as c, sys; c.compile(sys.argv[1], sys.argv[2], "
+    "'main.py', True, invalidation_mode=c.PycInvalidationMode.UNCHECKED_HASH)";
+
+}  // namespace
+
+absl::Status CompileBytecodeStep::ExecuteStep(ExecutionContext& context) {
+  ArtifactCacheInterface* const artifact_cache = services_.artifact_cache.get();
+  if (artifact_cache == nullptr ||
+      context.code.size() < absl::GetFlag(FLAGS_python_bytecode_min_bytes)) {
+    return absl::OkStatus();
+  }
+  // Every failure below leaves the source to be run as it is.
+  const absl::StatusOr<std::string> key = ArtifactCacheInterface::ComputeKey(
+      toolchain_id_, ResolveCompilerVersion(interpreter_),
+      {kCompileBytecodeSource}, context.code);
+  if (!key.ok()) {
+    context.trace << "[WARN] Bytecode skipped: " << key.status().message()
+                  << "\n";
+    return absl::OkStatus();
+  }
+  char dir_template[] = "/tmp/dcodex_XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    context.trace << "[WARN] Bytecode skipped: " << strerror(errno) << "\n";
+    return absl::OkStatus();
+  }
+  const std::string dir = dir_template;
+  const std::string source_path = absl::StrCat(dir, "/main.py");
+  const std::string bytecode_path = absl::StrCat(dir, "/main.pyc");
+  context.AddCleanupPath(source_path);
+  context.AddCleanupPath(bytecode_path);
+  context.AddCleanupPath(dir);
+  if (link(context.source_file_path.c_str(), source_path.c_str()) != 0) {
+    context.trace << "[WARN] Bytecode skipped: " << strerror(errno) << "\n";
+    return absl::OkStatus();
+  }
+
+  if (artifact_cache->Fetch(*key, bytecode_path).ok()) {
+    context.trace << "\033[92m[CACHE]\033[0m Reusing bytecode " << *key
+                  << "\n";
+  } else {
+    std::optional<CompileGovernor::Permit> permit;
+    if (services_.governor) {
+      permit.emplace(services_.governor->Acquire());
+    }
+    const absl::StatusOr<ExecutionResult> compiled = RunCommandWithSandbox(
+        "CompileBytecode",
+        {interpreter_, "-c", kCompileBytecodeSource, source_path,
+         bytecode_path},
+        "", false, ProcessRunner::CompileLimits(),
+        [](absl::string_view, absl::string_view) {}, context.trace);
+    permit.reset();
+    if (!compiled.ok() || !compiled->success) {
+      context.trace << "[INFO] Bytecode not compiled; running the source\n";
+      return absl::OkStatus();
+    }
+    if (const absl::Status stored = artifact_cache->Store(*key, bytecode_path);
+        !stored.ok()) {
+      context.trace << "[WARN] Bytecode not cached: " << stored.message()
+                    << "\n";
+    }
+  }
+  context.source_file_path = bytecode_path;
+  return absl::OkStatus();
+}
+
+void CompileStep::MaybeSchedulePromotion(ExecutionContext& context,
+                                         const std::string& fast_key,
+                                         const std::string& optimized_key) {
+  // A compile-ahead is not a use; the execution that follows counts itself.
+  if (context.compile_only || !services_.tiering->RecordUse(fast_key)) {
+    return;
+  }
+  context.trace << "[INFO] Source is hot; scheduling optimized rebuild\n";
+
+  // The task outlives this request, so it captures copies and owning
+  // references only.
+  services_.tiering->SchedulePromotion(
+      fast_key,
+      [cache = services_.artifact_cache, governor = services_.governor,
+       compiler = compiler_,
+       argv_flags = OptimizedFlags(), code = context.code,
+       extension = std::filesystem::path(context.source_file_path)
+                       .extension()
+                       .string(),
+       fast_key, optimized_key]() {
+        return BuildOptimizedArtifact(*cache, governor.get(), compiler,
+                                      argv_flags, code,
+                                      extension, fast_key, optimized_key);
+      });
+}
+
+namespace {
+
+// Hands the program that `context` built at `path` over to a
+// PreparedProgram, which from then on owns the file and `extra_paths`, along
+// with the fork server its runs start from, if any.
+absl::StatusOr<PreparedBuild> TakePreparedProgram(
+    ExecutionContext& context, absl::StatusOr<ExecutionResult> built,
+    absl::string_view language_id, const std::string& path, bool compiled,
+    std::shared_ptr<ForkServer> fork_server = nullptr,
+    std::vector<std::string> extra_paths = {}) {
+  ABSL_RETURN_IF_ERROR(built.status());
+  PreparedBuild prepared;
+  prepared.result = *std::move(built);
+  if (prepared.result.success) {
+    context.KeepPath(path);
+    for (const std::string& extra_path : extra_paths) {
+      context.KeepPath(extra_path);
+    }
+    prepared.program = std::make_shared<const PreparedProgram>(
+        std::string(language_id), path, compiled, std::move(fork_server),
+        std::move(extra_paths));
+  }
+  return prepared;
+}
+
+// The command RunProcessStep runs for `context`.
+std::vector<std::string> RunArgv(const ExecutionContext& context) {
   // Determine what to run based on binary_path
   if (!context.binary_path.empty()) {
     // Compiled language: run the binary
-    argv = {context.binary_path};
-  } else {
-    // Interpreted language: run with interpreter
-    // Detect language from source file extension
-    if (context.source_file_path.ends_with(".py")) {
-      argv = {"python3", "-u", context.source_file_path};
-    } else {
-      // Default: try to execute directly
-      argv = {context.source_file_path};
-    }
+    return {context.binary_path};
+  }
+  // Interpreted language: run with interpreter
+  // Detect language from source file extension
+  if (context.source_file_path.ends_with(".py") ||
+      context.source_file_path.ends_with(".pyc")) {
+    return {"python3", "-u", context.source_file_path};
   }
+  // Default: try to execute directly
+  return {context.source_file_path};
+}
 
-  ABSL_ASSIGN_OR_RETURN(const ExecutionResult run_res,
-                        RunCommandWithSandbox("Run", argv, context.stdin_data,
-                                              sandboxed_, context.callback,
-                                              context.trace));
-  
-  ABSL_ASSIGN_OR_RETURN(const ExecutionResult handled_res,
-                        HandleExecutionResult("Run", run_res, context.trace));
+// Records a finished run on `context`; a failed program fails the step.
+absl::Status RecordRunResult(ExecutionContext& context,
+                             absl::StatusOr<ExecutionResult> run_res) {
+  ABSL_RETURN_IF_ERROR(run_res.status());
+  ABSL_ASSIGN_OR_RETURN(
+      const ExecutionResult handled_res,
+      HandleExecutionResult("Run", *std::move(run_res), context.trace));
   
   context.result = handled_res;
-  if (!context.result.success) {
+  // Like a compile error, a wrong answer is the request's answer rather than
+  // an engine failure, so the result and its verdict reach the caller.
+  if (!context.result.success &&
+      context.result.verdict.kind != OutputVerdict::Kind::kWrongAnswer) {
     return absl::InternalError(context.result.error_message);
   }
   return absl::OkStatus();
 }
 
+}  // namespace
+
+absl::Status RunProcessStep::ExecuteStep(ExecutionContext& context) {
+  return RecordRunResult(
+      context, RunCommandWithSandbox(
+                   "Run", RunArgv(context), context.Stdin(), sandboxed_,
+                   sandboxed_ ? ProcessRunner::SandboxLimits() : ResourceLimits{},
+                   context.callback, context.trace, context.output_verifier,
+                   context.fork_server,
+                   sandboxed_ ? context.cancellation : nullptr));
+}
+
+void RunProcessStep::ExecuteStepAsync(ExecutionContext& context,
+                                      Continuation done) {
+  if (context.supervisor == nullptr) {
+    done(ExecuteStep(context));
+    return;
+  }
+  RunCommandSupervised(
+      *context.supervisor, "Run", RunArgv(context), context.Stdin(),
+      sandboxed_,
+      sandboxed_ ? ProcessRunner::SandboxLimits() : ResourceLimits{},
+      context.callback, context.output_verifier,
+      sandboxed_ ? context.cancellation : nullptr, context.trace,
+      context.fork_server,
+      [&context, done = std::move(done)](
+          absl::StatusOr<ExecutionResult> run_res) mutable {
+        done(RecordRunResult(context, std::move(run_res)));
+      });
+}
+
 absl::Status FinalizeResultStep::ExecuteStep(ExecutionContext& context) {
   // Ensure trace is captured in result
   context.result.backend_trace = context.trace.str();
   return absl::OkStatus();
 }
 
+void ExecutionStrategy::RunPipelineAsync(
+    std::unique_ptr<ExecutionPipeline> pipeline, absl::string_view code,
+    const StdinSource& stdin_source, OutputVerifier* verifier,
+    RunCancellation* cancellation, OutputCallback callback,
+    SandboxSupervisor* supervisor, ResultCallback done) {
+  auto context =
+      std::make_unique<ExecutionContext>(code, stdin_source, std::move(callback));
+  context->output_verifier = verifier;
+  context->cancellation = cancellation;
+  context->supervisor = supervisor;
+  RunPipelineAsync(std::move(pipeline), std::move(context), std::move(done));
+}
+
+void ExecutionStrategy::RunPipelineAsync(
+    std::unique_ptr<ExecutionPipeline> pipeline,
+    std::unique_ptr<ExecutionContext> context, ResultCallback done) {
+  struct AsyncRun {
+    std::unique_ptr<ExecutionPipeline> pipeline;
+    std::unique_ptr<ExecutionContext> context;
+  };
+  auto run = std::make_shared<AsyncRun>(
+      AsyncRun{std::move(pipeline), std::move(context)});
+  run->pipeline->RunAsync(
+      *run->context, [run, done = std::move(done)](
+                         absl::StatusOr<ExecutionResult> result) mutable {
+        done(std::move(result));
+      });
+}
+
+void ExecutionStrategy::RunPrepared(const PreparedProgram& program,
+                                    const StdinSource& stdin_source,
+                                    OutputVerifier* verifier,
+                                    RunCancellation* cancellation,
+                                    OutputCallback callback,
+                                    SandboxSupervisor* supervisor,
+                                    ResultCallback done) {
+  auto context =
+      std::make_unique<ExecutionContext>("", stdin_source, std::move(callback));
+  if (program.compiled()) {
+    context->binary_path = program.path();
+  } else {
+    context->source_file_path = program.path();
+  }
+  context->fork_server = program.fork_server();
+  context->output_verifier = verifier;
+  context->cancellation = cancellation;
+  context->supervisor = supervisor;
+  RunPipelineAsync(ExecutionPipelineBuilder()
+                       .AddRunProcessStep(true)
+                       .AddFinalizeResultStep(GetStrategyId())
+                       .Build(),
+                   std::move(context), std::move(done));
+}
+
 // -----------------------------------------------------------------------------
 // CompiledLanguageStrategy Implementation
 // Uses LanguageToolchainFactory for compiler/flag configuration.
 // -----------------------------------------------------------------------------
 CompiledLanguageStrategy::CompiledLanguageStrategy(
     std::unique_ptr<LanguageToolchainFactory> toolchain,
-    std::shared_ptr<CacheInterface> cache)
-    : toolchain_(std::move(toolchain)), cache_(std::move(cache)) {}
+    std::shared_ptr<CacheInterface> cache, CompilationServices services)
+    : toolchain_(std::move(toolchain)),
+      cache_(std::move(cache)),
+      services_(std::move(services)) {}
 
 absl::StatusOr<ExecutionResult> CompiledLanguageStrategy::Execute(
-    absl::string_view code, absl::string_view stdin_data,
+    absl::string_view code, const StdinSource& stdin_source,
+    OutputVerifier* verifier, RunCancellation* cancellation,
     OutputCallback callback) {
-  ExecutionContext context(code, stdin_data, std::move(callback));
+  ExecutionContext context(code, stdin_source, std::move(callback));
+  context.output_verifier = verifier;
+  context.cancellation = cancellation;
   
   auto pipeline = CreatePipeline(cache_);
   return pipeline->Run(context);
 }
 
+void CompiledLanguageStrategy::ExecuteAsync(absl::string_view code,
+                                            const StdinSource& stdin_source,
+                                            OutputVerifier* verifier,
+                                            RunCancellation* cancellation,
+                                            OutputCallback callback,
+                                            SandboxSupervisor* supervisor,
+                                            ResultCallback done) {
+  RunPipelineAsync(CreatePipeline(cache_), code, stdin_source, verifier,
+                   cancellation, std::move(callback), supervisor,
+                   std::move(done));
+}
+
 absl::string_view CompiledLanguageStrategy::GetStrategyId() const {
   return toolchain_->GetLanguageId();
 }
@@ -506,30 +1143,142 @@ std::unique_ptr<ExecutionPipeline> CompiledLanguageStrategy::CreatePipeline(
   return ExecutionPipelineBuilder()
       .WithCache(std::move(cache))
       .AddCreateSourceFileStep(toolchain_->GetFileExtension())
-      .AddCompileStep(toolchain_->GetExecutable(), toolchain_->GetStandardFlags())
+      .AddCompileStep(toolchain_->GetExecutable(), toolchain_->GetStandardFlags(),
+                      toolchain_->GetLanguageId(), services_)
       .AddRunProcessStep(true)
       .AddFinalizeResultStep(toolchain_->GetLanguageId())
       .Build();
 }
 
-CExecutionStrategy::CExecutionStrategy(std::shared_ptr<CacheInterface> cache)
-    : CompiledLanguageStrategy(LanguageToolchainFactory::CreateC(), std::move(cache)) {}
+absl::StatusOr<ExecutionResult> CompiledLanguageStrategy::Precompile(
+    absl::string_view code, OutputCallback callback) {
+  ExecutionContext context(code, "", std::move(callback));
+  context.compile_only = true;
+  auto pipeline = ExecutionPipelineBuilder()
+                      .AddCreateSourceFileStep(toolchain_->GetFileExtension())
+                      .AddCompileStep(toolchain_->GetExecutable(),
+                                      toolchain_->GetStandardFlags(),
+                                      toolchain_->GetLanguageId(), services_)
+                      .Build();
+  return pipeline->Run(context);
+}
+
+absl::StatusOr<PreparedBuild> CompiledLanguageStrategy::Prepare(
+    absl::string_view code, OutputCallback callback) {
+  ExecutionContext context(code, "", std::move(callback));
+  // The prepared binary is never swapped for a promoted build, so its uses
+  // are not counted towards one.
+  context.compile_only = true;
+  auto pipeline = ExecutionPipelineBuilder()
+                      .AddCreateSourceFileStep(toolchain_->GetFileExtension())
+                      .AddCompileStep(toolchain_->GetExecutable(),
+                                      toolchain_->GetStandardFlags(),
+                                      toolchain_->GetLanguageId(), services_)
+                      .Build();
+  absl::StatusOr<ExecutionResult> built = pipeline->Run(context);
+  // A binary linked with the stub is its own fork server.
+  std::shared_ptr<ForkServer> fork_server;
+  if (services_.fork_server_stub) {
+    fork_server = std::make_shared<ForkServer>(
+        std::vector<std::string>{context.binary_path});
+  }
+  return TakePreparedProgram(context, std::move(built), GetStrategyId(),
+                             context.binary_path, /*compiled=*/true,
+                             std::move(fork_server));
+}
 
-CppExecutionStrategy::CppExecutionStrategy(std::shared_ptr<CacheInterface> cache)
-    : CompiledLanguageStrategy(LanguageToolchainFactory::CreateCpp(), std::move(cache)) {}
+CExecutionStrategy::CExecutionStrategy(std::shared_ptr<CacheInterface> cache,
+                                       CompilationServices services)
+    : CompiledLanguageStrategy(LanguageToolchainFactory::CreateC(), std::move(cache),
+                               std::move(services)) {}
+
+CppExecutionStrategy::CppExecutionStrategy(std::shared_ptr<CacheInterface> cache,
+                                           CompilationServices services)
+    : CompiledLanguageStrategy(LanguageToolchainFactory::CreateCpp(), std::move(cache),
+                               std::move(services)) {}
 
 PythonExecutionStrategy::PythonExecutionStrategy(
-    std::shared_ptr<CacheInterface> cache)
-    : toolchain_(LanguageToolchainFactory::CreatePython()), cache_(std::move(cache)) {}
+    std::shared_ptr<CacheInterface> cache, CompilationServices services)
+    : toolchain_(LanguageToolchainFactory::CreatePython()),
+      cache_(std::move(cache)),
+      services_(std::move(services)) {}
+
+std::shared_ptr<ForkServer> PythonExecutionStrategy::PickZygote() const {
+  // A Python worker's own zygote before the shared ones.
+  if (SandboxWarmState* warm = SandboxWarmState::Current();
+      warm != nullptr && warm->python_zygote() != nullptr) {
+    return warm->python_zygote()->Pick();
+  }
+  return services_.python_zygote ? services_.python_zygote->Pick() : nullptr;
+}
 
 absl::StatusOr<ExecutionResult> PythonExecutionStrategy::Execute(
-    absl::string_view code, absl::string_view stdin_data,
+    absl::string_view code, const StdinSource& stdin_source,
+    OutputVerifier* verifier, RunCancellation* cancellation,
     OutputCallback callback) {
-  ExecutionContext context(code, stdin_data, std::move(callback));
+  ExecutionContext context(code, stdin_source, std::move(callback));
+  context.output_verifier = verifier;
+  context.cancellation = cancellation;
+  // The zygote owns its fork servers and this strategy the zygote.
+  context.fork_server = PickZygote().get();
   auto pipeline = CreatePipeline(cache_);
   return pipeline->Run(context);
 }
 
+void PythonExecutionStrategy::ExecuteAsync(absl::string_view code,
+                                           const StdinSource& stdin_source,
+                                           OutputVerifier* verifier,
+                                           RunCancellation* cancellation,
+                                           OutputCallback callback,
+                                           SandboxSupervisor* supervisor,
+                                           ResultCallback done) {
+  auto context =
+      std::make_unique<ExecutionContext>(code, stdin_source, std::move(callback));
+  context->output_verifier = verifier;
+  context->cancellation = cancellation;
+  context->supervisor = supervisor;
+  context->fork_server = PickZygote().get();
+  RunPipelineAsync(CreatePipeline(cache_), std::move(context), std::move(done));
+}
+
+absl::StatusOr<PreparedBuild> PythonExecutionStrategy::Prepare(
+    absl::string_view code, OutputCallback callback) {
+  ExecutionContext context(code, "", std::move(callback));
+  auto pipeline = ExecutionPipelineBuilder()
+                      .AddCreateSourceFileStep(toolchain_->GetFileExtension())
+                      .AddCompileBytecodeStep(toolchain_->GetExecutable(),
+                                              GetStrategyId(), services_)
+                      .Build();
+  absl::StatusOr<ExecutionResult> built = pipeline->Run(context);
+  if (built.ok()) {
+    built->success = true;
+  }
+  // The program takes every file the pipeline made; with bytecode, that
+  // includes the source beside it and their directory.
+  std::vector<std::string> extra_paths = context.cleanup_paths;
+  std::erase(extra_paths, context.source_file_path);
+  return TakePreparedProgram(context, std::move(built), GetStrategyId(),
+                             context.source_file_path, /*compiled=*/false,
+                             PickZygote(), std::move(extra_paths));
+}
+
+absl::StatusOr<ExecutionResult> PythonExecutionStrategy::Precompile(
+    absl::string_view code, OutputCallback callback) {
+  ExecutionContext context(code, "", std::move(callback));
+  context.compile_only = true;
+  auto pipeline = ExecutionPipelineBuilder()
+                      .AddCreateSourceFileStep(toolchain_->GetFileExtension())
+                      .AddCompileBytecodeStep(toolchain_->GetExecutable(),
+                                              GetStrategyId(), services_)
+                      .Build();
+  absl::StatusOr<ExecutionResult> built = pipeline->Run(context);
+  // Source that does not compile is still run, so this cannot fail.
+  if (built.ok()) {
+    built->success = true;
+  }
+  return built;
+}
+
 absl::string_view PythonExecutionStrategy::GetStrategyId() const {
   return toolchain_->GetLanguageId();
 }
@@ -539,6 +1288,8 @@ std::unique_ptr<ExecutionPipeline> PythonExecutionStrategy::CreatePipeline(
   return ExecutionPipelineBuilder()
       .WithCache(std::move(cache))
       .AddCreateSourceFileStep(toolchain_->GetFileExtension())
+      .AddCompileBytecodeStep(toolchain_->GetExecutable(), GetStrategyId(),
+                              services_)
       .AddRunProcessStep(true)
       .AddFinalizeResultStep(toolchain_->GetLanguageId())
       .Build();
@@ -547,87 +1298,297 @@ std::unique_ptr<ExecutionPipeline> PythonExecutionStrategy::CreatePipeline(
 // --- ExecutionStrategy Factory ---
 absl::StatusOr<std::unique_ptr<ExecutionStrategy>> ExecutionStrategy::Create(
     absl::string_view filename_or_extension,
-    std::shared_ptr<CacheInterface> cache) {
+    std::shared_ptr<CacheInterface> cache, CompilationServices services) {
   // Use LanguageToolchainFactory to determine language type
   auto toolchain = LanguageToolchainFactory::Create(filename_or_extension);
   
   // Create appropriate strategy based on language
   if (toolchain->GetLanguageId() == "python") {
-    return std::make_unique<PythonExecutionStrategy>(std::move(cache));
+    return std::make_unique<PythonExecutionStrategy>(std::move(cache),
+                                                     std::move(services));
   }
   
   if (toolchain->GetLanguageId() == "c") {
-    return std::make_unique<CExecutionStrategy>(std::move(cache));
+    return std::make_unique<CExecutionStrategy>(std::move(cache),
+                                                std::move(services));
   }
   
   // Default to C++
-  return std::make_unique<CppExecutionStrategy>(std::move(cache));
+  return std::make_unique<CppExecutionStrategy>(std::move(cache),
+                                                std::move(services));
 }
 
-SandboxedProcess::SandboxedProcess(std::shared_ptr<CacheInterface> cache)
-    : cache_(std::move(cache)) {}
+SandboxedProcess::SandboxedProcess(std::shared_ptr<CacheInterface> cache,
+                                   CompilationServices services,
+                                   std::shared_ptr<SandboxSupervisor> supervisor)
+    : cache_(std::move(cache)),
+      services_(std::move(services)),
+      supervisor_(std::move(supervisor)) {}
+
+namespace {
+
+// Accumulates streamed output so a successful run can be cached.
+struct OutputBuffer {
+  std::string out, err;
+  void Append(absl::string_view o, absl::string_view e) {
+    if (!o.empty()) out.append(o);
+    if (!e.empty()) err.append(e);
+  }
+};
+
+// Result-cache key for running `code` with `stdin_source`. The parts are
+// hashed in place rather than concatenated, and a file-backed stdin is keyed
+// by its digest, so no input is copied to compute the key.
+absl::StatusOr<std::string> ResultCacheKey(const ExecutionStrategy& strategy,
+                                           absl::string_view code,
+                                           const StdinSource& stdin_source) {
+  if (stdin_source.IsFile()) {
+    if (stdin_source.file_sha256.empty()) {
+      return absl::InvalidArgumentError("File stdin has no digest");
+    }
+    return CacheInterface::ComputeHash(
+        {strategy.GetStrategyId(), code, "file", stdin_source.file_sha256});
+  }
+  return CacheInterface::ComputeHash(
+      {strategy.GetStrategyId(), code, "bytes", stdin_source.data});
+}
+
+}  // namespace
+
+std::optional<ExecutionResult> SandboxedProcess::ReplayCached(
+    const absl::StatusOr<std::string>& hash_res, const OutputCallback& callback,
+    OutputVerifier* verifier) const {
+  if (!hash_res.ok()) {
+    return std::nullopt;
+  }
+  const auto cached = cache_->Get(*hash_res);
+  if (!cached) {
+    return std::nullopt;
+  }
+  if (verifier != nullptr) {
+    (void)verifier->Consume(cached->stdout_output);
+  } else if (!cached->stdout_output.empty()) {
+    callback(cached->stdout_output, "");
+  }
+  if (!cached->stderr_output.empty()) callback("", cached->stderr_output);
+  ExecutionResult res;
+  res.success = cached->success;
+  res.error_message = cached->error_message;
+  res.cache_hit = true;
+  res.cached_stdout = cached->stdout_output;
+  res.cached_stderr = cached->stderr_output;
+  res.stats.peak_memory_bytes = cached->peak_memory_bytes;
+  res.stats.elapsed_time_ms = static_cast<long>(cached->execution_time_ms);
+  if (verifier != nullptr) {
+    RecordVerdict(*verifier, res);
+  }
+  return res;
+}
+
+void SandboxedProcess::StoreResult(const absl::StatusOr<std::string>& hash_res,
+                                   std::string stdout_output,
+                                   std::string stderr_output,
+                                   const ExecutionResult& result) {
+  if (!result.success || !hash_res.ok()) {
+    return;
+  }
+  CachedResult cr;
+  cr.stdout_output = std::move(stdout_output);
+  cr.stderr_output = std::move(stderr_output);
+  cr.peak_memory_bytes = result.stats.peak_memory_bytes;
+  cr.execution_time_ms = static_cast<float>(result.stats.elapsed_time_ms);
+  cr.success = result.success;
+  cr.error_message = result.error_message;
+  cache_->Put(*hash_res, cr);
+}
 
 absl::StatusOr<ExecutionResult> SandboxedProcess::CompileAndRunStreaming(
     absl::string_view filename_or_extension, absl::string_view code,
-    absl::string_view stdin_data, OutputCallback callback) {
+    const StdinSource& stdin_source, OutputCallback callback,
+    const std::optional<OutputExpectation>& expected_output,
+    RunCancellation* cancellation) {
   ABSL_ASSIGN_OR_RETURN(
       std::unique_ptr<ExecutionStrategy> strategy,
-      ExecutionStrategy::Create(filename_or_extension, cache_));
+      ExecutionStrategy::Create(filename_or_extension, cache_, services_));
 
-  const std::string cache_input = absl::StrCat(strategy->GetStrategyId(), ":",
-                                               code, "\0", stdin_data);
   const absl::StatusOr<std::string> hash_res =
-      CacheInterface::ComputeHash(cache_input);
-
-  if (hash_res.ok()) {
-    const auto cached = cache_->Get(*hash_res);
-    if (cached) {
-      if (!cached->stdout_output.empty()) callback(cached->stdout_output, "");
-      if (!cached->stderr_output.empty()) callback("", cached->stderr_output);
-      ExecutionResult res;
-      res.success = cached->success;
-      res.error_message = cached->error_message;
-      res.cache_hit = true;
-      res.cached_stdout = cached->stdout_output;
-      res.cached_stderr = cached->stderr_output;
-      res.stats.peak_memory_bytes = cached->peak_memory_bytes;
-      res.stats.elapsed_time_ms = static_cast<long>(cached->execution_time_ms);
-      return res;
-    }
+      ResultCacheKey(*strategy, code, stdin_source);
+
+  std::optional<OutputVerifier> verifier;
+  if (expected_output) {
+    verifier.emplace(*expected_output);
   }
+  OutputVerifier* const verifier_ptr = verifier ? &*verifier : nullptr;
 
-  struct OutputBuffer {
-    std::string out, err;
-    void Append(absl::string_view o, absl::string_view e) {
-      if (!o.empty()) out.append(o);
-      if (!e.empty()) err.append(e);
-    }
-  } buffer;
+  if (auto cached = ReplayCached(hash_res, callback, verifier_ptr)) {
+    return *std::move(cached);
+  }
 
+  OutputBuffer buffer;
   auto wrapped_cb = [&](absl::string_view o, absl::string_view e) {
     buffer.Append(o, e);
     callback(o, e);
   };
 
-  ABSL_ASSIGN_OR_RETURN(const ExecutionResult result,
-                        strategy->Execute(code, stdin_data, wrapped_cb));
+  ABSL_ASSIGN_OR_RETURN(
+      const ExecutionResult result,
+      strategy->Execute(code, stdin_source, verifier_ptr, cancellation,
+                        wrapped_cb));
 
-  if (result.success && hash_res.ok()) {
-    CachedResult cr;
-    cr.stdout_output = buffer.out;
-    cr.stderr_output = buffer.err;
-    cr.peak_memory_bytes = result.stats.peak_memory_bytes;
-    cr.execution_time_ms = static_cast<float>(result.stats.elapsed_time_ms);
-    cr.success = result.success;
-    cr.error_message = result.error_message;
-    cache_->Put(*hash_res, cr);
+  // A verified run's stdout was checked, not captured, so it is not cached.
+  if (verifier_ptr == nullptr) {
+    StoreResult(hash_res, std::move(buffer.out), std::move(buffer.err), result);
   }
-
   return result;
 }
 
+void SandboxedProcess::CompileAndRunAsync(
+    absl::string_view filename_or_extension, absl::string_view code,
+    const StdinSource& stdin_source, OutputCallback callback,
+    ResultCallback done, std::optional<OutputExpectation> expected_output,
+    RunCancellation* cancellation) {
+  if (!supervisor_) {
+    done(CompileAndRunStreaming(filename_or_extension, code, stdin_source,
+                                std::move(callback), expected_output,
+                                cancellation));
+    return;
+  }
+
+  absl::StatusOr<std::unique_ptr<ExecutionStrategy>> created =
+      ExecutionStrategy::Create(filename_or_extension, cache_, services_);
+  if (!created.ok()) {
+    done(created.status());
+    return;
+  }
+  // Shared with the completion: the pipeline borrows from the strategy.
+  std::shared_ptr<ExecutionStrategy> strategy = *std::move(created);
+
+  absl::StatusOr<std::string> hash_res =
+      ResultCacheKey(*strategy, code, stdin_source);
+
+  // Shared with the completion, which outlives the supervised run.
+  std::shared_ptr<OutputVerifier> verifier =
+      expected_output ? std::make_shared<OutputVerifier>(*expected_output)
+                      : nullptr;
+
+  if (auto cached = ReplayCached(hash_res, callback, verifier.get())) {
+    done(*std::move(cached));
+    return;
+  }
+
+  auto buffer = std::make_shared<OutputBuffer>();
+  auto wrapped_cb = [buffer, callback = std::move(callback)](
+                        absl::string_view o, absl::string_view e) {
+    buffer->Append(o, e);
+    callback(o, e);
+  };
+
+  OutputVerifier* const verifier_ptr = verifier.get();
+  strategy->ExecuteAsync(
+      code, stdin_source, verifier_ptr, cancellation, std::move(wrapped_cb),
+      supervisor_.get(),
+      [this, strategy, buffer, verifier = std::move(verifier),
+       hash_res = std::move(hash_res), done = std::move(done)](
+          absl::StatusOr<ExecutionResult> result) mutable {
+        if (result.ok() && verifier == nullptr) {
+          StoreResult(hash_res, std::move(buffer->out),
+                      std::move(buffer->err), *result);
+        }
+        done(std::move(result));
+      });
+}
+
+absl::StatusOr<ExecutionResult> SandboxedProcess::Precompile(
+    absl::string_view filename_or_extension, absl::string_view code,
+    OutputCallback callback) {
+  ABSL_ASSIGN_OR_RETURN(
+      std::unique_ptr<ExecutionStrategy> strategy,
+      ExecutionStrategy::Create(filename_or_extension, nullptr, services_));
+  return strategy->Precompile(code, std::move(callback));
+}
+
+absl::StatusOr<PreparedBuild> SandboxedProcess::Prepare(
+    absl::string_view filename_or_extension, absl::string_view code,
+    OutputCallback callback) {
+  ABSL_ASSIGN_OR_RETURN(
+      std::unique_ptr<ExecutionStrategy> strategy,
+      ExecutionStrategy::Create(filename_or_extension, nullptr, services_));
+  return strategy->Prepare(code, std::move(callback));
+}
+
+void SandboxedProcess::RunPreparedAsync(
+    std::shared_ptr<const PreparedProgram> program,
+    const StdinSource& stdin_source, OutputCallback callback,
+    ResultCallback done, std::optional<OutputExpectation> expected_output,
+    RunCancellation* cancellation) {
+  absl::StatusOr<std::unique_ptr<ExecutionStrategy>> created =
+      ExecutionStrategy::Create(program->language_id(), nullptr, services_);
+  if (!created.ok()) {
+    done(created.status());
+    return;
+  }
+  std::shared_ptr<ExecutionStrategy> strategy = *std::move(created);
+  std::shared_ptr<OutputVerifier> verifier =
+      expected_output ? std::make_shared<OutputVerifier>(*expected_output)
+                      : nullptr;
+
+  // The program, strategy and verifier are all borrowed by the run, so the
+  // completion holds them until it finishes.
+  const PreparedProgram& program_ref = *program;
+  OutputVerifier* const verifier_ptr = verifier.get();
+  strategy->RunPrepared(
+      program_ref, stdin_source, verifier_ptr, cancellation,
+      std::move(callback), supervisor_.get(),
+      [program = std::move(program), strategy, verifier = std::move(verifier),
+       done = std::move(done)](absl::StatusOr<ExecutionResult> result) mutable {
+        done(std::move(result));
+      });
+}
+
+bool SandboxedProcess::SpeculativeCompile(absl::string_view filename_or_extension,
+                                          absl::string_view code) {
+  if (!services_.speculation_executor || !services_.artifact_cache) {
+    return false;
+  }
+  // The task must not own the executor it runs on, or the last reference
+  // could be dropped (and the executor joined) from one of its own threads.
+  CompilationServices task_services = services_;
+  task_services.speculation_executor.reset();
+  auto strategy = ExecutionStrategy::Create(filename_or_extension, nullptr,
+                                            std::move(task_services));
+  if (!strategy.ok()) {
+    return false;
+  }
+  const absl::Status submitted = services_.speculation_executor->Submit(
+      [strategy = std::shared_ptr<ExecutionStrategy>(*std::move(strategy)),
+       source = std::string(code)]() {
+        const auto result = strategy->Precompile(source, nullptr);
+        if (!result.ok() || !result->success) {
+          VLOG(1) << "Speculative compile did not produce an artifact";
+        }
+      });
+  if (!submitted.ok()) {
+    VLOG(1) << "Speculative compile skipped: " << submitted;
+    return false;
+  }
+  return true;
+}
+
 SandboxedProcess::Metrics SandboxedProcess::GetMetrics() const {
-  return {cache_->GetStats()};
+  Metrics metrics{cache_->GetStats(), {}, {}, {}, {}};
+  if (services_.artifact_cache) {
+    metrics.artifact_stats = services_.artifact_cache->GetStats();
+  }
+  if (services_.tiering) {
+    metrics.tier_stats = services_.tiering->GetStats();
+  }
+  if (services_.governor) {
+    metrics.governor_stats = services_.governor->GetStats();
+  }
+  if (supervisor_) {
+    metrics.supervisor_stats = supervisor_->GetStats();
+  }
+  return metrics;
 }
 
 }  // namespace dcodex
@@ -16,40 +16,143 @@
 #define SRC_ENGINE_SANDBOX_H_
 
 #include <memory>
+#include <optional>
+#include <string>
 
 #include "absl/flags/declare.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "src/common/artifact_cache.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/compile_governor.h"
 #include "src/engine/execution_types.h"
+#include "src/engine/output_verifier.h"
+#include "src/engine/prepared_program.h"
+#include "src/engine/run_cancellation.h"
+#include "src/engine/sandbox_supervisor.h"
+#include "src/engine/tiered_compilation.h"
 
 // Abseil Flags for sandboxed resource limits (must be in global namespace).
 ABSL_DECLARE_FLAG(int, sandbox_cpu_time_limit_seconds);
 ABSL_DECLARE_FLAG(int, sandbox_wall_clock_timeout_seconds);
+ABSL_DECLARE_FLAG(absl::Duration, sandbox_wall_clock_timeout);
 ABSL_DECLARE_FLAG(uint64_t, sandbox_memory_limit_bytes);
 ABSL_DECLARE_FLAG(uint64_t, sandbox_max_output_bytes);
+ABSL_DECLARE_FLAG(uint64_t, sandbox_pipe_buffer_bytes);
+ABSL_DECLARE_FLAG(uint64_t, sandbox_stdin_pipe_max_bytes);
+ABSL_DECLARE_FLAG(bool, sandbox_io_uring);
+// Limits for compiler invocations (looser than the program-run limits).
+ABSL_DECLARE_FLAG(int, compile_cpu_time_limit_seconds);
+ABSL_DECLARE_FLAG(int, compile_wall_clock_timeout_seconds);
+ABSL_DECLARE_FLAG(uint64_t, compile_memory_limit_bytes);
+ABSL_DECLARE_FLAG(uint64_t, python_bytecode_min_bytes);
 
 namespace dcodex {
 
 // Orchestrator class that manages sandboxed execution and caching.
 class SandboxedProcess {
  public:
-  // Constructs with required dependencies.
-  explicit SandboxedProcess(std::shared_ptr<CacheInterface> cache);
+  // Constructs with required dependencies. `services` is optional and enables
+  // compiled-artifact reuse across requests; `supervisor` is optional and
+  // lets CompileAndRunAsync() return while programs run.
+  explicit SandboxedProcess(std::shared_ptr<CacheInterface> cache,
+                            CompilationServices services = {},
+                            std::shared_ptr<SandboxSupervisor> supervisor =
+                                nullptr);
 
-  // Compiles and runs code with caching support.
+  // Compiles and runs code with caching support. With `expected_output`, the
+  // program's stdout is compared with it as it is written instead of being
+  // passed to `callback`, the program is killed at the first difference, and
+  // the result carries the verdict; such runs are not stored in the cache.
+  // With a `cancellation`, the sandboxed program is attached to it while it
+  // runs, so that RunCancellation::Cancel() kills it.
   [[nodiscard]] absl::StatusOr<ExecutionResult> CompileAndRunStreaming(
       absl::string_view filename_or_extension, absl::string_view code,
-      absl::string_view stdin_data, OutputCallback callback);
+      const StdinSource& stdin_source, OutputCallback callback,
+      const std::optional<OutputExpectation>& expected_output = std::nullopt,
+      RunCancellation* cancellation = nullptr);
+
+  // Like CompileAndRunStreaming(), but with a supervisor the calling thread
+  // is released once the program starts: `callback` and `done` then run on a
+  // supervisor thread. Compilation still happens on the calling thread.
+  // Without a supervisor this is CompileAndRunStreaming() followed by `done`.
+  void CompileAndRunAsync(
+      absl::string_view filename_or_extension, absl::string_view code,
+      const StdinSource& stdin_source, OutputCallback callback,
+      ResultCallback done,
+      std::optional<OutputExpectation> expected_output = std::nullopt,
+      RunCancellation* cancellation = nullptr);
+
+  // Compiles `code` into the artifact cache without running it; see
+  // ExecutionStrategy::Precompile. Used as the compile stage of a two-stage
+  // request, so that the later CompileAndRunStreaming() only runs.
+  [[nodiscard]] absl::StatusOr<ExecutionResult> Precompile(
+      absl::string_view filename_or_extension, absl::string_view code,
+      OutputCallback callback);
+
+  // Builds `code` once into a program that RunPreparedAsync() can run any
+  // number of times; see ExecutionStrategy::Prepare.
+  [[nodiscard]] absl::StatusOr<PreparedBuild> Prepare(
+      absl::string_view filename_or_extension, absl::string_view code,
+      OutputCallback callback);
+
+  // Runs a program from Prepare() as CompileAndRunAsync() runs a freshly
+  // built one, skipping straight to the run step. Runs of prepared programs
+  // are not looked up in or stored in the result cache.
+  void RunPreparedAsync(
+      std::shared_ptr<const PreparedProgram> program,
+      const StdinSource& stdin_source, OutputCallback callback,
+      ResultCallback done,
+      std::optional<OutputExpectation> expected_output = std::nullopt,
+      RunCancellation* cancellation = nullptr);
+
+  // Whether Precompile() output can be picked up by a later
+  // CompileAndRunStreaming(), i.e. whether an artifact cache is configured.
+  [[nodiscard]] bool CanStageCompilation() const {
+    return services_.artifact_cache != nullptr;
+  }
+
+  // Whether programs from Prepare() may be run through a fork server, i.e.
+  // whether the fork server stub or the Python zygote is configured.
+  [[nodiscard]] bool CanForkPrograms() const {
+    return services_.fork_server_stub != nullptr ||
+           services_.python_zygote != nullptr;
+  }
+
+  // Starts compiling `code` on the speculation executor so the compile
+  // overlaps the caller's wait for a worker; the later
+  // CompileAndRunStreaming() of the same code reuses or joins it. Returns
+  // false when speculation is disabled or the executor's queue is full.
+  bool SpeculativeCompile(absl::string_view filename_or_extension,
+                          absl::string_view code);
 
   // Real-time metrics from the sandbox and its cache.
   struct Metrics {
     ExecutionCache::CacheStats cache_stats;
+    ArtifactCacheInterface::ArtifactStats artifact_stats;
+    TieredCompilationManager::Stats tier_stats;
+    CompileGovernor::Stats governor_stats;
+    SandboxSupervisor::Stats supervisor_stats;
   };
   Metrics GetMetrics() const;
 
  private:
+  // Replays a cached run of `hash_res` through `callback`, if there is one.
+  // With a `verifier`, the cached stdout is checked instead of replayed.
+  std::optional<ExecutionResult> ReplayCached(
+      const absl::StatusOr<std::string>& hash_res,
+      const OutputCallback& callback, OutputVerifier* verifier) const;
+
+  // Caches a successful run under `hash_res`.
+  void StoreResult(const absl::StatusOr<std::string>& hash_res,
+                   std::string stdout_output, std::string stderr_output,
+                   const ExecutionResult& result);
+
   std::shared_ptr<CacheInterface> cache_;
+  CompilationServices services_;
+  std::shared_ptr<SandboxSupervisor> supervisor_;
 };
 
 }  // namespace dcodex
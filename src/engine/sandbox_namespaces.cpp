@@ -0,0 +1,343 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/sandbox_namespaces.h"
+
+#include <fcntl.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "src/common/status_macros.h"
+
+namespace dcodex {
+
+using internal::FileDescriptor;
+
+namespace {
+
+struct NamespaceKind {
+  const char* name;      // In --sandbox_namespaces.
+  const char* ns_file;   // Under /proc/<pid>/ns.
+  int flag;
+};
+
+// In the order runs join them: user first, for the rights to join the rest.
+constexpr NamespaceKind kKinds[] = {
+    {"user", "user", CLONE_NEWUSER}, {"mount", "mnt", CLONE_NEWNS},
+    {"net", "net", CLONE_NEWNET},    {"ipc", "ipc", CLONE_NEWIPC},
+    {"pid", "pid", CLONE_NEWPID},
+};
+
+constexpr char kSetUp = 'S';
+constexpr char kReset = 'R';
+// The holder's control socket, moved clear of the descriptors it closes.
+constexpr int kHolderControlFd = 3;
+constexpr const char* kScratchOptions = "size=64m,mode=1777";
+constexpr int kReplyTimeoutMs = 5000;
+
+// --- Holder process ----------------------------------------------------------
+// Runs in a clone of the multi-threaded server, so like any child between
+// fork and exec it makes system calls only.
+
+struct HolderArgs {
+  int kinds;
+  int control_fd;
+  pid_t server_pid;
+  const char* scratch_dir;
+};
+
+// Whether the holder mounted a /proc of its own PID namespace, in which
+// /proc/thread-self/children lists orphans by their pids in it.
+bool holder_has_proc = false;
+
+int HolderSetUp(const HolderArgs& args) {
+  if ((args.kinds & CLONE_NEWNS) != 0) {
+    if (mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) != 0 ||
+        mount("tmpfs", args.scratch_dir, "tmpfs", MS_NOSUID | MS_NODEV,
+              kScratchOptions) != 0) {
+      return errno;
+    }
+    // Best effort: where the host masks parts of /proc (e.g. in a
+    // container) the kernel refuses, and runs see the host's.
+    holder_has_proc =
+        (args.kinds & CLONE_NEWPID) != 0 &&
+        mount("proc", "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC,
+              nullptr) == 0;
+  }
+  if ((args.kinds & CLONE_NEWNET) != 0) {
+    // Best effort: a new network namespace starts with loopback down.
+    const int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock >= 0) {
+      struct ifreq ifr {};
+      memcpy(ifr.ifr_name, "lo", 3);
+      if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0) {
+        ifr.ifr_flags |= IFF_UP;
+        (void)ioctl(sock, SIOCSIFFLAGS, &ifr);
+      }
+      close(sock);
+    }
+  }
+  return 0;
+}
+
+// Kills the holder's children, which are the processes runs orphaned in the
+// PID namespace, and reaps them. Runs themselves are the server's children
+// and are left alone. Killing an orphan can orphan its own children, hence
+// the rounds.
+void HolderKillOrphans() {
+  constexpr int kRounds = 4;
+  constexpr int kMaxPids = 256;
+  for (int round = 0; round < kRounds; ++round) {
+    const int fd = open("/proc/thread-self/children", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    pid_t pids[kMaxPids];
+    int count = 0;
+    pid_t pid = 0;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+      for (ssize_t i = 0; i < n; ++i) {
+        if (buf[i] >= '0' && buf[i] <= '9') {
+          pid = pid * 10 + (buf[i] - '0');
+        } else {
+          if (pid > 0 && count < kMaxPids) pids[count++] = pid;
+          pid = 0;
+        }
+      }
+    }
+    if (pid > 0 && count < kMaxPids) pids[count++] = pid;
+    close(fd);
+    if (count == 0) return;
+    for (int i = 0; i < count; ++i) kill(pids[i], SIGKILL);
+    for (int i = 0; i < count; ++i) waitpid(pids[i], nullptr, 0);
+  }
+}
+
+int HolderReset(const HolderArgs& args) {
+  if ((args.kinds & CLONE_NEWPID) != 0) {
+    if (holder_has_proc) {
+      HolderKillOrphans();
+    }
+    while (waitpid(-1, nullptr, WNOHANG) > 0) {
+    }
+  }
+  if ((args.kinds & CLONE_NEWNS) != 0) {
+    // Detached, the old tmpfs lives on for runs still working in it.
+    if (umount2(args.scratch_dir, MNT_DETACH) != 0 ||
+        mount("tmpfs", args.scratch_dir, "tmpfs", MS_NOSUID | MS_NODEV,
+              kScratchOptions) != 0) {
+      return errno;
+    }
+  }
+  return 0;
+}
+
+int HolderMain(void* raw_args) {
+  const HolderArgs& args = *static_cast<HolderArgs*>(raw_args);
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  // In a new PID namespace the parent is outside it and reads as 0.
+  if (const pid_t parent = getppid(); parent != 0 && parent != args.server_pid) {
+    _exit(0);  // The server died before PR_SET_PDEATHSIG took effect.
+  }
+  // Keep nothing of the server's open, least of all other runs' pipes.
+  if (dup2(args.control_fd, kHolderControlFd) < 0) _exit(1);
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+  if (syscall(SYS_close_range, kHolderControlFd + 1, ~0U, 0U) != 0) {
+    for (int fd = kHolderControlFd + 1; fd < 65536; ++fd) close(fd);
+  }
+
+  while (true) {
+    char command;
+    const ssize_t n = read(kHolderControlFd, &command, 1);
+    if (n == 0) _exit(0);  // The server is done with the namespaces.
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      _exit(1);
+    }
+    const int result =
+        command == kSetUp ? HolderSetUp(args) : HolderReset(args);
+    if (write(kHolderControlFd, &result, sizeof(result)) != sizeof(result)) {
+      _exit(1);
+    }
+  }
+}
+
+// --- Server side ------------------------------------------------------------
+
+absl::Status WriteProcFile(pid_t pid, const char* name,
+                           const std::string& content) {
+  const std::string path = absl::StrCat("/proc/", pid, "/", name);
+  FileDescriptor file(open(path.c_str(), O_WRONLY | O_CLOEXEC));
+  if (!file.IsValid() ||
+      write(file.Get(), content.data(), content.size()) !=
+          static_cast<ssize_t>(content.size())) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Writing ", path));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<int> SandboxNamespaces::ParseKinds(
+    const std::vector<std::string>& names) {
+  int kinds = 0;
+  for (const std::string& name : names) {
+    const NamespaceKind* found = nullptr;
+    for (const NamespaceKind& kind : kKinds) {
+      if (name == kind.name) found = &kind;
+    }
+    if (found == nullptr) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Unknown namespace '", name, "'; expected one of user, mount, pid, "
+          "net, ipc"));
+    }
+    kinds |= found->flag;
+  }
+  return kinds;
+}
+
+SandboxNamespaces::SandboxNamespaces(int kinds, std::string scratch_dir)
+    : kinds_(kinds), scratch_dir_(std::move(scratch_dir)) {}
+
+absl::StatusOr<std::unique_ptr<SandboxNamespaces>> SandboxNamespaces::Create(
+    int kinds) {
+  std::string scratch_dir;
+  if ((kinds & CLONE_NEWNS) != 0) {
+    char dir_template[] = "/tmp/dcodex_ns_XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+      return absl::ErrnoToStatus(errno, "mkdtemp for scratch mount failed");
+    }
+    scratch_dir = dir_template;
+  }
+  std::unique_ptr<SandboxNamespaces> set(
+      new SandboxNamespaces(kinds, std::move(scratch_dir)));
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+    return absl::ErrnoToStatus(errno, "socketpair failed");
+  }
+  set->control_ = FileDescriptor(sockets[0]);
+  FileDescriptor remote(sockets[1]);
+
+  // The holder gets a copy of this stack, not a share of it.
+  constexpr size_t kHolderStackBytes = 64 * 1024;
+  void* stack = mmap(nullptr, kHolderStackBytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap() of holder stack failed");
+  }
+  HolderArgs args{kinds, remote.Get(), getpid(), set->scratch_dir_.c_str()};
+  // The holder keeps every signal blocked, so none of the server's handlers
+  // ever runs in it.
+  sigset_t all_signals;
+  sigset_t saved_mask;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_SETMASK, &all_signals, &saved_mask);
+  set->holder_pid_ =
+      clone(&HolderMain, static_cast<char*>(stack) + kHolderStackBytes,
+            kinds | SIGCHLD, &args);
+  const int clone_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &saved_mask, nullptr);
+  munmap(stack, kHolderStackBytes);
+  remote.Reset();
+  if (set->holder_pid_ < 0) {
+    return absl::ErrnoToStatus(clone_errno, "clone() of namespaces failed");
+  }
+
+  if ((kinds & CLONE_NEWUSER) != 0) {
+    const pid_t pid = set->holder_pid_;
+    ABSL_RETURN_IF_ERROR(WriteProcFile(pid, "setgroups", "deny"));
+    ABSL_RETURN_IF_ERROR(
+        WriteProcFile(pid, "uid_map", absl::StrCat("0 ", geteuid(), " 1")));
+    ABSL_RETURN_IF_ERROR(
+        WriteProcFile(pid, "gid_map", absl::StrCat("0 ", getegid(), " 1")));
+  }
+  ABSL_RETURN_IF_ERROR(set->Request(kSetUp));
+
+  for (const NamespaceKind& kind : kKinds) {
+    if ((kinds & kind.flag) == 0) continue;
+    const std::string path =
+        absl::StrCat("/proc/", set->holder_pid_, "/ns/", kind.ns_file);
+    FileDescriptor fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.IsValid()) {
+      return absl::ErrnoToStatus(errno, absl::StrCat("Opening ", path));
+    }
+    switch (kind.flag) {
+      case CLONE_NEWUSER: set->join_.user_fd = fd.Get(); break;
+      case CLONE_NEWNS: set->join_.mount_fd = fd.Get(); break;
+      case CLONE_NEWNET: set->join_.net_fd = fd.Get(); break;
+      case CLONE_NEWIPC: set->join_.ipc_fd = fd.Get(); break;
+      case CLONE_NEWPID: set->join_.pid_fd = fd.Get(); break;
+    }
+    set->ns_fds_.push_back(std::move(fd));
+  }
+  if (!set->scratch_dir_.empty()) {
+    set->join_.cwd = set->scratch_dir_.c_str();
+  }
+  return set;
+}
+
+SandboxNamespaces::~SandboxNamespaces() {
+  control_.Reset();
+  if (holder_pid_ > 0) {
+    kill(holder_pid_, SIGKILL);
+    waitpid(holder_pid_, nullptr, 0);
+  }
+  if (!scratch_dir_.empty()) {
+    rmdir(scratch_dir_.c_str());
+  }
+}
+
+absl::Status SandboxNamespaces::Reset() { return Request(kReset); }
+
+absl::Status SandboxNamespaces::Request(char command) {
+  if (write(control_.Get(), &command, 1) != 1) {
+    return absl::ErrnoToStatus(errno, "Namespace holder is gone");
+  }
+  struct pollfd pfd {control_.Get(), POLLIN, 0};
+  if (poll(&pfd, 1, kReplyTimeoutMs) != 1) {
+    return absl::DeadlineExceededError("Namespace holder did not reply");
+  }
+  int result = 0;
+  if (read(control_.Get(), &result, sizeof(result)) != sizeof(result)) {
+    return absl::UnavailableError("Namespace holder exited");
+  }
+  if (result != 0) {
+    return absl::ErrnoToStatus(
+        result, command == kSetUp ? "Setting up namespaces failed"
+                                  : "Resetting namespaces failed");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace dcodex
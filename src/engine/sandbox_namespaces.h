@@ -0,0 +1,105 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_SANDBOX_NAMESPACES_H_
+#define SRC_ENGINE_SANDBOX_NAMESPACES_H_
+
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// SandboxNamespaces: a set of Linux namespaces created once and joined by
+// many runs.
+//
+// Creating user, mount, PID, network and IPC namespaces for every run costs
+// milliseconds; joining existing ones with setns() costs microseconds (see
+// ProcessRunner::SpawnProcess with ResourceLimits::namespaces). So a worker
+// creates its set once, around a small holder process that keeps the
+// namespaces alive and is the init of the PID namespace:
+//
+//   user   the server's uid and gid mapped to root inside, nothing else
+//   mount  private propagation, a fresh /proc for the PID namespace, and a
+//          scratch tmpfs the runs start in (scratch_dir())
+//   pid    runs see only each other; orphans are reparented to the holder
+//   net    loopback only
+//   ipc    private System V IPC and POSIX message queues
+//
+// Runs join as root of the user namespace but with every capability dropped
+// (see ProcessRunner's JoinNamespacesAndClone), so they cannot mount,
+// unmount or reconfigure the network: the setup above is the same for every
+// run. Reset() clears the rest a run can leave behind in the set: it kills
+// the processes runs orphaned in the PID namespace and replaces the scratch
+// tmpfs. It does not remove System V IPC objects or POSIX message queues,
+// and files a run writes outside the scratch tmpfs persist as they would
+// without namespaces. Runs still in progress are the server's children, not
+// orphans, and keep the old tmpfs until they exit, so a worker may reset
+// while a program it started is still running. The network, IPC and user
+// namespaces are kept for the life of the set.
+// Not thread-safe: Reset() is for the owning worker's thread only.
+// -----------------------------------------------------------------------------
+class SandboxNamespaces {
+ public:
+  // The CLONE_NEW* flags for namespace names as in --sandbox_namespaces:
+  // "user", "mount", "pid", "net" and "ipc".
+  static absl::StatusOr<int> ParseKinds(const std::vector<std::string>& names);
+
+  // Creates the namespaces in `kinds`, a set of CLONE_NEW* flags. Without
+  // "user", creating and joining the others requires CAP_SYS_ADMIN.
+  static absl::StatusOr<std::unique_ptr<SandboxNamespaces>> Create(int kinds);
+
+  // Stops the holder, which ends the PID namespace and every process in it.
+  ~SandboxNamespaces();
+
+  SandboxNamespaces(const SandboxNamespaces&) = delete;
+  SandboxNamespaces& operator=(const SandboxNamespaces&) = delete;
+
+  // For ResourceLimits::namespaces; valid for the life of this object.
+  [[nodiscard]] const internal::JoinNamespaces& join() const { return join_; }
+
+  // Kills orphaned processes and replaces the scratch tmpfs. A failure means
+  // the holder is gone and the set can no longer be joined.
+  absl::Status Reset();
+
+  [[nodiscard]] int kinds() const { return kinds_; }
+  [[nodiscard]] pid_t holder_pid() const { return holder_pid_; }
+  // Where the scratch tmpfs is mounted inside the mount namespace; empty
+  // without one. The directory outside stays empty.
+  [[nodiscard]] const std::string& scratch_dir() const { return scratch_dir_; }
+
+ private:
+  SandboxNamespaces(int kinds, std::string scratch_dir);
+
+  // One request to the holder, answered with an errno value.
+  absl::Status Request(char command);
+
+  const int kinds_;
+  const std::string scratch_dir_;
+  pid_t holder_pid_ = -1;
+  internal::FileDescriptor control_;
+  std::vector<internal::FileDescriptor> ns_fds_;
+  internal::JoinNamespaces join_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_SANDBOX_NAMESPACES_H_
@@ -0,0 +1,137 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/sandbox_namespaces.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+namespace {
+
+using internal::PipePair;
+using internal::ProcessRunner;
+using internal::ResourceLimits;
+
+constexpr int kAllKinds =
+    CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWNET | CLONE_NEWIPC;
+
+class SandboxNamespacesTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto namespaces = SandboxNamespaces::Create(kAllKinds);
+    if (!namespaces.ok()) {
+      GTEST_SKIP() << "Namespaces unavailable here: " << namespaces.status();
+    }
+    namespaces_ = *std::move(namespaces);
+  }
+
+  // Runs `script` with /bin/sh in the namespaces and returns its stdout.
+  std::string Run(const std::string& script) {
+    ResourceLimits limits;
+    limits.cpu_time_seconds = 5;
+    limits.namespaces = &namespaces_->join();
+    auto stdin_file = ProcessRunner::CreateInputFile("");
+    EXPECT_TRUE(stdin_file.ok()) << stdin_file.status();
+    PipePair out;
+    EXPECT_TRUE(out.Create());
+    auto pid = ProcessRunner::SpawnProcess(
+        {"/bin/sh", "-c", script}, stdin_file->Get(), out.WriteFd(),
+        out.WriteFd(), limits);
+    EXPECT_TRUE(pid.ok()) << pid.status();
+    if (!pid.ok()) return "";
+    out.CloseWrite();
+    std::string output;
+    char buf[256];
+    ssize_t n = 0;
+    while ((n = read(out.ReadFd(), buf, sizeof(buf))) > 0) {
+      output.append(buf, static_cast<size_t>(n));
+    }
+    int status = 0;
+    EXPECT_EQ(waitpid(*pid, &status, 0), *pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << output;
+    return output;
+  }
+
+  std::unique_ptr<SandboxNamespaces> namespaces_;
+};
+
+TEST(SandboxNamespacesParseTest, MapsNamesToFlags) {
+  auto kinds = SandboxNamespaces::ParseKinds({"user", "mount", "pid"});
+  ASSERT_TRUE(kinds.ok()) << kinds.status();
+  EXPECT_EQ(*kinds, CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID);
+  EXPECT_EQ(*SandboxNamespaces::ParseKinds({}), 0);
+  EXPECT_FALSE(SandboxNamespaces::ParseKinds({"uts"}).ok());
+}
+
+TEST_F(SandboxNamespacesTest, RunsJoinTheNamespaces) {
+  const std::string theirs =
+      Run("readlink /proc/self/ns/net /proc/self/ns/pid /proc/self/ns/ipc");
+  for (const char* kind : {"net", "pid", "ipc"}) {
+    char ours[64] = {};
+    ASSERT_GT(readlink(absl::StrCat("/proc/self/ns/", kind).c_str(), ours,
+                       sizeof(ours) - 1),
+              0);
+    EXPECT_EQ(theirs.find(ours), std::string::npos) << kind << ": " << theirs;
+  }
+  EXPECT_EQ(Run("id -u"), "0\n");
+  EXPECT_EQ(Run("pwd"), absl::StrCat(namespaces_->scratch_dir(), "\n"));
+}
+
+TEST_F(SandboxNamespacesTest, ResetClearsScratchAndKillsOrphans) {
+  // The run exits at once, leaving a background sleep to the holder.
+  Run("touch left_behind; (sleep 60 >/dev/null 2>&1 &)");
+  EXPECT_EQ(Run("ls"), "left_behind\n");
+  EXPECT_EQ(Run("ps -e -o comm= | grep -c sleep"), "1\n");
+
+  ASSERT_TRUE(namespaces_->Reset().ok());
+  EXPECT_EQ(Run("ls"), "");
+  EXPECT_EQ(Run("ps -e -o comm= | grep -c sleep || true"), "0\n");
+  // The scratch tmpfs is only mounted inside the namespace.
+  EXPECT_TRUE(std::filesystem::is_empty(namespaces_->scratch_dir()));
+}
+
+TEST_F(SandboxNamespacesTest, RunsCannotChangeMountsForLaterRuns) {
+  EXPECT_EQ(Run("grep -E '^Cap(Eff|Prm|Bnd):' /proc/self/status"),
+            "CapPrm:\t0000000000000000\n"
+            "CapEff:\t0000000000000000\n"
+            "CapBnd:\t0000000000000000\n");
+  // Root in the user namespace, but without CAP_SYS_ADMIN.
+  EXPECT_EQ(Run("mount -t tmpfs none /usr 2>/dev/null || echo refused"),
+            "refused\n");
+  EXPECT_EQ(Run("umount -l /proc 2>/dev/null || echo refused"), "refused\n");
+  // So later runs still see the namespaces as set up.
+  EXPECT_EQ(Run("test -x /usr/bin/env && test -r /proc/1/stat && echo intact"),
+            "intact\n");
+}
+
+TEST_F(SandboxNamespacesTest, DestructionEndsThePidNamespace) {
+  const pid_t holder = namespaces_->holder_pid();
+  namespaces_.reset();
+  EXPECT_EQ(kill(holder, 0), -1);
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -0,0 +1,459 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/sandbox_supervisor.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "src/common/status_macros.h"
+#include "src/engine/process_runner.h"
+#include "src/engine/run_cancellation.h"
+#include "src/engine/sandbox.h"
+
+namespace dcodex {
+
+namespace {
+
+using internal::FileDescriptor;
+using internal::ProcessRunner;
+
+// Reaps the child into `exit`, first detaching it from its cancellation so
+// that the pid is not killed once it can be reused.
+void Reap(const SandboxSupervisor::Child& child, SandboxSupervisor::Exit& exit) {
+  if (child.cancellation != nullptr) {
+    child.cancellation->Detach(child.pid);
+  }
+  wait4(child.pid, &exit.status, 0, &exit.usage);
+}
+
+// Kills the child's process group, closes its pipes and reaps it. Used when
+// a child cannot be (or can no longer be) watched.
+SandboxSupervisor::Exit KillAndReap(SandboxSupervisor::Child& child) {
+  ProcessRunner::KillProcessGroup(child.pid);
+  FileDescriptor(child.stdout_fd).Reset();
+  FileDescriptor(child.stderr_fd).Reset();
+  child.stdout_fd = child.stderr_fd = -1;
+  SandboxSupervisor::Exit exit;
+  Reap(child, exit);
+  return exit;
+}
+
+}  // namespace
+
+#ifdef __linux__
+
+// One epoll set and the thread that waits on it. All members below mutex_
+// are touched only by that thread.
+class SandboxSupervisor::Loop {
+ public:
+  static absl::StatusOr<std::unique_ptr<Loop>> Create() {
+    FileDescriptor epoll_fd(epoll_create1(EPOLL_CLOEXEC));
+    if (!epoll_fd.IsValid()) {
+      return absl::ErrnoToStatus(errno, "epoll_create1 failed");
+    }
+    FileDescriptor wakeup_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!wakeup_fd.IsValid()) {
+      return absl::ErrnoToStatus(errno, "eventfd failed");
+    }
+    auto loop = std::unique_ptr<Loop>(
+        new Loop(std::move(epoll_fd), std::move(wakeup_fd)));
+    if (!loop->AddToEpoll(loop->wakeup_fd_.Get(), Token(0, kWakeup))) {
+      return absl::ErrnoToStatus(errno, "epoll_ctl ADD eventfd failed");
+    }
+    loop->thread_ = std::thread([raw = loop.get()] { raw->Run(); });
+    return loop;
+  }
+
+  ~Loop() {
+    {
+      absl::MutexLock lock(&mutex_);
+      stopping_ = true;
+    }
+    Wake();
+    thread_.join();
+    // Children queued after the loop stopped waiting.
+    absl::MutexLock lock(&mutex_);
+    for (auto& [id, watched] : incoming_) {
+      (void)id;
+      watched->pidfd.Reset();
+      std::move(watched->done)(KillAndReap(watched->child));
+    }
+    incoming_.clear();
+  }
+
+  absl::Status Add(Child child, FileDescriptor pidfd, DoneCallback done) {
+    auto watched = std::make_unique<Watched>();
+    watched->child = std::move(child);
+    watched->pidfd = std::move(pidfd);
+    watched->done = std::move(done);
+    {
+      absl::MutexLock lock(&mutex_);
+      if (stopping_) {
+        KillAndReap(watched->child);
+        return absl::FailedPreconditionError("Sandbox supervisor stopped");
+      }
+      incoming_.emplace_back(next_id_++, std::move(watched));
+    }
+    watching_.fetch_add(1, std::memory_order_relaxed);
+    Wake();
+    return absl::OkStatus();
+  }
+
+  int64_t watching() const { return watching_.load(std::memory_order_relaxed); }
+  int64_t completed() const {
+    return completed_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Event tokens: child id in the high bits, event source in the low two.
+  enum Source : uint64_t { kStdout = 0, kStderr = 1, kExit = 2, kWakeup = 3 };
+  static uint64_t Token(uint64_t id, Source source) {
+    return (id << 2) | source;
+  }
+
+  struct Watched {
+    Child child;
+    DoneCallback done;
+    FileDescriptor pidfd;
+    bool stdout_open = true;
+    bool stderr_open = true;
+    bool exited = false;
+    size_t total_bytes = 0;
+    // Pending entry in timers_: the deadline, then the post-exit drain.
+    absl::Time timer = absl::InfiniteFuture();
+    Exit exit;
+  };
+
+  Loop(FileDescriptor epoll_fd, FileDescriptor wakeup_fd)
+      : epoll_fd_(std::move(epoll_fd)), wakeup_fd_(std::move(wakeup_fd)) {}
+
+  void Wake() {
+    const uint64_t one = 1;
+    (void)write(wakeup_fd_.Get(), &one, sizeof(one));
+  }
+
+  bool AddToEpoll(int fd, uint64_t token) {
+    struct epoll_event ev {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = token;
+    return epoll_ctl(epoll_fd_.Get(), EPOLL_CTL_ADD, fd, &ev) == 0;
+  }
+
+  void RemoveFromEpoll(int fd) {
+    epoll_ctl(epoll_fd_.Get(), EPOLL_CTL_DEL, fd, nullptr);
+  }
+
+  void Run() {
+    std::array<struct epoll_event, 64> events;
+    bool stopping = false;
+    while (!stopping) {
+      const int nfds = epoll_wait(epoll_fd_.Get(), events.data(),
+                                  static_cast<int>(events.size()),
+                                  NextTimeoutMs());
+      if (nfds < 0) {
+        if (errno == EINTR) continue;
+        LOG(ERROR) << "Sandbox supervisor epoll_wait failed: "
+                   << absl::ErrnoToStatus(errno, "");
+        break;
+      }
+      for (int i = 0; i < nfds; ++i) {
+        const uint64_t token = events[static_cast<size_t>(i)].data.u64;
+        const uint64_t id = token >> 2;
+        const auto source = static_cast<Source>(token & 3);
+        if (source == kWakeup) {
+          stopping = TakeIncoming();
+          continue;
+        }
+        const auto it = watched_.find(id);
+        if (it == watched_.end()) continue;  // Completed earlier this batch.
+        Watched& watched = *it->second;
+        if (source == kExit) {
+          OnExit(id, watched);
+        } else {
+          OnReadable(watched, source == kStdout);
+        }
+        MaybeComplete(id);
+      }
+      ExpireTimers();
+    }
+
+    // Shutting down: nothing may outlive the loop.
+    while (!watched_.empty()) {
+      const uint64_t id = watched_.begin()->first;
+      Watched& watched = *watched_.begin()->second;
+      ProcessRunner::KillProcessGroup(watched.child.pid);
+      ClosePipes(watched);
+      Complete(id);
+    }
+  }
+
+  // Registers queued children; returns true once the loop should stop.
+  bool TakeIncoming() {
+    uint64_t drained = 0;
+    (void)read(wakeup_fd_.Get(), &drained, sizeof(drained));
+    std::vector<std::pair<uint64_t, std::unique_ptr<Watched>>> incoming;
+    bool stopping = false;
+    {
+      absl::MutexLock lock(&mutex_);
+      incoming.swap(incoming_);
+      stopping = stopping_;
+    }
+    for (auto& [id, watched] : incoming) {
+      Register(id, std::move(watched));
+    }
+    return stopping;
+  }
+
+  void Register(uint64_t id, std::unique_ptr<Watched> watched_ptr) {
+    Watched& watched = *watched_ptr;
+    watched_.emplace(id, std::move(watched_ptr));
+    ProcessRunner::SetNonBlocking(watched.child.stdout_fd);
+    ProcessRunner::SetNonBlocking(watched.child.stderr_fd);
+    if (!AddToEpoll(watched.child.stdout_fd, Token(id, kStdout)) ||
+        !AddToEpoll(watched.child.stderr_fd, Token(id, kStderr)) ||
+        !AddToEpoll(watched.pidfd.Get(), Token(id, kExit))) {
+      LOG(ERROR) << "Sandbox supervisor could not watch pid "
+                 << watched.child.pid << ": "
+                 << absl::ErrnoToStatus(errno, "epoll_ctl ADD failed");
+      ProcessRunner::KillProcessGroup(watched.child.pid);
+      ClosePipes(watched);
+      Complete(id);
+      return;
+    }
+    if (watched.child.deadline != absl::InfiniteFuture()) {
+      SetTimer(id, watched, watched.child.deadline);
+    }
+  }
+
+  void OnReadable(Watched& watched, bool is_stdout) {
+    bool& open = is_stdout ? watched.stdout_open : watched.stderr_open;
+    int& fd = is_stdout ? watched.child.stdout_fd : watched.child.stderr_fd;
+    if (!open) return;
+    ProcessRunner::ReadFromFd(fd, watched.child.callback, is_stdout, open,
+                              watched.total_bytes);
+    if (!open) {
+      RemoveFromEpoll(fd);
+      FileDescriptor(fd).Reset();
+      fd = -1;
+    }
+
+    const uint64_t max_output_bytes =
+        absl::GetFlag(FLAGS_sandbox_max_output_bytes);
+    if (!watched.exit.truncated && watched.total_bytes >= max_output_bytes) {
+      watched.exit.truncated = true;
+      ProcessRunner::KillProcessGroup(watched.child.pid);
+      watched.child.callback("",
+                             ProcessRunner::TruncationNotice(max_output_bytes));
+      ClosePipes(watched);
+    }
+  }
+
+  void OnExit(uint64_t id, Watched& watched) {
+    watched.exited = true;
+    // Descendants that inherited the pipes must not hold them open.
+    ProcessRunner::KillProcessGroup(watched.child.pid);
+    RemoveFromEpoll(watched.pidfd.Get());
+    watched.pidfd.Reset();
+    ClearTimer(watched);
+    if (watched.stdout_open || watched.stderr_open) {
+      SetTimer(id, watched,
+               absl::Now() + absl::Milliseconds(ProcessRunner::kExitDrainMs));
+    }
+  }
+
+  void ExpireTimers() {
+    const absl::Time now = absl::Now();
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+      const uint64_t id = timers_.begin()->second;
+      timers_.erase(timers_.begin());
+      Watched& watched = *watched_.at(id);
+      watched.timer = absl::InfiniteFuture();
+      if (!watched.exited) {
+        // Deadline: the exit event that follows the kill completes it.
+        watched.exit.timed_out = true;
+        ProcessRunner::KillProcessGroup(watched.child.pid);
+      } else {
+        // Drain grace elapsed; a descendant escaped the process group.
+        ClosePipes(watched);
+        MaybeComplete(id);
+      }
+    }
+  }
+
+  void SetTimer(uint64_t id, Watched& watched, absl::Time when) {
+    ClearTimer(watched);
+    watched.timer = when;
+    timers_.emplace(when, id);
+  }
+
+  void ClearTimer(Watched& watched) {
+    if (watched.timer == absl::InfiniteFuture()) return;
+    for (auto it = timers_.lower_bound({watched.timer, 0});
+         it != timers_.end() && it->first == watched.timer; ++it) {
+      if (watched_.at(it->second).get() == &watched) {
+        timers_.erase(it);
+        break;
+      }
+    }
+    watched.timer = absl::InfiniteFuture();
+  }
+
+  int NextTimeoutMs() const {
+    if (timers_.empty()) return -1;
+    const absl::Duration remaining = timers_.begin()->first - absl::Now();
+    if (remaining <= absl::ZeroDuration()) return 0;
+    return static_cast<int>(std::min<int64_t>(
+        absl::ToInt64Milliseconds(absl::Ceil(remaining, absl::Milliseconds(1))),
+        std::numeric_limits<int>::max()));
+  }
+
+  void ClosePipes(Watched& watched) {
+    for (int* fd : {&watched.child.stdout_fd, &watched.child.stderr_fd}) {
+      if (*fd != -1) {
+        RemoveFromEpoll(*fd);
+        FileDescriptor(*fd).Reset();
+        *fd = -1;
+      }
+    }
+    watched.stdout_open = watched.stderr_open = false;
+  }
+
+  void MaybeComplete(uint64_t id) {
+    const auto it = watched_.find(id);
+    if (it == watched_.end()) return;
+    const Watched& watched = *it->second;
+    if (watched.exited && !watched.stdout_open && !watched.stderr_open) {
+      Complete(id);
+    }
+  }
+
+  // Reaps the child and runs its completion. The child must have exited or
+  // been sent SIGKILL.
+  void Complete(uint64_t id) {
+    const auto it = watched_.find(id);
+    ClearTimer(*it->second);
+    std::unique_ptr<Watched> watched = std::move(it->second);
+    watched_.erase(it);
+    if (watched->pidfd.IsValid()) {
+      RemoveFromEpoll(watched->pidfd.Get());
+      watched->pidfd.Reset();
+    }
+    ClosePipes(*watched);
+    Reap(watched->child, watched->exit);
+    watching_.fetch_sub(1, std::memory_order_relaxed);
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    std::move(watched->done)(watched->exit);
+  }
+
+  FileDescriptor epoll_fd_;
+  FileDescriptor wakeup_fd_;
+  std::thread thread_;
+
+  absl::Mutex mutex_;
+  std::vector<std::pair<uint64_t, std::unique_ptr<Watched>>> incoming_
+      ABSL_GUARDED_BY(mutex_);
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  uint64_t next_id_ ABSL_GUARDED_BY(mutex_) = 1;
+
+  absl::flat_hash_map<uint64_t, std::unique_ptr<Watched>> watched_;
+  std::set<std::pair<absl::Time, uint64_t>> timers_;
+
+  std::atomic<int64_t> watching_{0};
+  std::atomic<int64_t> completed_{0};
+};
+
+absl::StatusOr<std::unique_ptr<SandboxSupervisor>> SandboxSupervisor::Create(
+    int threads) {
+  // Exit notification relies on pidfd_open (Linux 5.3+); probe it once.
+  if (const FileDescriptor probe(ProcessRunner::OpenPidFd(getpid()));
+      !probe.IsValid()) {
+    return absl::ErrnoToStatus(errno, "pidfd_open is unavailable");
+  }
+  std::vector<std::unique_ptr<Loop>> loops;
+  for (int i = 0; i < std::max(1, threads); ++i) {
+    ABSL_ASSIGN_OR_RETURN(std::unique_ptr<Loop> loop, Loop::Create());
+    loops.push_back(std::move(loop));
+  }
+  return std::unique_ptr<SandboxSupervisor>(
+      new SandboxSupervisor(std::move(loops)));
+}
+
+absl::Status SandboxSupervisor::Watch(Child child, DoneCallback done) {
+  FileDescriptor pidfd(ProcessRunner::OpenPidFd(child.pid));
+  if (!pidfd.IsValid()) {
+    const absl::Status status = absl::ErrnoToStatus(errno, "pidfd_open failed");
+    KillAndReap(child);
+    return status;
+  }
+  Loop& loop =
+      *loops_[next_loop_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+  return loop.Add(std::move(child), std::move(pidfd), std::move(done));
+}
+
+SandboxSupervisor::Stats SandboxSupervisor::GetStats() const {
+  Stats stats;
+  for (const auto& loop : loops_) {
+    stats.watching += loop->watching();
+    stats.completed += loop->completed();
+  }
+  return stats;
+}
+
+#else  // !__linux__
+
+class SandboxSupervisor::Loop {};
+
+absl::StatusOr<std::unique_ptr<SandboxSupervisor>> SandboxSupervisor::Create(
+    int threads) {
+  (void)threads;
+  return absl::UnimplementedError("SandboxSupervisor requires Linux");
+}
+
+absl::Status SandboxSupervisor::Watch(Child child, DoneCallback done) {
+  (void)done;
+  KillAndReap(child);
+  return absl::UnimplementedError("SandboxSupervisor requires Linux");
+}
+
+SandboxSupervisor::Stats SandboxSupervisor::GetStats() const { return {}; }
+
+#endif  // __linux__
+
+SandboxSupervisor::SandboxSupervisor(std::vector<std::unique_ptr<Loop>> loops)
+    : loops_(std::move(loops)) {}
+
+SandboxSupervisor::~SandboxSupervisor() = default;
+
+}  // namespace dcodex
@@ -0,0 +1,110 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_SANDBOX_SUPERVISOR_H_
+#define SRC_ENGINE_SANDBOX_SUPERVISOR_H_
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "src/engine/execution_types.h"
+
+namespace dcodex {
+
+class RunCancellation;
+
+// -----------------------------------------------------------------------------
+// SandboxSupervisor: one event loop for every running sandbox.
+//
+// Without a supervisor, RunProcessStep parks its worker thread in
+// ProcessRunner::ReadOutput() for the life of the child. With one, the step
+// hands the child's pid and output pipes to Watch() and returns; a supervisor
+// thread multiplexes the pipes, a pidfd exit notification and the wall-clock
+// deadline of every watched child in a single epoll set, and runs the
+// completion once the child has exited and been reaped. Thousands of
+// mostly-sleeping programs then cost a few threads; concurrency is bounded by
+// admission (--max_concurrent_sandboxes) and rlimits, not by the run pool.
+//
+// Children are spread round-robin over `threads` loops. Output limits,
+// process-group kills and the post-exit drain behave as in ReadOutput(),
+// whose --sandbox_io_uring backend the loops do not use.
+// Linux only: Create() fails where epoll or pidfd_open is unavailable, and
+// callers keep the blocking path.
+// -----------------------------------------------------------------------------
+class SandboxSupervisor {
+ public:
+  // A spawned child. The supervisor takes ownership of the pid (a process
+  // group leader) and of both read ends.
+  struct Child {
+    pid_t pid = -1;
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+    absl::Time deadline = absl::InfiniteFuture();
+    OutputCallback callback;
+    // When set, the pid is detached from it before the child is reaped.
+    RunCancellation* cancellation = nullptr;
+  };
+
+  // How a watched child ended.
+  struct Exit {
+    int status = 0;  // As reported by wait4().
+    struct rusage usage {};
+    bool timed_out = false;
+    bool truncated = false;
+  };
+
+  using DoneCallback = absl::AnyInvocable<void(const Exit&)>;
+
+  struct Stats {
+    int64_t watching = 0;
+    int64_t completed = 0;
+  };
+
+  [[nodiscard]] static absl::StatusOr<std::unique_ptr<SandboxSupervisor>>
+  Create(int threads);
+
+  // Stops the loops. Children still running are killed and reaped, and their
+  // completions run before the destructor returns.
+  ~SandboxSupervisor();
+
+  SandboxSupervisor(const SandboxSupervisor&) = delete;
+  SandboxSupervisor& operator=(const SandboxSupervisor&) = delete;
+
+  // Watches `child` and calls `done` exactly once, on a supervisor thread.
+  // On error the child has been killed and reaped and `done` is not called.
+  absl::Status Watch(Child child, DoneCallback done);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  class Loop;
+
+  explicit SandboxSupervisor(std::vector<std::unique_ptr<Loop>> loops);
+
+  std::vector<std::unique_ptr<Loop>> loops_;
+  std::atomic<size_t> next_loop_{0};
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_SANDBOX_SUPERVISOR_H_
@@ -0,0 +1,162 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/sandbox_supervisor.h"
+
+#include <sys/wait.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/strings/match.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/engine/process_runner.h"
+
+namespace dcodex {
+namespace {
+
+using internal::PipePair;
+using internal::ProcessRunner;
+using internal::ResourceLimits;
+
+// Output and exit of one watched child, filled in from the supervisor thread.
+struct Observed {
+  absl::Mutex mutex;
+  std::string output ABSL_GUARDED_BY(mutex);
+  SandboxSupervisor::Exit exit ABSL_GUARDED_BY(mutex);
+  absl::Notification done;
+};
+
+// Spawns `sh -c script` and hands it to `supervisor`.
+void WatchShell(SandboxSupervisor& supervisor, const std::string& script,
+                absl::Time deadline, Observed& observed) {
+  PipePair stdin_p, stdout_p, stderr_p;
+  ASSERT_TRUE(stdin_p.Create() && stdout_p.Create() && stderr_p.Create());
+  const std::vector<std::string> argv = {"/bin/sh", "-c", script};
+  const absl::StatusOr<pid_t> pid = ProcessRunner::SpawnProcess(
+      argv, stdin_p.ReadFd(), stdout_p.WriteFd(), stderr_p.WriteFd(),
+      ResourceLimits{});
+  ASSERT_TRUE(pid.ok()) << pid.status();
+  stdin_p.CloseWrite();
+  stdout_p.CloseWrite();
+  stderr_p.CloseWrite();
+
+  SandboxSupervisor::Child child;
+  child.pid = *pid;
+  child.stdout_fd = stdout_p.ReleaseRead();
+  child.stderr_fd = stderr_p.ReleaseRead();
+  child.deadline = deadline;
+  child.callback = [&observed](absl::string_view out, absl::string_view err) {
+    absl::MutexLock lock(&observed.mutex);
+    observed.output.append(out);
+    observed.output.append(err);
+  };
+  ASSERT_TRUE(supervisor
+                  .Watch(std::move(child),
+                         [&observed](const SandboxSupervisor::Exit& exit) {
+                           {
+                             absl::MutexLock lock(&observed.mutex);
+                             observed.exit = exit;
+                           }
+                           observed.done.Notify();
+                         })
+                  .ok());
+}
+
+std::unique_ptr<SandboxSupervisor> MakeSupervisor(int threads) {
+  auto supervisor = SandboxSupervisor::Create(threads);
+  if (!supervisor.ok()) {
+    return nullptr;
+  }
+  return *std::move(supervisor);
+}
+
+TEST(SandboxSupervisorTest, DeliversOutputAndExitStatus) {
+  auto supervisor = MakeSupervisor(1);
+  if (!supervisor) GTEST_SKIP() << "pidfd_open unavailable";
+
+  Observed observed;
+  WatchShell(*supervisor, "echo out; echo err >&2; exit 3",
+             absl::InfiniteFuture(), observed);
+  ASSERT_TRUE(observed.done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+
+  absl::MutexLock lock(&observed.mutex);
+  EXPECT_TRUE(absl::StrContains(observed.output, "out"));
+  EXPECT_TRUE(absl::StrContains(observed.output, "err"));
+  ASSERT_TRUE(WIFEXITED(observed.exit.status));
+  EXPECT_EQ(WEXITSTATUS(observed.exit.status), 3);
+  EXPECT_FALSE(observed.exit.timed_out);
+  EXPECT_FALSE(observed.exit.truncated);
+}
+
+TEST(SandboxSupervisorTest, DeadlineKillsChild) {
+  auto supervisor = MakeSupervisor(1);
+  if (!supervisor) GTEST_SKIP() << "pidfd_open unavailable";
+
+  const absl::Time start = absl::Now();
+  Observed observed;
+  WatchShell(*supervisor, "sleep 30", start + absl::Milliseconds(200),
+             observed);
+  ASSERT_TRUE(observed.done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+
+  absl::MutexLock lock(&observed.mutex);
+  EXPECT_TRUE(observed.exit.timed_out);
+  EXPECT_TRUE(WIFSIGNALED(observed.exit.status));
+}
+
+TEST(SandboxSupervisorTest, OneThreadWatchesManyChildren) {
+  auto supervisor = MakeSupervisor(1);
+  if (!supervisor) GTEST_SKIP() << "pidfd_open unavailable";
+
+  constexpr int kChildren = 64;
+  std::vector<std::unique_ptr<Observed>> observed;
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < kChildren; ++i) {
+    observed.push_back(std::make_unique<Observed>());
+    WatchShell(*supervisor, "sleep 0.5; echo done", absl::InfiniteFuture(),
+               *observed.back());
+  }
+  for (auto& o : observed) {
+    ASSERT_TRUE(o->done.WaitForNotificationWithTimeout(absl::Seconds(20)));
+    absl::MutexLock lock(&o->mutex);
+    EXPECT_EQ(o->output, "done\n");
+  }
+  // The children slept concurrently, not one after another.
+  EXPECT_LT(absl::Now() - start, absl::Seconds(10));
+
+  const SandboxSupervisor::Stats stats = supervisor->GetStats();
+  EXPECT_EQ(stats.watching, 0);
+  EXPECT_EQ(stats.completed, kChildren);
+}
+
+TEST(SandboxSupervisorTest, DestructorKillsRunningChildren) {
+  auto supervisor = MakeSupervisor(2);
+  if (!supervisor) GTEST_SKIP() << "pidfd_open unavailable";
+
+  Observed observed;
+  WatchShell(*supervisor, "sleep 30", absl::InfiniteFuture(), observed);
+  const absl::Time start = absl::Now();
+  supervisor.reset();
+  EXPECT_TRUE(observed.done.HasBeenNotified());
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+}
+
+}  // namespace
+}  // namespace dcodex
@@ -27,23 +27,48 @@
 
 #include "src/engine/sandbox.h"
 
+#include <stdlib.h>
 #include <sys/resource.h>
+#include <unistd.h>
 
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <system_error>
+#include <utility>
 
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "gtest/gtest.h"
+#include "src/common/artifact_cache.h"
 #include "src/common/execution_cache.h"
+#include "src/engine/bounded_executor.h"
+#include "src/engine/compilation_services.h"
+#include "src/engine/compile_single_flight.h"
+#include "src/engine/dynamic_worker_coordinator.h"
 #include "src/engine/execution_types.h"
+#include "src/engine/fork_server_stub.h"
+#include "src/engine/process_runner.h"
+#include "src/engine/python_zygote.h"
+#include "src/engine/run_cancellation.h"
+#include "src/engine/sandbox_namespaces.h"
+#include "src/engine/sandbox_supervisor.h"
+#include "src/engine/sandbox_warm_state.h"
+#include "src/engine/tiered_compilation.h"
 
 ABSL_DECLARE_FLAG(int, sandbox_cpu_time_limit_seconds);
 ABSL_DECLARE_FLAG(int, sandbox_wall_clock_timeout_seconds);
 ABSL_DECLARE_FLAG(uint64_t, sandbox_memory_limit_bytes);
 ABSL_DECLARE_FLAG(uint64_t, sandbox_max_output_bytes);
+ABSL_DECLARE_FLAG(uint64_t, python_bytecode_min_bytes);
 
 namespace dcodex {
 namespace {
@@ -55,6 +80,32 @@ std::shared_ptr<SandboxedProcess> MakeSandbox() {
   return std::make_shared<SandboxedProcess>(std::move(cache));
 }
 
+// Helper: an artifact cache in a fresh directory under the test's temp dir,
+// which is removed once the last user of the cache releases it. Returns null
+// (and fails the test) if the cache cannot be created.
+std::shared_ptr<ArtifactCache> MakeArtifactCache(absl::string_view name) {
+  std::string dir = absl::StrCat(testing::TempDir(), "/", name, "_XXXXXX");
+  if (mkdtemp(dir.data()) == nullptr) {
+    ADD_FAILURE() << "mkdtemp failed for " << dir;
+    return nullptr;
+  }
+  absl::StatusOr<std::shared_ptr<ArtifactCache>> cache =
+      ArtifactCache::Create(dir, 64ULL << 20);
+  if (!cache.ok()) {
+    ADD_FAILURE() << cache.status();
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return nullptr;
+  }
+  ArtifactCache* const raw = cache->get();
+  return std::shared_ptr<ArtifactCache>(
+      raw, [owned = *std::move(cache), dir](ArtifactCache*) mutable {
+        owned.reset();
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+      });
+}
+
 // Helper: collects all streaming output into a single string.
 struct OutputCapture {
   std::string combined;
@@ -178,6 +229,75 @@ int main() {
       << "stdout missing stdin echo. Got: " << cap.combined;
 }
 
+// Inputs past the pipe threshold come from a memfd; both kinds arrive whole,
+// even to a program that writes a lot before it starts reading.
+TEST(SandboxTest, LargeStdinIsDeliveredWhole) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 512ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 1024ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  constexpr absl::string_view kProgram =
+      "import sys\nsys.stdout.write('.' * 300000)\n"
+      "data = sys.stdin.buffer.read()\n"
+      "sys.stderr.write('%d %s' % (len(data), data[-4:].decode()))\n";
+  for (const size_t size : {size_t{200} * 1024, size_t{8} * 1024 * 1024}) {
+    const std::string input = std::string(size - 4, 'i') + "tail";
+    std::string err;
+    auto callback = [&err](absl::string_view, absl::string_view stderr_chunk) {
+      err.append(stderr_chunk);
+    };
+    absl::StatusOr<ExecutionResult> result =
+        sandbox->CompileAndRunStreaming("python", kProgram, input, callback);
+    ASSERT_TRUE(result.ok()) << result.status();
+    EXPECT_TRUE(result->success) << result->error_message;
+    EXPECT_EQ(err, absl::StrCat(size, " tail"));
+  }
+}
+
+// A file-backed stdin is handed to the program as is and keyed in the result
+// cache by its digest.
+TEST(SandboxTest, FileStdinIsServedAndCachedByDigest) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  const std::string path = absl::StrCat(testing::TempDir(), "/stdin_file");
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "from a file\n";
+  }
+  auto sandbox = MakeSandbox();
+  constexpr absl::string_view kProgram =
+      "import sys\nprint('got:', sys.stdin.read().strip())\n";
+
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python", kProgram, StdinSource::File(path, "digest-1"),
+      cap.MakeCallback());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_FALSE(result->cache_hit);
+  EXPECT_NE(cap.combined.find("got: from a file"), std::string::npos)
+      << cap.combined;
+
+  OutputCapture replay;
+  result = sandbox->CompileAndRunStreaming(
+      "python", kProgram, StdinSource::File(path, "digest-1"),
+      replay.MakeCallback());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->cache_hit);
+  EXPECT_EQ(replay.combined, cap.combined);
+
+  // The same bytes inline are a different input as far as the key goes.
+  result = sandbox->CompileAndRunStreaming("python", kProgram, "from a file\n",
+                                           replay.MakeCallback());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_FALSE(result->cache_hit);
+  unlink(path.c_str());
+}
+
 // =============================================================================
 // Compilation error surface
 // =============================================================================
@@ -197,13 +317,32 @@ TEST(SandboxTest, CompilationError) {
                                       "int main() { return 0 }",
                                       /*stdin_data=*/"", cap.MakeCallback());
 
-  // The pipeline returns an error status because compilation fails.
-  EXPECT_FALSE(result.ok() && result->success)
-      << "Expected compilation failure but got success";
+  // A compile error is a normal outcome: OK status, unsuccessful result.
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_FALSE(result->success) << "Expected compilation failure but got success";
+
+  // The compiler runs once; its buffered output is replayed to the client.
+  const std::string& trace = result->backend_trace;
+  size_t compile_runs = 0;
+  for (size_t pos = trace.find("Compile: clang++"); pos != std::string::npos;
+       pos = trace.find("Compile: clang++", pos + 1)) {
+    ++compile_runs;
+  }
+  EXPECT_EQ(compile_runs, 1u) << trace;
+  EXPECT_NE(cap.combined.find("error"), std::string::npos)
+      << "Compiler output was not replayed. Got: " << cap.combined;
+
+  ASSERT_FALSE(result->diagnostics.empty());
+  const CompilerDiagnostic& diag = result->diagnostics.front();
+  EXPECT_EQ(diag.file, "main.cpp");
+  EXPECT_EQ(diag.line, 1);
+  EXPECT_GT(diag.column, 0);
+  EXPECT_EQ(diag.severity, CompilerDiagnostic::Severity::kError);
+  EXPECT_FALSE(diag.message.empty());
 }
 
 // =============================================================================
-// Wall-clock timeout (applies on all platforms via gRPC Alarm)
+// Wall-clock timeout (enforced by the output event loop on all platforms)
 // =============================================================================
 
 TEST(SandboxTest, WallClockTimeoutTriggered) {
@@ -232,6 +371,164 @@ TEST(SandboxTest, WallClockTimeoutTriggered) {
       << "Error should mention timeout. Got: " << result.status().message();
 }
 
+TEST(SandboxTest, SubSecondWallClockTimeout) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 30);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::Milliseconds(300));
+
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+  const absl::Time start = absl::Now();
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python", "import time\nwhile True:\n    time.sleep(0.01)\n",
+      /*stdin_data=*/"", cap.MakeCallback());
+  const absl::Duration elapsed = absl::Now() - start;
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::ZeroDuration());
+
+  EXPECT_FALSE(result.ok());
+  EXPECT_NE(std::string(result.status().message()).find("timeout"),
+            std::string::npos)
+      << result.status();
+  EXPECT_GE(elapsed, absl::Milliseconds(300));
+  EXPECT_LT(elapsed, absl::Seconds(1));
+}
+
+// =============================================================================
+// Supervised runs: the program is watched by a SandboxSupervisor and the
+// result arrives on its thread.
+// =============================================================================
+
+TEST(SandboxTest, SupervisedRunDeliversResultAsynchronously) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto supervisor = SandboxSupervisor::Create(1);
+  if (!supervisor.ok()) GTEST_SKIP() << supervisor.status();
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000),
+      CompilationServices{}, *std::move(supervisor));
+
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result;
+  absl::Notification done;
+  sandbox->CompileAndRunAsync(
+      "cpp",
+      R"(
+#include <iostream>
+int main() {
+  std::string line;
+  std::getline(std::cin, line);
+  std::cout << "got " << line << std::endl;
+  return 0;
+}
+)",
+      /*stdin_data=*/"supervised\n", cap.MakeCallback(),
+      [&](absl::StatusOr<ExecutionResult> r) {
+        result = std::move(r);
+        done.Notify();
+      });
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(60)));
+
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  EXPECT_NE(cap.combined.find("got supervised"), std::string::npos)
+      << cap.combined;
+  EXPECT_EQ(sandbox->GetMetrics().supervisor_stats.completed, 1);
+}
+
+TEST(SandboxTest, SupervisedRunEnforcesWallClockTimeout) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 30);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::Milliseconds(300));
+
+  auto supervisor = SandboxSupervisor::Create(1);
+  if (!supervisor.ok()) GTEST_SKIP() << supervisor.status();
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000),
+      CompilationServices{}, *std::move(supervisor));
+
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result;
+  absl::Notification done;
+  sandbox->CompileAndRunAsync(
+      "python", "import time\nwhile True:\n    time.sleep(0.01)\n",
+      /*stdin_data=*/"", cap.MakeCallback(),
+      [&](absl::StatusOr<ExecutionResult> r) {
+        result = std::move(r);
+        done.Notify();
+      });
+  const bool finished = done.WaitForNotificationWithTimeout(absl::Seconds(10));
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::ZeroDuration());
+
+  ASSERT_TRUE(finished);
+  EXPECT_FALSE(result.ok());
+  EXPECT_NE(std::string(result.status().message()).find("timeout"),
+            std::string::npos)
+      << result.status();
+}
+
+TEST(SandboxTest, CancellingSupervisedRunKillsProgram) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 30);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 60);
+
+  auto supervisor = SandboxSupervisor::Create(1);
+  if (!supervisor.ok()) GTEST_SKIP() << supervisor.status();
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000),
+      CompilationServices{}, *std::move(supervisor));
+
+  RunCancellation cancellation;
+  absl::Notification started;
+  absl::StatusOr<ExecutionResult> result;
+  absl::Notification done;
+  const absl::Time start = absl::Now();
+  sandbox->CompileAndRunAsync(
+      "python",
+      "import time\nprint('started', flush=True)\nwhile True:\n"
+      "    time.sleep(0.01)\n",
+      /*stdin_data=*/"",
+      [&](absl::string_view out, absl::string_view err) {
+        (void)err;
+        if (!out.empty() && !started.HasBeenNotified()) started.Notify();
+      },
+      [&](absl::StatusOr<ExecutionResult> r) {
+        result = std::move(r);
+        done.Notify();
+      },
+      std::nullopt, &cancellation);
+  ASSERT_TRUE(started.WaitForNotificationWithTimeout(absl::Seconds(30)));
+  cancellation.Cancel();
+
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_LT(absl::Now() - start, absl::Seconds(30));
+  EXPECT_FALSE(result.ok() && result->success);
+}
+
+TEST(SandboxTest, RunStartedAfterCancelIsKilled) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 30);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 60);
+
+  auto sandbox = MakeSandbox();
+  RunCancellation cancellation;
+  cancellation.Cancel();
+  OutputCapture cap;
+  const absl::Time start = absl::Now();
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python", "import time\ntime.sleep(30)\n", "", cap.MakeCallback(),
+      std::nullopt, &cancellation);
+
+  EXPECT_LT(absl::Now() - start, absl::Seconds(20));
+  EXPECT_FALSE(result.ok() && result->success);
+}
+
 // =============================================================================
 // Output truncation
 // =============================================================================
@@ -267,6 +564,35 @@ TEST(SandboxTest, OutputTruncation) {
       << cap.combined;
 }
 
+TEST(SandboxTest, EscapedWriterDoesNotExtendExitDrain) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+  // The grandchild leaves the process group and keeps the pipes busy for
+  // three seconds after the program exits.
+  const absl::Time start = absl::Now();
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python",
+      "import os, time\n"
+      "if os.fork() == 0:\n"
+      "    os.setsid()\n"
+      "    for _ in range(100):\n"
+      "        print('x', flush=True)\n"
+      "        time.sleep(0.03)\n"
+      "    os._exit(0)\n"
+      "print('parent done', flush=True)\n",
+      /*stdin_data=*/"", cap.MakeCallback());
+
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_NE(cap.combined.find("parent done"), std::string::npos)
+      << cap.combined;
+  EXPECT_LT(absl::Now() - start, absl::Seconds(2));
+}
+
 // =============================================================================
 // Cache hit: identical code should produce a cache hit on second run.
 // =============================================================================
@@ -305,6 +631,619 @@ TEST(SandboxTest, CacheHitOnSecondRun) {
   }
 }
 
+// =============================================================================
+// Expected-output verification: stdout is checked as it is written.
+// =============================================================================
+
+TEST(SandboxTest, VerifiedRunStopsAtFirstDifference) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+  OutputExpectation expectation;
+  expectation.expected = "1\n2\n3\n";
+
+  // Goes wrong on the second line, then would print until the deadline.
+  const absl::Time start = absl::Now();
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python",
+      "import time\nprint(1)\nprint(5)\nwhile True:\n  time.sleep(0.01)\n",
+      /*stdin_data=*/"", cap.MakeCallback(), expectation);
+
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+  EXPECT_FALSE(result->success);
+  EXPECT_FALSE(result->wall_clock_timeout);
+  EXPECT_EQ(result->verdict.kind, OutputVerdict::Kind::kWrongAnswer);
+  EXPECT_EQ(result->verdict.line, 2);
+  EXPECT_EQ(result->verdict.expected_offset, 2u);
+  EXPECT_NE(result->verdict.actual_excerpt.find("1\n5"), std::string::npos)
+      << result->verdict.actual_excerpt;
+  EXPECT_NE(result->error_message.find("Wrong answer"), std::string::npos)
+      << result->error_message;
+  // Checked stdout is not streamed.
+  EXPECT_EQ(cap.combined.find('5'), std::string::npos) << cap.combined;
+}
+
+TEST(SandboxTest, VerifiedRunChecksCachedOutput) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  const std::string code = "print('0.3333333 done')\n";
+  OutputExpectation expectation;
+  expectation.expected = "0.33333333333   done";
+  expectation.mode = OutputExpectation::Mode::kFloatTolerance;
+
+  OutputCapture cap;
+  auto fresh =
+      sandbox->CompileAndRunStreaming("python", code, "", cap.MakeCallback(),
+                                      expectation);
+  ASSERT_TRUE(fresh.ok()) << fresh.status();
+  EXPECT_TRUE(fresh->success) << fresh->error_message;
+  EXPECT_EQ(fresh->verdict.kind, OutputVerdict::Kind::kAccepted);
+  EXPECT_TRUE(cap.combined.empty()) << cap.combined;
+
+  // Verified runs are not cached; an unverified one is, and a later
+  // verified run checks the cached stdout.
+  auto plain =
+      sandbox->CompileAndRunStreaming("python", code, "", cap.MakeCallback());
+  ASSERT_TRUE(plain.ok()) << plain.status();
+  EXPECT_FALSE(plain->cache_hit);
+  EXPECT_EQ(plain->verdict.kind, OutputVerdict::Kind::kNotChecked);
+
+  expectation.expected = "0.33 done";
+  auto cached =
+      sandbox->CompileAndRunStreaming("python", code, "", cap.MakeCallback(),
+                                      expectation);
+  ASSERT_TRUE(cached.ok()) << cached.status();
+  EXPECT_TRUE(cached->cache_hit);
+  EXPECT_FALSE(cached->success);
+  EXPECT_EQ(cached->verdict.kind, OutputVerdict::Kind::kWrongAnswer);
+}
+
+TEST(SandboxTest, SupervisedVerifiedRunStopsAtFirstDifference) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto supervisor = SandboxSupervisor::Create(1);
+  if (!supervisor.ok()) GTEST_SKIP() << supervisor.status();
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000),
+      CompilationServices{}, *std::move(supervisor));
+
+  OutputExpectation expectation;
+  expectation.expected = "yes\n";
+  expectation.mode = OutputExpectation::Mode::kTokens;
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result;
+  absl::Notification done;
+  const absl::Time start = absl::Now();
+  sandbox->CompileAndRunAsync(
+      "python", "import time\nprint('no', flush=True)\ntime.sleep(30)\n",
+      /*stdin_data=*/"", cap.MakeCallback(),
+      [&](absl::StatusOr<ExecutionResult> r) {
+        result = std::move(r);
+        done.Notify();
+      },
+      expectation);
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(60)));
+
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+  EXPECT_EQ(result->verdict.kind, OutputVerdict::Kind::kWrongAnswer);
+  EXPECT_NE(result->verdict.actual_excerpt.find("no"), std::string::npos)
+      << result->verdict.actual_excerpt;
+  EXPECT_FALSE(result->wall_clock_timeout);
+}
+
+// =============================================================================
+// Prepared programs: built once, then run with different stdin without any
+// compile step.
+// =============================================================================
+
+TEST(SandboxTest, PreparedProgramRunsWithoutRecompiling) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  auto prepared = sandbox->Prepare("cpp", R"(
+#include <iostream>
+int main() {
+  int x = 0;
+  std::cin >> x;
+  std::cout << "tripled=" << x * 3 << std::endl;
+  return 0;
+}
+)",
+                                   nullptr);
+  ASSERT_TRUE(prepared.ok()) << prepared.status();
+  ASSERT_TRUE(prepared->result.success) << prepared->result.error_message;
+  ASSERT_NE(prepared->program, nullptr);
+  const std::string binary = prepared->program->path();
+
+  for (const auto& [input, expected] :
+       {std::pair{"2\n", "tripled=6"}, std::pair{"5\n", "tripled=15"}}) {
+    OutputCapture cap;
+    absl::StatusOr<ExecutionResult> result;
+    sandbox->RunPreparedAsync(prepared->program, input, cap.MakeCallback(),
+                              [&](absl::StatusOr<ExecutionResult> r) {
+                                result = std::move(r);
+                              });
+    ASSERT_TRUE(result.ok()) << result.status();
+    EXPECT_TRUE(result->success) << result->error_message;
+    EXPECT_NE(cap.combined.find(expected), std::string::npos)
+        << "Got: " << cap.combined;
+    EXPECT_EQ(result->backend_trace.find("Compil"), std::string::npos)
+        << "Trace: " << result->backend_trace;
+  }
+
+  // The binary lives exactly as long as the last reference to the program.
+  EXPECT_EQ(access(binary.c_str(), X_OK), 0);
+  prepared->program.reset();
+  EXPECT_NE(access(binary.c_str(), F_OK), 0);
+}
+
+TEST(SandboxTest, PrepareReportsCompileErrorWithoutProgram) {
+  auto sandbox = MakeSandbox();
+  auto prepared = sandbox->Prepare("cpp", "int main() { return x; }", nullptr);
+  ASSERT_TRUE(prepared.ok()) << prepared.status();
+  EXPECT_FALSE(prepared->result.success);
+  EXPECT_FALSE(prepared->result.diagnostics.empty());
+  EXPECT_EQ(prepared->program, nullptr);
+}
+
+TEST(SandboxTest, PreparedProgramRunsFromForkServer) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  std::string stub_dir =
+      absl::StrCat(testing::TempDir(), "/sandbox_fork_server_XXXXXX");
+  ASSERT_NE(mkdtemp(stub_dir.data()), nullptr);
+  auto stub = ForkServerStub::Create(stub_dir, "clang");
+  ASSERT_TRUE(stub.ok()) << stub.status();
+
+  CompilationServices services;
+  services.fork_server_stub = *stub;
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+  ASSERT_TRUE(sandbox->CanForkPrograms());
+
+  auto prepared = sandbox->Prepare("cpp", R"(
+#include <iostream>
+int main() {
+  int x = 0;
+  std::cin >> x;
+  std::cout << "doubled=" << x * 2 << std::endl;
+  return 0;
+}
+)",
+                                   nullptr);
+  ASSERT_TRUE(prepared.ok()) << prepared.status();
+  ASSERT_TRUE(prepared->result.success) << prepared->result.error_message;
+  ASSERT_NE(prepared->program->fork_server(), nullptr);
+
+  for (const auto& [input, expected] :
+       {std::pair{"4\n", "doubled=8"}, std::pair{"21\n", "doubled=42"}}) {
+    OutputCapture cap;
+    absl::StatusOr<ExecutionResult> result;
+    sandbox->RunPreparedAsync(prepared->program, input, cap.MakeCallback(),
+                              [&](absl::StatusOr<ExecutionResult> r) {
+                                result = std::move(r);
+                              });
+    ASSERT_TRUE(result.ok()) << result.status();
+    EXPECT_TRUE(result->success) << result->error_message;
+    EXPECT_NE(cap.combined.find(expected), std::string::npos)
+        << "Got: " << cap.combined;
+    EXPECT_NE(result->backend_trace.find("Forked from fork server"),
+              std::string::npos)
+        << "Trace: " << result->backend_trace;
+  }
+}
+
+TEST(SandboxTest, PythonRunsFromZygote) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  CompilationServices services;
+  services.python_zygote =
+      std::make_shared<PythonZygote>(1, std::vector<std::string>{"math"});
+  ASSERT_TRUE(services.python_zygote->Start().ok());
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+
+  for (const auto& [input, expected] :
+       {std::pair{"4\n", "doubled=8"}, std::pair{"21\n", "doubled=42"}}) {
+    OutputCapture cap;
+    auto result = sandbox->CompileAndRunStreaming(
+        ".py", "print(f'doubled={int(input()) * 2}')\n", input,
+        cap.MakeCallback());
+    ASSERT_TRUE(result.ok()) << result.status();
+    EXPECT_TRUE(result->success) << result->error_message;
+    EXPECT_NE(cap.combined.find(expected), std::string::npos)
+        << "Got: " << cap.combined;
+    EXPECT_NE(result->backend_trace.find("Forked from fork server"),
+              std::string::npos)
+        << "Trace: " << result->backend_trace;
+  }
+}
+
+// =============================================================================
+// Worker warm state: runs on a worker of their language use its workspace,
+// pipes, toolchain path and, for Python, its zygote.
+// =============================================================================
+
+// Runs `body` on a worker and signals when it returns.
+class FunctionTask : public WorkerTask {
+ public:
+  explicit FunctionTask(std::function<void()> body) : body_(std::move(body)) {}
+  void StartExecution() override { body_(); }
+  void PumpWrites() override { done.Notify(); }
+
+  absl::Notification done;
+
+ private:
+  std::function<void()> body_;
+};
+
+TEST(SandboxTest, RunsUseTheirWorkersWarmState) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  DynamicWorkerCoordinator::Options opts;
+  opts.min_workers = 2;  // 1 C++, 1 Python.
+  opts.max_workers = 2;
+  opts.balance_period = absl::Seconds(60);
+  opts.warm_state_factory =
+      SandboxWarmState::Factory({.python_zygote = true, .preload_modules = {}});
+  DynamicWorkerCoordinator workers(opts);
+  workers.Start();
+  // No shared zygote: Python runs fork from their worker's.
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000));
+
+  std::string workspace;
+  absl::StatusOr<ExecutionResult> result;
+  OutputCapture py_cap;
+  auto py_task = std::make_shared<FunctionTask>([&] {
+    workspace = SandboxWarmState::Current()->workspace();
+    result = sandbox->CompileAndRunStreaming(
+        ".py", "import sys\nprint(sys.argv[0])\n", "", py_cap.MakeCallback());
+  });
+  auto lease = workers.LeaseWorker(LanguageId::kPython, py_task);
+  ASSERT_TRUE(lease.ok());
+  py_task->done.WaitForNotification();
+  workers.ReleaseWorker(*lease);
+  ASSERT_FALSE(workspace.empty());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  EXPECT_TRUE(py_cap.combined.starts_with(workspace + "/"))
+      << "Got: " << py_cap.combined;
+  EXPECT_NE(result->backend_trace.find("Forked from fork server"),
+            std::string::npos)
+      << "Trace: " << result->backend_trace;
+
+  bool pipes_left = true;
+  const std::string* compiler = nullptr;
+  OutputCapture cpp_cap;
+  auto cpp_task = std::make_shared<FunctionTask>([&] {
+    SandboxWarmState* warm = SandboxWarmState::Current();
+    compiler = warm->ResolvedPath("clang++");
+    result = sandbox->CompileAndRunStreaming(
+        ".cpp", "#include <cstdio>\nint main() { std::puts(\"warm\"); }\n",
+        "", cpp_cap.MakeCallback());
+    // Taken by the compile, until the worker resets.
+    internal::PipePair out, err;
+    pipes_left = warm->TakePipes(out, err);
+  });
+  lease = workers.LeaseWorker(LanguageId::kCpp, cpp_task);
+  ASSERT_TRUE(lease.ok());
+  cpp_task->done.WaitForNotification();
+  workers.ReleaseWorker(*lease);
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  EXPECT_NE(cpp_cap.combined.find("warm"), std::string::npos);
+  EXPECT_FALSE(pipes_left);
+  ASSERT_NE(compiler, nullptr);
+  EXPECT_TRUE(compiler->starts_with("/")) << *compiler;
+
+  const auto metrics = workers.GetMetrics();
+  EXPECT_EQ(metrics.affinity_hits, 2);
+  workers.Shutdown();
+}
+
+TEST(SandboxTest, RunsJoinTheirWorkersNamespaces) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  DynamicWorkerCoordinator::Options opts;
+  opts.min_workers = 2;  // 1 C++, 1 Python.
+  opts.max_workers = 2;
+  opts.balance_period = absl::Seconds(60);
+  opts.warm_state_factory = SandboxWarmState::Factory(
+      {.python_zygote = true,
+       .preload_modules = {},
+       .namespaces = *SandboxNamespaces::ParseKinds(
+           {"user", "mount", "pid", "net", "ipc"})});
+  DynamicWorkerCoordinator workers(opts);
+  workers.Start();
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000));
+
+  bool has_namespaces = false;
+  absl::StatusOr<ExecutionResult> result;
+  OutputCapture cap;
+  auto task = std::make_shared<FunctionTask>([&] {
+    has_namespaces = SandboxWarmState::Current()->namespaces() != nullptr;
+    result = sandbox->CompileAndRunStreaming(
+        ".py", "import os\nprint(os.readlink('/proc/self/ns/net'))\n", "",
+        cap.MakeCallback());
+  });
+  auto lease = workers.LeaseWorker(LanguageId::kPython, task);
+  ASSERT_TRUE(lease.ok());
+  task->done.WaitForNotification();
+  workers.ReleaseWorker(*lease);
+  workers.Shutdown();
+  if (!has_namespaces) {
+    GTEST_SKIP() << "Namespaces unavailable here";
+  }
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  char ours[64] = {};
+  ASSERT_GT(readlink("/proc/self/ns/net", ours, sizeof(ours) - 1), 0);
+  EXPECT_TRUE(cap.combined.starts_with("net:[")) << cap.combined;
+  EXPECT_EQ(cap.combined.find(ours), std::string::npos) << cap.combined;
+  // The worker's zygote cannot place runs in the namespaces.
+  EXPECT_NE(result->backend_trace.find("Running in worker namespaces"),
+            std::string::npos)
+      << "Trace: " << result->backend_trace;
+}
+
+// =============================================================================
+// Artifact cache: the same source with different stdin compiles only once.
+// =============================================================================
+
+TEST(SandboxTest, ArtifactReusedAcrossStdin) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto artifact_cache = MakeArtifactCache("sandbox_artifacts");
+  ASSERT_NE(artifact_cache, nullptr);
+
+  CompilationServices services;
+  services.artifact_cache = artifact_cache;
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+
+  const std::string code = R"(
+#include <iostream>
+int main() {
+  int x = 0;
+  std::cin >> x;
+  std::cout << "doubled=" << x * 2 << std::endl;
+  return 0;
+}
+)";
+
+  {
+    OutputCapture cap;
+    auto r = sandbox->CompileAndRunStreaming("cpp", code, "21\n",
+                                             cap.MakeCallback());
+    ASSERT_TRUE(r.ok()) << r.status();
+    ASSERT_TRUE(r->success) << r->error_message;
+    EXPECT_NE(cap.combined.find("doubled=42"), std::string::npos)
+        << "Got: " << cap.combined;
+  }
+
+  // A different stdin misses the result cache but must hit the artifact cache.
+  {
+    OutputCapture cap;
+    auto r = sandbox->CompileAndRunStreaming("cpp", code, "50\n",
+                                             cap.MakeCallback());
+    ASSERT_TRUE(r.ok()) << r.status();
+    ASSERT_TRUE(r->success) << r->error_message;
+    EXPECT_FALSE(r->cache_hit);
+    EXPECT_NE(cap.combined.find("doubled=100"), std::string::npos)
+        << "Got: " << cap.combined;
+    EXPECT_NE(r->backend_trace.find("Reusing compiled artifact"),
+              std::string::npos)
+        << "Trace: " << r->backend_trace;
+  }
+
+  const auto stats = sandbox->GetMetrics().artifact_stats;
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.entries, 1u);
+}
+
+TEST(SandboxTest, HotSourceIsPromotedToOptimizedBuild) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto artifact_cache = MakeArtifactCache("sandbox_tiers");
+  ASSERT_NE(artifact_cache, nullptr);
+
+  TieredCompilationManager::Options options;
+  options.promotion_threshold = 2;
+  CompilationServices services;
+  services.artifact_cache = artifact_cache;
+  services.tiering = std::make_shared<TieredCompilationManager>(options);
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+
+  const std::string code = R"(
+#include <iostream>
+int main() {
+  int x = 0;
+  std::cin >> x;
+  std::cout << "tripled=" << x * 3 << std::endl;
+  return 0;
+}
+)";
+  auto run = [&](const std::string& input) {
+    OutputCapture cap;
+    auto r = sandbox->CompileAndRunStreaming("cpp", code, input,
+                                             cap.MakeCallback());
+    EXPECT_TRUE(r.ok()) << r.status();
+    return r.ok() ? *r : ExecutionResult{};
+  };
+
+  // First run compiles at the fast tier; the second (a fast-tier cache hit)
+  // reaches the threshold and schedules the background rebuild.
+  EXPECT_TRUE(run("1\n").success);
+  EXPECT_TRUE(run("2\n").success);
+
+  const absl::Time deadline = absl::Now() + absl::Seconds(60);
+  while (sandbox->GetMetrics().tier_stats.promotions == 0 &&
+         absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(50));
+  }
+  ASSERT_EQ(sandbox->GetMetrics().tier_stats.promotions, 1);
+
+  const ExecutionResult promoted = run("3\n");
+  EXPECT_TRUE(promoted.success) << promoted.error_message;
+  EXPECT_NE(promoted.backend_trace.find("Reusing optimized artifact"),
+            std::string::npos)
+      << "Trace: " << promoted.backend_trace;
+
+  const auto tiers = sandbox->GetMetrics().tier_stats;
+  EXPECT_EQ(tiers.fast_compiles, 1);
+  EXPECT_EQ(tiers.fast_hits, 1);
+  EXPECT_EQ(tiers.optimized_hits, 1);
+  // The fast build is retired once the optimized one is published.
+  EXPECT_EQ(sandbox->GetMetrics().artifact_stats.entries, 1u);
+}
+
+TEST(SandboxTest, SpeculativeCompileIsReusedByRequest) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto artifact_cache = MakeArtifactCache("sandbox_speculative");
+  ASSERT_NE(artifact_cache, nullptr);
+
+  CompilationServices services;
+  services.artifact_cache = artifact_cache;
+  services.single_flight = std::make_shared<CompileSingleFlight>();
+  services.speculation_executor = std::make_shared<BoundedExecutor>(1, 4);
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+
+  const std::string code = R"(
+#include <iostream>
+int main() { std::cout << "speculated" << std::endl; return 0; }
+)";
+  ASSERT_TRUE(sandbox->SpeculativeCompile("cpp", code));
+
+  // Stand-in for the lease wait: give the background compile time to land.
+  const absl::Time deadline = absl::Now() + absl::Seconds(60);
+  while (sandbox->GetMetrics().artifact_stats.entries == 0 &&
+         absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(20));
+  }
+
+  // The request itself must not invoke the compiler.
+  OutputCapture cap;
+  auto r = sandbox->CompileAndRunStreaming("cpp", code, "", cap.MakeCallback());
+  ASSERT_TRUE(r.ok()) << r.status();
+  ASSERT_TRUE(r->success) << r->error_message;
+  EXPECT_NE(cap.combined.find("speculated"), std::string::npos);
+  EXPECT_EQ(r->backend_trace.find("Compile: clang++"), std::string::npos)
+      << "Trace: " << r->backend_trace;
+  EXPECT_NE(r->backend_trace.find("Reusing compiled artifact"),
+            std::string::npos)
+      << "Trace: " << r->backend_trace;
+
+  // Small Python sources have nothing to speculate on, but are accepted.
+  EXPECT_TRUE(sandbox->SpeculativeCompile("py", "print(1)\n"));
+}
+
+// =============================================================================
+// Python bytecode: compiled once per source, with tracebacks that still quote
+// the source.
+// =============================================================================
+
+TEST(SandboxTest, PythonBytecodeReusedAcrossRuns) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_python_bytecode_min_bytes, 0);
+
+  auto artifact_cache = MakeArtifactCache("sandbox_bytecode");
+  ASSERT_NE(artifact_cache, nullptr);
+  CompilationServices services;
+  services.artifact_cache = artifact_cache;
+  auto sandbox = std::make_shared<SandboxedProcess>(
+      std::make_shared<ExecutionCache>(absl::Hours(1), 1000), services);
+
+  const std::string code =
+      "x = int(input())\n"
+      "print(x * 3)\n"
+      "if x < 0:\n"
+      "    raise ValueError('negative')\n";
+  OutputCapture first;
+  auto r = sandbox->CompileAndRunStreaming(".py", code, "2\n",
+                                           first.MakeCallback());
+  ASSERT_TRUE(r.ok()) << r.status();
+  EXPECT_EQ(first.combined, "6\n");
+  EXPECT_NE(r->backend_trace.find("CompileBytecode"), std::string::npos)
+      << "Trace: " << r->backend_trace;
+  EXPECT_EQ(sandbox->GetMetrics().artifact_stats.entries, 1u);
+
+  OutputCapture second;
+  r = sandbox->CompileAndRunStreaming(".py", code, "5\n",
+                                      second.MakeCallback());
+  ASSERT_TRUE(r.ok()) << r.status();
+  EXPECT_EQ(second.combined, "15\n");
+  EXPECT_NE(r->backend_trace.find("Reusing bytecode"), std::string::npos)
+      << "Trace: " << r->backend_trace;
+
+  OutputCapture failing;
+  r = sandbox->CompileAndRunStreaming(".py", code, "-1\n",
+                                      failing.MakeCallback());
+  EXPECT_FALSE(r.ok());
+  EXPECT_NE(failing.combined.find("File \"main.py\", line 4"),
+            std::string::npos)
+      << failing.combined;
+  EXPECT_NE(failing.combined.find("raise ValueError('negative')"),
+            std::string::npos)
+      << failing.combined;
+
+  // A source that does not compile runs as it is and reports its error.
+  OutputCapture syntax;
+  r = sandbox->CompileAndRunStreaming(".py", "print(1\n", "",
+                                      syntax.MakeCallback());
+  EXPECT_FALSE(r.ok());
+  EXPECT_NE(syntax.combined.find("SyntaxError"), std::string::npos)
+      << syntax.combined;
+  EXPECT_EQ(sandbox->GetMetrics().artifact_stats.entries, 1u);
+
+  absl::SetFlag(&FLAGS_python_bytecode_min_bytes, 32 * 1024);
+}
+
 // =============================================================================
 // Non-zero exit code: verify the error message captures the actual exit status.
 // =============================================================================
@@ -515,6 +1454,114 @@ int main() {
       << "Large allocation should have failed due to RLIMIT_AS";
 }
 
+TEST(SandboxTest, Linux_CompileMemoryLimitIsEnforced) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  const uint64_t saved = absl::GetFlag(FLAGS_compile_memory_limit_bytes);
+  // Far too little for the compiler driver to start its back end.
+  absl::SetFlag(&FLAGS_compile_memory_limit_bytes, 16ULL * 1024 * 1024);
+
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "cpp", "#include <iostream>\nint main() { std::cout << \"ran\"; }\n",
+      /*stdin_data=*/"", cap.MakeCallback());
+  absl::SetFlag(&FLAGS_compile_memory_limit_bytes, saved);
+
+  EXPECT_FALSE(result.ok() && result->success)
+      << "Compile should fail under a 16 MiB address-space limit";
+  EXPECT_EQ(cap.combined.find("ran"), std::string::npos);
+}
+
+TEST(SandboxTest, Linux_GrandchildrenDieWithTheProgram) {
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+
+  // The grandchild inherits stdout and would outlive the program.
+  const absl::Time start = absl::Now();
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python",
+      "import os, time\n"
+      "pid = os.fork()\n"
+      "if pid == 0:\n"
+      "    time.sleep(30)\n"
+      "    os._exit(0)\n"
+      "print(pid, flush=True)\n",
+      /*stdin_data=*/"", cap.MakeCallback());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+
+  // The program's process group is killed once it exits, so the grandchild
+  // is gone (or a zombie awaiting its new parent) shortly afterwards.
+  const std::string stat_path =
+      absl::StrCat("/proc/", std::stol(cap.combined), "/stat");
+  bool grandchild_dead = false;
+  for (int i = 0; i < 200 && !grandchild_dead; ++i) {
+    std::ifstream stat(stat_path);
+    std::string pid_field, comm, state;
+    grandchild_dead = !(stat >> pid_field >> comm >> state) || state == "Z";
+    if (!grandchild_dead) absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_TRUE(grandchild_dead);
+}
+
+TEST(SandboxTest, Linux_IoUringBackendCapturesOutputAndDeadlines) {
+  if (!internal::ProcessRunner::IoUringSupported()) {
+    GTEST_SKIP() << "io_uring unavailable";
+  }
+  absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
+  absl::SetFlag(&FLAGS_sandbox_memory_limit_bytes, 256ULL * 1024 * 1024);
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 1024ULL * 1024ULL);
+  absl::SetFlag(&FLAGS_sandbox_io_uring, true);
+
+  // Several registered-buffer reads' worth on stdout, plus stderr.
+  auto sandbox = MakeSandbox();
+  OutputCapture cap;
+  absl::StatusOr<ExecutionResult> result = sandbox->CompileAndRunStreaming(
+      "python",
+      "import sys\nsys.stdout.write('x' * 300000)\n"
+      "sys.stderr.write('tail-on-stderr')\n",
+      /*stdin_data=*/"", cap.MakeCallback());
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_TRUE(result->success) << result->error_message;
+  EXPECT_EQ(cap.combined.size(), 300000U + 14U);
+
+  // Over the output cap: truncated, as with epoll.
+  absl::SetFlag(&FLAGS_sandbox_max_output_bytes, 64ULL * 1024ULL);
+  OutputCapture truncated_cap;
+  result = sandbox->CompileAndRunStreaming(
+      "python", "print('y' * 200000)\n", /*stdin_data=*/"",
+      truncated_cap.MakeCallback());
+  EXPECT_FALSE(result.ok());
+  EXPECT_NE(truncated_cap.combined.find("truncated"), std::string::npos);
+
+  // Deadline enforced by the TIMEOUT operation.
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::Milliseconds(300));
+  const absl::Time start = absl::Now();
+  OutputCapture timeout_cap;
+  result = sandbox->CompileAndRunStreaming(
+      "python", "import time\nwhile True:\n    time.sleep(0.01)\n",
+      /*stdin_data=*/"", timeout_cap.MakeCallback());
+  const absl::Duration elapsed = absl::Now() - start;
+  absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout, absl::ZeroDuration());
+  absl::SetFlag(&FLAGS_sandbox_io_uring, false);
+
+  EXPECT_FALSE(result.ok());
+  EXPECT_NE(std::string(result.status().message()).find("timeout"),
+            std::string::npos)
+      << result.status();
+  EXPECT_LT(elapsed, absl::Seconds(2));
+}
+
 TEST(SandboxTest, Linux_ResourceStatsPopulated) {
   absl::SetFlag(&FLAGS_sandbox_cpu_time_limit_seconds, 5);
   absl::SetFlag(&FLAGS_sandbox_wall_clock_timeout_seconds, 10);
@@ -0,0 +1,196 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/sandbox_warm_state.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "src/engine/language_toolchain.h"
+#include "src/engine/sandbox.h"
+
+namespace dcodex {
+
+namespace {
+
+// The toolchain programs runs of `lang` exec by name.
+std::vector<std::string> ToolchainPrograms(LanguageId lang) {
+  switch (lang) {
+    case LanguageId::kCpp:
+      return {std::string(LanguageToolchainFactory::CreateCpp()->GetExecutable()),
+              std::string(LanguageToolchainFactory::CreateC()->GetExecutable())};
+    case LanguageId::kPython:
+      return {std::string(
+          LanguageToolchainFactory::CreatePython()->GetExecutable())};
+    default:
+      return {};
+  }
+}
+
+// Searches PATH for `program` as execvp() would.
+std::string SearchPath(const std::string& program) {
+  const char* path = getenv("PATH");
+  if (path == nullptr) return "";
+  for (absl::string_view dir : absl::StrSplit(path, ':', absl::SkipEmpty())) {
+    std::string candidate = absl::StrCat(dir, "/", program);
+    struct stat st {};
+    if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+        access(candidate.c_str(), X_OK) == 0) {
+      return candidate;
+    }
+  }
+  return "";
+}
+
+}  // namespace
+
+std::function<std::unique_ptr<WorkerWarmState>(LanguageId)>
+SandboxWarmState::Factory(Options options) {
+  return [options = std::move(options)](LanguageId lang) {
+    return std::make_unique<SandboxWarmState>(lang, options);
+  };
+}
+
+SandboxWarmState::SandboxWarmState(LanguageId lang, Options options)
+    : lang_(lang), namespace_kinds_(options.namespaces) {
+  CreateWorkspace();
+  CreatePipes();
+  CreateNamespaces();
+  for (std::string& program : ToolchainPrograms(lang_)) {
+    if (std::string resolved = SearchPath(program); !resolved.empty()) {
+      resolved_paths_.emplace(std::move(program), std::move(resolved));
+    }
+  }
+  if (lang_ == LanguageId::kPython && options.python_zygote) {
+    python_zygote_ = std::make_unique<PythonZygote>(
+        1, std::move(options.preload_modules));
+    // A zygote that fails to start leaves the worker's runs to the shared
+    // zygotes, or to `python3 -u`.
+    (void)python_zygote_->Start();
+  }
+}
+
+SandboxWarmState::~SandboxWarmState() {
+  if (!workspace_.empty()) {
+    // Fails, keeping it, while a prepared program still has files in it.
+    rmdir(workspace_.c_str());
+  }
+}
+
+SandboxWarmState* SandboxWarmState::Current() {
+  return dynamic_cast<SandboxWarmState*>(WorkerWarmState::Current());
+}
+
+void SandboxWarmState::Reset() {
+  struct stat st {};
+  if (workspace_.empty() || stat(workspace_.c_str(), &st) != 0) {
+    CreateWorkspace();
+  }
+  CreatePipes();
+  if (namespaces_ != nullptr) {
+    if (absl::Status status = namespaces_->Reset(); !status.ok()) {
+      LOG(WARNING) << "Recreating worker namespaces: " << status;
+      namespaces_.reset();
+      CreateNamespaces();
+    }
+  }
+}
+
+absl::StatusOr<std::string> SandboxWarmState::WriteFile(
+    absl::string_view extension, absl::string_view content) {
+  if (workspace_.empty()) {
+    return absl::FailedPreconditionError("Worker has no workspace");
+  }
+  std::string path = absl::StrCat(workspace_, "/", next_file_++, extension);
+  internal::FileDescriptor file(
+      open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600));
+  if (!file.IsValid()) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to create ", path));
+  }
+  while (!content.empty()) {
+    const ssize_t written = write(file.Get(), content.data(), content.size());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      const absl::Status status =
+          absl::ErrnoToStatus(errno, absl::StrCat("Failed to write ", path));
+      unlink(path.c_str());
+      return status;
+    }
+    content.remove_prefix(static_cast<size_t>(written));
+  }
+  return path;
+}
+
+bool SandboxWarmState::TakePipes(internal::PipePair& stdout_p,
+                                 internal::PipePair& stderr_p) {
+  if (!pipes_ready_) return false;
+  stdout_p = std::move(stdout_p_);
+  stderr_p = std::move(stderr_p_);
+  pipes_ready_ = false;
+  return true;
+}
+
+const std::string* SandboxWarmState::ResolvedPath(
+    absl::string_view program) const {
+  auto it = resolved_paths_.find(program);
+  return it == resolved_paths_.end() ? nullptr : &it->second;
+}
+
+void SandboxWarmState::CreateWorkspace() {
+  char dir_template[] = "/tmp/dcodex_worker_XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    LOG(WARNING) << "Worker workspace unavailable: " << strerror(errno);
+    workspace_.clear();
+    return;
+  }
+  workspace_ = dir_template;
+}
+
+void SandboxWarmState::CreatePipes() {
+  if (pipes_ready_) return;
+  // Close-on-exec, as children that other workers spawn meanwhile must not
+  // hold them; a run's dup2() onto the child's stdio clears the flag.
+  if (!stdout_p_.Create(O_CLOEXEC) || !stderr_p_.Create(O_CLOEXEC)) {
+    return;
+  }
+  if (const uint64_t capacity = absl::GetFlag(FLAGS_sandbox_pipe_buffer_bytes);
+      capacity > 0) {
+    (void)stdout_p_.SetCapacity(capacity);
+    (void)stderr_p_.SetCapacity(capacity);
+  }
+  pipes_ready_ = true;
+}
+
+void SandboxWarmState::CreateNamespaces() {
+  if (namespace_kinds_ == 0) return;
+  absl::StatusOr<std::unique_ptr<SandboxNamespaces>> namespaces =
+      SandboxNamespaces::Create(namespace_kinds_);
+  if (!namespaces.ok()) {
+    LOG(WARNING) << "Worker namespaces unavailable: " << namespaces.status();
+    return;
+  }
+  namespaces_ = *std::move(namespaces);
+}
+
+}  // namespace dcodex
@@ -0,0 +1,139 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_SANDBOX_WARM_STATE_H_
+#define SRC_ENGINE_SANDBOX_WARM_STATE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "src/engine/dynamic_worker_coordinator.h"
+#include "src/engine/process_runner.h"
+#include "src/engine/python_zygote.h"
+#include "src/engine/sandbox_namespaces.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// SandboxWarmState: what a worker sets up for its language ahead of the runs
+// it serves, so that a run on a worker of its own language skips that setup.
+//
+//   workspace  a private directory the worker's source files are written to,
+//              by sequence number instead of mkstemp() in the shared /tmp
+//   pipes      the next run's stdout and stderr pipes, already created and
+//              enlarged to --sandbox_pipe_buffer_bytes
+//   toolchain  absolute paths of the language's compilers or interpreter,
+//              resolved from PATH once instead of by every exec
+//   zygote     for Python workers, a PythonZygote of their own
+//   namespaces with Options::namespaces, a SandboxNamespaces set the
+//              worker's sandboxed runs join
+//
+// The sandbox finds the state through WorkerWarmState::Current(), so runs
+// off worker threads, or on a worker of another language, fall back to
+// doing the setup themselves. Reset() replaces the pipes a run took and
+// restores the workspace if something removed it; the zygote restarts
+// itself, as any ForkServer does. The namespaces reset their PID namespace
+// and scratch mount, and are created anew if their holder died. Files in the
+// workspace belong to the runs that wrote them, which remove them; a run may
+// still be in progress when its worker resets.
+// Not thread-safe: used by its worker's thread only.
+// -----------------------------------------------------------------------------
+class SandboxWarmState : public WorkerWarmState {
+ public:
+  struct Options {
+    // Whether Python workers fork their runs from a zygote of their own.
+    bool python_zygote = false;
+    // Modules that zygote imports up front; see PythonZygote.
+    std::vector<std::string> preload_modules;
+    // CLONE_NEW* flags of the namespaces each worker's sandboxed runs are
+    // placed in; see SandboxNamespaces::ParseKinds(). Zero for none.
+    int namespaces = 0;
+  };
+
+  // For DynamicWorkerCoordinatorOptions::warm_state_factory.
+  [[nodiscard]] static std::function<
+      std::unique_ptr<WorkerWarmState>(LanguageId)>
+  Factory(Options options);
+
+  // Sets everything up now. A part that cannot be set up is left out, and
+  // runs do that setup themselves.
+  SandboxWarmState(LanguageId lang, Options options);
+  // Removes the workspace if the runs left it empty.
+  ~SandboxWarmState() override;
+
+  SandboxWarmState(const SandboxWarmState&) = delete;
+  SandboxWarmState& operator=(const SandboxWarmState&) = delete;
+
+  void Reset() override;
+
+  // The calling worker's state, or null off worker threads and on workers
+  // built without SandboxWarmState.
+  [[nodiscard]] static SandboxWarmState* Current();
+
+  // Writes `content` to a new file in the workspace, named with `extension`,
+  // and returns its path.
+  [[nodiscard]] absl::StatusOr<std::string> WriteFile(
+      absl::string_view extension, absl::string_view content);
+
+  // Moves the prepared pipes into `stdout_p` and `stderr_p`. Returns false,
+  // leaving them alone, when a run since the last Reset() took them.
+  bool TakePipes(internal::PipePair& stdout_p, internal::PipePair& stderr_p);
+
+  // The absolute path `program` resolved to, or null when it is not one of
+  // the language's toolchain programs or was not found on PATH.
+  [[nodiscard]] const std::string* ResolvedPath(
+      absl::string_view program) const;
+
+  // The worker's zygote, or null when it has none.
+  [[nodiscard]] PythonZygote* python_zygote() const {
+    return python_zygote_.get();
+  }
+
+  // The worker's namespaces, or null when it has none.
+  [[nodiscard]] const SandboxNamespaces* namespaces() const {
+    return namespaces_.get();
+  }
+
+  [[nodiscard]] LanguageId language() const { return lang_; }
+  [[nodiscard]] const std::string& workspace() const { return workspace_; }
+
+ private:
+  // Creates the workspace directory; leaves workspace_ empty on failure.
+  void CreateWorkspace();
+  // Creates the next run's pipes unless they are still there.
+  void CreatePipes();
+  // Creates the namespaces; leaves namespaces_ null on failure.
+  void CreateNamespaces();
+
+  const LanguageId lang_;
+  std::string workspace_;
+  uint64_t next_file_ = 0;
+  internal::PipePair stdout_p_;
+  internal::PipePair stderr_p_;
+  bool pipes_ready_ = false;
+  absl::flat_hash_map<std::string, std::string> resolved_paths_;
+  std::unique_ptr<PythonZygote> python_zygote_;
+  const int namespace_kinds_;
+  std::unique_ptr<SandboxNamespaces> namespaces_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_SANDBOX_WARM_STATE_H_
@@ -0,0 +1,128 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// spawn_benchmark: measures the latency of spawning a child with rlimits via
+// fork()+exec versus clone(CLONE_VM|CLONE_VFORK)+exec, as a function of the
+// spawning process's resident set size.
+//
+//   bazel run -c opt //src/engine:spawn_benchmark -- --rss_mb=0,1024,4096
+//
+// For each RSS level the benchmark first grows and touches a ballast
+// allocation so the page tables are populated (as they are in a long-running
+// server with warm caches), then spawns /bin/true repeatedly through
+// ProcessRunner::SpawnProcess with each method and waits for it.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/engine/process_runner.h"
+
+ABSL_FLAG(std::vector<std::string>, rss_mb,
+          std::vector<std::string>({"0", "1024", "4096"}),
+          "Ballast sizes in MiB to hold resident while spawning");
+ABSL_FLAG(int, iterations, 200, "Spawns per method and RSS level");
+ABSL_FLAG(std::string, binary, "/bin/true", "Program to spawn");
+
+namespace dcodex {
+namespace {
+
+using internal::ProcessRunner;
+using internal::ResourceLimits;
+
+struct Latency {
+  absl::Duration p50;
+  absl::Duration p99;
+};
+
+// Spawns and reaps `argv` `iterations` times. Returns negative latencies if
+// any spawn fails.
+Latency MeasureSpawn(ProcessRunner::SpawnMethod method,
+                     const std::vector<std::string>& argv, int iterations) {
+  // Any rlimit routes SpawnProcess to the sandboxed paths under test.
+  const ResourceLimits limits{60, 0, absl::ZeroDuration()};
+  std::vector<absl::Duration> samples;
+  samples.reserve(static_cast<size_t>(iterations));
+  for (int i = 0; i < iterations; ++i) {
+    const absl::Time start = absl::Now();
+    const auto pid = ProcessRunner::SpawnProcess(
+        argv, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, limits, method);
+    if (!pid.ok()) {
+      LOG(ERROR) << "Spawn failed: " << pid.status();
+      return {absl::Seconds(-1), absl::Seconds(-1)};
+    }
+    // Spawn latency is what the server pays on the request thread, so stop
+    // the clock before waiting for the child to finish.
+    samples.push_back(absl::Now() - start);
+    int status = 0;
+    waitpid(*pid, &status, 0);
+  }
+  std::sort(samples.begin(), samples.end());
+  return {samples[samples.size() / 2], samples[samples.size() * 99 / 100]};
+}
+
+int RunBenchmark() {
+  const int iterations = std::max(1, absl::GetFlag(FLAGS_iterations));
+  const std::vector<std::string> argv = {absl::GetFlag(FLAGS_binary)};
+
+  absl::PrintF("%10s %12s %12s %12s %12s %8s\n", "rss_mb", "fork_p50_us",
+               "fork_p99_us", "clone_p50_us", "clone_p99_us", "speedup");
+  for (const std::string& level : absl::GetFlag(FLAGS_rss_mb)) {
+    const size_t rss_mb = std::stoul(level);
+    const size_t bytes = rss_mb * 1024 * 1024;
+    std::unique_ptr<char[]> ballast(bytes > 0 ? new char[bytes] : nullptr);
+    if (ballast != nullptr) {
+      // Touch every page so it is resident and mapped.
+      std::memset(ballast.get(), 1, bytes);
+    }
+
+    const Latency fork_latency =
+        MeasureSpawn(ProcessRunner::SpawnMethod::kFork, argv, iterations);
+    const Latency clone_latency =
+        MeasureSpawn(ProcessRunner::SpawnMethod::kCloneVfork, argv, iterations);
+    if (fork_latency.p50 < absl::ZeroDuration() ||
+        clone_latency.p50 < absl::ZeroDuration()) {
+      return 1;
+    }
+    absl::PrintF("%10d %12.1f %12.1f %12.1f %12.1f %7.2fx\n", rss_mb,
+                 absl::ToDoubleMicroseconds(fork_latency.p50),
+                 absl::ToDoubleMicroseconds(fork_latency.p99),
+                 absl::ToDoubleMicroseconds(clone_latency.p50),
+                 absl::ToDoubleMicroseconds(clone_latency.p99),
+                 absl::FDivDuration(fork_latency.p50, clone_latency.p50));
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace dcodex
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::ParseCommandLine(argc, argv);
+  return dcodex::RunBenchmark();
+}
@@ -0,0 +1,34 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_STARTUP_COMMAND_H_
+#define SRC_ENGINE_STARTUP_COMMAND_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+
+namespace dcodex {
+
+// Runs `argv` to completion with stdin from /dev/null and stdout/stderr in
+// `log_path`, failing unless it exits 0. For the builds that happen once at
+// startup, outside any request (precompiled headers, the fork server stub),
+// so it bypasses the sandbox and its output limits.
+absl::Status RunStartupCommand(const std::vector<std::string>& argv,
+                               const std::string& log_path);
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_STARTUP_COMMAND_H_
@@ -0,0 +1,94 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/tiered_compilation.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"
+
+namespace dcodex {
+
+TieredCompilationManager::TieredCompilationManager(Options options)
+    : options_(std::move(options)),
+      executor_(options_.promotion_threads, options_.max_queued_promotions) {}
+
+const std::vector<std::string>& TieredCompilationManager::FlagsFor(
+    Tier tier) const {
+  return tier == Tier::kOptimized ? options_.optimized_flags
+                                  : options_.fast_flags;
+}
+
+bool TieredCompilationManager::RecordUse(absl::string_view source_id) {
+  absl::MutexLock lock(&mutex_);
+  if (use_counts_.size() >= options_.max_tracked_sources &&
+      !use_counts_.contains(source_id)) {
+    // Crude but bounded: hot sources re-accumulate quickly.
+    use_counts_.clear();
+  }
+  int& count = use_counts_[source_id];
+  ++count;
+  if (count < options_.promotion_threshold || in_flight_.contains(source_id)) {
+    return false;
+  }
+  in_flight_.emplace(source_id);
+  use_counts_.erase(source_id);
+  return true;
+}
+
+void TieredCompilationManager::SchedulePromotion(
+    std::string source_id, std::function<bool()> promote) {
+  const absl::Status status = executor_.Submit(
+      [this, source_id, promote = std::move(promote)]() {
+        FinishPromotion(source_id, promote());
+      });
+  if (!status.ok()) {
+    VLOG(1) << "Promotion of " << source_id << " not scheduled: " << status;
+    absl::MutexLock lock(&mutex_);
+    in_flight_.erase(source_id);
+  }
+}
+
+void TieredCompilationManager::FinishPromotion(const std::string& source_id,
+                                               bool promoted) {
+  absl::MutexLock lock(&mutex_);
+  in_flight_.erase(source_id);
+  if (promoted) {
+    stats_.promotions++;
+  } else {
+    stats_.promotion_failures++;
+  }
+}
+
+void TieredCompilationManager::RecordCacheHit(Tier tier) {
+  absl::MutexLock lock(&mutex_);
+  if (tier == Tier::kOptimized) {
+    stats_.optimized_hits++;
+  } else {
+    stats_.fast_hits++;
+  }
+}
+
+void TieredCompilationManager::RecordFastCompile() {
+  absl::MutexLock lock(&mutex_);
+  stats_.fast_compiles++;
+}
+
+TieredCompilationManager::Stats TieredCompilationManager::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+}  // namespace dcodex
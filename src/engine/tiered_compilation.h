@@ -0,0 +1,111 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_ENGINE_TIERED_COMPILATION_H_
+#define SRC_ENGINE_TIERED_COMPILATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "src/engine/bounded_executor.h"
+
+namespace dcodex {
+
+// -----------------------------------------------------------------------------
+// TieredCompilationManager: two-tier compile policy for compiled languages.
+//
+// Every source is first built with a cheap "fast" profile. Sources seen at
+// least `promotion_threshold` times are rebuilt with the "optimized" profile
+// on a background executor; the optimized binary then replaces the fast one
+// in the artifact cache. One-off submissions never pay for -O2.
+//
+// This class owns the policy (use counts, in-flight promotions, counters) and
+// the executor; CompileStep owns the mechanics of compiling and caching.
+// -----------------------------------------------------------------------------
+class TieredCompilationManager {
+ public:
+  enum class Tier { kFast, kOptimized };
+
+  struct Options {
+    // Appended to the toolchain's standard flags for first builds.
+    std::vector<std::string> fast_flags = {"-O0", "-g0"};
+    // Appended to the toolchain's standard flags for promoted builds.
+    std::vector<std::string> optimized_flags = {"-O2"};
+    // Number of executions of one source that triggers promotion.
+    int promotion_threshold = 3;
+    // Background compiler concurrency and backlog.
+    size_t promotion_threads = 1;
+    size_t max_queued_promotions = 16;
+    // Bound on tracked sources; counts reset when exceeded.
+    size_t max_tracked_sources = 100000;
+  };
+
+  struct Stats {
+    int64_t fast_hits = 0;
+    int64_t optimized_hits = 0;
+    int64_t fast_compiles = 0;
+    int64_t promotions = 0;
+    int64_t promotion_failures = 0;
+  };
+
+  explicit TieredCompilationManager(Options options);
+  ~TieredCompilationManager() = default;
+
+  TieredCompilationManager(const TieredCompilationManager&) = delete;
+  TieredCompilationManager& operator=(const TieredCompilationManager&) = delete;
+
+  [[nodiscard]] const std::vector<std::string>& FlagsFor(Tier tier) const;
+
+  // Records one execution of the source identified by `source_id` and returns
+  // true exactly once, when the caller should schedule its promotion.
+  [[nodiscard]] bool RecordUse(absl::string_view source_id);
+
+  // Runs `promote` on the background executor. `promote` must return whether
+  // the optimized build succeeded. If the backlog is full the promotion is
+  // abandoned and the source becomes eligible again.
+  void SchedulePromotion(std::string source_id,
+                         std::function<bool()> promote);
+
+  void RecordCacheHit(Tier tier);
+  void RecordFastCompile();
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  void FinishPromotion(const std::string& source_id, bool promoted);
+
+  const Options options_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, int> use_counts_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_set<std::string> in_flight_ ABSL_GUARDED_BY(mutex_);
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+
+  // Declared last: destroyed (and joined) first, while the state above that
+  // running promotions touch is still alive.
+  BoundedExecutor executor_;
+};
+
+}  // namespace dcodex
+
+#endif  // SRC_ENGINE_TIERED_COMPILATION_H_
@@ -0,0 +1,99 @@
+// Copyright 2024 DCodeX Team
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/engine/tiered_compilation.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace dcodex {
+namespace {
+
+TieredCompilationManager::Options TestOptions() {
+  TieredCompilationManager::Options options;
+  options.promotion_threshold = 3;
+  return options;
+}
+
+// Polls until `pred` holds or a generous deadline passes.
+template <typename Pred>
+bool WaitFor(Pred pred) {
+  const absl::Time deadline = absl::Now() + absl::Seconds(5);
+  while (!pred()) {
+    if (absl::Now() > deadline) return false;
+    absl::SleepFor(absl::Milliseconds(5));
+  }
+  return true;
+}
+
+TEST(TieredCompilationTest, FlagsForTier) {
+  TieredCompilationManager manager(TestOptions());
+  EXPECT_EQ(manager.FlagsFor(TieredCompilationManager::Tier::kFast),
+            (std::vector<std::string>{"-O0", "-g0"}));
+  EXPECT_EQ(manager.FlagsFor(TieredCompilationManager::Tier::kOptimized),
+            (std::vector<std::string>{"-O2"}));
+}
+
+TEST(TieredCompilationTest, RecordUseFiresOnceAtThreshold) {
+  TieredCompilationManager manager(TestOptions());
+  EXPECT_FALSE(manager.RecordUse("a"));
+  EXPECT_FALSE(manager.RecordUse("a"));
+  EXPECT_FALSE(manager.RecordUse("b"));
+  EXPECT_TRUE(manager.RecordUse("a"));
+  // In flight: further uses must not schedule a duplicate promotion.
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_FALSE(manager.RecordUse("a"));
+  }
+}
+
+TEST(TieredCompilationTest, PromotionOutcomesAreCounted) {
+  TieredCompilationManager manager(TestOptions());
+  for (int i = 0; i < 2; ++i) (void)manager.RecordUse("ok");
+  ASSERT_TRUE(manager.RecordUse("ok"));
+  for (int i = 0; i < 2; ++i) (void)manager.RecordUse("bad");
+  ASSERT_TRUE(manager.RecordUse("bad"));
+
+  manager.SchedulePromotion("ok", [] { return true; });
+  manager.SchedulePromotion("bad", [] { return false; });
+  ASSERT_TRUE(WaitFor([&] {
+    const auto stats = manager.GetStats();
+    return stats.promotions + stats.promotion_failures == 2;
+  }));
+  const auto stats = manager.GetStats();
+  EXPECT_EQ(stats.promotions, 1);
+  EXPECT_EQ(stats.promotion_failures, 1);
+
+  // A failed promotion makes the source eligible again.
+  for (int i = 0; i < 2; ++i) (void)manager.RecordUse("bad");
+  EXPECT_TRUE(manager.RecordUse("bad"));
+}
+
+TEST(TieredCompilationTest, HitCounters) {
+  TieredCompilationManager manager(TestOptions());
+  manager.RecordCacheHit(TieredCompilationManager::Tier::kFast);
+  manager.RecordCacheHit(TieredCompilationManager::Tier::kOptimized);
+  manager.RecordCacheHit(TieredCompilationManager::Tier::kOptimized);
+  manager.RecordFastCompile();
+  const auto stats = manager.GetStats();
+  EXPECT_EQ(stats.fast_hits, 1);
+  EXPECT_EQ(stats.optimized_hits, 2);
+  EXPECT_EQ(stats.fast_compiles, 1);
+}
+
+}  // namespace
+}  // namespace dcodex